@@ -219,11 +219,13 @@ import_array();
 }
 
 #define RUNMTH(T, WS_T)\
-  CCube<T>* run(CCube<T>& image, CCube<T>& psf)\
+  CCube<T>* run(const CCube<T>& image, const CCube<T>& psf)\
   {\
     CCube<T>* object = new CCube<T>(image);		\
     WS_T ws;\
-    self->run(image.length(), image.width(), image.height(), image.data(), psf.data(), object->data(), ws);\
+    const T* image_data = image.data();\
+    const T* psf_data = psf.data();\
+    self->run(image.length(), image.width(), image.height(), image_data, psf_data, object->data(), ws);\
     return object;\
   }
 
@@ -244,3 +246,44 @@ import_array();
   RUNMTH(float, EMsws);
   RUNMTH(double, EMdws);
 }
+
+/* the session rewrites the psf and the image, so the wrappers pass aligned copies and leave the cubes of the caller untouched */
+#define SESSIONMTH(T)\
+  void prepare(const CCube<T>& psf)\
+  {\
+    T* copy;\
+    WS_malloc(copy, psf.size());\
+    for (size_t i = 0; i < psf.size(); i++) copy[i] = psf.data()[i];\
+    try { self->prepare(psf.length(), psf.width(), psf.height(), copy); }\
+    catch (...) { WS_free(copy); throw; }\
+    WS_free(copy);\
+  }\
+  CCube<T>* run(const CCube<T>& image)\
+  {\
+    T* copy;\
+    WS_malloc(copy, image.size());\
+    for (size_t i = 0; i < image.size(); i++) copy[i] = image.data()[i];\
+    CCube<T>* object = new CCube<T>(image);		\
+    try { self->run(copy, object->data()); }\
+    catch (...) { WS_free(copy); delete object; throw; }\
+    WS_free(copy);\
+    return object;\
+  }
+
+%extend LWsession
+{
+  SESSIONMTH(float);
+  SESSIONMTH(double);
+}
+
+%extend CGsession
+{
+  SESSIONMTH(float);
+  SESSIONMTH(double);
+}
+
+%extend EMsession
+{
+  SESSIONMTH(float);
+  SESSIONMTH(double);
+}
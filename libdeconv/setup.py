@@ -9,7 +9,7 @@ def configuration(parent_package='',top_path=None):
     deconv_src = os.path.join(config.local_path, 'src','deconv','libdeconv')
     assert os.path.isdir(deconv_src),'Directory %r not found. Fix deconv_src in %s' % (deconv_src, __file__)
 
-    libs_info = dict (libraries = ['deconv_shared', 'gsl'])
+    libs_info = dict (libraries = ['deconv_shared', 'gsl', 'pthread'])
     blas_opt = get_info('blas_opt',notfound_action=2)
     if not blas_opt:
         raise NotFoundError,'no blas resources found'
@@ -21,6 +21,12 @@ def configuration(parent_package='',top_path=None):
     dict_append(libs_info, **blas_opt)
     if ('ATLAS_REQUIRES_GFORTRAN', None) in define_macros:
         dict_append(libs_info, libraries = ['gfortran'])
+    # optional FFTW3 threads libraries, they must precede the fftw3 libraries
+    deconv_macros = []
+    from ctypes.util import find_library
+    if find_library('fftw3_threads') and find_library('fftw3f_threads'):
+        dict_append(libs_info, libraries = ['fftw3_threads', 'fftw3f_threads'])
+        deconv_macros.append(('HAVE_FFTW3_THREADS', None))
     fftw3_info = get_info('fftw3',notfound_action=2)
     dict_append (fftw3_info, libraries = ['fftw3f'])
     if not fftw3_info:
@@ -29,7 +35,8 @@ def configuration(parent_package='',top_path=None):
 
     config.add_library('deconv_shared',
                        sources = glob.glob (os.path.join (deconv_src, '*.cc')),
-                       depends = glob.glob (os.path.join (deconv_src, '*.h')))
+                       depends = glob.glob (os.path.join (deconv_src, '*.h')),
+                       macros = deconv_macros)
     config.add_extension('_deconv',
                          sources = ['deconv.i'],
                          include_dirs = [deconv_src],
@@ -24,7 +24,8 @@
 
 template<> int CCube< unsigned char >::read( const char * filename )
 {
-	int length, width, height, cube_size ;
+	int length, width, height ;
+	size_t cube_size ;
 	std::string s = std::string( filename ) ;
 	std::string::size_type dot_pos = s.find_last_of( "." ) ;
 	std::string filehead = s.substr( 0, dot_pos ) ;
@@ -33,7 +34,7 @@ template<> int CCube< unsigned char >::read( const char * filename )
 	if( suffix == std::string( "u8" ) )
 	{
 		read_my_cube_hdr( filehead, length, width, height ) ;
-		cube_size = length * width * height ;	
+		cube_size = (size_t) length * width * height ;	
 		init( length, width, height ) ;
 		read_my_byte_cube_data( filename, cube_size, _data ) ;
 		return 1 ;
@@ -49,7 +50,8 @@ template<> int CCube< unsigned char >::read( const char * filename )
 
 template<> int CCube< unsigned short >::read( const char * filename )
 {
-	int length, width, height, cube_size ;
+	int length, width, height ;
+	size_t cube_size ;
 	std::string s = std::string( filename ) ;
 	std::string::size_type dot_pos = s.find_last_of( "." ) ;
 	std::string filehead = s.substr( 0, dot_pos ) ;
@@ -58,14 +60,14 @@ template<> int CCube< unsigned short >::read( const char * filename )
 	if( suffix == std::string( "u8" ) || suffix == std::string( "i16" ) )
 	{
 		read_my_cube_hdr( filehead, length, width, height ) ;
-		cube_size = length * width * height ;
+		cube_size = (size_t) length * width * height ;
 		init( length, width, height ) ;	
 		if( suffix == std::string( "u8" ) )
 		{
 			unsigned char* buf = (unsigned char*)fftw_malloc (cube_size * sizeof(unsigned char)) ;
 //			ByteArray buf( new unsigned char[ cube_size ] ) ;
 			read_my_byte_cube_data( filename, cube_size, buf) ;
-			for( int i = 0 ; i < cube_size ; i++ ) _data[i] = (unsigned short) buf[i] ;
+			for( size_t i = 0 ; i < cube_size ; i++ ) _data[i] = (unsigned short) buf[i] ;
 			fftw_free (buf) ;
 			return 1 ;
 		}
@@ -86,7 +88,8 @@ template<> int CCube< unsigned short >::read( const char * filename )
 
 template<> int CCube< int >::read( const char * filename )
 {
-	int length, width, height, cube_size ;
+	int length, width, height ;
+	size_t cube_size ;
 	std::string s = std::string( filename ) ;
 	std::string::size_type dot_pos = s.find_last_of( "." ) ;
 	std::string filehead = s.substr( 0, dot_pos ) ;
@@ -95,14 +98,14 @@ template<> int CCube< int >::read( const char * filename )
 	if( suffix == std::string( "u8" ) || suffix == std::string( "i16" ) )
 	{
 		read_my_cube_hdr( filehead, length, width, height ) ;
-		cube_size = length * width * height ;
+		cube_size = (size_t) length * width * height ;
 		init( length, width, height ) ;		
 		if( suffix == std::string( "u8" ) )
 		{
 			unsigned char* buf = (unsigned char*)fftw_malloc (cube_size * sizeof (unsigned char)) ;
 //			ByteArray buf( new unsigned char[ cube_size ] ) ;
 			read_my_byte_cube_data( filename, cube_size, buf) ;
-			for( int i = 0 ; i < cube_size ; i++ ) _data[i] = (int) buf[i] ;
+			for( size_t i = 0 ; i < cube_size ; i++ ) _data[i] = (int) buf[i] ;
 			fftw_free (buf) ;
 			return 1 ;
 		}
@@ -111,7 +114,7 @@ template<> int CCube< int >::read( const char * filename )
 			unsigned short* buf = (unsigned short*)fftw_malloc (cube_size * sizeof (unsigned short)) ;
 //			ShortArray buf( new unsigned short[ cube_size ] ) ;
 			read_my_short_cube_data( filename, cube_size, buf ) ;
-			for( int i = 0 ; i < cube_size ; i++ ) _data[i] = (int) buf[i] ;
+			for( size_t i = 0 ; i < cube_size ; i++ ) _data[i] = (int) buf[i] ;
 			fftw_free (buf) ;
 			return 2 ;
 		}
@@ -127,7 +130,8 @@ template<> int CCube< int >::read( const char * filename )
 	
 template<> int CCube< float >::read( const char * filename )
 {
-	int length, width, height, cube_size ;
+	int length, width, height ;
+	size_t cube_size ;
 	std::string s = std::string( filename ) ;
 	std::string::size_type dot_pos = s.find_last_of( "." ) ;
 	std::string filehead = s.substr( 0, dot_pos ) ;
@@ -136,7 +140,7 @@ template<> int CCube< float >::read( const char * filename )
 	if( suffix == std::string( "u8" ) || suffix == std::string( "i16" ) || suffix == std::string( "f32" ) )
 	{
 		read_my_cube_hdr( filehead, length, width, height ) ;
-		cube_size = length * width * height ;	
+		cube_size = (size_t) length * width * height ;	
 		init( length, width, height ) ;	
 		if( suffix == std::string( "u8" ) || suffix == std::string( "i16" ) )
 		{
@@ -145,7 +149,7 @@ template<> int CCube< float >::read( const char * filename )
 				unsigned char* buf = (unsigned char*)fftw_malloc (cube_size * sizeof (unsigned short)) ;
 //				ByteArray buf( new unsigned char[ cube_size ] ) ;
 				read_my_byte_cube_data( filename, cube_size, buf ) ;
-				for( int i = 0 ; i < cube_size ; i++ ) _data[i] = (float) buf[i] ;
+				for( size_t i = 0 ; i < cube_size ; i++ ) _data[i] = (float) buf[i] ;
 				fftw_free (buf) ;
 				return 1 ;
 			}
@@ -154,7 +158,7 @@ template<> int CCube< float >::read( const char * filename )
 				unsigned short* buf = (unsigned short*)fftw_malloc (cube_size * sizeof (unsigned short)) ;				
 //				ShortArray buf( new unsigned short[ cube_size ] ) ;
 				read_my_short_cube_data( filename, cube_size, buf) ;
-				for( int i = 0 ; i < cube_size ; i++ ) _data[i] = (float) buf[i] ;
+				for( size_t i = 0 ; i < cube_size ; i++ ) _data[i] = (float) buf[i] ;
 				fftw_free (buf) ;
 				return 2 ;
 			}
@@ -176,7 +180,8 @@ template<> int CCube< float >::read( const char * filename )
 
 template<> int CCube< double >::read( const char * filename )
 {
-	int length, width, height, cube_size ;
+	int length, width, height ;
+	size_t cube_size ;
 	std::string s = std::string( filename ) ;
 	std::string::size_type dot_pos = s.find_last_of( "." ) ;
 	std::string filehead = s.substr( 0, dot_pos ) ;
@@ -186,7 +191,7 @@ template<> int CCube< double >::read( const char * filename )
 	    suffix == std::string( "f32" ) || suffix == std::string( "f64" ) )
 	{
 		read_my_cube_hdr( filehead, length, width, height ) ;
-		cube_size = length * width * height ;
+		cube_size = (size_t) length * width * height ;
 		init( length, width, height ) ;
 		if( suffix == std::string( "u8" ) || suffix == std::string( "i16" ) || suffix == std::string( "f32" ) )
 		{ 		
@@ -195,7 +200,7 @@ template<> int CCube< double >::read( const char * filename )
 				unsigned char* buf = (unsigned char*)fftw_malloc (cube_size * sizeof (unsigned char)) ;
 //				ByteArray buf( new unsigned char[ cube_size ] ) ;
 				read_my_byte_cube_data( filename, cube_size, buf ) ;
-				for( int i = 0 ; i < cube_size ; i++ ) _data[i] = (double) buf[i] ;
+				for( size_t i = 0 ; i < cube_size ; i++ ) _data[i] = (double) buf[i] ;
 				fftw_free (buf) ;
 				return 1 ;
 			}
@@ -204,7 +209,7 @@ template<> int CCube< double >::read( const char * filename )
 				unsigned short* buf = (unsigned short*)fftw_malloc (cube_size * sizeof (unsigned short)) ;
 //				ShortArray buf( new unsigned short[ cube_size ] ) ;
 				read_my_short_cube_data( filename, cube_size, buf ) ;
-				for( int i = 0 ; i < cube_size ; i++ ) _data[i] = (double) buf[i] ;
+				for( size_t i = 0 ; i < cube_size ; i++ ) _data[i] = (double) buf[i] ;
 				fftw_free (buf) ;
 				return 2 ;
 			}
@@ -213,7 +218,7 @@ template<> int CCube< double >::read( const char * filename )
 				float* buf = (float*)fftw_malloc (cube_size * sizeof (float)) ;
 //				SingleArray buf( new float[ cube_size ] ) ;
 				read_my_single_cube_data( filename, cube_size, buf ) ;
-				for( int i = 0 ; i < cube_size ; i++ ) _data[i] = (double) buf[i] ;
+				for( size_t i = 0 ; i < cube_size ; i++ ) _data[i] = (double) buf[i] ;
 				fftw_free (buf) ;
 				return 3 ;
 			}
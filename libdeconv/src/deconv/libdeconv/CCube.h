@@ -23,7 +23,9 @@
 #define CCUBE_H_DEFINED
 
 
+#include <algorithm>
 #include "CSlice.h"
+#include "MYthreads.h"
 
 
 /* 
@@ -124,7 +126,7 @@ class CCube {
 	/*
 	 *	Copy constructor : copy cube to the CCube
 	 */
-	CCube( const CCube& cube )
+	CCube( const CCube& cube ) : _data( NULL )
 	{
 		*this = cube ;
 	}
@@ -140,7 +142,7 @@ class CCube {
 	 *	Throw:
 	 *		throw an error if length < 0 or width < 0 or height < 0.
 	 */
-	CCube( int length = 0, int width = 0, int height = 0, T* data = NULL )
+	CCube( int length = 0, int width = 0, int height = 0, T* data = NULL ) : _data( NULL )
 	{ 
 		init( length, width, height, data ) ;
 	}
@@ -162,7 +164,7 @@ class CCube {
 //		DataArray temp( new T[ _length * _width * _height ] ) ;
 		_data = (T*)fftw_malloc (sizeof(T) *_length * _width * _height);
 
-		for( int i = 0 ; i < _length * _width * _height ; i++ )
+		for( size_t i = 0 ; i < (size_t) _length * _width * _height ; i++ )
 		{
 			_data[i] = (cube.data())[i] ;
 		}
@@ -184,7 +186,7 @@ class CCube {
 		}
 		else
 		{
-			for( int i = 0 ; i < _length * _width * _height ; i++ )
+			for( size_t i = 0 ; i < (size_t) _length * _width * _height ; i++ )
 			{ 
 				if( _data[i] != (cube.data())[i] ) return false ;
 			}
@@ -220,7 +222,7 @@ class CCube {
 			{
 //				DataArray temp( new T[ length * width * height ] ) ;
 //				_data = temp ;
-				for( int i = 0 ; i < length * width * height ; i++ )
+				for( size_t i = 0 ; i < (size_t) length * width * height ; i++ )
 				{
 					_data[i] = data[i] ;
 				}
@@ -291,7 +293,7 @@ class CCube {
   	int	length  () const                   { return _length ;                                   }
   	int	width   () const                   { return _width  ;                                   }
   	int	height  () const                   { return _height ;                                   }
-	int	size    () const                   { return ( _length * _width * _height ) ;            }
+	size_t	size    () const                   { return ( (size_t) _length * _width * _height ) ;   }
   	T*	data    () const                   { return _data ;                               }
   	
   	
@@ -308,7 +310,7 @@ class CCube {
   	 */
 	T&	operator() ( int x, int y, int z ) 
 	{
-		return _data[ z*_length*_width + y*_length + x ] ;
+		return _data[ (size_t) z*_length*_width + y*_length + x ] ;
 	}
 	
 
@@ -329,7 +331,7 @@ class CCube {
 		{
 			throw CubeAccessError( x, y, z, _length, _width, _height ) ;
 		}
-		else    _data[ z*_length*_width + y*_length + x ] = value ;
+		else    _data[ (size_t) z*_length*_width + y*_length + x ] = value ;
 	}
 
 
@@ -350,7 +352,7 @@ class CCube {
 		{
 			throw CubeAccessError( x, y, z, _length, _width, _height ) ;
 		}
-		else    value = _data[ z*_length*_width + y*_length + x ] ;
+		else    value = _data[ (size_t) z*_length*_width + y*_length + x ] ;
 	}
 
 
@@ -365,7 +367,7 @@ class CCube {
 	{
 		if( Valid( true ) )
 		{
-			for( int i = 0 ; i < _length * _width * _height ; i++ )
+			for( size_t i = 0 ; i < (size_t) _length * _width * _height ; i++ )
 			{
 		 		_data[i] = value ;
 		 	}
@@ -627,7 +629,7 @@ int CCube<T>::getslice( int slice_index , int slice_plane , CSlice<T>& slice )
 				slice.init( _length, _width ) ; 
 				for( int j = 0 ; j < _width ; ++j )
 					for( int i = 0 ; i < _length ; ++i )
-						slice( i, j ) = _data[ slice_index*_width*_length + j*_length + i ] ;
+						slice( i, j ) = _data[ (size_t) slice_index*_width*_length + j*_length + i ] ;
 				return 0 ;
 			}
 			break ;
@@ -644,7 +646,7 @@ int CCube<T>::getslice( int slice_index , int slice_plane , CSlice<T>& slice )
 				slice.init( _length, _height ) ;
 				for( int j = 0 ; j < _height ; ++j )
 					for( int i = 0 ; i < _length ; ++i )
-						slice( i, j ) = _data[ j*_width*_length + slice_index*_length + i ] ;
+						slice( i, j ) = _data[ (size_t) j*_width*_length + slice_index*_length + i ] ;
 				return 0 ;
 			}
 			break ;
@@ -661,7 +663,7 @@ int CCube<T>::getslice( int slice_index , int slice_plane , CSlice<T>& slice )
 				slice.init( _width, _height ) ;
 				for( int j = 0 ; j < _height ; ++j )
 					for( int i = 0 ; i < _width ; ++i )
-						slice( i, j ) = _data[ j*_width*_length + i*_length + slice_index ] ;
+						slice( i, j ) = _data[ (size_t) j*_width*_length + i*_length + slice_index ] ;
 				return 0 ;
 			}
 			break ;
@@ -699,7 +701,7 @@ int CCube<T>::setslice( int slice_index, int slice_plane, CSlice<T> slice )
 			{
 				for( int j = 0 ; j < _width ; ++j )
 					for( int i = 0 ; i < _length ; ++i )
-						_data[ slice_index*_width*_length + j*_length + i ] = (slice.data())[ i + j*_length ] ;
+						_data[ (size_t) slice_index*_width*_length + j*_length + i ] = (slice.data())[ i + j*_length ] ;
 				return 0 ;
 			}
 			break ;
@@ -722,7 +724,7 @@ int CCube<T>::setslice( int slice_index, int slice_plane, CSlice<T> slice )
 			{
 				for( int j = 0 ; j < _height ; ++j )
 					for( int i = 0 ; i < _length ; ++i )
-						_data[ j*_width*_length + slice_index*_length + i ] = (slice.data())[ i + j*_length ] ;
+						_data[ (size_t) j*_width*_length + slice_index*_length + i ] = (slice.data())[ i + j*_length ] ;
 				return 0 ;
 			}
 			break ;
@@ -745,7 +747,7 @@ int CCube<T>::setslice( int slice_index, int slice_plane, CSlice<T> slice )
 			{
 				for( int j = 0 ; j < _height ; ++j )
 					for( int i = 0 ; i < _width ; ++i )
-						_data[ j*_width*_length + i*_length + slice_index ] = (slice.data())[ i + j*_width ] ;
+						_data[ (size_t) j*_width*_length + i*_length + slice_index ] = (slice.data())[ i + j*_width ] ;
 				return 0 ;
 			}
 			break ;
@@ -782,7 +784,7 @@ int CCube<T>::draw_cylinder(int cx, int cy, int cz, int rx, int ry, int hz, T va
 				for( int j = cy-ry ; j <= cy+ry ; ++j )
 					for( int i = cx-rx ; i <= cx+rx ; ++i )
 						if( ( ((double)((j-cy)*(j-cy)))/ry2 + ((double)((i-cx)*(i-cx)))/rx2 ) <= 1.0  ) 
-							_data[ k*_width*_length + j*_length + i ] = value ;
+							_data[ (size_t) k*_width*_length + j*_length + i ] = value ;
 		}
 		return 0 ;
 	}
@@ -814,7 +816,7 @@ int CCube<T>::draw_ellipse(int cx, int cy, int cz, int rx, int ry, int rz, T val
 					for( int i = cx-rx ; i <= cx+rx ; ++i )
 						if( ( ((double)((k-cz)*(k-cz)))/rz2 + ((double)((j-cy)*(j-cy)))/ry2 
 						                         + ((double)((i-cx)*(i-cx)))/rx2 ) <= 1.0 ) 
-							_data[ k*_width*_length + j*_length + i ] = value ;
+							_data[ (size_t) k*_width*_length + j*_length + i ] = value ;
 		}
 		return 0 ;
 	}
@@ -872,8 +874,8 @@ int CCube<T>::length_crop( int index0, int index1 )
 			for( int k = 0 ; k < _height ; k++ )
 				for( int j = 0 ; j < _width ; j++ )
 					for( int i = 0 ; i < length ; i++ )
-						buf[ k*_width*length + j*length + i ] 
-						= _data[ k*_width*_length + j*_length + i+index0 ] ;  	    	 
+						buf[ (size_t) k*_width*length + j*length + i ] 
+						= _data[ (size_t) k*_width*_length + j*_length + i+index0 ] ;  	    	 
 
 			_init( length, _width, _height, buf ) ;
 			fftw_free (buf) ;
@@ -907,8 +909,8 @@ int CCube<T>::width_crop( int index0, int index1 )
 			for( int k = 0 ; k < _height ; k++ )	  	  
 				for( int j = 0 ; j < width ; j++ )
 					for( int i = 0 ; i < _length ; i++ )
-						buf[ k*width*_length + j*_length + i ] 
-						= _data[ k*_width*_length + (j+index0)*_length + i ] ;
+						buf[ (size_t) k*width*_length + j*_length + i ] 
+						= _data[ (size_t) k*_width*_length + (j+index0)*_length + i ] ;
 
 			_init( _length, width, _height, buf ) ;
 			fftw_free (buf) ;
@@ -942,8 +944,8 @@ int CCube<T>::height_crop( int index0, int index1 )
 			for( int k = 0 ; k < height ; ++k )	  	  
 				for( int j = 0 ; j < _width ; ++j )
 					for( int i = 0 ; i < _length ; ++i )
-						buf[ k*_width*_length + j*_length + i ] 
-						= _data[ (k+index0)*_width*_length + j*_length + i ] ;
+						buf[ (size_t) k*_width*_length + j*_length + i ] 
+						= _data[ (size_t) (k+index0)*_width*_length + j*_length + i ] ;
 
 			_init( _length, _width, height, buf ) ;
 			fftw_free (buf) ;
@@ -972,13 +974,13 @@ int CCube<T>::length_pad( int num0, int num1, T value )
 			int length = num1 + num0 + _length ;
 			T* buf = (T*)fftw_malloc (sizeof(T) * _length * _width * _height) ;
 //			DataArray buf( new T [ length * _width * _height ] ) ;
-			for( int i = 0 ; i < length * _width * _height ; i++ ) buf[i] = value ;
+			for( size_t i = 0 ; i < (size_t) length * _width * _height ; i++ ) buf[i] = value ;
 
 			for( int k = 0 ; k < _height ; ++k )	  	  
 				for( int j = 0 ; j < _width ; ++j )
 					for( int i = 0 ; i < _length ; ++i )
-						buf[ k*_width*length + j*length + i+num0 ] 
-						= _data[ k*_width*_length + j*_length + i ] ;
+						buf[ (size_t) k*_width*length + j*length + i+num0 ] 
+						= _data[ (size_t) k*_width*_length + j*_length + i ] ;
 
 			_init( length, _width, _height, buf ) ;
 			fftw_free (buf) ;
@@ -1006,13 +1008,13 @@ int CCube<T>::width_pad(int num0, int num1, T value)
 			int width = num1 + num0 + _width ;
 			T* buf = (T*)fftw_malloc (sizeof(T) * _length * _width * _height) ;
 //			DataArray buf( new T [ _length * width * _height ] ) ;
-			for( int i = 0 ; i < _length * width * _height ; i++ ) buf[i] = value ;
+			for( size_t i = 0 ; i < (size_t) _length * width * _height ; i++ ) buf[i] = value ;
 
 			for( int k = 0 ; k < _height ; ++k )	  	  
 				for( int j = 0 ; j < _width ; ++j )
 					for( int i = 0 ; i < _length ; ++i )
-						buf[ k*width*_length + (j+num0)*_length + i ] 
-						= _data[ k*_width*_length + j*_length + i ] ;
+						buf[ (size_t) k*width*_length + (j+num0)*_length + i ] 
+						= _data[ (size_t) k*_width*_length + j*_length + i ] ;
 
 			_init( _length, width, _height, buf ) ;
 
@@ -1040,13 +1042,13 @@ int CCube<T>::height_pad(int num0, int num1, T value)
 			int height = num1 + num0 + _height ;
 			T* buf = (T*)fftw_malloc (sizeof(T) * _length * _width * _height) ;
 //			DataArray buf( new T [ _length * _width * height ] ) ;
-			for( int i = 0 ; i < _length * _width * height ; i++ ) buf[i] = value ;
+			for( size_t i = 0 ; i < (size_t) _length * _width * height ; i++ ) buf[i] = value ;
 
 			for( int k = 0 ; k < _height ; ++k )	  	  
 				for( int j = 0 ; j < _width ; ++j )
 					for( int i = 0 ; i < _length ; ++i )
-						buf[ (k+num0)*_width*_length + j*_length + i ] 
-						= _data[ k*_width*_length + j*_length + i ] ;
+						buf[ (size_t) (k+num0)*_width*_length + j*_length + i ] 
+						= _data[ (size_t) k*_width*_length + j*_length + i ] ;
 
 			_init( _length, _width, height, buf ) ;
 
@@ -1065,7 +1067,7 @@ double CCube<T>::cubemaxval ()
 	{
 		double max_value = (double) _data[0] ;		
 
-		for( int i = 0 ; i < _length * _width * _height ; ++i )
+		for( size_t i = 0 ; i < (size_t) _length * _width * _height ; ++i )
 		{ 
 			if( ((double)_data[i]) > max_value ) max_value = (double) _data[i] ;
 		}
@@ -1084,7 +1086,7 @@ double CCube<T>::cubeminval()
 	{
 		double min_value = (double) _data[0] ;  		
 
-		for( int i = 0 ; i < _length * _width * _height ; ++i )
+		for( size_t i = 0 ; i < (size_t) _length * _width * _height ; ++i )
 		{ 
 			if( ((double)_data[i]) < min_value ) min_value = (double) _data[i] ;
 		}
@@ -1103,7 +1105,7 @@ double CCube<T>::cubemeanval()
 	{
 		double mean_value = 0.0 ;  		
 
-		for( int i = 0 ; i < _length * _width * _height ; ++i ) 
+		for( size_t i = 0 ; i < (size_t) _length * _width * _height ; ++i ) 
 		{
 			mean_value += ((double)_data[i]) ;
 		}
@@ -1124,12 +1126,12 @@ double CCube<T>::cubevarval()
 		double var_value  = 0.0 ;
 		double mean_value = 0.0 ;  		
 
-		for( int i = 0 ; i < _length * _width * _height ; ++i )
+		for( size_t i = 0 ; i < (size_t) _length * _width * _height ; ++i )
 		{ 
 			mean_value += ((double)_data[i]) ;
 		}
 		mean_value /= ((double)(_length * _width * _height)) ;	  	
-		for( int i = 0 ; i < _length * _width * _height ; ++i )
+		for( size_t i = 0 ; i < (size_t) _length * _width * _height ; ++i )
 		{ 
 			var_value += ( ( (double)_data[i] - mean_value ) * ( (double)_data[i] - mean_value ) ) ;
 		}
@@ -1149,7 +1151,7 @@ double CCube<T>::cubesumval()
 	{
 		double sum_value  = 0.0 ;
 	  	
-		for( int i = 0 ; i< _length * _width * _height ; ++i )
+		for( size_t i = 0 ; i < (size_t) _length * _width * _height ; ++i )
 		{ 
 			sum_value += ((double)_data[i]) ; 
 		}
@@ -1161,51 +1163,57 @@ double CCube<T>::cubesumval()
 
 
 
+/*
+ *	CCube::shift() swaps the octant at (i, j, k) with the one at (i+L/2, j+W/2, k+H/2), modulo the dimensions.
+ *	Each x-row is swapped as two contiguous halves, and the slabs k < H/2 are shared among get_my_threads() threads.
+ */
+template <typename T>
+struct CCube_shiftArgs
+{
+	int   length ;
+	int   width ;
+	int   height ;
+	T   * data ;
+} ;
+
+
+template <typename T>
+void CCube_shiftSlabs( size_t begin, size_t end, void * arg )
+{
+	CCube_shiftArgs<T> * a = (CCube_shiftArgs<T> *) arg ;
+	int    hl    = a->length / 2 ;
+	size_t slice = (size_t) a->length * a->width ;
+
+	for( size_t k = begin ; k < end ; k++ )
+	{
+		for( int j = 0 ; j < a->width ; j++ )
+		{
+			int  jj  = ( j + a->width / 2 ) % a->width ;
+			T  * row = a->data + k * slice + (size_t) j * a->length ;
+			T  * opp = a->data + ( k + a->height / 2 ) * slice + (size_t) jj * a->length ;
+
+			std::swap_ranges( row, row + hl, opp + hl ) ;
+			std::swap_ranges( row + hl, row + a->length, opp ) ;
+		}
+	}
+}
+
+
 template <typename T>
 int CCube<T>::shift()
 { 	
-	T temp ;
 	if( Valid( true ) )
 	{
 		if( _length%2 == 0 && _width%2 == 0 && _height%2 == 0 ) 
 		{
-			for( int k = 0 ; k < _height/2 ; k++ ) 
-			{
-				for( int j = 0 ; j < _width/2 ; j++ ) 
-				{
-					for( int i = 0 ; i < _length/2 ; i++ ) 
-					{
-						temp = _data[ i + j*_length + k*_length*_width ] ;
-						_data[ i + j*_length + k*_length*_width ] 
-						= _data[ i+_length/2 + (j+_width/2)*_length + (k+_height/2)*_length*_width ] ;
-						_data[ i+_length/2 + (j+_width/2)*_length + (k+_height/2)*_length*_width ] = temp ;
-					}
-					for( int i = _length/2 ; i < _length ; i++ ) 
-					{
-						temp = _data[ i + j*_length + k*_length*_width ] ;
-						_data[ i + j*_length + k*_length*_width ] 
-						= _data[ i-_length/2 + (j+_width/2)*_length + (k+_height/2)*_length*_width ] ;
-						_data[ i-_length/2 + (j+_width/2)*_length + (k+_height/2)*_length*_width ] = temp ;
-					}
-				}
-				for( int j = _width/2 ; j < _width ; j++ ) 
-				{
-					for( int i = 0 ; i < _length/2 ; i++ ) 
-					{
-						temp = _data[ i + j*_length + k*_length*_width ] ;
-						_data[ i + j*_length + k*_length*_width ] 
-						= _data[ i+_length/2 + (j-_width/2)*_length + (k+_height/2)*_length*_width ] ;
-						_data[ i+_length/2 + (j-_width/2)*_length + (k+_height/2)*_length*_width ] = temp ;
-					}
-					for( int i = _length/2 ; i < _length ; i++ ) 
-					{
-						temp = _data[ i + j*_length + k*_length*_width ] ;
-						_data[ i + j*_length + k*_length*_width ] 
-						= _data[ i-_length/2 + (j-_width/2)*_length + (k+_height/2)*_length*_width ] ;
-						_data[ i-_length/2 + (j-_width/2)*_length + (k+_height/2)*_length*_width ] = temp ;
-					}
-				}
-			}
+			CCube_shiftArgs<T> a ;
+
+			a.length = _length ;
+			a.width  = _width ;
+			a.height = _height ;
+			a.data   = _data ;
+
+			my_parallel_for( (size_t) _height/2, 1, CCube_shiftSlabs<T>, &a ) ;
 		}
 		else
 		{
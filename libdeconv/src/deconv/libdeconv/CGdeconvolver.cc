@@ -21,6 +21,7 @@
 
 #include <math.h>
 #include "CGdeconvolver.h"
+#include "SPECTRALkernels.h"
 
 
 CGdeconvolver::CGdeconvolver()
@@ -28,20 +29,114 @@ CGdeconvolver::CGdeconvolver()
 	init() ; 
 }
 
-/* public functions */
-CGdeconvolver::~CGdeconvolver()
+template< class WS >
+static void CGdeallocate( WS & ws )
 {
-	if (_FFTplanf)
-		delete _FFTplanf ;
+	WS_free( ws.psf_re ) ;
+	WS_free( ws.psf_im ) ;
+	WS_free( ws.image_re ) ;
+	WS_free( ws.image_im ) ;
+	WS_free( ws.otf ) ;
+	WS_free( ws.cg_re ) ;
+	WS_free( ws.cg_im ) ;
+	WS_free( ws.sign ) ;
+}
+
+/*
+	The CG working space: seven spectra of <size>, six if the PSF spectrum is real, split or interleaved, 
+	and the signs of the object, allocated with fftw_malloc(); returns its size in bytes.
+	If an array can not be allocated, the ones already allocated are freed and std::bad_alloc is thrown.
+*/
+template< class WS >
+static size_t CGallocate( WS & ws, size_t size, size_t space, bool interleaved, bool real )
+{
+	size_t bytes = 0 ;
+	size_t n     = interleaved ? 2 * size : size ;
+	
+	ws.size = size ;
+	ws.real = real ;
+	try
+	{
+		bytes += WS_malloc( ws.psf_re,   real ? size : n ) ;
+		bytes += WS_malloc( ws.psf_im,   ( real || interleaved ) ? 0 : size ) ;
+		bytes += WS_malloc( ws.image_re, n ) ;
+		bytes += WS_malloc( ws.image_im, interleaved ? 0 : size ) ;
+		bytes += WS_malloc( ws.otf,      size ) ;
+		bytes += WS_malloc( ws.cg_re,    n ) ;
+		bytes += WS_malloc( ws.cg_im,    interleaved ? 0 : size ) ;
+		bytes += WS_malloc( ws.sign,     space ) ;
+	}
+	catch( std::bad_alloc & )
+	{
+		CGdeallocate( ws ) ;
+		throw ;
+	}
+	
+	return bytes ;
+}
+
+/*
+	The loops of the CG update on the object, see "MYthreads.h"; the sums are taken in <T> as before.
+	CGstart     : dir = res, sign = 1, returns res . res ; the first direction.
+	CGdirection : dir = res + beta * dir.
+	CGdot       : returns the sum of a * b * sign, or of a * b if <sign> is NULL.
+*/
+template< class T >
+struct CGstart
+{
+	typedef T result ;
+	const T * res ; T * dir ; unsigned char * sign ;
+	
+	T operator()( size_t begin, size_t end ) const
+	{
+		T sum = 0.0 ;
+		for( size_t i = begin ; i < end ; i++ ) 
+		{
+			 dir[i] = res[i] ;
+			sign[i] = ( unsigned char ) 1 ;
+			   sum += ( res[i] * res[i] ) ;
+		}
+		return sum ;
+	}
+	
+	void join( T & total, const T & partial ) const { total += partial ; }
+} ;
+
+template< class T >
+struct CGdirection
+{
+	const T * res ; T * dir ; T beta ;
+	
+	void operator()( size_t begin, size_t end ) const
+	{
+		for( size_t i = begin ; i < end ; i++ ) dir[i] = res[i] + beta * dir[i] ;
+	}
+} ;
+
+template< class T >
+struct CGdot
+{
+	typedef T result ;
+	const T * a ; const T * b ; const unsigned char * sign ;
+	
+	T operator()( size_t begin, size_t end ) const
+	{
+		T sum = 0.0 ;
+		if( sign == NULL ) for( size_t i = begin ; i < end ; i++ ) sum += ( a[i] * b[i] ) ;
+		else               for( size_t i = begin ; i < end ; i++ ) sum += ( a[i] * b[i] * ((T) sign[i]) ) ;
+		return sum ;
+	}
+	
+	void join( T & total, const T & partial ) const { total += partial ; }
+} ;
 
-	if (_FFTplanff)
-		delete _FFTplanff ;
-		
-	if (_FFTplanb)
-		delete _FFTplanb ;
 
-	if (_FFTplanbb)
-		delete _FFTplanbb ;
+
+/* public functions */
+CGdeconvolver::~CGdeconvolver()
+{
+	FFTW3_PlanCache::release( _FFTplanf ) ;
+	FFTW3_PlanCache::release( _FFTplanb ) ;
 }
 
 void CGdeconvolver::init( bool IsApplyIR, bool IsApplyNorm, bool IsTrackLike, bool IsTrackMax, bool IsCheckStatus )
@@ -91,27 +186,135 @@ void CGdeconvolver::exportCG( const char * filename )
 	}
 }
 
+void CGdeconvolver::allocWorkspace( int DimX, int DimY, int DimZ, CGdws & ws )
+{
+	freeWorkspace( ws ) ;
+	_setDimensions( DimX, DimY, DimZ ) ;
+	ws.bytes = CGallocate( ws, FFTW3_FFT::FFTsize( _DimX, _DimY, _DimZ ), _Space, _Interleaved, _RealOTF ) ;
+}
+
+void CGdeconvolver::allocWorkspace( int DimX, int DimY, int DimZ, CGsws & ws )
+{
+	freeWorkspace( ws ) ;
+	_setDimensions( DimX, DimY, DimZ ) ;
+	ws.bytes = CGallocate( ws, FFTW3_FFT::FFTsize( _DimX, _DimY, _DimZ ), _Space, _Interleaved, _RealOTF ) ;
+}
+
+void CGdeconvolver::freeWorkspace( CGdws & ws )
+{
+	CGdeallocate( ws ) ;
+	ws.size  = 0 ;
+	ws.bytes = 0 ;
+}
+
+void CGdeconvolver::freeWorkspace( CGsws & ws )
+{
+	CGdeallocate( ws ) ;
+	ws.size  = 0 ;
+	ws.bytes = 0 ;
+}
+
 void CGdeconvolver::run( int DimX, int DimY, int DimZ, double * cgr, double * cgp, double * object, 
                          CGdws & ws, unsigned char * SpacialSupport, unsigned char * FrequencySupport )
 {
-	double cri = 1.0E+37, max_intensity = 0.0, gamma = -1.0, alpha = 0.0, beta = 0.0, temp1, temp2, temp3 ;
+	/* initialize running */
+	_CGstartRun( DimX, DimY, DimZ, ws ) ;
+
+	/* start initialization */
+	if( _CheckStatus ) _CGprintStatus( 1 ) ;
+	if( _Interleaved ) _initPSF( _FFTplanf, cgp, ws.psf_re, FrequencySupport, ws.otf ) ;
+	else               _initPSF( ws.size, cgp, ws.psf_re, ws.psf_im, FrequencySupport, ws.otf ) ;
+	_CGrunFrame( cgr, cgp, object, ws, SpacialSupport, _ConditioningIteration > 0 ) ;
+	
+	/* end deconvolution */
+	_CGfinishRun( ws ) ;	
+}
 
+void CGdeconvolver::run( int DimX, int DimY, int DimZ, float * cgr, float * cgp, float * object, 
+                         CGsws & ws, unsigned char * SpacialSupport, unsigned char * FrequencySupport )
+{
 	/* initialize running */
 	_CGstartRun( DimX, DimY, DimZ, ws ) ;
 
 	/* start initialization */
 	if( _CheckStatus ) _CGprintStatus( 1 ) ;
-	_initPSF( ws.size, cgp, ws.psf_re, ws.psf_im, FrequencySupport, ws.otf ) ;
+	if( _Interleaved ) _initPSF( _FFTplanf, cgp, ws.psf_re, FrequencySupport, ws.otf ) ;
+	else               _initPSF( ws.size, cgp, ws.psf_re, ws.psf_im, FrequencySupport, ws.otf ) ;
+	_CGrunFrame( cgr, cgp, object, ws, SpacialSupport, _ConditioningIteration > 0 ) ;
+	
+	/* end deconvolution */
+	_CGfinishRun( ws ) ;	
+}
+
+void CGdeconvolver::run( int DimX, int DimY, int DimZ, const double * image, const double * psf, double * object, 
+                         CGdws & ws, unsigned char * SpacialSupport, unsigned char * FrequencySupport )
+{
+	double * scratch = NULL ;
+	
+	/* initialize running */
+	_CGstartRun( DimX, DimY, DimZ, ws ) ;
+	WS_malloc( scratch, 2 * (size_t)_Space ) ;
+
+	/* start initialization, the forward transform of the psf does not rewrite it */
+	if( _CheckStatus ) _CGprintStatus( 1 ) ;
+	if( _Interleaved ) _initPSF( _FFTplanf, const_cast< double * >( psf ), ws.psf_re, FrequencySupport, ws.otf ) ;
+	else               _initPSF( ws.size, const_cast< double * >( psf ), ws.psf_re, ws.psf_im, FrequencySupport, ws.otf ) ;
+	for( size_t i = 0 ; i < _Space ; i++ ) scratch[i] = image[i] ;
+	_CGrunFrame( scratch, scratch + _Space, object, ws, SpacialSupport, _ConditioningIteration > 0 ) ;
+	WS_free( scratch ) ;
+	
+	/* end deconvolution */
+	_CGfinishRun( ws ) ;	
+}
+
+void CGdeconvolver::run( int DimX, int DimY, int DimZ, const float * image, const float * psf, float * object, 
+                         CGsws & ws, unsigned char * SpacialSupport, unsigned char * FrequencySupport )
+{
+	float * scratch = NULL ;
+	
+	/* initialize running */
+	_CGstartRun( DimX, DimY, DimZ, ws ) ;
+	WS_malloc( scratch, 2 * (size_t)_Space ) ;
+
+	/* start initialization, the forward transform of the psf does not rewrite it */
+	if( _CheckStatus ) _CGprintStatus( 1 ) ;
+	if( _Interleaved ) _initPSF( _FFTplanf, const_cast< float * >( psf ), ws.psf_re, FrequencySupport, ws.otf ) ;
+	else               _initPSF( ws.size, const_cast< float * >( psf ), ws.psf_re, ws.psf_im, FrequencySupport, ws.otf ) ;
+	for( size_t i = 0 ; i < _Space ; i++ ) scratch[i] = image[i] ;
+	_CGrunFrame( scratch, scratch + _Space, object, ws, SpacialSupport, _ConditioningIteration > 0 ) ;
+	WS_free( scratch ) ;
+	
+	/* end deconvolution */
+	_CGfinishRun( ws ) ;	
+}
+
+/* private functions */
+
+/*
+	Deconvolve one image after the PSF has been transformed into <ws>: the part of run() 
+	which CGsession::run() repeats for each image; the conditioning value is searched if <condition> is true.
+*/
+void CGdeconvolver::_CGrunFrame( double * cgr, double * cgp, double * object, CGdws & ws,
+                                 unsigned char * SpacialSupport, bool condition )
+{
+	double cri = 1.0E+37, max_intensity = 0.0, gamma = -1.0, alpha = 0.0, beta = 0.0, temp1, temp2, temp3 ;
+	
+	/* the imaginary parts of the spectra follow their real parts in the interleaved layout */
+	size_t S = _Interleaved ? 2 : 1 ;
+	double * image_im = _Interleaved ? ws.image_re + 1 : ws.image_im ;
+	double * cg_im    = _Interleaved ? ws.cg_re + 1    : ws.cg_im ;
+	double * psf_im   = ( _Interleaved && !ws.real ) ? ws.psf_re + 1 : ws.psf_im ;
+
 	_initIMG( max_intensity, cgr, object, SpacialSupport ) ;	
-	_FFTplanff->execute( cgr, ws.image_re, ws.image_im ) ;	
+	_FFTplanf->forward( cgr, ws.image_re, ws.image_im ) ;	
 	if( _CheckStatus ) _CGprintStatus( 2 ) ;
 	
 	/* start regularization */
 	if( _ApplyIR )
 	{
-		for( int i = 0 ; i < ws.size ; i++ ) 
+		for( size_t k = 0, i = 0 ; k < ws.size ; k++, i += S ) 
 		{
-			ws.cg_re[i] = ws.image_re[i] * ws.image_re[i] + ws.image_im[i] * ws.image_im[i] ;
+			ws.cg_re[k] = ws.image_re[i] * ws.image_re[i] + image_im[i] * image_im[i] ;
 		}
 		_CGIRpenalty = _CGrunRegularization( ws.size, ws.cg_re, ws.otf ) ;
 		if( _CheckStatus ) _CGprintStatus( 3 ) ;
@@ -122,31 +325,41 @@ void CGdeconvolver::run( int DimX, int DimY, int DimZ, double * cgr, double * cg
 	}			
 
 	/* start conditioning */
-	if( _ConditioningIteration > 0 )
+	if( condition )
 	{
 		if( _CheckStatus ) _CGprintStatus( 4 ) ;
-		for( int i = 0 ; i < _Space ; i++ ) ws.object0[i] = object[i] ;
-		_ConditioningValue = _runConditioning( ws.size, ws.object0, object, cgr, cgp, 
-		                     ws.image_re, ws.image_im, ws.psf_re, ws.psf_im, ws.otf, SpacialSupport ) ;
-		for( int i = 0 ; i < _Space ; i++ ) object[i] = ws.object0[i] ;
-		delete [] ws.object0 ;
-		ws.object0 = NULL ;
+		for( size_t i = 0 ; i < _Space ; i++ ) cgp[i] = object[i] ;
+		_ConditioningValue = _runConditioning( ws.size, cgp, object, cgr, ws.cg_re, cg_im, 
+		                     ws.image_re, image_im, ws.psf_re, psf_im, ws.otf, SpacialSupport ) ;
+		for( size_t i = 0 ; i < _Space ; i++ ) object[i] = cgp[i] ;
 		if( _CheckStatus ) _CGprintStatus( 5 ) ;
 	}
 	
 	/* initialize arrays in deconvolution loop */
-	if( !_TrackLikelihood )
+	if( !_TrackLikelihood && ws.real )
 	{
-		for( int i = 0 ; i < ws.size ; i++ )
+		for( size_t k = 0, i = 0 ; k < ws.size ; k++, i += S )
 		{
-			         temp1 = ws.otf[i] + _ConditioningValue ;
+			         temp1 = ws.otf[k] + _ConditioningValue ;
 			         temp2 = sqrt( temp1 ) ;
-			         temp3 = ( ws.image_re[i]*ws.psf_re[i] + ws.image_im[i]*ws.psf_im[i] ) / temp1 ;
-			ws.image_im[i] = ( ws.image_im[i]*ws.psf_re[i] - ws.image_re[i]*ws.psf_im[i] ) / temp1 ;
+			ws.image_re[i] = ws.image_re[i]*ws.psf_re[k] / temp1 ;
+			   image_im[i] = image_im[i]*ws.psf_re[k] / temp1 ;
+		   	  ws.psf_re[k] = ws.psf_re[k] / temp2 ;
+		   	     ws.otf[k] = ws.otf[k] / temp1 ;
+		}
+	}
+	else if( !_TrackLikelihood )
+	{
+		for( size_t k = 0, i = 0 ; k < ws.size ; k++, i += S )
+		{
+			         temp1 = ws.otf[k] + _ConditioningValue ;
+			         temp2 = sqrt( temp1 ) ;
+			         temp3 = ( ws.image_re[i]*ws.psf_re[i] + image_im[i]*psf_im[i] ) / temp1 ;
+			   image_im[i] = ( image_im[i]*ws.psf_re[i] - ws.image_re[i]*psf_im[i] ) / temp1 ;
 		   	ws.image_re[i] = temp3 ;
 		   	  ws.psf_re[i] = ws.psf_re[i] / temp2 ;
-		   	  ws.psf_im[i] = ws.psf_im[i] / temp2 ;
-		   	     ws.otf[i] = ws.otf[i] / temp1 ;
+		   	     psf_im[i] = psf_im[i] / temp2 ;
+		   	     ws.otf[k] = ws.otf[k] / temp1 ;
 		}
 	}
 
@@ -155,29 +368,19 @@ void CGdeconvolver::run( int DimX, int DimY, int DimZ, double * cgr, double * cg
 	while( _Update.size() < _MaxRunIteration && cri > _Criterion )
 	{
 		if( _CheckStatus ) _CGprintStatus( 7 ) ;			
-		_FFTplanff->execute( object, ws.cg_re, ws.cg_im  ) ;		
+		_FFTplanf->forward( object, ws.cg_re, ws.cg_im  ) ;		
 		if( _TrackLikelihood )
 		{
-			_Likelihood.push_back( _getLikelihood( ws.size, ws.image_re, ws.image_im, 
-			                       ws.psf_re, ws.psf_im, ws.cg_re, ws.cg_im ) ) ;	
+			_Likelihood.push_back( _getLikelihood( ws.size, ws.image_re, image_im, 
+			                       ws.psf_re, psf_im, ws.cg_re, cg_im ) ) ;	
 			_CGupdate1( gamma, alpha, beta, cgr, cgp, ws ) ; 
 		}
 		else
 		{
 			_CGupdate2( gamma, alpha, beta, cgr, cgp, ws ) ;
 		}     		
-		for( int i = 0 ; i < _Space ; i++ )
-		{
-			       cgr[i] = object[i] ;
-			    object[i] = object[i] + alpha * cgp[i] ;
-			if( object[i] < 0.0 )
-			{
-				 object[i] = 0.0 ;
-				ws.sign[i] = (unsigned char) 0 ;
-			} 
-			else    ws.sign[i] = (unsigned char) 1 ;
-		}
-		_getUpdate( object, cgr, SpacialSupport ) ;	
+		_pushUpdate( object, cgr, UPDATE_object( _Space, object, cgr, true, 
+		             UPDATE_addSigned< double >( object, cgp, alpha, ws.sign ), SpacialSupport, _Threads ) ) ;
 		if( _Update.size() >= 10 )
 		{
 			cri = 0.0 ;
@@ -185,34 +388,33 @@ void CGdeconvolver::run( int DimX, int DimY, int DimZ, double * cgr, double * cg
 			cri /= 10.0 ;
 		}
 		if( _CheckStatus ) _CGprintStatus( 8 ) ;
-	}	
-	
-	/* end deconvolution */
-	_CGfinishRun( ws ) ;	
+	}
 }
 
-void CGdeconvolver::run( int DimX, int DimY, int DimZ, float * cgr, float * cgp, float * object, 
-                         CGsws & ws, unsigned char * SpacialSupport, unsigned char * FrequencySupport )
+
+
+void CGdeconvolver::_CGrunFrame( float * cgr, float * cgp, float * object, CGsws & ws,
+                                 unsigned char * SpacialSupport, bool condition )
 {
 	float  max_intensity = 0.0, gamma = -1.0, alpha = 0.0, beta = 0.0, temp1, temp2, temp3 ;
 	double cri = 1.0E+37 ;
+	
+	/* the imaginary parts of the spectra follow their real parts in the interleaved layout */
+	size_t S = _Interleaved ? 2 : 1 ;
+	float * image_im = _Interleaved ? ws.image_re + 1 : ws.image_im ;
+	float * cg_im    = _Interleaved ? ws.cg_re + 1    : ws.cg_im ;
+	float * psf_im   = ( _Interleaved && !ws.real ) ? ws.psf_re + 1 : ws.psf_im ;
 
-	/* initialize running */
-	_CGstartRun( DimX, DimY, DimZ, ws ) ;
-
-	/* start initialization */
-	if( _CheckStatus ) _CGprintStatus( 1 ) ;
-	_initPSF( ws.size, cgp, ws.psf_re, ws.psf_im, FrequencySupport, ws.otf ) ;
 	_initIMG( max_intensity, cgr, object, SpacialSupport ) ;
-	_FFTplanff->execute( cgr, ws.image_re, ws.image_im ) ;	
+	_FFTplanf->forward( cgr, ws.image_re, ws.image_im ) ;	
 	if( _CheckStatus ) _CGprintStatus( 2 ) ;	
 	
 	/* start regularization */
 	if( _ApplyIR )
 	{
-		for( int i = 0 ; i < ws.size ; i++ )
+		for( size_t k = 0, i = 0 ; k < ws.size ; k++, i += S )
 		{
-			ws.cg_re[i] = ws.image_re[i] * ws.image_re[i] + ws.image_im[i] * ws.image_im[i] ;
+			ws.cg_re[k] = ws.image_re[i] * ws.image_re[i] + image_im[i] * image_im[i] ;
 		}
 		_CGIRpenalty = _CGrunRegularization( ws.size, ws.cg_re, ws.otf ) ;
 		if( _CheckStatus ) _CGprintStatus( 3 ) ;
@@ -223,31 +425,41 @@ void CGdeconvolver::run( int DimX, int DimY, int DimZ, float * cgr, float * cgp,
 	}			
 
 	/* start conditioning */
-	if( _ConditioningIteration > 0 )
+	if( condition )
 	{
 		if( _CheckStatus ) _CGprintStatus( 4 ) ;
-		for( int i = 0 ; i < _Space ; i++ ) ws.object0[i] = object[i] ;
-		_ConditioningValue = _runConditioning( ws.size, ws.object0, object, cgr, cgp, 
-		                     ws.image_re, ws.image_im, ws.psf_re, ws.psf_im, ws.otf, SpacialSupport ) ;
-		for( int i = 0 ; i < _Space ; i++ ) object[i] = ws.object0[i] ;
-		delete [] ws.object0 ;
-		ws.object0 = NULL ;
+		for( size_t i = 0 ; i < _Space ; i++ ) cgp[i] = object[i] ;
+		_ConditioningValue = _runConditioning( ws.size, cgp, object, cgr, ws.cg_re, cg_im, 
+		                     ws.image_re, image_im, ws.psf_re, psf_im, ws.otf, SpacialSupport ) ;
+		for( size_t i = 0 ; i < _Space ; i++ ) object[i] = cgp[i] ;
 		if( _CheckStatus ) _CGprintStatus( 5 ) ;
 	}
 	
 	/* initialize arrays in deconvolution loop */
-	if( !_TrackLikelihood )
+	if( !_TrackLikelihood && ws.real )
+	{
+		for( size_t k = 0, i = 0 ; k < ws.size ; k++, i += S )
+		{
+			         temp1 = ws.otf[k] + _ConditioningValue ;
+			         temp2 = sqrt( temp1 ) ;
+			ws.image_re[i] = ws.image_re[i]*ws.psf_re[k] / temp1 ;
+			   image_im[i] = image_im[i]*ws.psf_re[k] / temp1 ;
+		   	  ws.psf_re[k] = ws.psf_re[k] / temp2 ;
+		   	     ws.otf[k] = ws.otf[k] / temp1 ;
+		}
+	}
+	else if( !_TrackLikelihood )
 	{
-		for( int i = 0 ; i < ws.size ; i++ )
+		for( size_t k = 0, i = 0 ; k < ws.size ; k++, i += S )
 		{
-			         temp1 = ws.otf[i] + _ConditioningValue ;
+			         temp1 = ws.otf[k] + _ConditioningValue ;
 			         temp2 = sqrt( temp1 ) ;
-			         temp3 = ( ws.image_re[i]*ws.psf_re[i] + ws.image_im[i]*ws.psf_im[i] ) / temp1 ;
-			ws.image_im[i] = ( ws.image_im[i]*ws.psf_re[i] - ws.image_re[i]*ws.psf_im[i] ) / temp1 ;
+			         temp3 = ( ws.image_re[i]*ws.psf_re[i] + image_im[i]*psf_im[i] ) / temp1 ;
+			   image_im[i] = ( image_im[i]*ws.psf_re[i] - ws.image_re[i]*psf_im[i] ) / temp1 ;
 		   	ws.image_re[i] = temp3 ;
 		   	  ws.psf_re[i] = ws.psf_re[i] / temp2 ;
-		   	  ws.psf_im[i] = ws.psf_im[i] / temp2 ;
-		   	     ws.otf[i] = ws.otf[i] / temp1 ;
+		   	     psf_im[i] = psf_im[i] / temp2 ;
+		   	     ws.otf[k] = ws.otf[k] / temp1 ;
 		}
 	}	
 
@@ -256,29 +468,19 @@ void CGdeconvolver::run( int DimX, int DimY, int DimZ, float * cgr, float * cgp,
 	while( _Update.size() < _MaxRunIteration && cri > _Criterion )
 	{
 		if( _CheckStatus ) _CGprintStatus( 7 ) ;			
-		_FFTplanff->execute( object, ws.cg_re, ws.cg_im  ) ;		
+		_FFTplanf->forward( object, ws.cg_re, ws.cg_im  ) ;		
 		if( _TrackLikelihood )
 		{
-			_Likelihood.push_back( _getLikelihood( ws.size, ws.image_re, ws.image_im, 
-			                       ws.psf_re, ws.psf_im, ws.cg_re, ws.cg_im ) ) ;	
+			_Likelihood.push_back( _getLikelihood( ws.size, ws.image_re, image_im, 
+			                       ws.psf_re, psf_im, ws.cg_re, cg_im ) ) ;	
 			_CGupdate1( gamma, alpha, beta, cgr, cgp, ws ) ; 
 		}
 		else
 		{
 			_CGupdate2( gamma, alpha, beta, cgr, cgp, ws ) ;
 		}     		
-		for( int i = 0 ; i < _Space ; i++ )
-		{
-			       cgr[i] = object[i] ;
-			    object[i] = object[i] + alpha * cgp[i] ;
-			if( object[i] < 0.0 )
-			{
-				 object[i] = 0.0 ;
-				ws.sign[i] = (unsigned char) 0 ;
-			} 
-			else    ws.sign[i] = (unsigned char) 1 ;
-		}
-		_getUpdate( object, cgr, SpacialSupport ) ;     		
+		_pushUpdate( object, cgr, UPDATE_object( _Space, object, cgr, true, 
+		             UPDATE_addSigned< float >( object, cgp, alpha, ws.sign ), SpacialSupport, _Threads ) ) ;
 		if( _Update.size() >= 10 )
 		{
 			cri = 0.0 ;
@@ -286,13 +488,10 @@ void CGdeconvolver::run( int DimX, int DimY, int DimZ, float * cgr, float * cgp,
 			cri /= 10.0 ;
 		}		   		   		
 		if( _CheckStatus ) _CGprintStatus( 8 ) ;
-	}	
-	
-	/* end deconvolution */
-	_CGfinishRun( ws ) ;	
+	}
 }
 
-/* private functions */
+
 
 void CGdeconvolver::_CGprintStatus( int stage )
 {
@@ -376,6 +575,11 @@ void CGdeconvolver::_CGprintStatus( int stage )
 void CGdeconvolver::_CGstartRun( int DimX, int DimY, int DimZ, CGdws & ws )
 {
 	_setDimensions( DimX, DimY, DimZ ) ;
+	if( ws.bytes > 0 && ( ws.size != FFTW3_FFT::FFTsize( _DimX, _DimY, _DimZ ) || _Interleaved != ( ws.cg_im == NULL ) || 
+	                      _RealOTF != ws.real ) )
+	{
+		throw WorkspaceError( ws.size, FFTW3_FFT::FFTsize( _DimX, _DimY, _DimZ ) ) ;
+	}
 	double memory = (double)_Space * 3.0 ;
 		
 	time( &_StartRunTime ) ;
@@ -387,39 +591,15 @@ void CGdeconvolver::_CGstartRun( int DimX, int DimY, int DimZ, CGdws & ws )
 	time( &_t0 ) ;
 	std::cout << " CGdeconvolver::run starts creating FFT plans ... \n" ;
         	
-	_FFTplanff = new FFTW3_FFT (_DimX, _DimY, _DimZ, true,  true, 3) ;
-	
-	_FFTplanbb = new FFTW3_FFT (_DimX, _DimY, _DimZ, false, true, 3) ;
-        	
-	if( _ConditioningIteration > 0 )
-	{
-		_FFTplanf = new FFTW3_FFT (_DimX, _DimY, _DimZ, true,  true, 1) ;
-	
-		_FFTplanb = new FFTW3_FFT (_DimX, _DimY, _DimZ, false, true, 2) ;
-	}
+	_FFTplanf = FFTW3_PlanCache::acquire( _DimX, _DimY, _DimZ, true,  true, _Interleaved ? 4 : 3, _PlannerEffort, _Threads ) ;
+	_FFTplanb = FFTW3_PlanCache::acquire( _DimX, _DimY, _DimZ, false, true, _Interleaved ? 4 : 3, _PlannerEffort, _Threads ) ;
 		
 	time( &_t1 ) ;
 	std::cout << " CGdeconvolver::run completes creating FFT plans, elapsed "
 	          << difftime( _t1, _t0 ) << " seconds.\n" ;
 	
-	ws.size = _FFTplanf->FFTsize() ;
-	memory += ( (double)ws.size * 7.0 + ((double)_Space) / 8.0 ) ;
-	
-	ws.psf_re   = new double[ ws.size ] ;
-	ws.psf_im   = new double[ ws.size ] ;
-	ws.image_re = new double[ ws.size ] ;
-	ws.image_im = new double[ ws.size ] ;
-	ws.otf      = new double[ ws.size ] ;
-	ws.cg_re    = new double[ ws.size ] ;
-	ws.cg_im    = new double[ ws.size ] ;
-	ws.sign     = new unsigned char[ _Space ] ;
-
-	if( _ConditioningIteration > 0 )
-	{
-		ws.object0 = new double[ _Space ] ;
-		memory += ( (double)_Space ) ;
-	}
-	else    ws.object0 = NULL ;
+	if( ws.bytes == 0 ) CGallocate( ws, _FFTplanf->FFTsize(), _Space, _Interleaved, _RealOTF ) ;
+	memory += ( (double)ws.size * ( ws.real ? 6.0 : 7.0 ) + ((double)_Space) / 8.0 ) ;
 	
 	if( _Update.size()  > 0 ) _Update.clear() ;
 	if( _Likelihood.size() > 0 ) _Likelihood.clear() ;
@@ -431,6 +611,11 @@ void CGdeconvolver::_CGstartRun( int DimX, int DimY, int DimZ, CGdws & ws )
 void CGdeconvolver::_CGstartRun( int DimX, int DimY, int DimZ, CGsws & ws )
 {
 	_setDimensions( DimX, DimY, DimZ ) ;
+	if( ws.bytes > 0 && ( ws.size != FFTW3_FFT::FFTsize( _DimX, _DimY, _DimZ ) || _Interleaved != ( ws.cg_im == NULL ) || 
+	                      _RealOTF != ws.real ) )
+	{
+		throw WorkspaceError( ws.size, FFTW3_FFT::FFTsize( _DimX, _DimY, _DimZ ) ) ;
+	}
 	double memory = (double)_Space * 3 ;
 		
 	time( &_StartRunTime ) ;
@@ -442,36 +627,15 @@ void CGdeconvolver::_CGstartRun( int DimX, int DimY, int DimZ, CGsws & ws )
 	time( &_t0 ) ;
 	std::cout << " CGdeconvolver::run starts creating FFT plans ... \n" ;
         	
-	_FFTplanff = new FFTW3_FFT (_DimX, _DimY, _DimZ, true, false, 3) ;
-	_FFTplanbb = new FFTW3_FFT (_DimX, _DimY, _DimZ, false, false, 3) ;
-		
-	if( _ConditioningIteration > 0 )
-	{
-		_FFTplanf = new FFTW3_FFT (_DimX, _DimY, _DimZ, true,  false, 1) ;
-		_FFTplanb = new FFTW3_FFT (_DimX, _DimY, _DimZ, false, false, 2) ;
-	}
+	_FFTplanf = FFTW3_PlanCache::acquire( _DimX, _DimY, _DimZ, true,  false, _Interleaved ? 4 : 3, _PlannerEffort, _Threads ) ;
+	_FFTplanb = FFTW3_PlanCache::acquire( _DimX, _DimY, _DimZ, false, false, _Interleaved ? 4 : 3, _PlannerEffort, _Threads ) ;
 		
 	time( &_t1 ) ;
 	std::cout << " CGdeconvolver::run completes creating FFT plans, elapsed "
 	          << difftime( _t1, _t0 ) << " seconds.\n" ;
 	
-	ws.size = _FFTplanf->FFTsize() ;
-	memory += ( (double)ws.size * 7.0 + ((double)_Space) / 8.0 ) ;
-	
-	ws.psf_re   = new float[ ws.size ] ;
-	ws.psf_im   = new float[ ws.size ] ;
-	ws.image_re = new float[ ws.size ] ;
-	ws.image_im = new float[ ws.size ] ;
-	ws.otf      = new float[ ws.size ] ;
-	ws.cg_re    = new float[ ws.size ] ;
-	ws.cg_im    = new float[ ws.size ] ;
-	ws.sign     = new unsigned char[ _Space ] ;
-	if( _ConditioningIteration > 0 )
-	{
-		ws.object0 = new float[ _Space ] ;
-		memory += ( (double)_Space ) ;
-	}
-	else    ws.object0 = NULL ;
+	if( ws.bytes == 0 ) CGallocate( ws, _FFTplanf->FFTsize(), _Space, _Interleaved, _RealOTF ) ;
+	memory += ( (double)ws.size * ( ws.real ? 6.0 : 7.0 ) + ((double)_Space) / 8.0 ) ;
 	
 	if( _Update.size()  > 0 ) _Update.clear() ;
 	if( _Likelihood.size() > 0 ) _Likelihood.clear() ;
@@ -484,14 +648,12 @@ void CGdeconvolver::_CGstartRun( int DimX, int DimY, int DimZ, CGsws & ws )
 
 void CGdeconvolver::_CGfinishRun( CGdws & ws )
 {
-	if( ws.psf_re   != NULL ) delete [] ws.psf_re ;
-	if( ws.psf_im   != NULL ) delete [] ws.psf_im ;
-	if( ws.image_re != NULL ) delete [] ws.image_re ;
-	if( ws.image_im != NULL ) delete [] ws.image_im ;
-	if( ws.otf      != NULL ) delete [] ws.otf ;
-	if( ws.cg_re    != NULL ) delete [] ws.cg_re ;
-	if( ws.cg_im    != NULL ) delete [] ws.cg_im ;
-	if( ws.sign     != NULL ) delete [] ws.sign ;
+	if( ws.bytes == 0 ) CGdeallocate( ws ) ;
+
+	FFTW3_PlanCache::release( _FFTplanf ) ;
+	FFTW3_PlanCache::release( _FFTplanb ) ;
+	_FFTplanf = NULL ;
+	_FFTplanb = NULL ;
 		
 	time( &_StopRunTime ) ;
 	std::cout << " CGdeconvolution finish running at " << ctime( &_StopRunTime ) ;
@@ -501,14 +663,12 @@ void CGdeconvolver::_CGfinishRun( CGdws & ws )
 
 void CGdeconvolver::_CGfinishRun( CGsws & ws )
 {
-	if( ws.psf_re   != NULL ) delete [] ws.psf_re ;
-	if( ws.psf_im   != NULL ) delete [] ws.psf_im ;
-	if( ws.image_re != NULL ) delete [] ws.image_re ;
-	if( ws.image_im != NULL ) delete [] ws.image_im ;
-	if( ws.otf      != NULL ) delete [] ws.otf ;
-	if( ws.cg_re    != NULL ) delete [] ws.cg_re ;
-	if( ws.cg_im    != NULL ) delete [] ws.cg_im ;
-	if( ws.sign     != NULL ) delete [] ws.sign ;
+	if( ws.bytes == 0 ) CGdeallocate( ws ) ;
+
+	FFTW3_PlanCache::release( _FFTplanf ) ;
+	FFTW3_PlanCache::release( _FFTplanb ) ;
+	_FFTplanf = NULL ;
+	_FFTplanb = NULL ;
 		
 	time( &_StopRunTime ) ;
 	std::cout << " CGdeconvolution finish running at " << ctime( &_StopRunTime ) ;
@@ -518,60 +678,49 @@ void CGdeconvolver::_CGfinishRun( CGsws & ws )
 
 void CGdeconvolver::_CGupdate1( double & gamma, double & alpha, double & beta, double * cgr, double * cgp, CGdws & ws )
 {
-	double temp1, temp2, temp3, temp4 ;
+	double temp1, temp2, temp3 ;
 		
-	for( int i = 0 ; i < ws.size ; i++ )
-	{
-		      temp1 = ws.otf[i] + _ConditioningValue ;
-		      temp2 = ( ws.image_re[i] * ws.psf_re[i] + ws.image_im[i] * ws.psf_im[i] ) / temp1 ;
-		      temp3 = ( ws.image_im[i] * ws.psf_re[i] - ws.image_re[i] * ws.psf_im[i] ) / temp1 ;
-		      temp4 = ws.otf[i] / temp1 ;
-		ws.cg_re[i] = temp2 - ( temp4 + _CGIRpenalty ) * ws.cg_re[i] ;
-		ws.cg_im[i] = temp3 - ( temp4 + _CGIRpenalty ) * ws.cg_im[i] ; 
-	}
-	
- 	_FFTplanbb->execute( ws.cg_re, ws.cg_im, cgr ) ;
+	if( _Interleaved )
+		SPECTRAL_landweberIR<2>( ws.size, ws.cg_re, ws.cg_re + 1, ws.image_re, ws.image_re + 1, ws.psf_re, 
+		                         ws.real ? NULL : ws.psf_re + 1, ws.otf, _ConditioningValue, _CGIRpenalty, _Threads ) ;
+	else
+		SPECTRAL_landweberIR<1>( ws.size, ws.cg_re, ws.cg_im, ws.image_re, ws.image_im, ws.psf_re, ws.psf_im, ws.otf, 
+		                         _ConditioningValue, _CGIRpenalty, _Threads ) ;
+
+ 	_FFTplanb->backward( ws.cg_re, ws.cg_im, cgr ) ;
  	
  	if( gamma < 0.0 ) 
  	{
- 		gamma = 0.0 ;
- 		for( int i = 0 ; i < _Space ; i++ ) 
- 		{
- 			    cgp[i] = cgr[i] ;
- 			ws.sign[i] = ( unsigned char ) 1 ;
- 			   gamma  += cgr[i] * cgr[i] ;
- 		}
+ 		CGstart< double > start = { cgr, cgp, ws.sign } ;
+ 		gamma = my_parallel_reduce( _Space, start, _Threads ) ;
  	}
  	else
  	{
+ 		CGdot< double > norm = { cgr, cgr, NULL } ;
  		temp1 = gamma ;
- 		gamma = 0.0 ;
- 		for( int i = 0 ; i < _Space ; i++ ) gamma += cgr[i] * cgr[i] ;
+ 		gamma = my_parallel_reduce( _Space, norm, _Threads ) ;
  		beta = gamma / temp1 ;
- 		for( int i = 0 ; i < _Space ; i++ ) cgp[i] = cgr[i] + beta * cgp[i] ;
- 		_FFTplanff->execute( cgp, ws.cg_re, ws.cg_im ) ;
+ 		CGdirection< double > direction = { cgr, cgp, beta } ;
+ 		my_parallel_range( _Space, direction, _Threads ) ;
+ 		_FFTplanf->forward( cgp, ws.cg_re, ws.cg_im ) ;
  	}
  	
-	for( int i = 0 ; i < ws.size ; i++ )
-	{
-		       temp1 = sqrt( ws.otf[i] + _ConditioningValue ) ; 
-		       temp2 = ws.psf_re[i] / temp1 ;
-		       temp3 = ws.psf_im[i] / temp1 ;
-		       temp4 = ws.cg_re[i] * temp3 + ws.cg_im[i] * temp2 ;
-		 ws.cg_re[i] = ws.cg_re[i] * temp2 - ws.cg_im[i] * temp3 ;
-		 ws.cg_im[i] = temp4 ;
-	}
-		
-	temp1 = 0.0 ;
-	for( int i = 0 ; i < _Space ; i++ ) temp1 += ( cgr[i] * cgp[i] * ((double) ws.sign[i]) ) ;
+	if( _Interleaved )
+		SPECTRAL_whiten<2>( ws.size, ws.cg_re, ws.cg_re + 1, ws.psf_re, ws.real ? NULL : ws.psf_re + 1, ws.otf, 
+		                    _ConditioningValue, _Threads ) ;
+	else
+		SPECTRAL_whiten<1>( ws.size, ws.cg_re, ws.cg_im, ws.psf_re, ws.psf_im, ws.otf, _ConditioningValue, _Threads ) ;
+	
+	CGdot< double > dot1 = { cgr, cgp, ws.sign } ;
+	temp1 = my_parallel_reduce( _Space, dot1, _Threads ) ;
      	
-	_FFTplanbb->execute( ws.cg_re, ws.cg_im, cgr ) ;
-	temp2 = 0.0 ;
-	for( int i = 0 ; i < _Space ; i++ ) temp2 += ( ((double) ws.sign[i]) * cgr[i] * cgr[i] ) ;
+	_FFTplanb->backward( ws.cg_re, ws.cg_im, cgr ) ;
+	CGdot< double > dot2 = { cgr, cgr, ws.sign } ;
+	temp2 = my_parallel_reduce( _Space, dot2, _Threads ) ;
 	if( _ApplyIR )
 	{
-		temp3 = 0.0 ;
-		for( int i = 0 ; i < _Space ; i++ ) temp3 += ( ((double) ws.sign[i]) * cgp[i] * cgp[i] ) ;
+		CGdot< double > dot3 = { cgp, cgp, ws.sign } ;
+		temp3 = my_parallel_reduce( _Space, dot3, _Threads ) ;
 		temp2 += temp3 * _CGIRpenalty ;
 	}
      	
@@ -582,60 +731,49 @@ void CGdeconvolver::_CGupdate1( double & gamma, double & alpha, double & beta, d
 
 void CGdeconvolver::_CGupdate1( float & gamma, float & alpha, float & beta, float * cgr, float * cgp, CGsws & ws )
 {
-	float temp1, temp2, temp3, temp4 ;
+	float temp1, temp2, temp3 ;
 		
-	for( int i = 0 ; i < ws.size ; i++ )
-	{
-		      temp1 = ws.otf[i] + _ConditioningValue ;
-		      temp2 = ( ws.image_re[i] * ws.psf_re[i] + ws.image_im[i] * ws.psf_im[i] ) / temp1 ;
-		      temp3 = ( ws.image_im[i] * ws.psf_re[i] - ws.image_re[i] * ws.psf_im[i] ) / temp1 ;
-		      temp4 = ws.otf[i] / temp1 ;
-		ws.cg_re[i] = temp2 - ( temp4 + _CGIRpenalty ) * ws.cg_re[i] ;
-		ws.cg_im[i] = temp3 - ( temp4 + _CGIRpenalty ) * ws.cg_im[i] ; 
-	}
-	
- 	_FFTplanbb->execute( ws.cg_re, ws.cg_im, cgr ) ;
+	if( _Interleaved )
+		SPECTRAL_landweberIR<2>( ws.size, ws.cg_re, ws.cg_re + 1, ws.image_re, ws.image_re + 1, ws.psf_re, 
+		                         ws.real ? NULL : ws.psf_re + 1, ws.otf, _ConditioningValue, _CGIRpenalty, _Threads ) ;
+	else
+		SPECTRAL_landweberIR<1>( ws.size, ws.cg_re, ws.cg_im, ws.image_re, ws.image_im, ws.psf_re, ws.psf_im, ws.otf, 
+		                         _ConditioningValue, _CGIRpenalty, _Threads ) ;
+
+ 	_FFTplanb->backward( ws.cg_re, ws.cg_im, cgr ) ;
  	
  	if( gamma < 0.0 ) 
  	{
- 		gamma = 0.0 ;
- 		for( int i = 0 ; i < _Space ; i++ ) 
- 		{
- 			    cgp[i] = cgr[i] ;
- 			ws.sign[i] = ( unsigned char ) 1 ;
- 			   gamma  += cgr[i] * cgr[i] ;
- 		}
+ 		CGstart< float > start = { cgr, cgp, ws.sign } ;
+ 		gamma = my_parallel_reduce( _Space, start, _Threads ) ;
  	}
  	else
  	{
+ 		CGdot< float > norm = { cgr, cgr, NULL } ;
  		temp1 = gamma ;
- 		gamma = 0.0 ;
- 		for( int i = 0 ; i < _Space ; i++ ) gamma += cgr[i] * cgr[i] ;
+ 		gamma = my_parallel_reduce( _Space, norm, _Threads ) ;
  		beta = gamma / temp1 ;
- 		for( int i = 0 ; i < _Space ; i++ ) cgp[i] = cgr[i] + beta * cgp[i] ;
- 		_FFTplanff->execute( cgp, ws.cg_re, ws.cg_im ) ;
+ 		CGdirection< float > direction = { cgr, cgp, beta } ;
+ 		my_parallel_range( _Space, direction, _Threads ) ;
+ 		_FFTplanf->forward( cgp, ws.cg_re, ws.cg_im ) ;
  	}
  	
-	for( int i = 0 ; i < ws.size ; i++ )
-	{
-		       temp1 = sqrt( ws.otf[i] + _ConditioningValue ) ; 
-		       temp2 = ws.psf_re[i] / temp1 ;
-		       temp3 = ws.psf_im[i] / temp1 ;
-		       temp4 = ws.cg_re[i] * temp3 + ws.cg_im[i] * temp2 ;
-		 ws.cg_re[i] = ws.cg_re[i] * temp2 - ws.cg_im[i] * temp3 ;
-		 ws.cg_im[i] = temp4 ;
-	}
-		
-	temp1 = 0.0 ;
-	for( int i = 0 ; i < _Space ; i++ ) temp1 += ( cgr[i] * cgp[i] * ((float) ws.sign[i]) ) ;
+	if( _Interleaved )
+		SPECTRAL_whiten<2>( ws.size, ws.cg_re, ws.cg_re + 1, ws.psf_re, ws.real ? NULL : ws.psf_re + 1, ws.otf, 
+		                    _ConditioningValue, _Threads ) ;
+	else
+		SPECTRAL_whiten<1>( ws.size, ws.cg_re, ws.cg_im, ws.psf_re, ws.psf_im, ws.otf, _ConditioningValue, _Threads ) ;
+	
+	CGdot< float > dot1 = { cgr, cgp, ws.sign } ;
+	temp1 = my_parallel_reduce( _Space, dot1, _Threads ) ;
      	
-	_FFTplanbb->execute( ws.cg_re, ws.cg_im, cgr ) ;
-	temp2 = 0.0 ;
-	for( int i = 0 ; i < _Space ; i++ ) temp2 += ( ((float) ws.sign[i]) * cgr[i] * cgr[i] ) ;
+	_FFTplanb->backward( ws.cg_re, ws.cg_im, cgr ) ;
+	CGdot< float > dot2 = { cgr, cgr, ws.sign } ;
+	temp2 = my_parallel_reduce( _Space, dot2, _Threads ) ;
 	if( _ApplyIR )
 	{
-		temp3 = 0.0 ;
-		for( int i = 0 ; i < _Space ; i++ ) temp3 += ( ((float) ws.sign[i]) * cgp[i] * cgp[i] ) ;
+		CGdot< float > dot3 = { cgp, cgp, ws.sign } ;
+		temp3 = my_parallel_reduce( _Space, dot3, _Threads ) ;
 		temp2 += temp3 * _CGIRpenalty ;
 	}
      	
@@ -648,54 +786,47 @@ void CGdeconvolver::_CGupdate2( double & gamma, double & alpha, double & beta, d
 {
 	double temp1, temp2, temp3 ;
 		
-	for( int i = 0 ; i < ws.size ; i++ )
-	{
-		ws.cg_re[i] = ws.image_re[i] - ( ws.otf[i] + _CGIRpenalty ) * ws.cg_re[i] ;
-		ws.cg_im[i] = ws.image_im[i] - ( ws.otf[i] + _CGIRpenalty ) * ws.cg_im[i] ; 
-	}
-	
- 	_FFTplanbb->execute( ws.cg_re, ws.cg_im, cgr ) ;
+	if( _Interleaved )
+		SPECTRAL_residualIR<2>( ws.size, ws.cg_re, ws.cg_re + 1, ws.image_re, ws.image_re + 1, ws.otf, _CGIRpenalty, _Threads ) ;
+	else
+		SPECTRAL_residualIR<1>( ws.size, ws.cg_re, ws.cg_im, ws.image_re, ws.image_im, ws.otf, _CGIRpenalty, _Threads ) ;
+
+ 	_FFTplanb->backward( ws.cg_re, ws.cg_im, cgr ) ;
  	
  	if( gamma < 0.0 ) 
  	{
- 		gamma = 0.0 ;
- 		for( int i = 0 ; i < _Space ; i++ ) 
- 		{
- 			    cgp[i] = cgr[i] ;
- 			ws.sign[i] = ( unsigned char ) 1 ;
- 			   gamma  += ( cgr[i] * cgr[i] ) ;
- 		}
+ 		CGstart< double > start = { cgr, cgp, ws.sign } ;
+ 		gamma = my_parallel_reduce( _Space, start, _Threads ) ;
  	}
  	else
  	{
+ 		CGdot< double > norm = { cgr, cgr, NULL } ;
  		temp1 = gamma ;
- 		gamma = 0.0 ;
- 		for( int i = 0 ; i < _Space ; i++ ) gamma += cgr[i] * cgr[i] ;
+ 		gamma = my_parallel_reduce( _Space, norm, _Threads ) ;
  		beta = gamma / temp1 ;
- 		for( int i = 0 ; i < _Space ; i++ ) cgp[i] = cgr[i] + beta * cgp[i] ;
- 		_FFTplanff->execute( cgp, ws.cg_re, ws.cg_im ) ;
+ 		CGdirection< double > direction = { cgr, cgp, beta } ;
+ 		my_parallel_range( _Space, direction, _Threads ) ;
+ 		_FFTplanf->forward( cgp, ws.cg_re, ws.cg_im ) ;
  	}
  	
-	for( int i = 0 ; i < ws.size ; i++ )
-	{
-		       temp1 = ws.cg_re[i] * ws.psf_re[i] - ws.cg_im[i] * ws.psf_im[i] ;
-		 ws.cg_im[i] = ws.cg_re[i] * ws.psf_im[i] + ws.cg_im[i] * ws.psf_re[i] ;
-		 ws.cg_re[i] = temp1 ;
-	}
-		
-	temp1 = 0.0 ;
-	for( int i = 0 ; i < _Space ; i++ ) temp1 += ( cgr[i] * cgp[i] * ((double) ws.sign[i]) ) ;
+	if( _Interleaved )
+		SPECTRAL_multiply<2>( ws.size, ws.cg_re, ws.cg_re + 1, ws.psf_re, ws.real ? NULL : ws.psf_re + 1, _Threads ) ;
+	else
+		SPECTRAL_multiply<1>( ws.size, ws.cg_re, ws.cg_im, ws.psf_re, ws.psf_im, _Threads ) ;
+	
+	CGdot< double > dot1 = { cgr, cgp, ws.sign } ;
+	temp1 = my_parallel_reduce( _Space, dot1, _Threads ) ;
      	
-	_FFTplanbb->execute( ws.cg_re, ws.cg_im, cgr ) ;
-	temp2 = 0.0 ;
-	for( int i = 0 ; i < _Space ; i++ ) temp2 += ( ((double) ws.sign[i]) * cgr[i] * cgr[i] ) ; 
+	_FFTplanb->backward( ws.cg_re, ws.cg_im, cgr ) ;
+	CGdot< double > dot2 = { cgr, cgr, ws.sign } ;
+	temp2 = my_parallel_reduce( _Space, dot2, _Threads ) ;
 	if( _ApplyIR )
 	{
-		temp3 = 0.0 ;
-		for( int i = 0 ; i < _Space ; i++ ) temp3 += ( ((float) ws.sign[i]) * cgp[i] * cgp[i] ) ;
-		temp2 += temp3 * _CGIRpenalty ;	
+		CGdot< double > dot3 = { cgp, cgp, ws.sign } ;
+		temp3 = my_parallel_reduce( _Space, dot3, _Threads ) ;
+		temp2 += temp3 * _CGIRpenalty ;
 	}
-     		
+     	
 	alpha = temp1 / temp2 ;
 }
 
@@ -705,60 +836,53 @@ void CGdeconvolver::_CGupdate2( float & gamma, float & alpha, float & beta, floa
 {
 	float temp1, temp2, temp3 ;
 		
-	for( int i = 0 ; i < ws.size ; i++ )
-	{
-		ws.cg_re[i] = ws.image_re[i] - ( ws.otf[i] + _CGIRpenalty ) * ws.cg_re[i] ;
-		ws.cg_im[i] = ws.image_im[i] - ( ws.otf[i] + _CGIRpenalty ) * ws.cg_im[i] ; 
-	}
-	
- 	_FFTplanbb->execute( ws.cg_re, ws.cg_im, cgr ) ;
+	if( _Interleaved )
+		SPECTRAL_residualIR<2>( ws.size, ws.cg_re, ws.cg_re + 1, ws.image_re, ws.image_re + 1, ws.otf, _CGIRpenalty, _Threads ) ;
+	else
+		SPECTRAL_residualIR<1>( ws.size, ws.cg_re, ws.cg_im, ws.image_re, ws.image_im, ws.otf, _CGIRpenalty, _Threads ) ;
+
+ 	_FFTplanb->backward( ws.cg_re, ws.cg_im, cgr ) ;
  	
  	if( gamma < 0.0 ) 
  	{
- 		gamma = 0.0 ;
- 		for( int i = 0 ; i < _Space ; i++ ) 
- 		{
- 			    cgp[i] = cgr[i] ;
- 			ws.sign[i] = ( unsigned char ) 1 ;
- 			   gamma  += ( cgr[i] * cgr[i] ) ;
- 		}
+ 		CGstart< float > start = { cgr, cgp, ws.sign } ;
+ 		gamma = my_parallel_reduce( _Space, start, _Threads ) ;
  	}
  	else
  	{
+ 		CGdot< float > norm = { cgr, cgr, NULL } ;
  		temp1 = gamma ;
- 		gamma = 0.0 ;
- 		for( int i = 0 ; i < _Space ; i++ ) gamma += cgr[i] * cgr[i] ;
+ 		gamma = my_parallel_reduce( _Space, norm, _Threads ) ;
  		beta = gamma / temp1 ;
- 		for( int i = 0 ; i < _Space ; i++ ) cgp[i] = cgr[i] + beta * cgp[i] ;
- 		_FFTplanff->execute( cgp, ws.cg_re, ws.cg_im ) ;
+ 		CGdirection< float > direction = { cgr, cgp, beta } ;
+ 		my_parallel_range( _Space, direction, _Threads ) ;
+ 		_FFTplanf->forward( cgp, ws.cg_re, ws.cg_im ) ;
  	}
  	
-	for( int i = 0 ; i < ws.size ; i++ )
-	{
-		       temp1 = ws.cg_re[i] * ws.psf_re[i] - ws.cg_im[i] * ws.psf_im[i] ;
-		 ws.cg_im[i] = ws.cg_re[i] * ws.psf_im[i] + ws.cg_im[i] * ws.psf_re[i] ;
-		 ws.cg_re[i] = temp1 ;
-	}
-		
-	temp1 = 0.0 ;
-	for( int i = 0 ; i < _Space ; i++ ) temp1 += ( cgr[i] * cgp[i] * ((float) ws.sign[i]) ) ;
+	if( _Interleaved )
+		SPECTRAL_multiply<2>( ws.size, ws.cg_re, ws.cg_re + 1, ws.psf_re, ws.real ? NULL : ws.psf_re + 1, _Threads ) ;
+	else
+		SPECTRAL_multiply<1>( ws.size, ws.cg_re, ws.cg_im, ws.psf_re, ws.psf_im, _Threads ) ;
+	
+	CGdot< float > dot1 = { cgr, cgp, ws.sign } ;
+	temp1 = my_parallel_reduce( _Space, dot1, _Threads ) ;
      	
-	_FFTplanbb->execute( ws.cg_re, ws.cg_im, cgr ) ;
-	temp2 = 0.0 ;
-	for( int i = 0 ; i < _Space ; i++ ) temp2 += ( ((float) ws.sign[i]) * cgr[i] * cgr[i] ) ; 
+	_FFTplanb->backward( ws.cg_re, ws.cg_im, cgr ) ;
+	CGdot< float > dot2 = { cgr, cgr, ws.sign } ;
+	temp2 = my_parallel_reduce( _Space, dot2, _Threads ) ;
 	if( _ApplyIR )
 	{
-		temp3 = 0.0 ;
-		for( int i = 0 ; i < _Space ; i++ ) temp3 += ( ((float) ws.sign[i]) * cgp[i] * cgp[i] ) ;
-		temp2 += temp3 * _CGIRpenalty ;	
+		CGdot< float > dot3 = { cgp, cgp, ws.sign } ;
+		temp3 = my_parallel_reduce( _Space, dot3, _Threads ) ;
+		temp2 += temp3 * _CGIRpenalty ;
 	}
-     		
+     	
 	alpha = temp1 / temp2 ;
 }
 
 
 
-double CGdeconvolver::_CGrunRegularization( int size, double * img, double * otf )
+double CGdeconvolver::_CGrunRegularization( size_t size, double * img, double * otf )
 {
 	double R   = 0.61803399 ;
 	double C   = 1.0 - R ;
@@ -774,7 +898,7 @@ double CGdeconvolver::_CGrunRegularization( int size, double * img, double * otf
 		x0 = x0 * 0.1 ;
 		gcv1 = 0.0 ;
 		gcv2 = 0.0 ;
-		for( int i = 0 ; i < size ; i++ )
+		for( size_t i = 0 ; i < size ; i++ )
 		{ 
 			gcv1 += ( x0 * x0 * img[i] / ( otf[i] + x0 ) / ( otf[i] + x0 ) ) ;
 			gcv2 += ( x0 / ( otf[i] + x0 ) ) ;
@@ -790,7 +914,7 @@ double CGdeconvolver::_CGrunRegularization( int size, double * img, double * otf
 		x2 = x1 + C * ( x3 - x1 ) ;
 		gcv1 = 0.0 ;
 		gcv2 = 0.0 ;
-		for( int i = 0 ; i < size ; i++ )
+		for( size_t i = 0 ; i < size ; i++ )
 		{ 
 			gcv1 += ( x2 * x2 * img[i] / ( otf[i] + x2 ) / ( otf[i] + x2 ) ) ;
 			gcv2 += ( x2 / ( otf[i] + x2 ) ) ;
@@ -804,7 +928,7 @@ double CGdeconvolver::_CGrunRegularization( int size, double * img, double * otf
 		x1 = x2 - C * ( x2 - x0 ) ;
 		gcv1 = 0.0 ;
 		gcv2 = 0.0 ;
-		for( int i = 0 ; i < size ; i++ )
+		for( size_t i = 0 ; i < size ; i++ )
 		{ 
 			gcv1 += ( x1 * x1 * img[i] / ( otf[i] + x1 ) / ( otf[i] + x1 ) ) ;
 			gcv2 += ( x1 / ( otf[i] + x1 ) ) ;
@@ -822,7 +946,7 @@ double CGdeconvolver::_CGrunRegularization( int size, double * img, double * otf
 			f1 = f2 ;
 			gcv1 = 0.0 ;
 			gcv2 = 0.0 ;
-			for( int i = 0 ; i < size ; i++ )
+			for( size_t i = 0 ; i < size ; i++ )
 			{ 
 				gcv1 += ( x2 * x2 * img[i] / ( otf[i] + x2 ) / ( otf[i] + x2 ) ) ;
 				gcv2 += ( x2 / ( otf[i] + x2 ) ) ;
@@ -837,7 +961,7 @@ double CGdeconvolver::_CGrunRegularization( int size, double * img, double * otf
 			f2 = f1 ;
 			gcv1 = 0.0 ;
 			gcv2 = 0.0 ;
-			for( int i = 0 ; i < size ; i++ )
+			for( size_t i = 0 ; i < size ; i++ )
 			{ 
 				gcv1 += ( x1 * x1 * img[i] / ( otf[i] + x1 ) / ( otf[i] + x1 ) ) ;
 				gcv2 += ( x1 / ( otf[i] + x1 ) ) ;
@@ -858,7 +982,7 @@ double CGdeconvolver::_CGrunRegularization( int size, double * img, double * otf
 
 
 
-double CGdeconvolver::_CGrunRegularization( int size, float * img, float * otf )
+double CGdeconvolver::_CGrunRegularization( size_t size, float * img, float * otf )
 {
 	double R   = 0.61803399 ;
 	double C   = 1.0 - R ;
@@ -874,7 +998,7 @@ double CGdeconvolver::_CGrunRegularization( int size, float * img, float * otf )
 		x0 = x0 * 0.1 ;
 		gcv1 = 0.0 ;
 		gcv2 = 0.0 ;
-		for( int i = 0 ; i < size ; i++ )
+		for( size_t i = 0 ; i < size ; i++ )
 		{ 
 			gcv1 += ( x0 * x0 * img[i] / ( otf[i] + x0 ) / ( otf[i] + x0 ) ) ;
 			gcv2 += ( x0 / ( otf[i] + x0 ) ) ;
@@ -890,7 +1014,7 @@ double CGdeconvolver::_CGrunRegularization( int size, float * img, float * otf )
 		x2 = x1 + C * ( x3 - x1 ) ;
 		gcv1 = 0.0 ;
 		gcv2 = 0.0 ;
-		for( int i = 0 ; i < size ; i++ )
+		for( size_t i = 0 ; i < size ; i++ )
 		{ 
 			gcv1 += ( x2 * x2 * img[i] / ( otf[i] + x2 ) / ( otf[i] + x2 ) ) ;
 			gcv2 += ( x2 / ( otf[i] + x2 ) ) ;
@@ -904,7 +1028,7 @@ double CGdeconvolver::_CGrunRegularization( int size, float * img, float * otf )
 		x1 = x2 - C * ( x2 - x0 ) ;
 		gcv1 = 0.0 ;
 		gcv2 = 0.0 ;
-		for( int i = 0 ; i < size ; i++ )
+		for( size_t i = 0 ; i < size ; i++ )
 		{ 
 			gcv1 += ( x1 * x1 * img[i] / ( otf[i] + x1 ) / ( otf[i] + x1 ) ) ;
 			gcv2 += ( x1 / ( otf[i] + x1 ) ) ;
@@ -922,7 +1046,7 @@ double CGdeconvolver::_CGrunRegularization( int size, float * img, float * otf )
 			f1 = f2 ;
 			gcv1 = 0.0 ;
 			gcv2 = 0.0 ;
-			for( int i = 0 ; i < size ; i++ )
+			for( size_t i = 0 ; i < size ; i++ )
 			{ 
 				gcv1 += ( x2 * x2 * img[i] / ( otf[i] + x2 ) / ( otf[i] + x2 ) ) ;
 				gcv2 += ( x2 / ( otf[i] + x2 ) ) ;
@@ -937,7 +1061,7 @@ double CGdeconvolver::_CGrunRegularization( int size, float * img, float * otf )
 			f2 = f1 ;
 			gcv1 = 0.0 ;
 			gcv2 = 0.0 ;
-			for( int i = 0 ; i < size ; i++ )
+			for( size_t i = 0 ; i < size ; i++ )
 			{ 
 				gcv1 += ( x1 * x1 * img[i] / ( otf[i] + x1 ) / ( otf[i] + x1 ) ) ;
 				gcv2 += ( x1 / ( otf[i] + x1 ) ) ;
@@ -955,3 +1079,143 @@ double CGdeconvolver::_CGrunRegularization( int size, float * img, float * otf )
 		return x2 ;
 	}
 }
+
+
+/* 
+	CGsession: the FFT of the PSF and the OTF are kept from prepare(); they are copied back
+	before each run() since the deconvolution loop scales them by the conditioning value.
+	The spectrum of the PSF takes the first 2 * size values of the copy if it is interleaved.
+*/
+
+CGsession::CGsession()
+{
+	_Prepared    = false ;
+	_IsDouble    = true ;
+	_Conditioned = false ;
+	_dscratch    = NULL ;
+	_sscratch    = NULL ;
+	_dspec       = NULL ;
+	_sspec       = NULL ;
+}
+
+
+
+CGsession::~CGsession()
+{
+	release() ;
+}
+
+
+
+void CGsession::prepare( int DimX, int DimY, int DimZ, double * psf, unsigned char * FrequencySupport )
+{
+	release() ;
+	
+	_CGstartRun( DimX, DimY, DimZ, _dws ) ;
+	WS_malloc( _dscratch, _Space ) ;
+	WS_malloc( _dspec, 3 * _dws.size ) ;
+	if( _Interleaved ) _initPSF( _FFTplanf, psf, _dws.psf_re, FrequencySupport, _dws.otf ) ;
+	else               _initPSF( _dws.size, psf, _dws.psf_re, _dws.psf_im, FrequencySupport, _dws.otf ) ;
+	size_t n = ( _Interleaved && !_dws.real ) ? 2 * _dws.size : _dws.size ;
+	for( size_t i = 0 ; i < n ; i++ ) _dspec[i] = _dws.psf_re[i] ;
+	for( size_t i = 0 ; i < _dws.size ; i++ ) 
+	{
+		if( _dws.psf_im != NULL ) _dspec[i + _dws.size] = _dws.psf_im[i] ;
+		_dspec[i + 2 * _dws.size] = _dws.otf[i] ;
+	}
+	
+	_IsDouble    = true ;
+	_Conditioned = false ;
+	_Prepared    = true ;
+}
+
+
+
+void CGsession::run( double * image, double * object, unsigned char * SpacialSupport )
+{
+	if( !_Prepared || !_IsDouble ) throw SessionError( "CGsession" ) ;
+	
+	if( _Update.size()  > 0 ) _Update.clear() ;
+	if( _Likelihood.size() > 0 ) _Likelihood.clear() ;
+	if( _ObjectMax.size()  > 0 ) _ObjectMax.clear() ;
+	_ApplySpacialSupport = false ;
+	
+	if( _CheckStatus ) _CGprintStatus( 1 ) ;
+	size_t n = ( _Interleaved && !_dws.real ) ? 2 * _dws.size : _dws.size ;
+	for( size_t i = 0 ; i < n ; i++ ) _dws.psf_re[i] = _dspec[i] ;
+	for( size_t i = 0 ; i < _dws.size ; i++ ) 
+	{
+		if( _dws.psf_im != NULL ) _dws.psf_im[i] = _dspec[i + _dws.size] ;
+		   _dws.otf[i] = _dspec[i + 2 * _dws.size] ;
+	}
+	_CGrunFrame( image, _dscratch, object, _dws, SpacialSupport, !_Conditioned && _ConditioningIteration > 0 ) ;
+	_Conditioned = true ;
+}
+
+
+
+void CGsession::prepare( int DimX, int DimY, int DimZ, float * psf, unsigned char * FrequencySupport )
+{
+	release() ;
+	
+	_CGstartRun( DimX, DimY, DimZ, _sws ) ;
+	WS_malloc( _sscratch, _Space ) ;
+	WS_malloc( _sspec, 3 * _sws.size ) ;
+	if( _Interleaved ) _initPSF( _FFTplanf, psf, _sws.psf_re, FrequencySupport, _sws.otf ) ;
+	else               _initPSF( _sws.size, psf, _sws.psf_re, _sws.psf_im, FrequencySupport, _sws.otf ) ;
+	size_t n = ( _Interleaved && !_sws.real ) ? 2 * _sws.size : _sws.size ;
+	for( size_t i = 0 ; i < n ; i++ ) _sspec[i] = _sws.psf_re[i] ;
+	for( size_t i = 0 ; i < _sws.size ; i++ ) 
+	{
+		if( _sws.psf_im != NULL ) _sspec[i + _sws.size] = _sws.psf_im[i] ;
+		_sspec[i + 2 * _sws.size] = _sws.otf[i] ;
+	}
+	
+	_IsDouble    = false ;
+	_Conditioned = false ;
+	_Prepared    = true ;
+}
+
+
+
+void CGsession::run( float * image, float * object, unsigned char * SpacialSupport )
+{
+	if( !_Prepared || _IsDouble ) throw SessionError( "CGsession" ) ;
+	
+	if( _Update.size()  > 0 ) _Update.clear() ;
+	if( _Likelihood.size() > 0 ) _Likelihood.clear() ;
+	if( _ObjectMax.size()  > 0 ) _ObjectMax.clear() ;
+	_ApplySpacialSupport = false ;
+	
+	if( _CheckStatus ) _CGprintStatus( 1 ) ;
+	size_t n = ( _Interleaved && !_sws.real ) ? 2 * _sws.size : _sws.size ;
+	for( size_t i = 0 ; i < n ; i++ ) _sws.psf_re[i] = _sspec[i] ;
+	for( size_t i = 0 ; i < _sws.size ; i++ ) 
+	{
+		if( _sws.psf_im != NULL ) _sws.psf_im[i] = _sspec[i + _sws.size] ;
+		   _sws.otf[i] = _sspec[i + 2 * _sws.size] ;
+	}
+	_CGrunFrame( image, _sscratch, object, _sws, SpacialSupport, !_Conditioned && _ConditioningIteration > 0 ) ;
+	_Conditioned = true ;
+}
+
+
+
+void CGsession::release()
+{
+	if( _Prepared )
+	{
+		if( _IsDouble ) _CGfinishRun( _dws ) ;
+		else            _CGfinishRun( _sws ) ;
+	}
+	WS_free( _dscratch ) ;
+	WS_free( _dspec ) ;
+	WS_free( _sscratch ) ;
+	WS_free( _sspec ) ;
+	
+	_dscratch    = NULL ;
+	_sscratch    = NULL ;
+	_dspec       = NULL ;
+	_sspec       = NULL ;
+	_Prepared = false ;
+}
@@ -49,7 +49,8 @@
  *		*****************************
  *		The input cubic image to be deconvolved, with the dimensions of DimX, DimY and DimZ 
  *		where DimX is its fastest varying dimension and DimZ is its slowest varying dimension, 
- *		must have a black (0) background. Each dimension of the cubic image must be a power of 2. 
+ *		must have a black (0) background. Any positive dimensions are allowed, but FFTs are fastest if
+ *		each dimension is a product of 2, 3, 5 and 7; pad the image to such a size with "PADfft.h". 
  *		The image data must be stored in an one-dimensional array : <image> as "x+y*DimX+z*DimX*DimY".
  *		
  *		Warnning: the <image> array will be rewritten in run(). 
@@ -101,10 +102,19 @@
 
 /*
  *	CGdeconvolver working space in double floating precision
+ *	<bytes> is the size in bytes of a working space from allocWorkspace(); it is 0 if run() allocates its own.
+ *	<cg_re> and <cg_im> hold the spectrum of the estimated object.
+ *	The spectra <psf_*>, <image_*> and <cg_*> have <size> values each; if the deconvolver is interleaved 
+ *	(see "deconvolver.h"), <psf_re>, <image_re> and <cg_re> hold <size> (re, im) pairs and the <*_im> are NULL.
+ *	<real> is true if the PSF spectrum is real (see setRealOTF() in "deconvolver.h"); <psf_re> then holds 
+ *	<size> real values in both layouts and <psf_im> is NULL.
  */
-typedef struct
+struct CGdws
 {
-	int size ;
+	CGdws() : size( 0 ), bytes( 0 ), real( false ), psf_re( NULL ), psf_im( NULL ), image_re( NULL ), image_im( NULL ), cg_re( NULL ), cg_im( NULL ), otf( NULL ), sign( NULL ) {}
+	size_t size ;
+	size_t bytes ;
+	bool real ;
 	double * psf_re ;
 	double * psf_im ;
 	double * image_re ;
@@ -112,17 +122,19 @@ typedef struct
 	double * cg_re ;
 	double * cg_im ;
 	double * otf ;
-	double * object0 ;
 	unsigned char * sign ;
-} CGdws ;
+} ;
 
 
 /*
  *	CGdeconvolver working space in single floating precision
  */
-typedef struct
+struct CGsws
 {
-	int size ;
+	CGsws() : size( 0 ), bytes( 0 ), real( false ), psf_re( NULL ), psf_im( NULL ), image_re( NULL ), image_im( NULL ), cg_re( NULL ), cg_im( NULL ), otf( NULL ), sign( NULL ) {}
+	size_t size ;
+	size_t bytes ;
+	bool real ;
 	float * psf_re ;
 	float * psf_im ;
 	float * image_re ;
@@ -130,9 +142,8 @@ typedef struct
 	float * cg_re ;
 	float * cg_im ;
 	float * otf ;
-	float * object0 ;
 	unsigned char * sign ;
-} CGsws ;
+} ;
 
                
 class CGdeconvolver : public LWCGdeconvolver
@@ -165,11 +176,13 @@ class CGdeconvolver : public LWCGdeconvolver
 	/*
 	 *	Run CGdeconvolution in the double/single floating precision
 	 *	Input:
-	 *		DimX,             it is the fastest varying dimension of the image/psf; it must be power of 2.
-	 *		DimY,             it is the middle          dimension of the image/psf; it must be power of 2.
-	 *		DimZ,             it is the slowest varying dimension of the image/psf; it must be power of 2.
-	 *		image,            it points to an one-dimensional DimX*DimY*DimZ array storing the image data.
-	 *		psf,              it points to an one-dimensional DimX*DimY*DimZ array storing the psf data.
+	 *		DimX,             it is the fastest varying dimension of the image/psf; it must be positive.
+	 *		DimY,             it is the middle          dimension of the image/psf; it must be positive.
+	 *		DimZ,             it is the slowest varying dimension of the image/psf; it must be positive.
+	 *		image,            it points to an one-dimensional DimX*DimY*DimZ array storing the image data;
+	 *		                  it will be rewritten.
+	 *		psf,              it points to an one-dimensional DimX*DimY*DimZ array storing the psf data;
+	 *		                  it will be rewritten.
 	 *		object,           it points to an one-dimensional DimX*DimY*DimZ array storing both 
 	 *		                  the first estimated object data and the finally deconvolved object data. 
 	 *		ws,               it points to the CGdeconvolver double/float working space. 
@@ -184,6 +197,37 @@ class CGdeconvolver : public LWCGdeconvolver
 	             unsigned char * SpacialSupport = NULL, unsigned char * FrequencySupport = NULL ) ;   
 	void    run( int DimX, int DimY, int DimZ, float  * image, float  * psf, float  * object, CGsws & ws,
 	             unsigned char * SpacialSupport = NULL, unsigned char * FrequencySupport = NULL ) ;
+
+
+	/*
+	 *	Run CGdeconvolution without rewriting the image and the psf, in double/single floating precision
+	 *	The input is the same as for run() above, but <image> and <psf> are only read; the run allocates 
+	 *	two DimX*DimY*DimZ scratch volumes and frees them at its end.
+	 *	Throw:
+	 *		throw an error if a given dimension is wrong.
+	 */
+	void    run( int DimX, int DimY, int DimZ, const double * image, const double * psf, double * object, CGdws & ws,
+	             unsigned char * SpacialSupport = NULL, unsigned char * FrequencySupport = NULL ) ;
+	void    run( int DimX, int DimY, int DimZ, const float  * image, const float  * psf, float  * object, CGsws & ws,
+	             unsigned char * SpacialSupport = NULL, unsigned char * FrequencySupport = NULL ) ;
+	
+	/*
+	 *	Allocate/free a CGdeconvolver working space once for many runs of a same size
+	 *	The working space is allocated with fftw_malloc() for the dimensions and the control flags set at 
+	 *	the time; run() then uses it instead of allocating and freeing its own. 
+	 *	Input:
+	 *		DimX, DimY, DimZ, they are the dimensions of the runs; each must be positive.
+	 *		ws,               it is the working space; ws.bytes returns its size in bytes.
+	 *	Throw:
+	 *		throw an error if a given dimension is wrong; run() throws an error if the working space 
+	 *		does not fit its dimensions or control flags; std::bad_alloc is thrown, and nothing is
+	 *		allocated, if the memory runs out.
+	 */
+	void    allocWorkspace( int DimX, int DimY, int DimZ, CGdws & ws ) ;
+	void    allocWorkspace( int DimX, int DimY, int DimZ, CGsws & ws ) ;
+	void    freeWorkspace( CGdws & ws ) ;
+	void    freeWorkspace( CGsws & ws ) ;
+	
 	
 	/*
 	 *	Export the profile of a CGdeconvolver to a text file
@@ -195,11 +239,9 @@ class CGdeconvolver : public LWCGdeconvolver
 	void    exportCG( const char * filename ) ;
 	
 
-	private:
+	protected:
 	bool           	_ApplyIR ;
 	double         	_CGIRpenalty ;	
-	FFTW3_FFT* 		_FFTplanff ;
-	FFTW3_FFT* 		_FFTplanbb ;
         
 	void    _CGprintStatus( int stage ) ;
         
@@ -209,14 +251,96 @@ class CGdeconvolver : public LWCGdeconvolver
 	void    _CGfinishRun( CGdws & ws ) ;
 	void    _CGfinishRun( CGsws & ws ) ;
         
+	void    _CGrunFrame( double * cgr, double * cgp, double * object, CGdws & ws, unsigned char * SpacialSupport, bool condition ) ;
+	void    _CGrunFrame( float  * cgr, float  * cgp, float  * object, CGsws & ws, unsigned char * SpacialSupport, bool condition ) ;
+        
 	void    _CGupdate1( double & gamma, double & alpha, double & beta, double * cgr, double * cgp, CGdws & ws ) ; 
 	void    _CGupdate1( float  & gamma, float  & alpha, float  & beta, float  * cgr, float  * cgp, CGsws & ws ) ; 
         
 	void    _CGupdate2( double & gamma, double & alpha, double & beta, double * cgr, double * cgp, CGdws & ws ) ; 
 	void    _CGupdate2( float  & gamma, float  & alpha, float  & beta, float  * cgr, float  * cgp, CGsws & ws ) ;
   
-	double  _CGrunRegularization( int size, double * img, double * otf ) ;
-	double  _CGrunRegularization( int size, float  * img, float  * otf ) ;
+	double  _CGrunRegularization( size_t size, double * img, double * otf ) ;
+	double  _CGrunRegularization( size_t size, float  * img, float  * otf ) ;
+} ;
+
+
+
+/*
+ *	===========================================================================================
+ *	CGsession runs CGdeconvolution on many images taken with a same PSF, e.g. the frames of a 
+ *	time-lapse series: prepare() creates the FFT plans, the working space and the FFT of the PSF 
+ *	once, and each run() then deconvolves one image without allocating memory or creating plans.
+ *	===========================================================================================
+ *
+ *	The control flags and parameters are set as for a CGdeconvolver, before prepare().
+ *	The conditioning value is searched on the first image run and then used for the following ones;
+ *	set <_ConditioningIteration> to 0 and give <_ConditioningValue> before prepare() to skip the search.
+ *	The intensity regularization penalty depends on the image and is found again for each run().
+ */
+class CGsession : public CGdeconvolver
+{
+	public:
+	CGsession() ;
+	virtual ~CGsession() ;
+	
+	
+	/*
+	 *	Prepare a session in double/single floating precision
+	 *	Input:
+	 *		DimX, DimY, DimZ, they are the dimensions of the psf and of every image; each must be positive.
+	 *		psf,              it points to an one-dimensional DimX*DimY*DimZ array storing the psf data;
+	 *		                  it is not kept by the session.
+	 *		FrequencySupport, it points to an one-dimensional unsigned char DimX*DimY*DimZ
+	 *		                  array storing the frequency support data and its default is NULL.
+	 *	Throw:
+	 *		throw an error if a given dimension is wrong.
+	 */
+	void    prepare( int DimX, int DimY, int DimZ, double * psf, unsigned char * FrequencySupport = NULL ) ;
+	void    prepare( int DimX, int DimY, int DimZ, float  * psf, unsigned char * FrequencySupport = NULL ) ;
+	
+	
+	/*
+	 *	Run CGdeconvolution on one image with the prepared psf
+	 *	Input:
+	 *		image,            it points to an one-dimensional DimX*DimY*DimZ array storing the image data;
+	 *		                  it will be rewritten.
+	 *		object,           it points to an one-dimensional DimX*DimY*DimZ array storing both 
+	 *		                  the first estimated object data and the finally deconvolved object data. 
+	 *		SpacialSuppport,  it points to an one-dimensional unsigned char DimX*DimY*DimZ 
+	 *		                  array storing the spacial support data and its default is NULL.
+	 *	Throw:
+	 *		throw an error if the session has not been prepared in the same floating precision.
+	 */
+	void    run( double * image, double * object, unsigned char * SpacialSupport = NULL ) ;
+	void    run( float  * image, float  * object, unsigned char * SpacialSupport = NULL ) ;
+	
+	
+	/*
+	 *	Release the FFT plans and the working space of a session; it is called by prepare() and the destructor.
+	 */
+	void    release() ;
+	
+	
+	/*
+	 *	Get the state of a session
+	 *	IsPrepared() returns true after prepare() and until release().
+	 *	IsDouble()   returns true if the session was prepared in double floating precision.
+	 */
+	bool    IsPrepared()  { return _Prepared ; }
+	bool    IsDouble()    { return _IsDouble ; }
+	
+	
+	private:
+	bool      _Prepared ;
+	bool      _IsDouble ;
+	bool      _Conditioned ;
+	CGdws     _dws ;
+	CGsws     _sws ;
+	double *  _dscratch ;
+	float  *  _sscratch ;
+	double *  _dspec ;
+	float  *  _sspec ;
 } ;
 
 
@@ -21,21 +21,308 @@
 
 #include <math.h>
 #include "EMdeconvolver.h"
+#include "SPECTRALkernels.h"
 
 EMdeconvolver::EMdeconvolver() :deconvolver()
 { 
+	_FFTplanf = NULL ;
+	_FFTplanb = NULL ;
+	_Batch    = 1 ;
+	_ExtX     = 0 ;
+	_ExtY     = 0 ;
+	_ExtZ     = 0 ;
+	_RadialOTF = false ;
+	_Extrapolate = false ;
 	init() ; 
 }		
 
 EMdeconvolver::~EMdeconvolver()
 {
-	if (_FFTplanf)
-		delete _FFTplanf ;
-		
-	if (_FFTplanb)
-		delete _FFTplanb ;
+	FFTW3_PlanCache::release( _FFTplanf ) ;
+	FFTW3_PlanCache::release( _FFTplanb ) ;
+}
+
+template< class WS >
+static void EMdeallocate( WS & ws )
+{
+	WS_free( ws.psf_re ) ;
+	WS_free( ws.psf_im ) ;
+	RADIAL_free( ws.radial ) ;
+	WS_free( ws.buf_re ) ;
+	WS_free( ws.buf_im ) ;
+	WS_free( ws.buf ) ;
+	WS_free( ws.eimg ) ;
+	WS_free( ws.grad ) ;
 }
 
+/*
+	The EM working space: the spectra of the PSF and of the convolutions, split or interleaved, 
+	the last object and the estimated image used by the acceleration and the likelihood, 
+	and the change of the last EM step used by the extrapolation, 
+	allocated with fftw_malloc(); returns its size in bytes. A real PSF spectrum takes <size> values, 
+	a radial one a table in place of the PSF spectrum (see "RADIALotf.h").
+	If an array can not be allocated, the ones already allocated are freed and std::bad_alloc is thrown.
+*/
+template< class WS >
+static size_t EMallocate( WS & ws, int DimX, int DimY, int DimZ, int batch, bool interleaved, bool real, bool radial, bool eimg, bool grad )
+{
+	size_t bytes = 0 ;
+	size_t size  = FFTW3_FFT::FFTsize( DimX, DimY, DimZ ) * batch ;
+	size_t space = (size_t) DimX * DimY * DimZ * batch ;
+	
+	ws.size = size ;
+	ws.real = real ;
+	try
+	{
+		if( radial )
+		{
+			bytes += RADIAL_allocate( ws.radial, DimX, DimY, DimZ, batch ) ;
+			ws.psf_re = NULL ;
+			ws.psf_im = NULL ;
+		}
+		else if( real )
+		{
+			bytes += WS_malloc( ws.psf_re, size ) ;
+			ws.psf_im = NULL ;
+		}
+		else if( interleaved )
+		{
+			bytes += WS_malloc( ws.psf_re, 2 * (size_t)size ) ;
+			ws.psf_im = NULL ;
+		}
+		else
+		{
+			bytes += WS_malloc( ws.psf_re, size ) ;
+			bytes += WS_malloc( ws.psf_im, size ) ;
+		}
+		if( interleaved )
+		{
+			bytes += WS_malloc( ws.buf_re, 2 * (size_t)size ) ;
+			ws.buf_im = NULL ;
+		}
+		else
+		{
+			bytes += WS_malloc( ws.buf_re, size ) ;
+			bytes += WS_malloc( ws.buf_im, size ) ;
+		}
+		bytes += WS_malloc( ws.buf,  space ) ;
+		bytes += WS_malloc( ws.eimg, eimg ? space : 0 ) ;
+		bytes += WS_malloc( ws.grad, grad ? space : 0 ) ;
+	}
+	catch( std::bad_alloc & )
+	{
+		EMdeallocate( ws ) ;
+		throw ;
+	}
+	
+	return bytes ;
+}
+
+/*
+	The loops of the EM update on the object, see "MYthreads.h".
+	EMratio     : model = max( model, eps ), rat = image / model ; returns the likelihood of <model> if <track>.
+	EMstep      : last = object, object = max( object * rat, 0 ).
+	EMdirection : last = object, object = object * ( rat - 1 ).
+	EMtrial     : returns the likelihood of eimg + alpha * rat and, if <count>, the number of voxels 
+	              where the negative <object> would make last + alpha * object negative.
+	EMnewton    : returns the two sums of the Newton step on <alpha>.
+	EMcombine   : object = max( last + alpha * object, 0 ).
+	
+	The loops of the Biggs-Andrews extrapolation :
+	EMextrapolate : last = object, object = max( object + alpha * ( object - last ), 0 ).
+	EMbiggs       : object = max( object * rat, 0 ) masked by <support>, grad = the change of object; 
+	                returns the sums of grad * the last grad and of the last grad * itself.
+*/
+template< class T >
+struct EMratio
+{
+	typedef double result ;
+	const T * image ; T * model ; T * rat ; double eps ; bool track ;
+	
+	double operator()( size_t begin, size_t end ) const
+	{
+		double likelihood = 0.0 ;
+		for( size_t i = begin ; i < end ; i++ )
+		{
+			if ( model[i] < eps ) model[i] = eps ;
+			if ( track ) likelihood += ( image[i] * log(model[i]) - model[i] ) ;
+			rat[i] = image[i] / model[i] ;
+		}
+		return likelihood ;
+	}
+	
+	void join( double & total, const double & partial ) const { total += partial ; }
+} ;
+
+template< class T >
+struct EMstep
+{
+	T * object ; const T * rat ; T * last ;
+	
+	void operator()( size_t begin, size_t end ) const
+	{
+		for( size_t i = begin ; i < end ; i++ ) 
+		{
+			last[i]  = object[i] ;	
+			object[i] *= rat[i] ;
+			if ( object[i] < 0.0 ) object[i] = 0.0 ;
+		}
+	}
+} ;
+
+template< class T >
+struct EMdirection
+{
+	T * object ; const T * rat ; T * last ;
+	
+	void operator()( size_t begin, size_t end ) const
+	{
+		for( size_t i = begin ; i < end ; i++ ) 
+		{
+			last[i]  = object[i] ;
+			object[i] *= ( rat[i] - 1.0 ) ;
+		}
+	}
+} ;
+
+typedef struct
+{
+	double likelihood ;
+	size_t negative ;
+} EMtrialSums ;
+
+template< class T >
+struct EMtrial
+{
+	typedef EMtrialSums result ;
+	const T * image ; const T * object ; const T * last ; const T * eimg ; const T * rat ; double alpha ; double eps ; bool count ;
+	
+	EMtrialSums operator()( size_t begin, size_t end ) const
+	{
+		EMtrialSums sums = { 0.0, 0 } ;
+		T temp ;
+		for( size_t i = begin ; i < end ; i++ )
+		{
+			if( count && object[i] < 0.0 && ( alpha * object[i] + last[i] ) < 0.0 ) sums.negative++ ;
+			temp = eimg[i] + alpha * rat[i] ;
+			if ( temp > eps ) sums.likelihood += ( image[i] * log(temp) - temp ) ;
+		}
+		return sums ;
+	}
+	
+	void join( EMtrialSums & total, const EMtrialSums & partial ) const 
+	{
+		total.likelihood += partial.likelihood ;
+		total.negative   += partial.negative ;
+	}
+} ;
+
+typedef struct
+{
+	double first ;
+	double second ;
+} EMnewtonSums ;
+
+template< class T >
+struct EMnewton
+{
+	typedef EMnewtonSums result ;
+	const T * image ; const T * eimg ; const T * rat ; double alpha ; double eps ;
+	
+	EMnewtonSums operator()( size_t begin, size_t end ) const
+	{
+		EMnewtonSums sums = { 0.0, 0.0 } ;
+		T temp ;
+		for( size_t i = begin ; i < end ; i++ ) 
+		{
+			temp = eimg[i] + alpha * rat[i] ; 
+			if( fabs( temp ) > eps )
+			{ 
+				sums.first  += ( image[i] * rat[i] / temp - rat[i] ) ;
+				sums.second += ( image[i] * rat[i] * rat[i] / ( temp * temp ) ) ;
+			}
+		}
+		return sums ;
+	}
+	
+	void join( EMnewtonSums & total, const EMnewtonSums & partial ) const 
+	{
+		total.first  += partial.first ;
+		total.second += partial.second ;
+	}
+} ;
+
+template< class T >
+struct EMcombine
+{
+	T * object ; const T * last ; double alpha ;
+	
+	void operator()( size_t begin, size_t end ) const
+	{
+		for( size_t i = begin ; i < end ; i++ ) 
+		{
+			object[i] = last[i] + alpha * object[i] ;
+			if ( object[i] < 0.0 ) object[i] = 0.0 ;
+		}
+	}
+} ;
+
+template< class T >
+struct EMextrapolate
+{
+	T * object ; T * last ; double alpha ;
+	
+	void operator()( size_t begin, size_t end ) const
+	{
+		T o ;
+		for( size_t i = begin ; i < end ; i++ ) 
+		{
+			o = (T)( object[i] + alpha * ( object[i] - last[i] ) ) ;
+			last[i]   = object[i] ;
+			object[i] = ( o < 0.0 ) ? 0.0 : o ;
+		}
+	}
+} ;
+
+typedef struct
+{
+	double gh ;
+	double hh ;
+} EMbiggsSums ;
+
+template< class T >
+struct EMbiggs
+{
+	typedef EMbiggsSums result ;
+	T * object ; const T * rat ; T * grad ; const unsigned char * support ;
+	
+	EMbiggsSums operator()( size_t begin, size_t end ) const
+	{
+		EMbiggsSums sums = { 0.0, 0.0 } ;
+		T o, g ;
+		for( size_t i = begin ; i < end ; i++ ) 
+		{
+			o = object[i] * rat[i] ;
+			if ( o < 0.0 ) o = 0.0 ;
+			if ( support != NULL ) o *= ((T) support[i]) ;
+			g = o - object[i] ;
+			sums.gh += g * grad[i] ;
+			sums.hh += grad[i] * grad[i] ;
+			grad[i]   = g ;
+			object[i] = o ;
+		}
+		return sums ;
+	}
+	
+	void join( EMbiggsSums & total, const EMbiggsSums & partial ) const 
+	{
+		total.gh += partial.gh ;
+		total.hh += partial.hh ;
+	}
+} ;
+
+
+
 /* public functions */
 
 void EMdeconvolver::setEMIRpenalty( double penalty )      
@@ -52,6 +339,15 @@ void EMdeconvolver::setEMIRpenalty( double penalty )
 }
 
 
+
+void EMdeconvolver::setNonzeroExtent( int ExtX, int ExtY, int ExtZ )
+{
+	_ExtX = ExtX > 0 ? ExtX : 0 ;
+	_ExtY = ExtY > 0 ? ExtY : 0 ;
+	_ExtZ = ExtZ > 0 ? ExtZ : 0 ;
+}
+
+
 	
 void EMdeconvolver::init( bool IsAccelerate, bool IsApplyNorm, bool IsTrackLike, bool IsTrackMax, bool IsCheckStatus )
 {
@@ -97,6 +393,24 @@ void EMdeconvolver::exportEM( const char * filename )
 			
 		fprintf( fp, "%d -> Apply newton acceleration iteratively in the deconvolution loop.\n", ((int) _Accelerate) ) ; 
 		fprintf( fp, "\n" ) ;
+		
+		if( _Extrapolate )
+		{
+			fprintf( fp, "%d -> Apply Biggs-Andrews extrapolation iteratively in the deconvolution loop.\n", ((int) _Extrapolate) ) ;
+			fprintf( fp, "\n" ) ;
+		}
+		
+		if( _ExtX > 0 || _ExtY > 0 || _ExtZ > 0 )
+		{
+			fprintf( fp, "%d %d %d -> Nonzero extent of the object, pruned FFTs are used.\n", _ExtX, _ExtY, _ExtZ ) ;
+			fprintf( fp, "\n" ) ;
+		}
+		
+		if( _RadialOTF )
+		{
+			fprintf( fp, "%d -> Keep the OTF as a radial (kr, kz) table.\n", ((int) _RadialOTF) ) ;
+			fprintf( fp, "\n" ) ;
+		}
 			
 		fclose( fp ) ;
 	}
@@ -108,18 +422,494 @@ void EMdeconvolver::exportEM( const char * filename )
 
 
 
+void EMdeconvolver::allocWorkspace( int DimX, int DimY, int DimZ, EMdws & ws, int N )
+{
+	int batch = ( N > 1 && !_Accelerate && !_Extrapolate ) ? N : 1 ;
+	
+	freeWorkspace( ws ) ;
+	_setDimensions( DimX, DimY, DimZ ) ;
+	ws.bytes = EMallocate( ws, _DimX, _DimY, _DimZ, batch, _Interleaved, _RealOTF, _RadialOTF, _Accelerate || _TrackLikelihood, _Extrapolate && !_Accelerate ) ;
+}
+
+
+
+void EMdeconvolver::allocWorkspace( int DimX, int DimY, int DimZ, EMsws & ws, int N )
+{
+	int batch = ( N > 1 && !_Accelerate && !_Extrapolate ) ? N : 1 ;
+	
+	freeWorkspace( ws ) ;
+	_setDimensions( DimX, DimY, DimZ ) ;
+	ws.bytes = EMallocate( ws, _DimX, _DimY, _DimZ, batch, _Interleaved, _RealOTF, _RadialOTF, _Accelerate || _TrackLikelihood, _Extrapolate && !_Accelerate ) ;
+}
+
+
+
+void EMdeconvolver::freeWorkspace( EMdws & ws )
+{
+	EMdeallocate( ws ) ;
+	ws.size  = 0 ;
+	ws.bytes = 0 ;
+}
+
+
+
+void EMdeconvolver::freeWorkspace( EMsws & ws )
+{
+	EMdeallocate( ws ) ;
+	ws.size  = 0 ;
+	ws.bytes = 0 ;
+}
+
+
+
 void EMdeconvolver::run( int DimX, int DimY, int DimZ, double * image, double * rat, double * object, EMdws & ws,
                          unsigned char * SpacialSupport, unsigned char * FrequencySupport )
 {
-	double max_intensity = 0.0, cri = 1.0E+37 ;
+	/* initialize running */
+	_Batch = 1 ;
+	_EMstartRun( DimX, DimY, DimZ, ws ) ;
+
+	/* start initialization */
+	if( _CheckStatus ) _EMprintStatus( 1 ) ;
+	if( _RadialOTF )        _EMradialPSF( rat, ws, FrequencySupport ) ;
+	else if( _Interleaved ) _EMinterleavedPSF( rat, ws, FrequencySupport ) ;
+	else                    _initPSF( ws.size, rat, ws.psf_re, ws.psf_im, FrequencySupport ) ;
+	_EMrunFrame( image, rat, object, ws, SpacialSupport, rat[0] ) ;
+	
+	/* end deconvolution */
+	_EMfinishRun( ws ) ;	
+}
+
+
+
+void EMdeconvolver::run( int DimX, int DimY, int DimZ, float * image, float * rat, float * object, EMsws & ws,
+                         unsigned char * SpacialSupport, unsigned char * FrequencySupport )
+{
+	/* initialize running */
+	_Batch = 1 ;
+	_EMstartRun( DimX, DimY, DimZ, ws ) ;
+
+	/* start initialization */
+	if( _CheckStatus ) _EMprintStatus( 1 ) ;
+	if( _RadialOTF )        _EMradialPSF( rat, ws, FrequencySupport ) ;
+	else if( _Interleaved ) _EMinterleavedPSF( rat, ws, FrequencySupport ) ;
+	else                    _initPSF( ws.size, rat, ws.psf_re, ws.psf_im, FrequencySupport ) ;
+	_EMrunFrame( image, rat, object, ws, SpacialSupport, rat[0] ) ;
+	
+	/* end deconvolution */
+	_EMfinishRun( ws ) ;	
+}
+
+
+
+/*
+	<image> is only copied when the normalization rescales it; <rat> is a scratch volume of the run.
+*/
+void EMdeconvolver::run( int DimX, int DimY, int DimZ, const double * image, const double * psf, double * object, EMdws & ws,
+                         unsigned char * SpacialSupport, unsigned char * FrequencySupport )
+{
+	double * rat  = NULL ;
+	double * copy = NULL ;
+	
+	/* initialize running */
+	_Batch = 1 ;
+	_EMstartRun( DimX, DimY, DimZ, ws ) ;
+	WS_malloc( rat, _Space ) ;
+	if( _ApplyNormalization )
+	{
+		WS_malloc( copy, _Space ) ;
+		for( size_t i = 0 ; i < _Space ; i++ ) copy[i] = image[i] ;
+	}
+
+	/* start initialization, the forward transform of the psf does not rewrite it */
+	if( _CheckStatus ) _EMprintStatus( 1 ) ;
+	if( _RadialOTF )        _EMradialPSF( const_cast< double * >( psf ), ws, FrequencySupport ) ;
+	else if( _Interleaved ) _EMinterleavedPSF( const_cast< double * >( psf ), ws, FrequencySupport ) ;
+	else                    _initPSF( ws.size, const_cast< double * >( psf ), ws.psf_re, ws.psf_im, FrequencySupport ) ;
+	_EMrunFrame( ( copy != NULL ) ? copy : const_cast< double * >( image ), rat, object, ws, SpacialSupport, psf[0] ) ;
+	WS_free( rat ) ;
+	WS_free( copy ) ;
+	
+	/* end deconvolution */
+	_EMfinishRun( ws ) ;	
+}
+
+
+
+/*
+	<image> is only copied when the normalization rescales it; <rat> is a scratch volume of the run.
+*/
+void EMdeconvolver::run( int DimX, int DimY, int DimZ, const float * image, const float * psf, float * object, EMsws & ws,
+                         unsigned char * SpacialSupport, unsigned char * FrequencySupport )
+{
+	float * rat  = NULL ;
+	float * copy = NULL ;
+	
+	/* initialize running */
+	_Batch = 1 ;
+	_EMstartRun( DimX, DimY, DimZ, ws ) ;
+	WS_malloc( rat, _Space ) ;
+	if( _ApplyNormalization )
+	{
+		WS_malloc( copy, _Space ) ;
+		for( size_t i = 0 ; i < _Space ; i++ ) copy[i] = image[i] ;
+	}
+
+	/* start initialization, the forward transform of the psf does not rewrite it */
+	if( _CheckStatus ) _EMprintStatus( 1 ) ;
+	if( _RadialOTF )        _EMradialPSF( const_cast< float * >( psf ), ws, FrequencySupport ) ;
+	else if( _Interleaved ) _EMinterleavedPSF( const_cast< float * >( psf ), ws, FrequencySupport ) ;
+	else                    _initPSF( ws.size, const_cast< float * >( psf ), ws.psf_re, ws.psf_im, FrequencySupport ) ;
+	_EMrunFrame( ( copy != NULL ) ? copy : const_cast< float * >( image ), rat, object, ws, SpacialSupport, psf[0] ) ;
+	WS_free( rat ) ;
+	WS_free( copy ) ;
+	
+	/* end deconvolution */
+	_EMfinishRun( ws ) ;	
+}
+
+
+
+void EMdeconvolver::runBatch( int DimX, int DimY, int DimZ, int N, double * image, double * rat, double * object, EMdws & ws,
+                              unsigned char * SpacialSupport, unsigned char * FrequencySupport )
+{
+	double cri = 1.0E+37 ;
+	double max_intensity = 0.0 ;
+	size_t space = (size_t) DimX * DimY * DimZ ;
+	
+	/* Newton acceleration and the extrapolation pick their own step for every volume */
+	if( N <= 1 || _Accelerate || _Extrapolate )
+	{
+		/* 
+			the plans of run() were made on fftw_malloc() arrays, a volume whose offset breaks 
+			their alignment runs on an aligned copy, which is copied back after the run
+		*/
+		double * copy[3] = { NULL, NULL, NULL } ;
+		double user = _EMIRpenalty ;
+		_EMIRpenalties.assign( N, user ) ;
+		for( int b = 0 ; b < N ; b++ )
+		{
+			/* run() keeps the penalty it finds, every volume finds its own from the user setting */
+			_EMIRpenalty = user ;
+			double * volume[3] = { image + b * space, rat + b * space, object + b * space } ;
+			bool aligned = true ;
+			for( int k = 0 ; k < 3 ; k++ ) aligned = aligned && ( fftw_alignment_of( volume[k] ) == 0 ) ;
+			if( aligned )
+			{
+				run( DimX, DimY, DimZ, volume[0], volume[1], volume[2], ws, SpacialSupport, FrequencySupport ) ;
+				_EMIRpenalties[b] = _EMIRpenalty ;
+				continue ;
+			}
+			
+			for( int k = 0 ; k < 3 ; k++ )
+			{
+				if( copy[k] == NULL ) WS_malloc( copy[k], space ) ;
+				for( size_t i = 0 ; i < space ; i++ ) copy[k][i] = volume[k][i] ;
+			}
+			run( DimX, DimY, DimZ, copy[0], copy[1], copy[2], ws, SpacialSupport, FrequencySupport ) ;
+			_EMIRpenalties[b] = _EMIRpenalty ;
+			for( int k = 0 ; k < 3 ; k++ )
+			{
+				for( size_t i = 0 ; i < space ; i++ ) volume[k][i] = copy[k][i] ;
+			}
+		}
+		for( int k = 0 ; k < 3 ; k++ ) WS_free( copy[k] ) ;
+		_EMIRpenalty = user ;
+		return ;
+	}
+
+	/* initialize running */
+	_Batch = N ;
+	_EMstartRun( DimX, DimY, DimZ, ws ) ;
+	size_t size = _FFTplanf->FFTsize() ;
+
+	/* start initialization */
+	if( _CheckStatus ) _EMprintStatus( 1 ) ;
+	if( _RadialOTF )        _EMradialPSF( rat, ws, FrequencySupport ) ;
+	else if( _Interleaved ) _EMinterleavedPSF( rat, ws, FrequencySupport ) ;
+	else 
+	{
+		for( int b = 0 ; b < N ; b++ )
+		{
+			_initPSF( size, rat + b * space, ws.psf_re + b * size, ws.real ? NULL : ws.psf_im + b * size, FrequencySupport ) ;
+		}
+	}
+	for( int b = 0 ; b < N ; b++ ) 
+	{
+		_initIMG( max_intensity, image + b * space, object + b * space, SpacialSupport ) ;
+		_EMapplyExtent( object + b * space ) ;
+	}
+	if( _CheckStatus ) _EMprintStatus( 2 ) ;	
+	
+	/* start regularization, with one penalty per volume */
+	std::vector< double > penalty( N, _EMIRpenalty ) ;
+	if( SpacialSupport != NULL ) _ApplySpacialSupport = true ;
+	if( _EMIRiteration > 0 )
+	{
+		for( int b = 0 ; b < N ; b++ )
+		{
+			if( penalty[b] < EMDepsilon )
+			{
+				double * img = image + b * space ;
+				if( _ApplyNormalization ) penalty[b] = rat[b * space] ;
+				else
+				{
+					max_intensity = img[0] ;
+					for( size_t i = 0 ; i < space ; i++ )
+					{
+						if( img[i] > max_intensity ) max_intensity = img[i] ;
+					}
+					penalty[b] = rat[b * space] / max_intensity ; 
+				}
+			}
+		}
+		if( _CheckStatus ) 
+		{
+			for( int b = 0 ; b < N ; b++ )
+			{
+				std::cout << " EMdeconvolver::runBatch applys intensity regularization to volume " << b 
+				          << " with penalty = " << penalty[b] << " every " << _EMIRiteration << " iterations.\n" ;
+			}
+		}
+	}	
+	_EMIRpenalties = penalty ;
+
+	/* deconvolution loop, one batched transform pair per convolution for all the volumes */
+	if( _CheckStatus ) _EMprintStatus( 4 ) ;	
+	while( _Update.size() < _MaxRunIteration && cri > _Criterion )
+	{
+		if( _CheckStatus ) _EMprintStatus( 5 ) ;
+		_EMupdate1( image, rat, object, ws ) ;        		
+		
+		/* the slowest converging volume decides when to stop */
+		bool regularize = ( _EMIRiteration > 0 && (_Update.size() + 1) % _EMIRiteration == 0 ) ;
+		for( int b = 0 ; b < N ; b++ ) 
+		{
+			double * obj = object + b * space ;
+			double * last = ws.buf + b * space ;
+			if( regularize ) 
+			     _pushUpdate( obj, last, UPDATE_object( space, obj, last, false, UPDATE_regularize< double >( obj, penalty[b] ), SpacialSupport, _Threads ) ) ;
+			else _pushUpdate( obj, last, UPDATE_object( space, obj, last, false, UPDATE_keep< double >( obj ), SpacialSupport, _Threads ) ) ;
+		}
+		_collapseBatch( _Update, N ) ;
+		if( _TrackMaxInObject ) _collapseBatch( _ObjectMax, N ) ;
+		
+		if( _Update.size() >= 10 )
+		{
+			cri = 0.0 ;
+			for( int i = 1 ; i <= 10 ; i++ ) cri += _Update[ _Update.size()-i ] ;
+			cri /= 10.0 ;
+		}		
+		if( _CheckStatus ) _EMprintStatus( 6 ) ;
+	}	
+	
+	/* end deconvolution */
+	_EMfinishRun( ws ) ;
+	_Batch = 1 ;
+}
+
+
+
+void EMdeconvolver::runBatch( int DimX, int DimY, int DimZ, int N, float * image, float * rat, float * object, EMsws & ws,
+                              unsigned char * SpacialSupport, unsigned char * FrequencySupport )
+{
+	double cri = 1.0E+37 ;
+	float max_intensity = 0.0 ;
+	size_t space = (size_t) DimX * DimY * DimZ ;
+	
+	/* Newton acceleration and the extrapolation pick their own step for every volume */
+	if( N <= 1 || _Accelerate || _Extrapolate )
+	{
+		/* 
+			the plans of run() were made on fftw_malloc() arrays, a volume whose offset breaks 
+			their alignment runs on an aligned copy, which is copied back after the run
+		*/
+		float * copy[3] = { NULL, NULL, NULL } ;
+		double user = _EMIRpenalty ;
+		_EMIRpenalties.assign( N, user ) ;
+		for( int b = 0 ; b < N ; b++ )
+		{
+			/* run() keeps the penalty it finds, every volume finds its own from the user setting */
+			_EMIRpenalty = user ;
+			float * volume[3] = { image + b * space, rat + b * space, object + b * space } ;
+			bool aligned = true ;
+			for( int k = 0 ; k < 3 ; k++ ) aligned = aligned && ( fftwf_alignment_of( volume[k] ) == 0 ) ;
+			if( aligned )
+			{
+				run( DimX, DimY, DimZ, volume[0], volume[1], volume[2], ws, SpacialSupport, FrequencySupport ) ;
+				_EMIRpenalties[b] = _EMIRpenalty ;
+				continue ;
+			}
+			
+			for( int k = 0 ; k < 3 ; k++ )
+			{
+				if( copy[k] == NULL ) WS_malloc( copy[k], space ) ;
+				for( size_t i = 0 ; i < space ; i++ ) copy[k][i] = volume[k][i] ;
+			}
+			run( DimX, DimY, DimZ, copy[0], copy[1], copy[2], ws, SpacialSupport, FrequencySupport ) ;
+			_EMIRpenalties[b] = _EMIRpenalty ;
+			for( int k = 0 ; k < 3 ; k++ )
+			{
+				for( size_t i = 0 ; i < space ; i++ ) volume[k][i] = copy[k][i] ;
+			}
+		}
+		for( int k = 0 ; k < 3 ; k++ ) WS_free( copy[k] ) ;
+		_EMIRpenalty = user ;
+		return ;
+	}
+
+	/* initialize running */
+	_Batch = N ;
+	_EMstartRun( DimX, DimY, DimZ, ws ) ;
+	size_t size = _FFTplanf->FFTsize() ;
+
+	/* start initialization */
+	if( _CheckStatus ) _EMprintStatus( 1 ) ;
+	if( _RadialOTF )        _EMradialPSF( rat, ws, FrequencySupport ) ;
+	else if( _Interleaved ) _EMinterleavedPSF( rat, ws, FrequencySupport ) ;
+	else 
+	{
+		for( int b = 0 ; b < N ; b++ )
+		{
+			_initPSF( size, rat + b * space, ws.psf_re + b * size, ws.real ? NULL : ws.psf_im + b * size, FrequencySupport ) ;
+		}
+	}
+	for( int b = 0 ; b < N ; b++ ) 
+	{
+		_initIMG( max_intensity, image + b * space, object + b * space, SpacialSupport ) ;
+		_EMapplyExtent( object + b * space ) ;
+	}
+	if( _CheckStatus ) _EMprintStatus( 2 ) ;	
+	
+	/* start regularization, with one penalty per volume */
+	std::vector< double > penalty( N, _EMIRpenalty ) ;
+	if( SpacialSupport != NULL ) _ApplySpacialSupport = true ;
+	if( _EMIRiteration > 0 )
+	{
+		for( int b = 0 ; b < N ; b++ )
+		{
+			if( penalty[b] < EMDepsilon )
+			{
+				float * img = image + b * space ;
+				if( _ApplyNormalization ) penalty[b] = rat[b * space] ;
+				else
+				{
+					max_intensity = img[0] ;
+					for( size_t i = 0 ; i < space ; i++ )
+					{
+						if( img[i] > max_intensity ) max_intensity = img[i] ;
+					}
+					penalty[b] = rat[b * space] / max_intensity ; 
+				}
+			}
+		}
+		if( _CheckStatus ) 
+		{
+			for( int b = 0 ; b < N ; b++ )
+			{
+				std::cout << " EMdeconvolver::runBatch applys intensity regularization to volume " << b 
+				          << " with penalty = " << penalty[b] << " every " << _EMIRiteration << " iterations.\n" ;
+			}
+		}
+	}	
+	_EMIRpenalties = penalty ;
+
+	/* deconvolution loop, one batched transform pair per convolution for all the volumes */
+	if( _CheckStatus ) _EMprintStatus( 4 ) ;	
+	while( _Update.size() < _MaxRunIteration && cri > _Criterion )
+	{
+		if( _CheckStatus ) _EMprintStatus( 5 ) ;
+		_EMupdate1( image, rat, object, ws ) ;        		
+		
+		/* the slowest converging volume decides when to stop */
+		bool regularize = ( _EMIRiteration > 0 && (_Update.size() + 1) % _EMIRiteration == 0 ) ;
+		for( int b = 0 ; b < N ; b++ ) 
+		{
+			float * obj = object + b * space ;
+			float * last = ws.buf + b * space ;
+			if( regularize ) 
+			     _pushUpdate( obj, last, UPDATE_object( space, obj, last, false, UPDATE_regularize< float >( obj, penalty[b] ), SpacialSupport, _Threads ) ) ;
+			else _pushUpdate( obj, last, UPDATE_object( space, obj, last, false, UPDATE_keep< float >( obj ), SpacialSupport, _Threads ) ) ;
+		}
+		_collapseBatch( _Update, N ) ;
+		if( _TrackMaxInObject ) _collapseBatch( _ObjectMax, N ) ;
+		
+		if( _Update.size() >= 10 )
+		{
+			cri = 0.0 ;
+			for( int i = 1 ; i <= 10 ; i++ ) cri += _Update[ _Update.size()-i ] ;
+			cri /= 10.0 ;
+		}		
+		if( _CheckStatus ) _EMprintStatus( 6 ) ;
+	}	
+	
+	/* end deconvolution */
+	_EMfinishRun( ws ) ;
+	_Batch = 1 ;
+}
+
+
+
+/* private functions */
+
+/* 
+	Zero the object outside its nonzero extent, EM updates are multiplicative 
+	so it stays zero there and the pruned FFTs see the volume they expect.
+*/
+template< class T >
+static void EMzeroOutside( int DimX, int DimY, int DimZ, int ExtX, int ExtY, int ExtZ, T * object )
+{
+	ExtX = ( ExtX <= 0 || ExtX > DimX ) ? DimX : ExtX ;
+	ExtY = ( ExtY <= 0 || ExtY > DimY ) ? DimY : ExtY ;
+	ExtZ = ( ExtZ <= 0 || ExtZ > DimZ ) ? DimZ : ExtZ ;
+
+	for( int z = 0 ; z < DimZ ; z++ )
+		for( int y = 0 ; y < DimY ; y++ )
+		{
+			T * row = object + (size_t) DimX * ( y + (size_t) DimY * z ) ;
+			int from = ( z < ExtZ && y < ExtY ) ? ExtX : 0 ;
+			for( int x = from ; x < DimX ; x++ ) row[x] = 0.0 ;
+		}
+}
+
+void EMdeconvolver::_EMapplyExtent( double * object )
+{
+	if( _ExtX > 0 || _ExtY > 0 || _ExtZ > 0 )
+		EMzeroOutside( _DimX, _DimY, _DimZ, _ExtX, _ExtY, _ExtZ, object ) ;
+}
+
+void EMdeconvolver::_EMapplyExtent( float * object )
+{
+	if( _ExtX > 0 || _ExtY > 0 || _ExtZ > 0 )
+		EMzeroOutside( _DimX, _DimY, _DimZ, _ExtX, _ExtY, _ExtZ, object ) ;
+}
+
+
+
+void EMdeconvolver::_collapseBatch( std::vector< double > & history, int N )
+{
+	double max_value = history.back() ;
+	for( int b = 0 ; b < N ; b++ )
+	{
+		if( history.back() > max_value ) max_value = history.back() ;
+		history.pop_back() ;
+	}
+	history.push_back( max_value ) ;
+}
+
 
-	/* initialize running */
-	_EMstartRun( DimX, DimY, DimZ, ws ) ;
 
-	/* start initialization */
-	if( _CheckStatus ) _EMprintStatus( 1 ) ;
-	_initPSF( ws.size, rat, ws.psf_re, ws.psf_im, FrequencySupport ) ;
+/*
+	Deconvolve one image after the PSF has been transformed into <ws>: the part of run() 
+	which EMsession::run() repeats for each image; <psf0> is the psf value at the origin.
+*/
+void EMdeconvolver::_EMrunFrame( double * image, double * rat, double * object, EMdws & ws,
+                                 unsigned char * SpacialSupport, double psf0 )
+{
+	double max_intensity = 0.0, cri = 1.0E+37, alpha = 0.0 ;
+
 	_initIMG( max_intensity, image, object, SpacialSupport ) ;	
+	_EMapplyExtent( object ) ;
 	if( _CheckStatus ) _EMprintStatus( 2 ) ;	
 	
 	/* start regularization */
@@ -128,20 +918,30 @@ void EMdeconvolver::run( int DimX, int DimY, int DimZ, double * image, double *
 	{
 		if( _EMIRpenalty < EMDepsilon )
 		{
-			if( _ApplyNormalization ) _EMIRpenalty = rat[0] ;
+			if( _ApplyNormalization ) _EMIRpenalty = psf0 ;
 			else
 			{
 				max_intensity = image[0] ;
-				for( int i = 0 ; i < _Space ; i++ )
+				for( size_t i = 0 ; i < _Space ; i++ )
 				{
 					if( image[i] > max_intensity ) max_intensity = image[i] ;
 				}
-				_EMIRpenalty = rat[0] / max_intensity ; 
+				_EMIRpenalty = psf0 / max_intensity ; 
 			}
 		}
 		if( _CheckStatus ) _EMprintStatus( 3 ) ;
 	}	
 
+	/* the extrapolation starts from the first estimated object, with no change behind it */
+	if( _Extrapolate && !_Accelerate )
+	{
+		for( size_t i = 0 ; i < _Space ; i++ ) 
+		{
+			ws.buf[i]  = object[i] ;
+			ws.grad[i] = 0.0 ;
+		}
+	}
+
 	/* deconvolution loop */
 	if( _CheckStatus ) _EMprintStatus( 4 ) ;	
 	while( _Update.size() < _MaxRunIteration && cri > _Criterion )
@@ -151,21 +951,17 @@ void EMdeconvolver::run( int DimX, int DimY, int DimZ, double * image, double *
 		{ 
 			_EMupdate2( image, rat, object, ws ) ;
 		}
+		else if ( _Extrapolate )
+		{
+			_EMupdate3( image, rat, object, ws, SpacialSupport, alpha ) ;
+		}
 		else
 		{
 			_EMupdate1( image, rat, object, ws ) ;        		
 		} 
-        	if( _EMIRiteration > 0 )
-		{
-			if( (_Update.size() + 1) % _EMIRiteration == 0 )
-			{
-				for( int i = 0 ; i < _Space ; i++ ) 
-				{
-					object[i] = ( -1.0 + sqrt(1.0 + 2.0 * _EMIRpenalty * object[i]) ) / _EMIRpenalty ;
-				}
-			}
-		}
-		_getUpdate( object, ws.buf, SpacialSupport ) ;
+		if( _EMIRiteration > 0 && (_Update.size() + 1) % _EMIRiteration == 0 )
+		     _pushUpdate( object, ws.buf, UPDATE_object( _Space, object, ws.buf, false, UPDATE_regularize< double >( object, _EMIRpenalty ), SpacialSupport, _Threads ) ) ;
+		else _pushUpdate( object, ws.buf, UPDATE_object( _Space, object, ws.buf, false, UPDATE_keep< double >( object ), SpacialSupport, _Threads ) ) ;
 		if( _Update.size() >= 10 )
 		{
 			cri = 0.0 ;
@@ -173,27 +969,19 @@ void EMdeconvolver::run( int DimX, int DimY, int DimZ, double * image, double *
 			cri /= 10.0 ;
 		}		
 		if( _CheckStatus ) _EMprintStatus( 6 ) ;
-	}	
-	
-	/* end deconvolution */
-	_EMfinishRun( ws ) ;	
+	}
 }
 
 
 
-void EMdeconvolver::run( int DimX, int DimY, int DimZ, float * image, float * rat, float * object, EMsws & ws,
-                         unsigned char * SpacialSupport, unsigned char * FrequencySupport )
+void EMdeconvolver::_EMrunFrame( float * image, float * rat, float * object, EMsws & ws,
+                                 unsigned char * SpacialSupport, float psf0 )
 {
 	float  max_intensity = 0.0 ;
-	double cri = 1.0E+37 ;
+	double cri = 1.0E+37, alpha = 0.0 ;
 
-	/* initialize running */
-	_EMstartRun( DimX, DimY, DimZ, ws ) ;
-
-	/* start initialization */
-	if( _CheckStatus ) _EMprintStatus( 1 ) ;
-	_initPSF( ws.size, rat, ws.psf_re, ws.psf_im, FrequencySupport ) ;
 	_initIMG( max_intensity, image, object, SpacialSupport ) ;	
+	_EMapplyExtent( object ) ;
 	if( _CheckStatus ) _EMprintStatus( 2 ) ;	
 	
 	/* start regularization */
@@ -201,20 +989,30 @@ void EMdeconvolver::run( int DimX, int DimY, int DimZ, float * image, float * ra
 	{
 		if( _EMIRpenalty < EMDepsilon )
 		{
-			if( _ApplyNormalization ) _EMIRpenalty = rat[0] ;
+			if( _ApplyNormalization ) _EMIRpenalty = psf0 ;
 			else
 			{
 				max_intensity = image[0] ;
-				for( int i = 0 ; i < _Space ; i++ )
+				for( size_t i = 0 ; i < _Space ; i++ )
 				{
 					if( image[i] > max_intensity ) max_intensity = image[i] ;
 				}
-				_EMIRpenalty = rat[0] / max_intensity ; 
+				_EMIRpenalty = psf0 / max_intensity ; 
 			}
 		}
 		if( _CheckStatus ) _EMprintStatus( 3 ) ;
 	}	
 
+	/* the extrapolation starts from the first estimated object, with no change behind it */
+	if( _Extrapolate && !_Accelerate )
+	{
+		for( size_t i = 0 ; i < _Space ; i++ ) 
+		{
+			ws.buf[i]  = object[i] ;
+			ws.grad[i] = 0.0 ;
+		}
+	}
+
 	/* deconvolution loop */
 	if( _CheckStatus ) _EMprintStatus( 4 ) ;	
 	while( _Update.size() < _MaxRunIteration && cri > _Criterion )
@@ -224,21 +1022,17 @@ void EMdeconvolver::run( int DimX, int DimY, int DimZ, float * image, float * ra
 		{ 
 			_EMupdate2( image, rat, object, ws ) ;
 		}
+		else if ( _Extrapolate )
+		{
+			_EMupdate3( image, rat, object, ws, SpacialSupport, alpha ) ;
+		}
 		else
 		{
 			_EMupdate1( image, rat, object, ws ) ;        		
 		} 
-		if( _EMIRiteration > 0 )
-		{
-			if( (_Update.size() + 1) % _EMIRiteration == 0 )
-			{
-				for( int i = 0 ; i < _Space ; i++ ) 
-				{
-					object[i] = ( -1.0 + sqrt(1.0 + 2.0 * _EMIRpenalty * object[i]) ) / _EMIRpenalty ;
-				}
-			}
-		}
-		_getUpdate( object, ws.buf, SpacialSupport ) ;
+		if( _EMIRiteration > 0 && (_Update.size() + 1) % _EMIRiteration == 0 )
+		     _pushUpdate( object, ws.buf, UPDATE_object( _Space, object, ws.buf, false, UPDATE_regularize< float >( object, _EMIRpenalty ), SpacialSupport, _Threads ) ) ;
+		else _pushUpdate( object, ws.buf, UPDATE_object( _Space, object, ws.buf, false, UPDATE_keep< float >( object ), SpacialSupport, _Threads ) ) ;
 		if( _Update.size() >= 10 )
 		{
 			cri = 0.0 ;
@@ -246,16 +1040,11 @@ void EMdeconvolver::run( int DimX, int DimY, int DimZ, float * image, float * ra
 			cri /= 10.0 ;
 		}		
 		if( _CheckStatus ) _EMprintStatus( 6 ) ;
-	}	
-	
-	/* end deconvolution */
-	_EMfinishRun( ws ) ;	
+	}
 }
 
 
 
-/* private functions */
-
 void EMdeconvolver::_EMprintStatus( int stage )
 {
 	switch( stage )
@@ -320,10 +1109,10 @@ void EMdeconvolver::_EMprintStatus( int stage )
 
 
 
-void EMdeconvolver::_EMprintAcceleration( double alpha, double likelihood, int negative_points ) 
+void EMdeconvolver::_EMprintAcceleration( double alpha, double likelihood, size_t negative_points ) 
 {
-	printf( " --> Newton Acceleration Value = %9.6f -> Likelihood = %12.6e , Negative Points = %9d\n", 
-	         alpha, likelihood, negative_points ) ; 
+	printf( " --> Newton Acceleration Value = %9.6f -> Likelihood = %12.6e , Negative Points = %9lu\n", 
+	         alpha, likelihood, (unsigned long) negative_points ) ; 
 }
 
 
@@ -338,7 +1127,14 @@ void EMdeconvolver::_EMprintAcceleration( double alpha )
 void EMdeconvolver::_EMstartRun( int DimX, int DimY, int DimZ, EMdws & ws )
 {
 	_setDimensions( DimX, DimY, DimZ ) ;
-	double memory = (double)_Space * 3 ;
+	if( ws.bytes > 0 && ( ws.size != FFTW3_FFT::FFTsize( _DimX, _DimY, _DimZ ) * _Batch || _Interleaved != ( ws.buf_im == NULL ) || 
+	                      _RealOTF != ws.real || _RadialOTF != ( ws.radial.table != NULL ) ||
+	                      ( ( _Accelerate || _TrackLikelihood ) && ws.eimg == NULL ) ||
+	                      ( _Extrapolate && !_Accelerate && ws.grad == NULL ) ) )
+	{
+		throw WorkspaceError( ws.size, FFTW3_FFT::FFTsize( _DimX, _DimY, _DimZ ) * _Batch ) ;
+	}
+	double memory = (double)_Space * _Batch * 3 ;
 		
 	time( &_StartRunTime ) ;
 	std::cout << " EMdeconvolution starts running at " << ctime( &_StartRunTime ) ;
@@ -349,27 +1145,20 @@ void EMdeconvolver::_EMstartRun( int DimX, int DimY, int DimZ, EMdws & ws )
 	time( &_t0 ) ;
 	std::cout << " EMdeconvolver::run starts creating FFT plans ... \n" ;
         	
-	_FFTplanf = new FFTW3_FFT (_DimX, _DimY, _DimZ, true,  true, 3) ;
-	_FFTplanb = new FFTW3_FFT (_DimX, _DimY, _DimZ, false, true, 3) ;
+	_FFTplanf = FFTW3_PlanCache::acquire( _DimX, _DimY, _DimZ, true,  true, _Interleaved ? 4 : 3, _PlannerEffort, _Threads, _Batch,
+	                                      _ExtX, _ExtY, _ExtZ ) ;
+	_FFTplanb = FFTW3_PlanCache::acquire( _DimX, _DimY, _DimZ, false, true, _Interleaved ? 4 : 3, _PlannerEffort, _Threads, _Batch,
+	                                      _ExtX, _ExtY, _ExtZ ) ;
 		
 	time( &_t1 ) ;
 	std::cout << " EMdeconvolver::run completes creating FFT plans, elapsed "
 	          << difftime( _t1, _t0 ) << " seconds.\n" ;
 	
-	ws.size = _FFTplanf->FFTsize() ;
-	memory += ( (double)ws.size * 4.0 + (double)_Space ) ;
-	
-	ws.psf_re = new double[ ws.size ] ;
-	ws.psf_im = new double[ ws.size ] ;
-	ws.buf_re = new double[ ws.size ] ;
-	ws.buf_im = new double[ ws.size ] ;
-	ws.buf    = new double[ _Space  ] ;
-	if( _Accelerate || _TrackLikelihood )
-	{
-		ws.eimg = new double[ _Space ] ;
-		memory += ( (double)_Space ) ;
-	}
-	else    ws.eimg = NULL ;
+	if( ws.bytes == 0 ) EMallocate( ws, _DimX, _DimY, _DimZ, _Batch, _Interleaved, _RealOTF, _RadialOTF, _Accelerate || _TrackLikelihood, _Extrapolate && !_Accelerate ) ;
+	memory += ( (double)ws.size * ( _RadialOTF ? 2.0 : ws.real ? 3.0 : 4.0 ) + (double)_Space * _Batch ) ;
+	if( _RadialOTF ) memory += (double)ws.radial.nr * ws.radial.Zh * _Batch ;
+	if( ws.eimg != NULL ) memory += ( (double)_Space * _Batch ) ;
+	if( ws.grad != NULL ) memory += ( (double)_Space * _Batch ) ;
 	
 	if( _Update.size()  > 0 ) _Update.clear() ;
 	if( _Likelihood.size() > 0 ) _Likelihood.clear() ;
@@ -383,7 +1172,14 @@ void EMdeconvolver::_EMstartRun( int DimX, int DimY, int DimZ, EMdws & ws )
 void EMdeconvolver::_EMstartRun( int DimX, int DimY, int DimZ, EMsws & ws )
 {
 	_setDimensions( DimX, DimY, DimZ ) ;
-	double memory = (double) _Space * 3.0 ;
+	if( ws.bytes > 0 && ( ws.size != FFTW3_FFT::FFTsize( _DimX, _DimY, _DimZ ) * _Batch || _Interleaved != ( ws.buf_im == NULL ) || 
+	                      _RealOTF != ws.real || _RadialOTF != ( ws.radial.table != NULL ) ||
+	                      ( ( _Accelerate || _TrackLikelihood ) && ws.eimg == NULL ) ||
+	                      ( _Extrapolate && !_Accelerate && ws.grad == NULL ) ) )
+	{
+		throw WorkspaceError( ws.size, FFTW3_FFT::FFTsize( _DimX, _DimY, _DimZ ) * _Batch ) ;
+	}
+	double memory = (double) _Space * _Batch * 3.0 ;
 		
 	time( &_StartRunTime ) ;
 	std::cout << " EMdeconvolution starts running at " << ctime( &_StartRunTime ) ;
@@ -394,28 +1190,20 @@ void EMdeconvolver::_EMstartRun( int DimX, int DimY, int DimZ, EMsws & ws )
 	time( &_t0 ) ;
 	std::cout << " EMdeconvolver::run starts creating FFT plans ... \n" ;
         	
-	_FFTplanf = new FFTW3_FFT (_DimX, _DimY, _DimZ, true,  false, 3) ;
-	_FFTplanb = new FFTW3_FFT( _DimX, _DimY, _DimZ, false, false, 3) ;
+	_FFTplanf = FFTW3_PlanCache::acquire( _DimX, _DimY, _DimZ, true,  false, _Interleaved ? 4 : 3, _PlannerEffort, _Threads, _Batch,
+	                                      _ExtX, _ExtY, _ExtZ ) ;
+	_FFTplanb = FFTW3_PlanCache::acquire( _DimX, _DimY, _DimZ, false, false, _Interleaved ? 4 : 3, _PlannerEffort, _Threads, _Batch,
+	                                      _ExtX, _ExtY, _ExtZ ) ;
 		
 	time( &_t1 ) ;
 	std::cout << " EMdeconvolver::run completes creating FFT plans, elapsed "
 	          << difftime( _t1, _t0 ) << " seconds.\n" ;
 	
-	ws.size = _FFTplanf->FFTsize() ;
-	memory += ( (double)ws.size * 4.0 + (double)_Space ) ;
-	
-	ws.psf_re = new float[ ws.size ] ;
-	ws.psf_im = new float[ ws.size ] ;
-	ws.buf_re = new float[ ws.size ] ;
-	ws.buf_im = new float[ ws.size ] ;
-	ws.buf    = new float[ _Space  ] ;
-	
-	if( _Accelerate || _TrackLikelihood )
-	{
-		ws.eimg = new float[ _Space ] ;
-		memory += ( (double)_Space ) ;
-	}
-	else    ws.eimg = NULL ;
+	if( ws.bytes == 0 ) EMallocate( ws, _DimX, _DimY, _DimZ, _Batch, _Interleaved, _RealOTF, _RadialOTF, _Accelerate || _TrackLikelihood, _Extrapolate && !_Accelerate ) ;
+	memory += ( (double)ws.size * ( _RadialOTF ? 2.0 : ws.real ? 3.0 : 4.0 ) + (double)_Space * _Batch ) ;
+	if( _RadialOTF ) memory += (double)ws.radial.nr * ws.radial.Zh * _Batch ;
+	if( ws.eimg != NULL ) memory += ( (double)_Space * _Batch ) ;
+	if( ws.grad != NULL ) memory += ( (double)_Space * _Batch ) ;
 	
 	if( _Update.size()  > 0 ) _Update.clear() ;
 	if( _Likelihood.size() > 0 ) _Likelihood.clear() ;
@@ -428,12 +1216,12 @@ void EMdeconvolver::_EMstartRun( int DimX, int DimY, int DimZ, EMsws & ws )
 
 void EMdeconvolver::_EMfinishRun( EMdws & ws )
 {
-	if( ws.psf_re != NULL ) delete [] ws.psf_re ;
-	if( ws.psf_im != NULL ) delete [] ws.psf_im ;
-	if( ws.buf_re != NULL ) delete [] ws.buf_re ;
-	if( ws.buf_im != NULL ) delete [] ws.buf_im ;
-	if( ws.buf    != NULL ) delete [] ws.buf ;
-	if( ws.eimg   != NULL ) delete [] ws.eimg ;
+	if( ws.bytes == 0 ) EMdeallocate( ws ) ;
+
+	FFTW3_PlanCache::release( _FFTplanf ) ;
+	FFTW3_PlanCache::release( _FFTplanb ) ;
+	_FFTplanf = NULL ;
+	_FFTplanb = NULL ;
 		
 	time( &_StopRunTime ) ;
 	std::cout << " EMdeconvolution finish running at " << ctime( &_StopRunTime ) ;
@@ -443,12 +1231,12 @@ void EMdeconvolver::_EMfinishRun( EMdws & ws )
 
 void EMdeconvolver::_EMfinishRun( EMsws & ws )
 {
-	if( ws.psf_re != NULL ) delete [] ws.psf_re ;
-	if( ws.psf_im != NULL ) delete [] ws.psf_im ;
-	if( ws.buf_re != NULL ) delete [] ws.buf_re ;
-	if( ws.buf_im != NULL ) delete [] ws.buf_im ;
-	if( ws.buf    != NULL ) delete [] ws.buf ;
-	if( ws.eimg   != NULL ) delete [] ws.eimg ;
+	if( ws.bytes == 0 ) EMdeallocate( ws ) ;
+
+	FFTW3_PlanCache::release( _FFTplanf ) ;
+	FFTW3_PlanCache::release( _FFTplanb ) ;
+	_FFTplanf = NULL ;
+	_FFTplanb = NULL ;
 		
 	time( &_StopRunTime ) ;
 	std::cout << " EMdeconvolution finish running at " << ctime( &_StopRunTime ) ;
@@ -456,178 +1244,228 @@ void EMdeconvolver::_EMfinishRun( EMsws & ws )
 
 
 
-void EMdeconvolver::_EMupdate1( double * image, double * rat, double * object, EMdws & ws )
+/*
+	The radial OTF of the <_Batch> PSFs in <psf>: the real spectrum of each PSF is taken in a temporary 
+	array and fitted into the table of <ws>; the frequency support is applied when the table is expanded.
+*/
+void EMdeconvolver::_EMradialPSF( double * psf, EMdws & ws, unsigned char * FrequencySupport )
 {
-	double temp ;
+	size_t size = _FFTplanf->FFTsize() ;
+	double * spec_re = NULL ;
+	double * spec_im = NULL ;
 	
-	_FFTplanf->execute( object, ws.buf_re, ws.buf_im ) ;
-	for( int i = 0 ; i < ws.size ; i++ )
+	WS_malloc( spec_re, size ) ;
+	WS_malloc( spec_im, size ) ;
+	for( int b = 0 ; b < _Batch ; b++ )
 	{
-		        temp = ws.buf_re[i] * ws.psf_re[i] - ws.buf_im[i] * ws.psf_im[i] ;  
-		ws.buf_im[i] = ws.buf_re[i] * ws.psf_im[i] + ws.buf_im[i] * ws.psf_re[i] ;
-		ws.buf_re[i] = temp ;
+		fft3d( _DimX, _DimY, _DimZ, psf + b * _Space, spec_re, spec_im ) ;
+		RADIAL_fit( ws.radial, b, spec_re ) ;
+		std::cout << " EMdeconvolver::run radial OTF table " << ws.radial.nr << " x " << ws.radial.Zh 
+		          << ", max error " << RADIAL_error( ws.radial, b, spec_re ) << "\n" ;
 	}
-	_FFTplanb->execute( ws.buf_re, ws.buf_im, rat ) ;
+	WS_free( spec_re ) ;
+	WS_free( spec_im ) ;
+	
+	ws.radial.support = FrequencySupport ;
+	if( FrequencySupport != NULL ) _ApplyFrequencySupport = true ;
+}
 
-	if( _TrackLikelihood )
-	{
-		double likelihood = 0.0 ;
-		for( int i = 0 ; i < _Space ; i++ )
-		{
-			if ( rat[i] < EMDepsilon ) rat[i] = EMDepsilon ;
-			likelihood += ( image[i] * log(rat[i]) - rat[i] ) ;
-			rat[i] = image[i] / rat[i] ;
-		}
-		_Likelihood.push_back( likelihood ) ;
-	}
-	else
-	{
-		for( int i = 0 ; i < _Space ; i++ )
-		{
-			if ( rat[i] < EMDepsilon ) rat[i] = EMDepsilon ;
-			rat[i] = image[i] / rat[i] ;
-		}
-	}
-		
-	_FFTplanf->execute( rat, ws.buf_re, ws.buf_im ) ;
-	for( int i = 0 ; i < ws.size ; i++ )
+
+
+void EMdeconvolver::_EMradialPSF( float * psf, EMsws & ws, unsigned char * FrequencySupport )
+{
+	size_t size = _FFTplanf->FFTsize() ;
+	float * spec_re = NULL ;
+	float * spec_im = NULL ;
+	
+	WS_malloc( spec_re, size ) ;
+	WS_malloc( spec_im, size ) ;
+	for( int b = 0 ; b < _Batch ; b++ )
 	{
-		        temp = ws.buf_re[i] * ws.psf_re[i] + ws.buf_im[i] * ws.psf_im[i] ;  
-		ws.buf_im[i] = ws.buf_im[i] * ws.psf_re[i] - ws.buf_re[i] * ws.psf_im[i] ;
-		ws.buf_re[i] = temp ;
+		fft3d( _DimX, _DimY, _DimZ, psf + b * _Space, spec_re, spec_im ) ;
+		RADIAL_fit( ws.radial, b, spec_re ) ;
+		std::cout << " EMdeconvolver::run radial OTF table " << ws.radial.nr << " x " << ws.radial.Zh 
+		          << ", max error " << RADIAL_error( ws.radial, b, spec_re ) << "\n" ;
 	}
-	_FFTplanb->execute( ws.buf_re, ws.buf_im, rat ) ;
-		
-	for( int i = 0 ; i < _Space ; i++ ) 
+	WS_free( spec_re ) ;
+	WS_free( spec_im ) ;
+	
+	ws.radial.support = FrequencySupport ;
+	if( FrequencySupport != NULL ) _ApplyFrequencySupport = true ;
+}
+
+
+
+/*
+	The interleaved spectrum of the <_Batch> PSFs in <psf>. A pruned <_FFTplanf> skips the values 
+	outside the nonzero extent, where the wrapped PSF keeps its tails, so the PSF is then transformed 
+	with a full plan of the same layout.
+*/
+void EMdeconvolver::_EMinterleavedPSF( double * psf, EMdws & ws, unsigned char * FrequencySupport )
+{
+	if( _ExtX > 0 || _ExtY > 0 || _ExtZ > 0 )
 	{
-		ws.buf[i]  = object[i] ;	
-		object[i] *= rat[i] ;
-		if ( object[i] < 0.0 ) object[i] = 0.0 ;
+		FFTW3_FFT * plan = FFTW3_PlanCache::acquire( _DimX, _DimY, _DimZ, true, true, 4, _PlannerEffort, _Threads, _Batch ) ;
+		_initPSF( plan, psf, ws.psf_re, FrequencySupport ) ;
+		FFTW3_PlanCache::release( plan ) ;
 	}
+	else _initPSF( _FFTplanf, psf, ws.psf_re, FrequencySupport ) ;
 }
 
 
 
-void EMdeconvolver::_EMupdate1( float * image, float * rat, float * object, EMsws & ws )
+void EMdeconvolver::_EMinterleavedPSF( float * psf, EMsws & ws, unsigned char * FrequencySupport )
 {
-	float temp ;
-	
-	_FFTplanf->execute( object, ws.buf_re, ws.buf_im ) ;
-	for( int i = 0 ; i < ws.size ; i++ )
+	if( _ExtX > 0 || _ExtY > 0 || _ExtZ > 0 )
 	{
-		        temp = ws.buf_re[i] * ws.psf_re[i] - ws.buf_im[i] * ws.psf_im[i] ;  
-		ws.buf_im[i] = ws.buf_re[i] * ws.psf_im[i] + ws.buf_im[i] * ws.psf_re[i] ;
-		ws.buf_re[i] = temp ;
+		FFTW3_FFT * plan = FFTW3_PlanCache::acquire( _DimX, _DimY, _DimZ, true, false, 4, _PlannerEffort, _Threads, _Batch ) ;
+		_initPSF( plan, psf, ws.psf_re, FrequencySupport ) ;
+		FFTW3_PlanCache::release( plan ) ;
 	}
-	_FFTplanb->execute( ws.buf_re, ws.buf_im, rat ) ;
+	else _initPSF( _FFTplanf, psf, ws.psf_re, FrequencySupport ) ;
+}
 
-	if( _TrackLikelihood )
+
+
+/*
+	<out> = <in> convolved with the PSF, or correlated with it if <correlate> is true,
+	on the spectra in <ws> kept in the layout selected by <_Interleaved>.
+*/
+void EMdeconvolver::_EMconvolve( double * in, double * out, EMdws & ws, bool correlate )
+{
+	if( _Interleaved && _RadialOTF )
 	{
-		double likelihood = 0.0 ;
-		for( int i = 0 ; i < _Space ; i++ )
-		{
-			if ( rat[i] < EMSepsilon ) rat[i] = EMSepsilon ;
-			likelihood += ( image[i] * log(rat[i]) - rat[i] ) ;
-			rat[i] = image[i] / rat[i] ;
-		}
-		_Likelihood.push_back( likelihood ) ;
+		_FFTplanf->execute( in, (fftw_complex *) ws.buf_re ) ;
+		RADIAL_multiply<2>( ws.size, ws.buf_re, ws.buf_re + 1, ws.radial, _Threads ) ;
+		_FFTplanb->execute( (fftw_complex *) ws.buf_re, out ) ;
 	}
-	else
+	else if( _Interleaved )
 	{
-		for( int i = 0 ; i < _Space ; i++ )
-		{
-			if ( rat[i] < EMSepsilon ) rat[i] = EMSepsilon ;
-			rat[i] = image[i] / rat[i] ;
-		}
+		_FFTplanf->execute( in, (fftw_complex *) ws.buf_re ) ;
+		if( correlate ) SPECTRAL_correlate<2>( ws.size, ws.buf_re, ws.buf_re + 1, ws.psf_re, ws.real ? NULL : ws.psf_re + 1, _Threads ) ;
+		else            SPECTRAL_multiply<2>(  ws.size, ws.buf_re, ws.buf_re + 1, ws.psf_re, ws.real ? NULL : ws.psf_re + 1, _Threads ) ;
+		_FFTplanb->execute( (fftw_complex *) ws.buf_re, out ) ;
 	}
-		
-	_FFTplanf->execute( rat, ws.buf_re, ws.buf_im ) ;
-	for( int i = 0 ; i < ws.size ; i++ )
+	else if( _RadialOTF )
 	{
-		        temp = ws.buf_re[i] * ws.psf_re[i] + ws.buf_im[i] * ws.psf_im[i] ;  
-		ws.buf_im[i] = ws.buf_im[i] * ws.psf_re[i] - ws.buf_re[i] * ws.psf_im[i] ;
-		ws.buf_re[i] = temp ;
+		/* the OTF is real, the correlation is the convolution */
+		_FFTplanf->execute( in, ws.buf_re, ws.buf_im ) ;
+		RADIAL_multiply<1>( ws.size, ws.buf_re, ws.buf_im, ws.radial, _Threads ) ;
+		_FFTplanb->execute( ws.buf_re, ws.buf_im, out ) ;
 	}
-	_FFTplanb->execute( ws.buf_re, ws.buf_im, rat ) ;
-		
-	for( int i = 0 ; i < _Space ; i++ ) 
+	else
 	{
-		ws.buf[i]  = object[i] ;	
-		object[i] *= rat[i] ;
-		if ( object[i] < 0.0 ) object[i] = 0.0 ;
+		_FFTplanf->execute( in, ws.buf_re, ws.buf_im ) ;
+		if( correlate ) SPECTRAL_correlate<1>( ws.size, ws.buf_re, ws.buf_im, ws.psf_re, ws.psf_im, _Threads ) ;
+		else            SPECTRAL_multiply<1>(  ws.size, ws.buf_re, ws.buf_im, ws.psf_re, ws.psf_im, _Threads ) ;
+		_FFTplanb->execute( ws.buf_re, ws.buf_im, out ) ;
 	}
 }
 
 
 
-void EMdeconvolver::_EMupdate2( double * image, double * rat, double * object, EMdws & ws )
+void EMdeconvolver::_EMconvolve( float * in, float * out, EMsws & ws, bool correlate )
 {
-	double alpha = 1.0, alpha_new = 1.0, likelihood, temp, temp1, temp2 ;
-	bool   continue_loop_1 = true, continue_loop_2 = true ;
-	
-	_FFTplanf->execute( object, ws.buf_re, ws.buf_im ) ;
-	for( int i = 0 ; i < ws.size ; i++ )
+	if( _Interleaved && _RadialOTF )
 	{
-		        temp = ws.buf_re[i] * ws.psf_re[i] - ws.buf_im[i] * ws.psf_im[i] ;  
-		ws.buf_im[i] = ws.buf_re[i] * ws.psf_im[i] + ws.buf_im[i] * ws.psf_re[i] ;
-		ws.buf_re[i] = temp ;
+		_FFTplanf->execute( in, (fftwf_complex *) ws.buf_re ) ;
+		RADIAL_multiply<2>( ws.size, ws.buf_re, ws.buf_re + 1, ws.radial, _Threads ) ;
+		_FFTplanb->execute( (fftwf_complex *) ws.buf_re, out ) ;
 	}
-	_FFTplanb->execute( ws.buf_re, ws.buf_im, ws.eimg ) ;
-     	
-	for( int i = 0 ; i < _Space ; i++ )
+	else if( _Interleaved )
 	{
-		if ( ws.eimg[i] < EMDepsilon ) ws.eimg[i] = EMDepsilon ;
-		rat[i] = image[i] / ws.eimg[i] ;
+		_FFTplanf->execute( in, (fftwf_complex *) ws.buf_re ) ;
+		if( correlate ) SPECTRAL_correlate<2>( ws.size, ws.buf_re, ws.buf_re + 1, ws.psf_re, ws.real ? NULL : ws.psf_re + 1, _Threads ) ;
+		else            SPECTRAL_multiply<2>(  ws.size, ws.buf_re, ws.buf_re + 1, ws.psf_re, ws.real ? NULL : ws.psf_re + 1, _Threads ) ;
+		_FFTplanb->execute( (fftwf_complex *) ws.buf_re, out ) ;
 	}
-     	
-	_FFTplanf->execute( rat, ws.buf_re, ws.buf_im ) ;
-	for( int i = 0 ; i < ws.size ; i++ )
+	else if( _RadialOTF )
 	{
-		        temp = ws.buf_re[i] * ws.psf_re[i] + ws.buf_im[i] * ws.psf_im[i] ;  
-		ws.buf_im[i] = ws.buf_im[i] * ws.psf_re[i] - ws.buf_re[i] * ws.psf_im[i] ;
-		ws.buf_re[i] = temp ;
+		/* the OTF is real, the correlation is the convolution */
+		_FFTplanf->execute( in, ws.buf_re, ws.buf_im ) ;
+		RADIAL_multiply<1>( ws.size, ws.buf_re, ws.buf_im, ws.radial, _Threads ) ;
+		_FFTplanb->execute( ws.buf_re, ws.buf_im, out ) ;
 	}
-	_FFTplanb->execute( ws.buf_re, ws.buf_im, rat ) ;
-     	
-	for( int i = 0 ; i < _Space ; i++ ) 
+	else
 	{
-		ws.buf[i]  = object[i] ;
-		object[i] *= ( rat[i] - 1.0 ) ;
+		_FFTplanf->execute( in, ws.buf_re, ws.buf_im ) ;
+		if( correlate ) SPECTRAL_correlate<1>( ws.size, ws.buf_re, ws.buf_im, ws.psf_re, ws.psf_im, _Threads ) ;
+		else            SPECTRAL_multiply<1>(  ws.size, ws.buf_re, ws.buf_im, ws.psf_re, ws.psf_im, _Threads ) ;
+		_FFTplanb->execute( ws.buf_re, ws.buf_im, out ) ;
 	}
+}
+
+
+
+void EMdeconvolver::_EMupdate1( double * image, double * rat, double * object, EMdws & ws )
+{
+	size_t space = _Space * _Batch ;
+
+	_EMconvolve( object, rat, ws, false ) ;
+
+	EMratio< double > ratio = { image, rat, rat, EMDepsilon, _TrackLikelihood } ;
+	double likelihood = my_parallel_reduce( space, ratio, _Threads ) ;
+	if( _TrackLikelihood ) _Likelihood.push_back( likelihood ) ;
+		
+	_EMconvolve( rat, rat, ws, true ) ;
+		
+	EMstep< double > step = { object, rat, ws.buf } ;
+	my_parallel_range( space, step, _Threads ) ;
+}
+
+
+
+void EMdeconvolver::_EMupdate1( float * image, float * rat, float * object, EMsws & ws )
+{
+	size_t space = _Space * _Batch ;
+
+	_EMconvolve( object, rat, ws, false ) ;
+
+	EMratio< float > ratio = { image, rat, rat, EMSepsilon, _TrackLikelihood } ;
+	double likelihood = my_parallel_reduce( space, ratio, _Threads ) ;
+	if( _TrackLikelihood ) _Likelihood.push_back( likelihood ) ;
+		
+	_EMconvolve( rat, rat, ws, true ) ;
+		
+	EMstep< float > step = { object, rat, ws.buf } ;
+	my_parallel_range( space, step, _Threads ) ;
+}
+
+
+
+void EMdeconvolver::_EMupdate2( double * image, double * rat, double * object, EMdws & ws )
+{
+	double alpha = 1.0, alpha_new = 1.0, likelihood, temp1, temp2 ;
+	bool   continue_loop_1 = true, continue_loop_2 = true ;
+	
+	_EMconvolve( object, ws.eimg, ws, false ) ;
      	
-	_FFTplanf->execute( object, ws.buf_re, ws.buf_im ) ;
-	for( int i = 0 ; i < ws.size ; i++ )
-	{
-		        temp = ws.buf_re[i] * ws.psf_re[i] - ws.buf_im[i] * ws.psf_im[i] ;  
-		ws.buf_im[i] = ws.buf_re[i] * ws.psf_im[i] + ws.buf_im[i] * ws.psf_re[i] ;
-		ws.buf_re[i] = temp ;
-	}
-	_FFTplanb->execute( ws.buf_re, ws.buf_im, rat ) ;
+	EMratio< double > ratio = { image, ws.eimg, rat, EMDepsilon, false } ;
+	my_parallel_reduce( _Space, ratio, _Threads ) ;
+     	
+	_EMconvolve( rat, rat, ws, true ) ;
+     	
+	EMdirection< double > direction = { object, rat, ws.buf } ;
+	my_parallel_range( _Space, direction, _Threads ) ;
+     	
+	_EMconvolve( object, rat, ws, false ) ;
 
 	do
 	{ 
-		likelihood = 0.0 ;
-		int j = 0 ;
-		for( int i = 0 ; i < _Space ; i++ )
-		{
-			if( object[i] < 0.0 && ( alpha_new * object[i] + ws.buf[i] ) < 0.0 ) j++ ;
-			temp = ws.eimg[i] + alpha_new * rat[i] ;
-			if ( temp > EMDepsilon ) likelihood += ( image[i] * log(temp) - temp ) ;
-		}           			
+		EMtrial< double > trial = { image, object, ws.buf, ws.eimg, rat, alpha_new, EMDepsilon, true } ;
+		EMtrialSums sums = my_parallel_reduce( _Space, trial, _Threads ) ;
+		likelihood = sums.likelihood ;
+		size_t j = sums.negative ;
 		if( _CheckStatus ) _EMprintAcceleration( alpha_new, likelihood, j ) ;
 		if( j > 0 )
 		{
 			while( alpha < alpha_new && continue_loop_1 )
 			{
 				alpha *= 1.5 ;
-				int k = 0 ;
-				likelihood = 0.0 ; 
-				for( int i = 0 ; i < _Space ; i++ )
-				{
-					if( object[i] < 0.0 && ( alpha * object[i] + ws.buf[i] ) < 0.0 ) k++ ;
-					temp = ws.eimg[i] + alpha * rat[i] ;
-					if ( temp > EMDepsilon ) likelihood += ( image[i] * log(temp) - temp ) ;
-				}
+				EMtrial< double > trial = { image, object, ws.buf, ws.eimg, rat, alpha, EMDepsilon, true } ;
+				EMtrialSums sums = my_parallel_reduce( _Space, trial, _Threads ) ;
+				likelihood = sums.likelihood ;
+				size_t k = sums.negative ;
 				if( _CheckStatus ) _EMprintAcceleration( alpha, likelihood, k ) ;       		
 				if( k > 0 )
 				{
@@ -640,17 +1478,10 @@ void EMdeconvolver::_EMupdate2( double * image, double * rat, double * object, E
 		if( continue_loop_2 )
 		{
 			alpha = alpha_new ;
-			temp1 = 0.0 ;
-			temp2 = 0.0 ;
-			for( int i = 0 ; i < _Space ; i++ ) 
-			{
-				temp = ws.eimg[i] + alpha * rat[i] ; 
-				if( fabs( temp ) > EMDepsilon )
-				{ 
-					temp1 += ( image[i] * rat[i] / temp - rat[i] ) ;
-					temp2 += ( image[i] * rat[i] * rat[i] / ( temp * temp ) ) ;
-				}
-			}
+			EMnewton< double > newton = { image, ws.eimg, rat, alpha, EMDepsilon } ;
+			EMnewtonSums sums = my_parallel_reduce( _Space, newton, _Threads ) ;
+			temp1 = sums.first ;
+			temp2 = sums.second ;
 			alpha_new = alpha + temp1 / temp2 ;
 		}
 	}
@@ -658,21 +1489,13 @@ void EMdeconvolver::_EMupdate2( double * image, double * rat, double * object, E
 	
 	if( _CheckStatus ) _EMprintAcceleration( alpha ) ;
              
-	for( int i = 0 ; i < _Space ; i++ ) 
-	{
-		object[i] = ws.buf[i] + alpha * object[i] ;
-		if ( object[i] < 0.0 ) object[i] = 0.0 ;
-	}
+	EMcombine< double > combine = { object, ws.buf, alpha } ;
+	my_parallel_range( _Space, combine, _Threads ) ;
         
 	if( _TrackLikelihood )
 	{
-		likelihood = 0.0 ;
-		for( int i = 0 ; i < _Space ; i++ )
-		{
-			temp = ws.eimg[i] + alpha * rat[i] ;
-			if ( temp > EMDepsilon ) likelihood += ( image[i] * log(temp) - temp ) ;
-		}
-		_Likelihood.push_back( likelihood ) ;
+		EMtrial< double > trial = { image, object, ws.buf, ws.eimg, rat, alpha, EMDepsilon, false } ;
+		_Likelihood.push_back( my_parallel_reduce( _Space, trial, _Threads ).likelihood ) ;
 	}
 }
 
@@ -680,73 +1503,37 @@ void EMdeconvolver::_EMupdate2( double * image, double * rat, double * object, E
 
 void EMdeconvolver::_EMupdate2( float * image, float * rat, float * object, EMsws & ws )
 {
-	float  temp ;
 	double alpha = 1.0, alpha_new = 1.0, likelihood, temp1, temp2 ;
 	bool   continue_loop_1 = true, continue_loop_2 = true ;
 	
-	_FFTplanf->execute( object, ws.buf_re, ws.buf_im ) ;
-	for( int i = 0 ; i < ws.size ; i++ )
-	{
-		        temp = ws.buf_re[i] * ws.psf_re[i] - ws.buf_im[i] * ws.psf_im[i] ;  
-		ws.buf_im[i] = ws.buf_re[i] * ws.psf_im[i] + ws.buf_im[i] * ws.psf_re[i] ;
-		ws.buf_re[i] = temp ;
-	}
-	_FFTplanb->execute( ws.buf_re, ws.buf_im, ws.eimg ) ;
+	_EMconvolve( object, ws.eimg, ws, false ) ;
      	
-	for( int i = 0 ; i < _Space ; i++ )
-	{
-		if ( ws.eimg[i] < EMSepsilon ) ws.eimg[i] = EMSepsilon ;
-		rat[i] = image[i] / ws.eimg[i] ;
-	}
+	EMratio< float > ratio = { image, ws.eimg, rat, EMSepsilon, false } ;
+	my_parallel_reduce( _Space, ratio, _Threads ) ;
      	
-	_FFTplanf->execute( rat, ws.buf_re, ws.buf_im ) ;
-	for( int i = 0 ; i < ws.size ; i++ )
-	{
-		        temp = ws.buf_re[i] * ws.psf_re[i] + ws.buf_im[i] * ws.psf_im[i] ;  
-		ws.buf_im[i] = ws.buf_im[i] * ws.psf_re[i] - ws.buf_re[i] * ws.psf_im[i] ;
-		ws.buf_re[i] = temp ;
-	}
-	_FFTplanb->execute( ws.buf_re, ws.buf_im, rat ) ;
+	_EMconvolve( rat, rat, ws, true ) ;
      	
-	for( int i = 0 ; i < _Space ; i++ ) 
-	{
-		ws.buf[i]  = object[i] ;
-		object[i] *= ( rat[i] - 1.0 ) ;
-	}
+	EMdirection< float > direction = { object, rat, ws.buf } ;
+	my_parallel_range( _Space, direction, _Threads ) ;
      	
-	_FFTplanf->execute( object, ws.buf_re, ws.buf_im ) ;
-	for( int i = 0 ; i < ws.size ; i++ )
-	{
-		        temp = ws.buf_re[i] * ws.psf_re[i] - ws.buf_im[i] * ws.psf_im[i] ;  
-		ws.buf_im[i] = ws.buf_re[i] * ws.psf_im[i] + ws.buf_im[i] * ws.psf_re[i] ;
-		ws.buf_re[i] = temp ;
-	}
-	_FFTplanb->execute( ws.buf_re, ws.buf_im, rat ) ;
+	_EMconvolve( object, rat, ws, false ) ;
 
 	do
 	{ 
-		likelihood = 0.0 ;
-		int j = 0 ;
-		for( int i = 0 ; i < _Space ; i++ )
-		{
-			if( object[i] < 0.0 && ( alpha_new * object[i] + ws.buf[i] ) < 0.0 ) j++ ;
-			temp = ws.eimg[i] + alpha_new * rat[i] ;
-			if ( temp > EMSepsilon ) likelihood += ( image[i] * log(temp) - temp ) ;
-		}           			
+		EMtrial< float > trial = { image, object, ws.buf, ws.eimg, rat, alpha_new, EMSepsilon, true } ;
+		EMtrialSums sums = my_parallel_reduce( _Space, trial, _Threads ) ;
+		likelihood = sums.likelihood ;
+		size_t j = sums.negative ;
 		if( _CheckStatus ) _EMprintAcceleration( alpha_new, likelihood, j ) ;
 		if( j > 0 )
 		{
 			while( alpha < alpha_new && continue_loop_1 )
 			{
 				alpha *= 1.5 ;
-				int k = 0 ;
-				likelihood = 0.0 ; 
-				for( int i = 0 ; i < _Space ; i++ )
-				{
-					if( object[i] < 0.0 && ( alpha * object[i] + ws.buf[i] ) < 0.0 ) k++ ;
-					temp = ws.eimg[i] + alpha * rat[i] ;
-					if ( temp > EMSepsilon ) likelihood += ( image[i] * log(temp) - temp ) ;
-				}
+				EMtrial< float > trial = { image, object, ws.buf, ws.eimg, rat, alpha, EMSepsilon, true } ;
+				EMtrialSums sums = my_parallel_reduce( _Space, trial, _Threads ) ;
+				likelihood = sums.likelihood ;
+				size_t k = sums.negative ;
 				if( _CheckStatus ) _EMprintAcceleration( alpha, likelihood, k ) ;       		
 				if( k > 0 ) 
 				{
@@ -759,17 +1546,10 @@ void EMdeconvolver::_EMupdate2( float * image, float * rat, float * object, EMsw
 		if( continue_loop_2 )
 		{
 			alpha = alpha_new ;
-			temp1 = 0.0 ;
-			temp2 = 0.0 ;
-			for( int i = 0 ; i < _Space ; i++ ) 
-			{
-				temp = ws.eimg[i] + alpha * rat[i] ; 
-				if( fabs( temp ) > EMSepsilon )
-				{ 
-					temp1 += ( image[i] * rat[i] / temp - rat[i] ) ;
-					temp2 += ( image[i] * rat[i] * rat[i] / ( temp * temp ) ) ;
-				}
-			}
+			EMnewton< float > newton = { image, ws.eimg, rat, alpha, EMSepsilon } ;
+			EMnewtonSums sums = my_parallel_reduce( _Space, newton, _Threads ) ;
+			temp1 = sums.first ;
+			temp2 = sums.second ;
 			alpha_new = alpha + temp1 / temp2 ;
 		}
 	}
@@ -777,20 +1557,168 @@ void EMdeconvolver::_EMupdate2( float * image, float * rat, float * object, EMsw
 	
 	if( _CheckStatus ) _EMprintAcceleration( alpha ) ;
              
-	for( int i = 0 ; i < _Space ; i++ ) 
-	{
-		object[i] = ws.buf[i] + alpha * object[i] ;
-		if ( object[i] < 0.0 ) object[i] = 0.0 ;
-	}
+	EMcombine< float > combine = { object, ws.buf, alpha } ;
+	my_parallel_range( _Space, combine, _Threads ) ;
         
 	if( _TrackLikelihood )
 	{
-		likelihood = 0.0 ;
-		for( int i = 0 ; i < _Space ; i++ )
-		{
-			temp = ws.eimg[i] + alpha * rat[i] ;
-			if ( temp > EMSepsilon ) likelihood += ( image[i] * log(temp) - temp ) ;
-		}
-		_Likelihood.push_back( likelihood ) ;
+		EMtrial< float > trial = { image, object, ws.buf, ws.eimg, rat, alpha, EMSepsilon, false } ;
+		_Likelihood.push_back( my_parallel_reduce( _Space, trial, _Threads ).likelihood ) ;
+	}
+}
+
+
+
+/*
+	One Biggs-Andrews iteration: the EM step is applied on the object extrapolated with <alpha>, 
+	and <alpha> is set for the next iteration from the changes made by this step and the last one.
+	<ws.buf> keeps the object before the extrapolation, so that _pushUpdate() sees the change 
+	between two successive estimates as in the other updates.
+*/
+void EMdeconvolver::_EMupdate3( double * image, double * rat, double * object, EMdws & ws, unsigned char * SpacialSupport, double & alpha )
+{
+	EMextrapolate< double > extrapolate = { object, ws.buf, alpha } ;
+	my_parallel_range( _Space, extrapolate, _Threads ) ;
+
+	_EMconvolve( object, rat, ws, false ) ;
+
+	EMratio< double > ratio = { image, rat, rat, EMDepsilon, _TrackLikelihood } ;
+	double likelihood = my_parallel_reduce( _Space, ratio, _Threads ) ;
+	if( _TrackLikelihood ) _Likelihood.push_back( likelihood ) ;
+		
+	_EMconvolve( rat, rat, ws, true ) ;
+		
+	EMbiggs< double > biggs = { object, rat, ws.grad, SpacialSupport } ;
+	EMbiggsSums sums = my_parallel_reduce( _Space, biggs, _Threads ) ;
+	alpha = ( sums.hh > EMDepsilon ) ? sums.gh / sums.hh : 0.0 ;
+	if( alpha < 0.0 ) alpha = 0.0 ;
+	if( alpha > 1.0 ) alpha = 1.0 ;
+	if( _CheckStatus ) _EMprintAcceleration( alpha ) ;
+}
+
+
+
+void EMdeconvolver::_EMupdate3( float * image, float * rat, float * object, EMsws & ws, unsigned char * SpacialSupport, double & alpha )
+{
+	EMextrapolate< float > extrapolate = { object, ws.buf, alpha } ;
+	my_parallel_range( _Space, extrapolate, _Threads ) ;
+
+	_EMconvolve( object, rat, ws, false ) ;
+
+	EMratio< float > ratio = { image, rat, rat, EMSepsilon, _TrackLikelihood } ;
+	double likelihood = my_parallel_reduce( _Space, ratio, _Threads ) ;
+	if( _TrackLikelihood ) _Likelihood.push_back( likelihood ) ;
+		
+	_EMconvolve( rat, rat, ws, true ) ;
+		
+	EMbiggs< float > biggs = { object, rat, ws.grad, SpacialSupport } ;
+	EMbiggsSums sums = my_parallel_reduce( _Space, biggs, _Threads ) ;
+	alpha = ( sums.hh > EMSepsilon ) ? sums.gh / sums.hh : 0.0 ;
+	if( alpha < 0.0 ) alpha = 0.0 ;
+	if( alpha > 1.0 ) alpha = 1.0 ;
+	if( _CheckStatus ) _EMprintAcceleration( alpha ) ;
+}
+
+
+/* 
+	EMsession: the FFT of the PSF is kept from prepare() and is not changed by the deconvolution loop.
+*/
+
+EMsession::EMsession()
+{
+	_Prepared = false ;
+	_IsDouble = true ;
+	_dscratch = NULL ;
+	_sscratch = NULL ;
+	_psf0     = 0.0 ;
+}
+
+
+
+EMsession::~EMsession()
+{
+	release() ;
+}
+
+
+
+void EMsession::prepare( int DimX, int DimY, int DimZ, double * psf, unsigned char * FrequencySupport )
+{
+	release() ;
+	
+	_Batch = 1 ;
+	_EMstartRun( DimX, DimY, DimZ, _dws ) ;
+	WS_malloc( _dscratch, _Space ) ;
+	if( _RadialOTF )        _EMradialPSF( psf, _dws, FrequencySupport ) ;
+	else if( _Interleaved ) _EMinterleavedPSF( psf, _dws, FrequencySupport ) ;
+	else                    _initPSF( _dws.size, psf, _dws.psf_re, _dws.psf_im, FrequencySupport ) ;
+	_psf0 = psf[0] ;
+	
+	_IsDouble = true ;
+	_Prepared = true ;
+}
+
+
+
+void EMsession::run( double * image, double * object, unsigned char * SpacialSupport )
+{
+	if( !_Prepared || !_IsDouble ) throw SessionError( "EMsession" ) ;
+	
+	if( _Update.size()  > 0 ) _Update.clear() ;
+	if( _Likelihood.size() > 0 ) _Likelihood.clear() ;
+	if( _ObjectMax.size()  > 0 ) _ObjectMax.clear() ;
+	_ApplySpacialSupport = false ;
+	
+	if( _CheckStatus ) _EMprintStatus( 1 ) ;
+	_EMrunFrame( image, _dscratch, object, _dws, SpacialSupport, _psf0 ) ;
+}
+
+
+
+void EMsession::prepare( int DimX, int DimY, int DimZ, float * psf, unsigned char * FrequencySupport )
+{
+	release() ;
+	
+	_Batch = 1 ;
+	_EMstartRun( DimX, DimY, DimZ, _sws ) ;
+	WS_malloc( _sscratch, _Space ) ;
+	if( _RadialOTF )        _EMradialPSF( psf, _sws, FrequencySupport ) ;
+	else if( _Interleaved ) _EMinterleavedPSF( psf, _sws, FrequencySupport ) ;
+	else                    _initPSF( _sws.size, psf, _sws.psf_re, _sws.psf_im, FrequencySupport ) ;
+	_psf0 = psf[0] ;
+	
+	_IsDouble = false ;
+	_Prepared = true ;
+}
+
+
+
+void EMsession::run( float * image, float * object, unsigned char * SpacialSupport )
+{
+	if( !_Prepared || _IsDouble ) throw SessionError( "EMsession" ) ;
+	
+	if( _Update.size()  > 0 ) _Update.clear() ;
+	if( _Likelihood.size() > 0 ) _Likelihood.clear() ;
+	if( _ObjectMax.size()  > 0 ) _ObjectMax.clear() ;
+	_ApplySpacialSupport = false ;
+	
+	if( _CheckStatus ) _EMprintStatus( 1 ) ;
+	_EMrunFrame( image, _sscratch, object, _sws, SpacialSupport, _psf0 ) ;
+}
+
+
+
+void EMsession::release()
+{
+	if( _Prepared )
+	{
+		if( _IsDouble ) _EMfinishRun( _dws ) ;
+		else            _EMfinishRun( _sws ) ;
 	}
+	WS_free( _dscratch ) ;
+	WS_free( _sscratch ) ;
+	
+	_dscratch    = NULL ;
+	_sscratch    = NULL ;
+	_Prepared = false ;
 }
@@ -25,6 +25,7 @@
 
 #include "deconvolver.h"
 #include "FFTW3fft.h"
+#include "RADIALotf.h"
 
 
 #define EMDepsilon 2.2204460492503131E-16
@@ -45,6 +46,19 @@
  *		Acceleration using Newton method will be applied in EMdeconvolver::run() if <_IsAccelerate> is true.    		
  *
  *
+ *		------------------------------------------
+ *		Biggs-Andrews Acceleration: <_Extrapolate>
+ *		------------------------------------------
+ *		If <_Extrapolate> is true and Newton acceleration is not applied, every iteration of run() starts from 
+ *		the estimate extrapolated along the last change of the object, y = max( x + alpha * ( x - x_last ), 0 ),
+ *		and applies the EM step on it (D.S.C. Biggs and M. Andrews, Applied Optics 36, 1997). <alpha> is the 
+ *		correlation of the changes made by the last two EM steps, clipped to [0, 1]; it is 0 in the first 
+ *		two iterations. It costs one more volume in the working space and no more FFTs per iteration, 
+ *		unlike the Newton search, and usually needs several times fewer iterations than plain EM. 
+ *		The likelihood tracked is the one of the extrapolated estimate.
+ *		It is false by default and init() does not reset it.
+ *
+ *
  *		----------------------------------------------------------
  *		Intensity Regularization: <_EMIRiteration>, <_EMIRpenalty>
  *		----------------------------------------------------------
@@ -64,6 +78,29 @@
  *		" the_max_value_in_the_input_PSF / the_max_intensity_in_the_input_image ".
  *
  *
+ *		-----------------------------------------
+ *		Nonzero Extent: <_ExtX>, <_ExtY>, <_ExtZ>
+ *		-----------------------------------------
+ *		If the image is padded with zeros to a fast FFT size, e.g. a stack of 40 planes padded to 64 planes,
+ *		setNonzeroExtent() tells the size of the original data, which lies at x < <_ExtX>, y < <_ExtY>, z < <_ExtZ>. 
+ *		The object is then set to zero outside the extent in run() and stays zero there, and the FFTs 
+ *		skip the zero rows and planes (see the pruned plans in "FFTW3fft.h"). The image must be zero outside the extent.
+ *		The extent is not set by default and init() does not reset it.
+ *
+ *
+ *		------------------------
+ *		Radial OTF: <_RadialOTF>
+ *		------------------------
+ *		If the PSF is radially symmetric in XY, e.g. Fluo3DPSF with CalibrationX equal to CalibrationY, 
+ *		its OTF depends only on the radial and the axial frequencies. If <_RadialOTF> is true, run() keeps 
+ *		the OTF as a (kr, kz) table of a few hundred kbytes (see "RADIALotf.h") instead of the PSF spectrum, 
+ *		and interpolates it in the convolutions; the largest error of the table relative to the PSF spectrum 
+ *		is printed by run(). The PSF must be even as for setRealOTF() (see "deconvolver.h"). 
+ *		The frequency support, if any, is applied in every convolution and its array must stay valid 
+ *		during the run, or until EMsession::release() for a session.
+ *		It is false by default and init() does not reset it.
+ *
+ *
  *		----------------------------------------------------------------------
  *		run() : <image>, <psf>, <object>, <SpacialSupport>, <FrequencySupport>
  *		----------------------------------------------------------------------
@@ -73,7 +110,8 @@
  *		*****************************
  *		The input cubic image to be deconvolved, with the dimensions of DimX, DimY and DimZ 
  *		where DimX is its fastest varying dimension and DimZ is its slowest varying dimension, 
- *		must have a black (0) background. Each dimension of the cubic image must be a power of 2. 
+ *		must have a black (0) background. Any positive dimensions are allowed, but FFTs are fastest if
+ *		each dimension is a product of 2, 3, 5 and 7; pad the image to such a size with "PADfft.h". 
  *		The image data must be stored in an one-dimensional array : <image> as "x+y*DimX+z*DimX*DimY".
  *
  *		Warnning: the <image> array will be rewritten in run() if Normalization is applied.
@@ -127,32 +165,49 @@
 
 /*
  *	EMdeconvolver working space in double precision
+ *	<bytes> is the size in bytes of a working space from allocWorkspace(); it is 0 if run() allocates its own.
+ *	The spectra <psf_*> and <buf_*> have <size> values each; if the deconvolver is interleaved 
+ *	(see "deconvolver.h"), <psf_re> and <buf_re> hold <size> (re, im) pairs and <psf_im>, <buf_im> are NULL.
+ *	<real> is true if the PSF spectrum is real (see setRealOTF() in "deconvolver.h"); <psf_re> then holds 
+ *	<size> real values in both layouts and <psf_im> is NULL.
+ *	<radial> holds the OTF table if the OTF is radial (see setRadialOTF()); <psf_re> and <psf_im> are then NULL.
+ *	<grad> holds the change made by the last EM step if the extrapolation is applied (see setExtrapolation()).
  */
-typedef struct
+struct EMdws
 {
-	int size ;
+	EMdws() : size( 0 ), bytes( 0 ), real( false ), psf_re( NULL ), psf_im( NULL ), buf_re( NULL ), buf_im( NULL ), buf( NULL ), eimg( NULL ), grad( NULL ) {}
+	size_t size ;
+	size_t bytes ;
+	bool real ;
+	RADIALotf< double > radial ;
 	double * psf_re ;
 	double * psf_im ;
 	double * buf_re ;
 	double * buf_im ;
 	double * buf ;
 	double * eimg ;
-} EMdws ;
+	double * grad ;
+} ;
 
 
 /*
- *	EMdeconvolver working space in single precision
+ *	EMdeconvolver working space in single precision, laid out as the double one
  */
-typedef struct
+struct EMsws
 {
-	int size ;
+	EMsws() : size( 0 ), bytes( 0 ), real( false ), psf_re( NULL ), psf_im( NULL ), buf_re( NULL ), buf_im( NULL ), buf( NULL ), eimg( NULL ), grad( NULL ) {}
+	size_t size ;
+	size_t bytes ;
+	bool real ;
+	RADIALotf< float > radial ;
 	float * psf_re ;
 	float * psf_im ;
 	float * buf_re ;
 	float * buf_im ;
 	float * buf ;
 	float * eimg ;
-} EMsws ;
+	float * grad ;
+} ;
                
 class EMdeconvolver : public deconvolver
 {
@@ -164,9 +219,11 @@ class EMdeconvolver : public deconvolver
 	 *	Get private members
 	 *	EMIRiteration() returns <_EMIRiteration> described above.
 	 *	EMIRpenalty()   returns <_EMIRpenalty>   described above.
+	 *	EMIRpenalties() returns the penalty applied to each volume by the last runBatch().
 	 */	       
 	unsigned int  EMIRiteration()  { return _EMIRiteration ; }
 	double        EMIRpenalty()    { return _EMIRpenalty ;   }
+	const std::vector< double > & EMIRpenalties() { return _EMIRpenalties ; }
 	
 	
 	/*
@@ -185,6 +242,33 @@ class EMdeconvolver : public deconvolver
 	void    setEMIRpenalty( double penalty ) ;
 	
 	
+	/*
+	 *	Set <_ExtX>, <_ExtY>, <_ExtZ> (see the description of the nonzero extent above).
+	 *	Input:
+	 *		ExtX, ExtY, ExtZ, they are the nonzero extent of the image and the object along each dimension;
+	 *		                  0 takes the whole dimension and is the default of each.
+	 */
+	void    setNonzeroExtent( int ExtX = 0, int ExtY = 0, int ExtZ = 0 ) ;
+	
+	
+	/*
+	 *	Get/set <_RadialOTF> (see the description of the radial OTF above).
+	 *	Input:
+	 *		IsRadial, it is to indicate whether to keep the OTF as a radial table and its default is false.
+	 */
+	bool    RadialOTF() { return _RadialOTF ; }
+	void    setRadialOTF( bool IsRadial = false ) { _RadialOTF = IsRadial ; }
+	
+	
+	/*
+	 *	Get/set <_Extrapolate> (see the description of the Biggs-Andrews acceleration above).
+	 *	Input:
+	 *		IsExtrapolate, it is to indicate whether to extrapolate the estimates and its default is false.
+	 */
+	bool    Extrapolation() { return _Extrapolate ; }
+	void    setExtrapolation( bool IsExtrapolate = false ) { _Extrapolate = IsExtrapolate ; }
+	
+	
 	/*
 	 *	Set up the control flags and default parameters used for EMdeconvolver
 	 *	Input:
@@ -209,11 +293,13 @@ class EMdeconvolver : public deconvolver
 	/*
 	 *	Run EMdeconvolution in double/single floating precision
 	 *	Input:
-	 *		DimX,             it is the fastest varying dimension of the image/psf; it must be power of 2.
-	 *		DimY,             it is the middle          dimension of the image/psf; it must be power of 2.
-	 *		DimZ,             it is the slowest varying dimension of the image/psf; it must be power of 2.
-	 *		image,            it points to an one-dimensional DimX*DimY*DimZ array storing the image data.
-	 *		psf,              it points to an one-dimensional DimX*DimY*DimZ array storing the psf data.
+	 *		DimX,             it is the fastest varying dimension of the image/psf; it must be positive.
+	 *		DimY,             it is the middle          dimension of the image/psf; it must be positive.
+	 *		DimZ,             it is the slowest varying dimension of the image/psf; it must be positive.
+	 *		image,            it points to an one-dimensional DimX*DimY*DimZ array storing the image data;
+	 *		                  it will be rewritten.
+	 *		psf,              it points to an one-dimensional DimX*DimY*DimZ array storing the psf data;
+	 *		                  it will be rewritten.
 	 *		object,           it points to an one-dimensional DimX*DimY*DimZ array storing both 
 	 *		                  the first estimated object data and the finally deconvolved object data. 
 	 *		ws,               it points to the EMdeconvolver double/float working space. 
@@ -228,6 +314,68 @@ class EMdeconvolver : public deconvolver
                      unsigned char * SpacialSupport = NULL, unsigned char * FrequencySupport = NULL ) ;  
 	void    run( int DimX, int DimY, int DimZ, float  * image, float  * psf, float  * object, EMsws & ws,
 	             unsigned char * SpacialSupport = NULL, unsigned char * FrequencySupport = NULL ) ;
+
+
+	/*
+	 *	Run EMdeconvolution without rewriting the image and the psf, in double/single floating precision
+	 *	The input is the same as for run() above, but <image> and <psf> are only read; the run allocates 
+	 *	one DimX*DimY*DimZ scratch volume, and a copy of the image if <_ApplyNormalization> is true, 
+	 *	and frees them at its end.
+	 *	Throw:
+	 *		throw an error if a given dimension is wrong.
+	 */
+	void    run( int DimX, int DimY, int DimZ, const double * image, const double * psf, double * object, EMdws & ws,
+	             unsigned char * SpacialSupport = NULL, unsigned char * FrequencySupport = NULL ) ;
+	void    run( int DimX, int DimY, int DimZ, const float  * image, const float  * psf, float  * object, EMsws & ws,
+	             unsigned char * SpacialSupport = NULL, unsigned char * FrequencySupport = NULL ) ;
+	
+	
+	/*
+	 *	Run EMdeconvolution on N volumes of a same size at once, e.g. the channels of a multi-channel stack, 
+	 *	in double/single floating precision; each FFT step goes through one batched plan for all the volumes.
+	 *	Input:
+	 *		DimX, DimY, DimZ, they are the dimensions of every volume; each must be positive.
+	 *		N,                it is the number of volumes.
+	 *		image,            it points to an one-dimensional N*DimX*DimY*DimZ array storing the N images; 
+	 *		                  volume b starts at b*DimX*DimY*DimZ.
+	 *		psf,              it points to an one-dimensional N*DimX*DimY*DimZ array storing one psf per volume.
+	 *		object,           it points to an one-dimensional N*DimX*DimY*DimZ array storing the N objects.
+	 *		ws,               it points to the EMdeconvolver double/float working space. 
+	 *		SpacialSuppport,  as in run(); it is shared by all the volumes.
+	 *		FrequencySupport, as in run(); it is shared by all the volumes.
+	 *	Warning:
+	 *		the run stops when the slowest converging volume meets <_Criterion>, and the update and 
+	 *		max intensity tracked per iteration are the largest over the volumes; the likelihood is their sum.
+	 *		Newton acceleration and the extrapolation choose a step for each volume, so with either of them 
+	 *		the volumes are run one by one. Each volume starts from the <_EMIRpenalty> set by the user and 
+	 *		gets its own penalty, which is kept in EMIRpenalties(); <_EMIRpenalty> is not changed.
+	 *	Throw:
+	 *		throw an error if a given dimension is wrong.
+	 */
+	void    runBatch( int DimX, int DimY, int DimZ, int N, double * image, double * psf, double * object, EMdws & ws,
+	                  unsigned char * SpacialSupport = NULL, unsigned char * FrequencySupport = NULL ) ;
+	void    runBatch( int DimX, int DimY, int DimZ, int N, float  * image, float  * psf, float  * object, EMsws & ws,
+	                  unsigned char * SpacialSupport = NULL, unsigned char * FrequencySupport = NULL ) ;
+	
+	
+	/*
+	 *	Allocate/free a EMdeconvolver working space once for many runs of a same size
+	 *	The working space is allocated with fftw_malloc() for the dimensions and the control flags set at 
+	 *	the time; run() then uses it instead of allocating and freeing its own. 
+	 *	Input:
+	 *		DimX, DimY, DimZ, they are the dimensions of the runs; each must be positive.
+	 *		ws,               it is the working space; ws.bytes returns its size in bytes.
+	 *		N,                it is the number of volumes given to runBatch() and its default is 1.
+	 *	Throw:
+	 *		throw an error if a given dimension is wrong; run() throws an error if the working space 
+	 *		does not fit its dimensions or control flags; std::bad_alloc is thrown, and nothing is
+	 *		allocated, if the memory runs out.
+	 */
+	void    allocWorkspace( int DimX, int DimY, int DimZ, EMdws & ws, int N = 1 ) ;
+	void    allocWorkspace( int DimX, int DimY, int DimZ, EMsws & ws, int N = 1 ) ;
+	void    freeWorkspace( EMdws & ws ) ;
+	void    freeWorkspace( EMsws & ws ) ;
+	
 	
 	/*
 	 *	Export the profile of a EMdeconvolver to a text file
@@ -239,16 +387,28 @@ class EMdeconvolver : public deconvolver
 	void    exportEM( const char * filename ) ;
 	
 
-	private:
+	protected:
 	bool            _Accelerate ;
 	unsigned int    _EMIRiteration ;
 	double          _EMIRpenalty ;	
+	std::vector< double > _EMIRpenalties ;
 	FFTW3_FFT*  	_FFTplanf ;
 	FFTW3_FFT*  	_FFTplanb ;
+	int             _Batch ;
+	int             _ExtX ;
+	int             _ExtY ;
+	int             _ExtZ ;
+	bool            _RadialOTF ;
+	bool            _Extrapolate ;
+        
+	void    _collapseBatch( std::vector< double > & history, int N ) ;
+        
+	void    _EMapplyExtent( double * object ) ;
+	void    _EMapplyExtent( float  * object ) ;
         
 	void    _EMprintStatus( int stage ) ; 
                
-	void    _EMprintAcceleration( double alpha, double likelihood, int negative_points ) ;
+	void    _EMprintAcceleration( double alpha, double likelihood, size_t negative_points ) ;
 	void    _EMprintAcceleration( double alpha ) ;
         
 	void    _EMstartRun( int DimX, int DimY, int DimZ, EMdws & ws ) ;
@@ -256,12 +416,103 @@ class EMdeconvolver : public deconvolver
         
 	void    _EMfinishRun( EMdws & ws ) ;
 	void    _EMfinishRun( EMsws & ws ) ;
+        
+	void    _EMrunFrame( double * image, double * rat, double * object, EMdws & ws, unsigned char * SpacialSupport, double psf0 ) ;
+	void    _EMrunFrame( float  * image, float  * rat, float  * object, EMsws & ws, unsigned char * SpacialSupport, float  psf0 ) ;
                 
+	void    _EMradialPSF( double * psf, EMdws & ws, unsigned char * FrequencySupport ) ;
+	void    _EMradialPSF( float  * psf, EMsws & ws, unsigned char * FrequencySupport ) ;
+        
+	void    _EMinterleavedPSF( double * psf, EMdws & ws, unsigned char * FrequencySupport ) ;
+	void    _EMinterleavedPSF( float  * psf, EMsws & ws, unsigned char * FrequencySupport ) ;
+        
+	void    _EMconvolve( double * in, double * out, EMdws & ws, bool correlate ) ;
+	void    _EMconvolve( float  * in, float  * out, EMsws & ws, bool correlate ) ;
+        
 	void    _EMupdate1( double * image, double * rat, double * object, EMdws & ws ) ; 
 	void    _EMupdate1( float  * image, float  * rat, float  * object, EMsws & ws ) ; 
        
 	void    _EMupdate2( double * image, double * rat, double * object, EMdws & ws ) ; 
 	void    _EMupdate2( float  * image, float  * rat, float  * object, EMsws & ws ) ;
+       
+	void    _EMupdate3( double * image, double * rat, double * object, EMdws & ws, unsigned char * SpacialSupport, double & alpha ) ; 
+	void    _EMupdate3( float  * image, float  * rat, float  * object, EMsws & ws, unsigned char * SpacialSupport, double & alpha ) ;
+} ;
+
+
+
+/*
+ *	===========================================================================================
+ *	EMsession runs EMdeconvolution on many images taken with a same PSF, e.g. the frames of a 
+ *	time-lapse series: prepare() creates the FFT plans, the working space and the FFT of the PSF 
+ *	once, and each run() then deconvolves one image without allocating memory or creating plans.
+ *	===========================================================================================
+ *
+ *	The control flags and parameters are set as for a EMdeconvolver, before prepare().
+ *	The intensity regularization penalty found on the first image run is used for the following ones,
+ *	as it is when an EMdeconvolver runs again. A nonzero extent is taken into account as in run().
+ */
+class EMsession : public EMdeconvolver
+{
+	public:
+	EMsession() ;
+	virtual ~EMsession() ;
+	
+	
+	/*
+	 *	Prepare a session in double/single floating precision
+	 *	Input:
+	 *		DimX, DimY, DimZ, they are the dimensions of the psf and of every image; each must be positive.
+	 *		psf,              it points to an one-dimensional DimX*DimY*DimZ array storing the psf data;
+	 *		                  it is not kept by the session.
+	 *		FrequencySupport, it points to an one-dimensional unsigned char DimX*DimY*DimZ
+	 *		                  array storing the frequency support data and its default is NULL.
+	 *	Throw:
+	 *		throw an error if a given dimension is wrong.
+	 */
+	void    prepare( int DimX, int DimY, int DimZ, double * psf, unsigned char * FrequencySupport = NULL ) ;
+	void    prepare( int DimX, int DimY, int DimZ, float  * psf, unsigned char * FrequencySupport = NULL ) ;
+	
+	
+	/*
+	 *	Run EMdeconvolution on one image with the prepared psf
+	 *	Input:
+	 *		image,            it points to an one-dimensional DimX*DimY*DimZ array storing the image data;
+	 *		                  it will be rewritten.
+	 *		object,           it points to an one-dimensional DimX*DimY*DimZ array storing both 
+	 *		                  the first estimated object data and the finally deconvolved object data. 
+	 *		SpacialSuppport,  it points to an one-dimensional unsigned char DimX*DimY*DimZ 
+	 *		                  array storing the spacial support data and its default is NULL.
+	 *	Throw:
+	 *		throw an error if the session has not been prepared in the same floating precision.
+	 */
+	void    run( double * image, double * object, unsigned char * SpacialSupport = NULL ) ;
+	void    run( float  * image, float  * object, unsigned char * SpacialSupport = NULL ) ;
+	
+	
+	/*
+	 *	Release the FFT plans and the working space of a session; it is called by prepare() and the destructor.
+	 */
+	void    release() ;
+	
+	
+	/*
+	 *	Get the state of a session
+	 *	IsPrepared() returns true after prepare() and until release().
+	 *	IsDouble()   returns true if the session was prepared in double floating precision.
+	 */
+	bool    IsPrepared()  { return _Prepared ; }
+	bool    IsDouble()    { return _IsDouble ; }
+	
+	
+	private:
+	bool      _Prepared ;
+	bool      _IsDouble ;
+	EMdws     _dws ;
+	EMsws     _sws ;
+	double *  _dscratch ;
+	float  *  _sscratch ;
+	double    _psf0 ;
 } ;
 
 
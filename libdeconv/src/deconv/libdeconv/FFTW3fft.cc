@@ -19,9 +19,14 @@
  */
 
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
 #include "MYerror.h"
 #include "SHIFTfft.h"
 #include "FFTW3fft.h"
+#include "MYthreads.h"
 
 class FFTW3Error : public Error
 {
@@ -56,6 +61,14 @@ class FFTW3Error : public Error
 				}
 				break ;
 
+			case -4:
+				_error << " FFTW3-FFT error : wrong use of a split/interleaved plan with the other spectrum layout.\n" ;
+				break ;
+
+			case -5:
+				_error << " FFTW3-FFT error : the arrays or the transform do not match the plan.\n" ;
+				break ;
+
 			case 0:
 				_error << " FFTW3-FFT error : construction of FFTW3 plan failed.\n" ;
 				break ;
@@ -68,605 +81,1531 @@ class FFTW3Error : public Error
 } ;
 
 
-FFTW3_FFT::~FFTW3_FFT()
-{
-	if (_dplan)
-		fftw_destroy_plan (_dplan) ;
-
-	if (_splan)
-		fftwf_destroy_plan (_splan) ;
-
-	if (_fbuf1)
-		delete [] _fbuf1 ;
-
-	if (_fbuf2)
-		delete [] _fbuf2 ;
-		
-	if (_fbuf3)
-		delete [] _fbuf3 ;
-		
-	if (_dbuf1)
-		delete [] _dbuf1 ;
-		
-	if (_dbuf2)
-		delete [] _dbuf2 ;
-		
-	if (_dbuf3)
-		delete [] _dbuf3 ;
-}
+/*
+	The FFTW3 planner is not thread-safe, all calls creating or destroying a plan 
+	must hold <FFTW3_planner>. Executing a plan with new arrays needs no lock.
+*/
+static pthread_mutex_t FFTW3_planner = PTHREAD_MUTEX_INITIALIZER ;
 
-FFTW3_FFT::FFTW3_FFT( int DimX, int DimY, int DimZ, bool IsForward, bool IsDouble, int status )
+class FFTW3_Lock
 {
-	_DimX = DimX ;
-	_DimY = DimY ;
-	_DimZ = DimZ ;
-	
-	_dplan = NULL ;
-	_splan = NULL ;
-	_fbuf1 = _fbuf2 = _fbuf3 = NULL ;
-	_dbuf1 = _dbuf2 = _dbuf3 = NULL ;
+	public:
+	FFTW3_Lock( pthread_mutex_t * mutex ) : _mutex( mutex ) { pthread_mutex_lock( _mutex ) ; }
+	~FFTW3_Lock() { pthread_mutex_unlock( _mutex ) ; }
 
-	if( DimZ % 2 == 0 )
-		_FFTsize = (DimZ/2 + 1) * DimY * DimX ;
-	else
-		_FFTsize = ((DimZ+1)/2) * DimY * DimX ;
-	
-	_weight = (double) (DimX * DimY * DimZ) ;
-	_IsForward = IsForward ;
-	_IsDouble = IsDouble ;
-	_status = status ;
+	private:
+	pthread_mutex_t * _mutex ;
+} ;
 
-	fftw_iodim dims [3] ;
-	
-	dims[2].n  = DimZ ;
-	dims[2].is = DimX * DimY ;
-	dims[2].os = DimX * DimY ;
-	dims[1].n  = DimY ;
-	dims[1].is = DimX ;
-	dims[1].os = DimX ;
-	dims[0].n  = DimX ;
-	dims[0].is = 1 ;
-	dims[0].os = 1 ;
 
-	if (status == 1)
+/*
+	FFTW3 wisdom files, see FFTW3_Wisdom in "FFTW3fft.h".
+	The functions below must be called with <FFTW3_planner> held.
+*/
+static bool         FFTW3_wisdom_init   = false ;
+static bool         FFTW3_wisdom_loaded = false ;
+static bool         FFTW3_wisdom_exit   = false ;
+static bool         FFTW3_wisdom_dirty[2] = { false, false } ;
+static std::string  FFTW3_wisdom_path ;
+
+static const char * FFTW3_wisdom_header = "# deconv FFTW3 wisdom, cpu: " ;
+
+static std::string FFTW3_wisdom_getPath()
+{
+	if( !FFTW3_wisdom_init )
 	{
-		if (IsDouble)
-		{
-			_dbuf1 = new double [ DimX * DimY * DimZ] ;			
-			_dbuf2 = new double [ DimX * DimY * DimZ] ;
-			_dbuf3 = new double [ DimX * DimY * DimZ] ;
+		const char * env = getenv( "DECONV_FFTW_WISDOM" ) ;
+		const char * home = getenv( "HOME" ) ;
 
-			if (IsForward)
-				_dplan = fftw_plan_guru_split_dft_r2c (3, dims, 0, NULL, _dbuf1, _dbuf2, _dbuf3, FFTW3_FLAG) ;
-			else
-				_dplan = fftw_plan_guru_split_dft_c2r (3, dims, 0, NULL, _dbuf1, _dbuf2, _dbuf3, FFTW3_FLAG) ;
-		}
-		else
-		{
-			_fbuf1 = new float [ DimX * DimY * DimZ] ;
-			_fbuf2 = new float [ DimX * DimY * DimZ] ;
-			_fbuf3 = new float [ DimX * DimY * DimZ] ;
+		if( env )
+			FFTW3_wisdom_path = env ;
+		else if( home )
+			FFTW3_wisdom_path = std::string( home ) + "/.deconv_fftw_wisdom" ;
 
-			if (IsForward)
-				_splan = fftwf_plan_guru_split_dft_r2c (3, dims, 0, NULL, _fbuf1, _fbuf2, _fbuf3, FFTW3_FLAG) ;
-			else
-				_splan = fftwf_plan_guru_split_dft_c2r (3, dims, 0, NULL, _fbuf1, _fbuf2, _fbuf3, FFTW3_FLAG) ;
-		}
+		FFTW3_wisdom_init = true ;
 	}
-	else if (status == 2)
-	{	
-		if (IsDouble)
-		{
-			_dbuf1 = new double [ DimX * DimY * DimZ ] ;
-			_dbuf2 = new double [ DimX * DimY * DimZ ] ;
+	return FFTW3_wisdom_path ;
+}
 
-			if (IsForward)
-				_dplan = fftw_plan_guru_split_dft_r2c (3, dims, 0, NULL, _dbuf1, _dbuf2, _dbuf2, FFTW3_FLAG) ;
-			else
-				_dplan = fftw_plan_guru_split_dft_c2r (3, dims, 0, NULL, _dbuf1, _dbuf2, _dbuf1, FFTW3_FLAG) ;
-		}
-		else
-		{
-			_fbuf1 = new float [ DimX * DimY * DimZ ] ;
-			_fbuf2 = new float [ DimX * DimY * DimZ ] ;
+static std::string FFTW3_wisdom_cpu()
+{
+	std::string cpu = "unknown" ;
+	char line[ 512 ] ;
 
-			if (IsForward)
-				_splan = fftwf_plan_guru_split_dft_r2c (3, dims, 0, NULL, _fbuf1, _fbuf1, _fbuf2, FFTW3_FLAG) ;
-			else
-				_splan = fftwf_plan_guru_split_dft_c2r (3, dims, 0, NULL, _fbuf1, _fbuf2, _fbuf1, FFTW3_FLAG) ;
-		}
-	}
-	else if (status == 3)
+	FILE * fp = fopen( "/proc/cpuinfo", "rt" ) ;
+	if( fp )
 	{
-		if (IsDouble)
+		while( fgets( line, sizeof(line), fp ) )
 		{
-			if (IsForward)
+			if( strncmp( line, "model name", 10 ) == 0 || strncmp( line, "Processor", 9 ) == 0 )
 			{
-				_dbuf1 = new double [ DimX * DimY * DimZ] ;
-				_dbuf2 = new double [ _FFTsize ] ;
-				_dbuf3 = new double [ _FFTsize ] ;
-
-				_dplan = fftw_plan_guru_split_dft_r2c (3, dims, 0, NULL, _dbuf1, _dbuf2, _dbuf3, FFTW3_FLAG) ;
-			}
-			else
-			{	
-				_dbuf1 = new double [ _FFTsize ] ;
-				_dbuf2 = new double [ _FFTsize ] ;
-				_dbuf3 = new double [ DimX * DimY * DimZ] ;
-
-				_dplan = fftw_plan_guru_split_dft_r2c (3, dims, 0, NULL, _dbuf1, _dbuf2, _dbuf3, FFTW3_FLAG) ;
+				char * value = strchr( line, ':' ) ;
+				if( value )
+				{
+					value++ ;
+					while( *value == ' ' || *value == '\t' ) value++ ;
+					cpu = value ;
+					while( !cpu.empty() && ( cpu[cpu.size()-1] == '\n' || cpu[cpu.size()-1] == ' ' ) )
+						cpu.erase( cpu.size()-1 ) ;
+					break ;
+				}
 			}
 		}
-		else
-		{
-			if (IsForward)
-			{
-				_fbuf1 = new float [ DimX * DimY * DimZ] ;
-				_fbuf2 = new float [ _FFTsize ] ;
-				_fbuf3 = new float [ _FFTsize ] ; 
+		fclose( fp ) ;
+	}
+	return cpu ;
+}
 
-				_splan = fftwf_plan_guru_split_dft_r2c (3, dims, 0, NULL, _fbuf1, _fbuf2, _fbuf3, FFTW3_FLAG) ;
-			}
-			else
-			{					
-				_fbuf1 = new float [ _FFTsize ] ; 
-				_fbuf2 = new float [ _FFTsize ] ;
-				_fbuf3 = new float [ DimX * DimY * DimZ] ;
+static std::string FFTW3_wisdom_file( bool IsDouble )
+{
+	std::string path = FFTW3_wisdom_getPath() ;
+	if( path.empty() )
+		return path ;
+	return path + ( IsDouble ? ".double" : ".float" ) ;
+}
 
-				_splan = fftwf_plan_guru_split_dft_c2r (3, dims, 0, NULL, _fbuf1, _fbuf2, _fbuf3, FFTW3_FLAG) ;
-			}
-		}
+/*
+	Read the wisdom of <file> into <wisdom>, it returns false if the file 
+	does not exist or it was not made on this CPU model.
+*/
+static bool FFTW3_wisdom_read( const std::string & file, std::string & wisdom )
+{
+	if( file.empty() )
+		return false ;
+
+	FILE * fp = fopen( file.c_str(), "rt" ) ;
+	if( !fp )
+		return false ;
+
+	std::string header ;
+	char buf[ 4096 ] ;
+	size_t n ;
+
+	if( fgets( buf, sizeof(buf), fp ) )
+		header = buf ;
+
+	wisdom.clear() ;
+	while( ( n = fread( buf, 1, sizeof(buf), fp ) ) > 0 )
+		wisdom.append( buf, n ) ;
+	fclose( fp ) ;
+
+	if( header != std::string( FFTW3_wisdom_header ) + FFTW3_wisdom_cpu() + "\n" )
+	{
+		std::cerr << " FFTW3 wisdom in " << file << " was made on another CPU and is ignored.\n" ;
+		return false ;
 	}
-	else 
-		throw FFTW3Error (0) ;
+	return true ;
 }
 
-void FFTW3_FFT::execute( double * buf1, double * buf2, double * buf3 )
+static void FFTW3_wisdom_load()
 {
-	if( _IsDouble )
-	{
-		if( _IsForward )
-			fftw_execute_split_dft_r2c( _dplan, buf1, buf2, buf3 ) ;
-		else
-		{
-			fftw_execute_split_dft_c2r( _dplan, buf1, buf2, buf3 ) ;
+	std::string wisdom ;
 
-			for( int i = 0 ; i < _DimX * _DimY * _DimZ ; i++ )
-				buf3[i] /= _weight ;
-		}
-	}
-	else
-		throw FFTW3Error( -2, _IsForward ) ;
+	if( FFTW3_wisdom_read( FFTW3_wisdom_file( true ), wisdom ) )
+		fftw_import_wisdom_from_string( wisdom.c_str() ) ;
+
+	if( FFTW3_wisdom_read( FFTW3_wisdom_file( false ), wisdom ) )
+		fftwf_import_wisdom_from_string( wisdom.c_str() ) ;
+
+	FFTW3_wisdom_loaded = true ;
 }
 
-void FFTW3_FFT::execute( float * buf1, float * buf2, float * buf3 )
+static void FFTW3_wisdom_save( bool IsDouble )
 {
-	if( !_IsDouble )
+	std::string file = FFTW3_wisdom_file( IsDouble ) ;
+	if( file.empty() )
+		return ;
+
+	/* merge the wisdom saved meanwhile by other processes */
+	std::string wisdom ;
+	if( FFTW3_wisdom_read( file, wisdom ) )
 	{
-		if( _IsForward )
-			fftwf_execute_split_dft_r2c( _splan, buf1, buf2, buf3 ) ;
+		if( IsDouble )
+			fftw_import_wisdom_from_string( wisdom.c_str() ) ;
 		else
-		{
-			fftwf_execute_split_dft_c2r( _splan, buf1, buf2, buf3 ) ;
+			fftwf_import_wisdom_from_string( wisdom.c_str() ) ;
+	}
 
-			for( int i = 0 ; i < _DimX * _DimY * _DimZ ; i++ )
-				buf3[i] /= _weight ;
-		}
+	char * str = IsDouble ? fftw_export_wisdom_to_string() : fftwf_export_wisdom_to_string() ;
+	if( !str )
+		return ;
+
+	/* write to a temporary file and rename it, so that readers never see a partial file */
+	char pid[ 32 ] ;
+	sprintf( pid, ".%d", (int)getpid() ) ;
+	std::string temp = file + pid ;
+
+	FILE * fp = fopen( temp.c_str(), "wt" ) ;
+	if( fp )
+	{
+		bool ok = fprintf( fp, "%s%s\n", FFTW3_wisdom_header, FFTW3_wisdom_cpu().c_str() ) > 0 
+		          && fputs( str, fp ) >= 0 ;
+		ok = ( fclose( fp ) == 0 ) && ok ;
+
+		if( !ok || rename( temp.c_str(), file.c_str() ) != 0 )
+			remove( temp.c_str() ) ;
 	}
-	else
-		throw FFTW3Error( -3, _IsForward ) ;
+	free( str ) ;
 }
 
-void fft3d( int DimX, int DimY, int DimZ, double * in, double * out_re, double * out_im )
+
+/*
+	The wisdom of the plans created by a process is saved once, when the process exits,
+	instead of merging and rewriting the files after every plan.
+*/
+static void FFTW3_wisdom_atexit()
 {
-	fftw_iodim dims [3] ;
-	
-	dims[2].n  = DimZ ;
-	dims[2].is = DimX * DimY ;
-	dims[2].os = DimX * DimY ;
-	dims[1].n  = DimY ;
-	dims[1].is = DimX ;
-	dims[1].os = DimX ;
-	dims[0].n  = DimX ;
-	dims[0].is = 1 ;
-	dims[0].os = 1 ;
+	FFTW3_Lock lock( &FFTW3_planner ) ;
 
-	fftw_plan p = fftw_plan_guru_split_dft_r2c( 3, dims, 0, NULL, in, out_re, out_im, FFTW_ESTIMATE ) ;
+	if( FFTW3_wisdom_dirty[1] )
+		FFTW3_wisdom_save( true ) ;
+	if( FFTW3_wisdom_dirty[0] )
+		FFTW3_wisdom_save( false ) ;
+	FFTW3_wisdom_dirty[0] = FFTW3_wisdom_dirty[1] = false ;
+}
 
-	if( p )
-		fftw_execute_split_dft_r2c( p, in, out_re, out_im ) ;
-	else
-		throw FFTW3Error( 0 ) ;	
-		
-	fftw_destroy_plan (p) ;	
+/* a plan of precision <IsDouble> was created, its wisdom will be saved at exit */
+static void FFTW3_wisdom_created( bool IsDouble )
+{
+	FFTW3_wisdom_dirty[ IsDouble ? 1 : 0 ] = true ;
+
+	if( !FFTW3_wisdom_exit )
+	{
+		atexit( FFTW3_wisdom_atexit ) ;
+		FFTW3_wisdom_exit = true ;
+	}
 }
 
 
+void FFTW3_Wisdom::setPath( const char * path )
+{
+	FFTW3_Lock lock( &FFTW3_planner ) ;
+	FFTW3_wisdom_path = path ? path : "" ;
+	FFTW3_wisdom_init = true ;
+	FFTW3_wisdom_loaded = false ;
+}
 
-void fft3d( int DimX, int DimY, int DimZ, float * in, float * out_re, float * out_im )
+std::string FFTW3_Wisdom::path()
 {
-	fftw_iodim dims [3] ;
-	
-	dims[2].n  = DimZ ;
-	dims[2].is = DimX * DimY ;
-	dims[2].os = DimX * DimY ;
-	dims[1].n  = DimY ;
-	dims[1].is = DimX ;
-	dims[1].os = DimX ;
-	dims[0].n  = DimX ;
-	dims[0].is = 1 ;
-	dims[0].os = 1 ;
-	
-	fftwf_plan p = fftwf_plan_guru_split_dft_r2c( 3, dims, 0, NULL, in, out_re, out_im, FFTW_ESTIMATE ) ;
-	
-	if( p )
-		fftwf_execute_split_dft_r2c( p, in, out_re, out_im ) ;
-	else
-		throw FFTW3Error( 0 ) ;
-				
-	fftwf_destroy_plan (p) ;
+	FFTW3_Lock lock( &FFTW3_planner ) ;
+	return FFTW3_wisdom_getPath() ;
 }
 
-void fft3d( int DimX, int DimY, int DimZ, bool IsForward, bool IsShift, 
-            double * in_re, double * in_im, double * out_re, double * out_im )
+std::string FFTW3_Wisdom::cpu()
 {
-	fftw_iodim dims [3] ;
-	
-	dims[2].n  = DimZ ;
-	dims[2].is = DimX * DimY ;
-	dims[2].os = DimX * DimY ;
-	dims[1].n  = DimY ;
-	dims[1].is = DimX ;
-	dims[1].os = DimX ;
-	dims[0].n  = DimX ;
-	dims[0].is = 1 ;
-	dims[0].os = 1 ;
+	return FFTW3_wisdom_cpu() ;
+}
 
-	if( IsForward ) 
-	{
-		fftw_plan p = fftw_plan_guru_split_dft( 3, dims, 0, NULL, in_re, in_im, out_re, out_im, FFTW_ESTIMATE ) ;
+void FFTW3_Wisdom::load()
+{
+	FFTW3_Lock lock( &FFTW3_planner ) ;
+	FFTW3_wisdom_load() ;
+}
 
-		if( p )
-		{
-			if( IsShift )
-				shift3d( DimX, DimY, DimZ, in_re, in_im, in_re, in_im ) ;
+void FFTW3_Wisdom::save( bool IsDouble )
+{
+	FFTW3_Lock lock( &FFTW3_planner ) ;
+	FFTW3_wisdom_save( IsDouble ) ;
+	FFTW3_wisdom_dirty[ IsDouble ? 1 : 0 ] = false ;
+}
 
-			fftw_execute_split_dft( p, in_re, in_im, out_re, out_im ) ;
 
-			if( IsShift && in_re != out_re && in_im != out_im )
-				shift3d( DimX, DimY, DimZ, in_re, in_im, in_re, in_im ) ;
-			
-			fftw_destroy_plan (p) ;
-		}
-		else
-			throw FFTW3Error( 0 ) ;		
+/*
+	Make the following plans run with <nthreads> threads.
+	<FFTW3_planner> must be held.
+*/
+static void FFTW3_setThreads( bool IsDouble, int nthreads )
+{
+#ifdef HAVE_FFTW3_THREADS
+	static bool initialized = false ;
+
+	if( !initialized )
+	{
+		fftw_init_threads() ;
+		fftwf_init_threads() ;
+		initialized = true ;
 	}
+
+	if( IsDouble )
+		fftw_plan_with_nthreads( nthreads < 1 ? 1 : nthreads ) ;
 	else
-	{
-		fftw_plan p = fftw_plan_guru_split_dft( 3, dims, 0, NULL, in_im, in_re, out_im, out_re, FFTW_ESTIMATE ) ;
+		fftwf_plan_with_nthreads( nthreads < 1 ? 1 : nthreads ) ;
+#else
+	(void) IsDouble ;
+	(void) nthreads ;
+#endif
+}
 
-		if( p )
-		{
-			double weight = (double) ( DimX * DimY * DimZ ) ;
 
-			fftw_execute_split_dft( p, in_im, in_re, out_im, out_re ) ;
-			double * temp = out_im ;
-			out_im = out_re ;
-			out_re = temp ;
+FFTW3_FFT::~FFTW3_FFT()
+{
+	{
+		FFTW3_Lock lock( &FFTW3_planner ) ;
+		_destroy() ;
+	}
+
+	if( _scratch )
+		fftw_free( _scratch ) ;
+	pthread_mutex_destroy( &_scratchLock ) ;
+}
 
-			if( IsShift )
-				shift3d( DimX, DimY, DimZ, out_re, out_im, out_re, out_im ) ;
+/*
+	Destroy the plans, <FFTW3_planner> must be held.
+*/
+void FFTW3_FFT::_destroy()
+{
+	if (_dplan)
+		fftw_destroy_plan (_dplan) ;
 
-			fftw_destroy_plan (p) ;
+	if (_splan)
+		fftwf_destroy_plan (_splan) ;
 
-			for( int i = 0 ; i < DimX * DimY * DimZ ; i++ )
-			{
-				out_re[i] /= weight ;
-				out_im[i] /= weight ;
-			}
-		}
-		else
-			throw FFTW3Error( 0 ) ;		
+	for( int i = 0 ; i < 3 ; i++ )
+	{
+		if( _dsub[i] )
+			fftw_destroy_plan( _dsub[i] ) ;
+		if( _ssub[i] )
+			fftwf_destroy_plan( _ssub[i] ) ;
+		_dsub[i] = NULL ;
+		_ssub[i] = NULL ;
 	}
+
+	_dplan = NULL ;
+	_splan = NULL ;
 }
 
-void fft3d( int DimX, int DimY, int DimZ, bool IsForward, bool IsShift, 
-            float * in_re, float * in_im, float * out_re, float * out_im )
+unsigned FFTW3_flags( FFTW3_Effort effort )
 {
-	fftw_iodim dims [3] ;
-	
-	dims[2].n  = DimZ ;
-	dims[2].is = DimX * DimY ;
-	dims[2].os = DimX * DimY ;
-	dims[1].n  = DimY ;
-	dims[1].is = DimX ;
-	dims[1].os = DimX ;
-	dims[0].n  = DimX ;
-	dims[0].is = 1 ;
-	dims[0].os = 1 ;
+	switch( effort )
+	{
+		case FFTW3_ESTIMATE : return FFTW_ESTIMATE ;
+		case FFTW3_PATIENT  : return FFTW_PATIENT ;
+		default             : return FFTW_MEASURE ;
+	}
+}
 
-	if( IsForward ) 
+const char * FFTW3_effortName( FFTW3_Effort effort )
+{
+	switch( effort )
 	{
-		fftwf_plan p = fftwf_plan_guru_split_dft( 3, dims, 0, NULL, in_re, in_im, out_re, out_im, FFTW_ESTIMATE ) ;
+		case FFTW3_ESTIMATE : return "estimate" ;
+		case FFTW3_MEASURE  : return "measure" ;
+		case FFTW3_PATIENT  : return "patient" ;
+		case FFTW3_AUTO     : return "auto" ;
+		default             : return "unknown" ;
+	}
+}
 
-		if( p )
-		{
-			if( IsShift )
-				shift3d( DimX, DimY, DimZ, in_re, in_im, in_re, in_im ) ;
 
-			fftwf_execute_split_dft( p, in_re, in_im, out_re, out_im ) ;
+/* 
+	Winners of FFTW3_AUTO tuning, the key effort is always FFTW3_AUTO.
+	It is accessed with <FFTW3_planner> held.
+*/
+static std::map< FFTW3_PlanKey, unsigned > FFTW3_tuned ;
 
-			if( IsShift && in_re != out_re && in_im != out_im )
-				shift3d( DimX, DimY, DimZ, in_re, in_im, in_re, in_im ) ;
-		
-			fftwf_destroy_plan (p) ;
-		}
-		else
-			throw FFTW3Error( 0 ) ;		
+
+/*
+	A nonzero extent out of (0, dim] takes the whole dimension.
+*/
+static int FFTW3_extent( int ext, int dim )
+{
+	return ( ext <= 0 || ext > dim ) ? dim : ext ;
+}
+
+
+FFTW3_FFT::FFTW3_FFT( int DimX, int DimY, int DimZ, bool IsForward, bool IsDouble, int status, 
+                      FFTW3_Effort effort, int nthreads, int howmany, int ExtX, int ExtY, int ExtZ )
+{
+	_DimX = DimX ;
+	_DimY = DimY ;
+	_DimZ = DimZ ;
+	_ExtX = FFTW3_extent( ExtX, DimX ) ;
+	_ExtY = FFTW3_extent( ExtY, DimY ) ;
+	_ExtZ = FFTW3_extent( ExtZ, DimZ ) ;
+	_pruned = ( status >= 3 ) && ( _ExtY < DimY || _ExtZ < DimZ ) ;
+	
+	_dplan = NULL ;
+	_splan = NULL ;
+	_scratch = NULL ;
+	for( int i = 0 ; i < 3 ; i++ )
+	{
+		_dsub[i] = NULL ;
+		_ssub[i] = NULL ;
 	}
+	pthread_mutex_init( &_scratchLock, NULL ) ;
+
+	if( DimZ % 2 == 0 )
+		_FFTsize = (size_t)(DimZ/2 + 1) * DimY * DimX ;
 	else
-	{
-		fftwf_plan p = fftwf_plan_guru_split_dft( 3, dims, 0, NULL, in_im, in_re, out_im, out_re, FFTW_ESTIMATE ) ;
+		_FFTsize = (size_t)((DimZ+1)/2) * DimY * DimX ;
+	
+	_weight = (double) DimX * DimY * DimZ ;
+	_IsForward = IsForward ;
+	_IsDouble = IsDouble ;
+	_status = status ;
+	_effort = effort ;
+	_flags = FFTW3_flags( effort ) ;
+	_nthreads = ( nthreads < 1 ) ? 1 : nthreads ;
+	_howmany = ( howmany < 1 ) ? 1 : howmany ;
 
-		if (p)
-		{
-			double weight = (double) ( DimX * DimY * DimZ ) ;
+	if( status < 1 || status > 4 )
+		throw FFTW3Error (0) ;
 
-			fftwf_execute_split_dft( p, in_im, in_re, out_im, out_re ) ;
-			float * temp = out_im ;
-			out_im = out_re ;
-			out_re = temp ;
+	/* 
+		the real array always has DimX*DimY*DimZ elements, 
+		the complex arrays have _FFTsize elements only if status is 3, 
+		a status 4 plan has a single interleaved complex array of 2*_FFTsize elements;
+		a batched plan has <_howmany> of them one after another.
+	*/
+	size_t space = (size_t)DimX * DimY * DimZ ;
+	size_t csize = ( status == 3 ) ? _FFTsize : ( status == 4 ) ? 2 * _FFTsize : space ;
+	space *= _howmany ;
+	csize *= _howmany ;
+	size_t bytes = IsDouble ? sizeof(double) : sizeof(float) ;
 
-			if( IsShift )
-				shift3d( DimX, DimY, DimZ, out_re, out_im, out_re, out_im ) ;
+	/* the pruned passes run on a spectrum halved along X, which is then unfolded into the <_FFTsize> layout */
+	if( _pruned )
+		_scratch = fftw_malloc( 2 * (size_t)( DimX/2 + 1 ) * DimY * DimZ * bytes ) ;
 
-			fftwf_destroy_plan (p) ;
+	FFTW3_Lock lock( &FFTW3_planner ) ;
 
-			for( int i = 0 ; i < DimX * DimY * DimZ ; i++ )
-			{
-				out_re[i] /= weight ;
-				out_im[i] /= weight ;
-			}
-		}
-		else
-			throw FFTW3Error( 0 ) ;		
-	}
+	if( !FFTW3_wisdom_loaded )
+		FFTW3_wisdom_load() ;
+
+	FFTW3_setThreads( IsDouble, _nthreads ) ;
+
+	void * real = fftw_malloc( space * bytes ) ;
+	void * cre  = ( status == 2 ) ? real : fftw_malloc( csize * bytes ) ;
+	void * cim  = ( status == 4 ) ? NULL : fftw_malloc( csize * bytes ) ;
+
+	if( effort == FFTW3_AUTO )
+		_tune( real, cre, cim ) ;
+	else
+		_plan( _flags, real, cre, cim ) ;
+
+	if( cim )
+		fftw_free( cim ) ;
+	if( cre != real )
+		fftw_free( cre ) ;
+	fftw_free( real ) ;
+
+	if( !_dplan && !_splan && !_dsub[2] && !_ssub[2] )
+		throw FFTW3Error (0) ;
+
+	FFTW3_wisdom_created( IsDouble ) ;
 }
 
-void fft2d( int DimX, int DimY, bool IsForward, bool IsShift, 
-            double * in_re, double * in_im, double * out_re, double * out_im )
+/*
+	Create the plan with the planner <flags> on the planning arrays,
+	an existing plan is destroyed first. <FFTW3_planner> must be held.
+*/
+void FFTW3_FFT::_plan( unsigned flags, void * real, void * cre, void * cim )
 {
-	fftw_iodim dims [3] ;
+	fftw_iodim64 dims [3] ;
+	fftw_iodim64 batch [1] ;
 	
-	dims[1].n  = DimY ;
-	dims[1].is = DimX ;
-	dims[1].os = DimX ;
-	dims[0].n  = DimX ;
+	dims[2].n  = _DimZ ;
+	dims[2].is = (ptrdiff_t) _DimX * _DimY ;
+	dims[2].os = (ptrdiff_t) _DimX * _DimY ;
+	dims[1].n  = _DimY ;
+	dims[1].is = _DimX ;
+	dims[1].os = _DimX ;
+	dims[0].n  = _DimX ;
 	dims[0].is = 1 ;
 	dims[0].os = 1 ;
 
-	if( IsForward ) 
-	{
-		fftw_plan p = fftw_plan_guru_split_dft( 2, dims, 0, NULL, in_re, in_im, out_re, out_im, FFTW_ESTIMATE ) ;
+	/* the volumes of a batch follow one another, a complex volume counts in complex values */
+	ptrdiff_t rdist = (ptrdiff_t) _DimX * _DimY * _DimZ ;
+	ptrdiff_t cdist = ( _status >= 3 ) ? (ptrdiff_t) _FFTsize : rdist ;
+	int brank = ( _howmany > 1 ) ? 1 : 0 ;
+	batch[0].n  = _howmany ;
+	batch[0].is = _IsForward ? rdist : cdist ;
+	batch[0].os = _IsForward ? cdist : rdist ;
 
-		if( p )
-		{
-			if( IsShift )
-				shift2d( DimX, DimY, in_re, in_im, in_re, in_im ) ;
+	_destroy() ;
+	_flags = flags ;
 
-			fftw_execute_split_dft( p, in_re, in_im, out_re, out_im ) ;
+	if( _pruned )
+	{
+		_planPruned( flags, real ) ;
+		return ;
+	}
 
-			fftw_destroy_plan (p) ;
+	if( _IsDouble )
+	{
+		double * r  = (double *)real ;
+		double * re = (double *)cre ;
+		double * im = (double *)cim ;
 
-			if( IsShift && in_re != out_re && in_im != out_im )
-				shift2d( DimX, DimY, in_re, in_im, in_re, in_im ) ;
-		}
-		else
+		if( _status == 4 )
 		{
-			throw FFTW3Error( 0 ) ;		
+			if( _IsForward )
+				_dplan = fftw_plan_guru64_dft_r2c( 3, dims, brank, batch, r, (fftw_complex *)re, flags ) ;
+			else
+				_dplan = fftw_plan_guru64_dft_c2r( 3, dims, brank, batch, (fftw_complex *)re, r, flags ) ;
 		}
+		else if( _IsForward )
+			_dplan = fftw_plan_guru64_split_dft_r2c( 3, dims, brank, batch, r, re, im, flags ) ;
+		else
+			_dplan = fftw_plan_guru64_split_dft_c2r( 3, dims, brank, batch, re, im, r, flags ) ;
 	}
 	else
 	{
-		fftw_plan p = fftw_plan_guru_split_dft( 2, dims, 0, NULL, in_im, in_re, out_im, out_re, FFTW_ESTIMATE ) ;
+		float * r  = (float *)real ;
+		float * re = (float *)cre ;
+		float * im = (float *)cim ;
 
-		if( p )
+		if( _status == 4 )
 		{
-			double weight = (double) ( DimX * DimY ) ;
-
-			fftw_execute_split_dft( p, in_im, in_re, out_im, out_re ) ;
-			double * temp = out_im ;
-			out_im = out_re ;
-			out_re = temp ;
-
-			fftw_destroy_plan (p) ;
-
-			if( IsShift )
-				shift2d( DimX, DimY, out_re, out_im, out_re, out_im ) ;
-
-			for( int i = 0 ; i < DimX * DimY ; i++ )
-			{
-				out_re[i] /= weight ;
-				out_im[i] /= weight ;
-			}
+			if( _IsForward )
+				_splan = fftwf_plan_guru64_dft_r2c( 3, dims, brank, batch, r, (fftwf_complex *)re, flags ) ;
+			else
+				_splan = fftwf_plan_guru64_dft_c2r( 3, dims, brank, batch, (fftwf_complex *)re, r, flags ) ;
 		}
+		else if( _IsForward )
+			_splan = fftwf_plan_guru64_split_dft_r2c( 3, dims, brank, batch, r, re, im, flags ) ;
 		else
-			throw FFTW3Error( 0 ) ;		
+			_splan = fftwf_plan_guru64_split_dft_c2r( 3, dims, brank, batch, re, im, r, flags ) ;
 	}
 }
 
-void fft2d( int DimX, int DimY, bool IsForward, bool IsShift, 
-            float * in_re, float * in_im, float * out_re, float * out_im )
+/*
+	Pruned plans : the passes run on a spectrum <w> halved along X, of (DimX/2+1)*DimY*DimZ complex values,
+	the X and Y passes of the forward transform only run over the rows and planes holding data, 
+	and the Y and X passes of the backward transform only compute them.
+	<w> is unfolded into the <_FFTsize> spectrum halved along Z, and folded back, 
+	with the Hermitian symmetry F(kx,ky,kz) = conj F(-kx,-ky,-kz) of a real transform.
+	<FFTW3_planner> must be held.
+*/
+void FFTW3_FFT::_planPruned( unsigned flags, void * real )
 {
-	fftw_iodim dims [3] ;
-	
-	dims[1].n  = DimY ;
-	dims[1].is = DimX ;
-	dims[1].os = DimX ;
-	dims[0].n  = DimX ;
-	dims[0].is = 1 ;
-	dims[0].os = 1 ;
+	ptrdiff_t X   = _DimX ;
+	ptrdiff_t Y   = _DimY ;
+	ptrdiff_t Z   = _DimZ ;
+	ptrdiff_t Xh  = X/2 + 1 ;
+	ptrdiff_t XY  = X * Y ;
+	ptrdiff_t XhY = Xh * Y ;
+
+	/* the volumes of a batch are run one by one, with arrays not aligned as the planning ones */
+	unsigned rflags = ( _howmany > 1 ) ? ( flags | FFTW_UNALIGNED ) : flags ;
+
+	fftw_iodim64 dx [1] = { { X, 1, 1 } } ;
+	fftw_iodim64 dy [1] = { { Y, Xh, Xh } } ;
+	fftw_iodim64 dz [1] = { { Z, XhY, XhY } } ;
+	fftw_iodim64 hr2c [2] = { { _ExtY, X, Xh }, { _ExtZ, XY, XhY } } ;
+	fftw_iodim64 hc2r [2] = { { _ExtY, Xh, X }, { _ExtZ, XhY, XY } } ;
+	fftw_iodim64 hy [2] = { { Xh, 1, 1 }, { _ExtZ, XhY, XhY } } ;
+	fftw_iodim64 hz [2] = { { Xh, 1, 1 }, { Y, Xh, Xh } } ;
 
-	if( IsForward ) 
+	if( _IsDouble )
 	{
-		fftwf_plan p = fftwf_plan_guru_split_dft( 2, dims, 0, NULL, in_re, in_im, out_re, out_im, FFTW_ESTIMATE ) ;
+		double       * r = (double *)real ;
+		fftw_complex * w = (fftw_complex *)_scratch ;
 
-		if( p )
+		if( _IsForward )
 		{
-			if( IsShift )
-				shift2d( DimX, DimY, in_re, in_im, in_re, in_im ) ;
-
-			fftwf_execute_split_dft( p, in_re, in_im, out_re, out_im ) ;
-
-			fftwf_destroy_plan (p) ;
-
-			if( IsShift && in_re != out_re && in_im != out_im )
-				shift2d( DimX, DimY, in_re, in_im, in_re, in_im ) ;
+			_dsub[0] = fftw_plan_guru64_dft_r2c( 1, dx, 2, hr2c, r, w, rflags ) ;
+			_dsub[1] = fftw_plan_guru64_dft( 1, dy, 2, hy, w, w, FFTW_FORWARD, flags ) ;
+			_dsub[2] = fftw_plan_guru64_dft( 1, dz, 2, hz, w, w, FFTW_FORWARD, flags ) ;
 		}
 		else
 		{
-			throw FFTW3Error( 0 ) ;		
+			_dsub[0] = fftw_plan_guru64_dft( 1, dz, 2, hz, w, w, FFTW_BACKWARD, flags ) ;
+			_dsub[1] = fftw_plan_guru64_dft( 1, dy, 2, hy, w, w, FFTW_BACKWARD, flags ) ;
+			_dsub[2] = fftw_plan_guru64_dft_c2r( 1, dx, 2, hc2r, w, r, rflags ) ;
 		}
+
+		if( !_dsub[0] || !_dsub[1] || !_dsub[2] )
+			_destroy() ;
 	}
 	else
 	{
-		fftwf_plan p = fftwf_plan_guru_split_dft( 2, dims, 0, NULL, in_im, in_re, out_im, out_re, FFTW_ESTIMATE ) ;
+		float         * r = (float *)real ;
+		fftwf_complex * w = (fftwf_complex *)_scratch ;
 
-		if( p )
+		if( _IsForward )
+		{
+			_ssub[0] = fftwf_plan_guru64_dft_r2c( 1, dx, 2, hr2c, r, w, rflags ) ;
+			_ssub[1] = fftwf_plan_guru64_dft( 1, dy, 2, hy, w, w, FFTW_FORWARD, flags ) ;
+			_ssub[2] = fftwf_plan_guru64_dft( 1, dz, 2, hz, w, w, FFTW_FORWARD, flags ) ;
+		}
+		else
 		{
-			double weight = (double) ( DimX * DimY ) ;
+			_ssub[0] = fftwf_plan_guru64_dft( 1, dz, 2, hz, w, w, FFTW_BACKWARD, flags ) ;
+			_ssub[1] = fftwf_plan_guru64_dft( 1, dy, 2, hy, w, w, FFTW_BACKWARD, flags ) ;
+			_ssub[2] = fftwf_plan_guru64_dft_c2r( 1, dx, 2, hc2r, w, r, rflags ) ;
+		}
 
-			fftwf_execute_split_dft( p, in_im, in_re, out_im, out_re ) ;
-			float * temp = out_im ;
-			out_im = out_re ;
-			out_re = temp ;
+		if( !_ssub[0] || !_ssub[1] || !_ssub[2] )
+			_destroy() ;
+	}
+}
 
-			fftwf_destroy_plan (p) ;
 
-			if( IsShift )
-				shift2d( DimX, DimY, out_re, out_im, out_re, out_im ) ;
+/*
+	Unfolding/folding between the spectrum <w> halved along X and the spectrum <re>, <im> halved along Z;
+	the complex value n of the latter is ( re[n*step], im[n*step] ).
+*/
+template< class T >
+struct FFTW3_fold
+{
+	int  X ;
+	int  Y ;
+	int  Z ;
+	int  Zh ;
+	T  * w ;
+	T  * re ;
+	T  * im ;
+	int  step ;
+} ;
+
+
+template< class T >
+static void FFTW3_unfoldPlanes( size_t begin, size_t end, void * arg )
+{
+	FFTW3_fold<T> * f = (FFTW3_fold<T> *) arg ;
+	int X  = f->X ;
+	int Y  = f->Y ;
+	int Xh = X/2 + 1 ;
 
-			for( int i = 0 ; i < DimX * DimY ; i++ )
+	for( int kz = (int) begin ; kz < (int) end ; kz++ )
+	{
+		for( int ky = 0 ; ky < Y ; ky++ )
+		{
+			T * w  = f->w + 2 * (size_t) Xh * ( ky + (size_t) Y * kz ) ;
+			T * wc = f->w + 2 * (size_t) Xh * ( ( Y - ky ) % Y + (size_t) Y * ( ( f->Z - kz ) % f->Z ) ) ;
+			T * re = f->re + (size_t) f->step * X * ( ky + (size_t) Y * kz ) ;
+			T * im = f->im + (size_t) f->step * X * ( ky + (size_t) Y * kz ) ;
+
+			for( int kx = 0 ; kx < Xh ; kx++ )
 			{
-				out_re[i] /= weight ;
-				out_im[i] /= weight ;
+				re[ kx * f->step ] = w[ 2*kx ] ;
+				im[ kx * f->step ] = w[ 2*kx + 1 ] ;
+			}
+			for( int kx = Xh ; kx < X ; kx++ )
+			{
+				re[ kx * f->step ] =  wc[ 2*(X - kx) ] ;
+				im[ kx * f->step ] = -wc[ 2*(X - kx) + 1 ] ;
 			}
 		}
-		else
-			throw FFTW3Error( 0 ) ;		
 	}
 }
 
-void fft1d( int DimX, bool IsForward, bool IsShift, 
-            double * in_re, double * in_im, double * out_re, double * out_im )
+
+template< class T >
+static void FFTW3_foldPlanes( size_t begin, size_t end, void * arg )
 {
-	fftw_iodim dims [3] ;
-	
-	dims[0].n  = DimX ;
-	dims[0].is = 1 ;
-	dims[0].os = 1 ;
+	FFTW3_fold<T> * f = (FFTW3_fold<T> *) arg ;
+	int X  = f->X ;
+	int Y  = f->Y ;
+	int Xh = X/2 + 1 ;
 
-	if( IsForward ) 
+	for( int kz = (int) begin ; kz < (int) end ; kz++ )
 	{
-		fftw_plan p = fftw_plan_guru_split_dft( 1, dims, 0, NULL, in_re, in_im, out_re, out_im, FFTW_ESTIMATE ) ;
-
-		if( p )
+		for( int ky = 0 ; ky < Y ; ky++ )
 		{
-			if( IsShift )
-				shift1d( DimX, in_re, in_im, in_re, in_im ) ;
+			T * w = f->w + 2 * (size_t) Xh * ( ky + (size_t) Y * kz ) ;
 
-			fftw_execute_split_dft( p, in_re, in_im, out_re, out_im ) ;
+			if( kz < f->Zh )
+			{
+				T * re = f->re + (size_t) f->step * X * ( ky + (size_t) Y * kz ) ;
+				T * im = f->im + (size_t) f->step * X * ( ky + (size_t) Y * kz ) ;
 
-			fftw_destroy_plan (p) ;
+				for( int kx = 0 ; kx < Xh ; kx++ )
+				{
+					w[ 2*kx ]     = re[ kx * f->step ] ;
+					w[ 2*kx + 1 ] = im[ kx * f->step ] ;
+				}
+			}
+			else
+			{
+				T * re = f->re + (size_t) f->step * X * ( ( Y - ky ) % Y + (size_t) Y * ( f->Z - kz ) ) ;
+				T * im = f->im + (size_t) f->step * X * ( ( Y - ky ) % Y + (size_t) Y * ( f->Z - kz ) ) ;
 
-			if( IsShift && in_re != out_re && in_im != out_im )
-				shift1d( DimX, in_re, in_im, in_re, in_im ) ;
+				for( int kx = 0 ; kx < Xh ; kx++ )
+				{
+					w[ 2*kx ]     =  re[ ( ( X - kx ) % X ) * f->step ] ;
+					w[ 2*kx + 1 ] = -im[ ( ( X - kx ) % X ) * f->step ] ;
+				}
+			}
 		}
-		else
-			throw FFTW3Error( 0 ) ;		
+	}
+}
+
+
+/* zero the rows y >= ExtY of the planes z < ExtZ and the planes z >= ExtZ of a (rowsize)*Y*Z array */
+template< class T >
+static void FFTW3_zeroOutside( T * a, size_t rowsize, int Y, int Z, int ExtY, int ExtZ )
+{
+	if( ExtY < Y )
+	{
+		for( int z = 0 ; z < ExtZ ; z++ )
+			memset( a + rowsize * ( ExtY + (size_t) Y * z ), 0, rowsize * ( Y - ExtY ) * sizeof(T) ) ;
+	}
+	if( ExtZ < Z )
+		memset( a + rowsize * Y * ExtZ, 0, rowsize * Y * ( Z - ExtZ ) * sizeof(T) ) ;
+}
+
+
+static void FFTW3_execute( fftw_plan p, double * r, fftw_complex * c )        { fftw_execute_dft_r2c( p, r, c ) ; }
+static void FFTW3_execute( fftw_plan p, fftw_complex * c, double * r )        { fftw_execute_dft_c2r( p, c, r ) ; }
+static void FFTW3_execute( fftw_plan p, fftw_complex * i, fftw_complex * o )  { fftw_execute_dft( p, i, o ) ; }
+static void FFTW3_execute( fftwf_plan p, float * r, fftwf_complex * c )       { fftwf_execute_dft_r2c( p, r, c ) ; }
+static void FFTW3_execute( fftwf_plan p, fftwf_complex * c, float * r )       { fftwf_execute_dft_c2r( p, c, r ) ; }
+static void FFTW3_execute( fftwf_plan p, fftwf_complex * i, fftwf_complex * o ) { fftwf_execute_dft( p, i, o ) ; }
+
+
+template< class T, class P, class C >
+static void FFTW3_runPruned( P * sub, bool IsForward, int X, int Y, int Z, size_t FFTsize, int ExtY, int ExtZ, 
+                             T * r, T * re, T * im, int step, T * w )
+{
+	FFTW3_fold<T> f ;
+
+	f.X    = X ;
+	f.Y    = Y ;
+	f.Z    = Z ;
+	f.Zh   = (int)( FFTsize / ( (size_t) X * Y ) ) ;
+	f.w    = w ;
+	f.re   = re ;
+	f.im   = im ;
+	f.step = step ;
+
+	int Xh    = X/2 + 1 ;
+	size_t grain = 65536 / ( (size_t) X * Y ) + 1 ;
+
+	if( IsForward )
+	{
+		FFTW3_zeroOutside( w, 2 * (size_t) Xh, Y, Z, ExtY, ExtZ ) ;
+		FFTW3_execute( sub[0], r, (C *) w ) ;
+		FFTW3_execute( sub[1], (C *) w, (C *) w ) ;
+		FFTW3_execute( sub[2], (C *) w, (C *) w ) ;
+		my_parallel_for( f.Zh, grain, FFTW3_unfoldPlanes<T>, &f ) ;
 	}
 	else
 	{
-		fftw_plan p = fftw_plan_guru_split_dft( 1, dims, 0, NULL, in_im, in_re, out_im, out_re, FFTW_ESTIMATE ) ;
+		my_parallel_for( Z, grain, FFTW3_foldPlanes<T>, &f ) ;
+		FFTW3_execute( sub[0], (C *) w, (C *) w ) ;
+		FFTW3_execute( sub[1], (C *) w, (C *) w ) ;
+		FFTW3_execute( sub[2], (C *) w, r ) ;
+		FFTW3_zeroOutside( r, (size_t) X, Y, Z, ExtY, ExtZ ) ;
+	}
+}
 
-		if( p )
+
+/*
+	Run a pruned plan on the arrays of execute(), <cim> is NULL for an interleaved spectrum <cre>.
+*/
+void FFTW3_FFT::_runPruned( void * real, void * cre, void * cim )
+{
+	size_t rdist = (size_t)_DimX * _DimY * _DimZ ;
+	size_t cdist = _FFTsize * ( cim ? 1 : 2 ) ;
+	size_t bytes = _IsDouble ? sizeof(double) : sizeof(float) ;
+	int    step  = cim ? 1 : 2 ;
+
+	/* the plan scratch is used by one thread at a time, the others take their own */
+	bool   owner = ( pthread_mutex_trylock( &_scratchLock ) == 0 ) ;
+	void * w     = owner ? _scratch : fftw_malloc( 2 * (size_t)( _DimX/2 + 1 ) * _DimY * _DimZ * bytes ) ;
+
+	for( int b = 0 ; b < _howmany ; b++ )
+	{
+		if( _IsDouble )
+		{
+			double * r  = (double *)real + b * rdist ;
+			double * re = (double *)cre + b * cdist ;
+			double * im = cim ? (double *)cim + b * cdist : re + 1 ;
+			FFTW3_runPruned< double, fftw_plan, fftw_complex >( _dsub, _IsForward, _DimX, _DimY, _DimZ, _FFTsize, 
+			                                                   _ExtY, _ExtZ, r, re, im, step, (double *)w ) ;
+		}
+		else
 		{
-			double weight = (double) DimX ;
+			float * r  = (float *)real + b * rdist ;
+			float * re = (float *)cre + b * cdist ;
+			float * im = cim ? (float *)cim + b * cdist : re + 1 ;
+			FFTW3_runPruned< float, fftwf_plan, fftwf_complex >( _ssub, _IsForward, _DimX, _DimY, _DimZ, _FFTsize, 
+			                                                    _ExtY, _ExtZ, r, re, im, step, (float *)w ) ;
+		}
+	}
 
-			fftw_execute_split_dft( p, in_im, in_re, out_im, out_re ) ;
-			double * temp = out_im ;
-			out_im = out_re ;
-			out_re = temp ;
+	if( owner )
+		pthread_mutex_unlock( &_scratchLock ) ;
+	else
+		fftw_free( w ) ;
+}
 
-			fftw_destroy_plan (p) ;
+/*
+	Return the best wall time in seconds of a few executions of the plan on the planning arrays.
+*/
+double FFTW3_FFT::_time( void * real, void * cre, void * cim )
+{
+	size_t space = (size_t)_DimX * _DimY * _DimZ ;
+	size_t csize = ( _status == 3 ) ? _FFTsize : ( _status == 4 ) ? 2 * _FFTsize : space ;
+	size_t bytes = _IsDouble ? sizeof(double) : sizeof(float) ;
+	space *= _howmany ;
+	csize *= _howmany ;
+	double best = 1.0E+37 ;
 
-			if( IsShift )
-				shift1d( DimX, out_re, out_im, out_re, out_im ) ;
+	if( !_dplan && !_splan && !_dsub[2] && !_ssub[2] )
+		return best ;
 
-			for( int i = 0 ; i < DimX ; i++ )
+	for( int k = 0 ; k < 3 ; k++ )
+	{
+		/* c2r transforms destroy their input, so the input is reset every time */
+		memset( real, 0, space * bytes ) ;
+		if( cim )
+			memset( cim, 0, csize * bytes ) ;
+		if( cre != real )
+			memset( cre, 0, csize * bytes ) ;
+
+		struct timeval t0, t1 ;
+		gettimeofday( &t0, NULL ) ;
+
+		if( _pruned )
+			_runPruned( real, cre, cim ) ;
+		else if( _IsDouble )
+		{
+			if( _status == 4 )
 			{
-				out_re[i] /= weight ;
-				out_im[i] /= weight ;
+				if( _IsForward )
+					fftw_execute_dft_r2c( _dplan, (double *)real, (fftw_complex *)cre ) ;
+				else
+					fftw_execute_dft_c2r( _dplan, (fftw_complex *)cre, (double *)real ) ;
 			}
+			else if( _IsForward )
+				fftw_execute_split_dft_r2c( _dplan, (double *)real, (double *)cre, (double *)cim ) ;
+			else
+				fftw_execute_split_dft_c2r( _dplan, (double *)cre, (double *)cim, (double *)real ) ;
 		}
 		else
-			throw FFTW3Error( 0 ) ;		
+		{
+			if( _status == 4 )
+			{
+				if( _IsForward )
+					fftwf_execute_dft_r2c( _splan, (float *)real, (fftwf_complex *)cre ) ;
+				else
+					fftwf_execute_dft_c2r( _splan, (fftwf_complex *)cre, (float *)real ) ;
+			}
+			else if( _IsForward )
+				fftwf_execute_split_dft_r2c( _splan, (float *)real, (float *)cre, (float *)cim ) ;
+			else
+				fftwf_execute_split_dft_c2r( _splan, (float *)cre, (float *)cim, (float *)real ) ;
+		}
+
+		gettimeofday( &t1, NULL ) ;
+		double t = (double)( t1.tv_sec - t0.tv_sec ) + 1.0E-6 * (double)( t1.tv_usec - t0.tv_usec ) ;
+		if( t < best )
+			best = t ;
 	}
+	return best ;
 }
 
-void fft1d( int DimX, bool IsForward, bool IsShift, 
-            float * in_re, float * in_im, float * out_re, float * out_im )
+/*
+	FFTW3_AUTO: plan the size with each effort and keep the fastest plan.
+	FFTW_PATIENT planning is limited to a few times the FFTW_MEASURE planning time, 
+	so that a huge size does not stall the first run.
+	The winner is remembered, a later plan of the same size is created with it directly.
+	<FFTW3_planner> must be held.
+*/
+void FFTW3_FFT::_tune( void * real, void * cre, void * cim )
 {
-	fftw_iodim dims [3] ;
-	
-	dims[0].n  = DimX ;
-	dims[0].is = 1 ;
-	dims[0].os = 1 ;
+	FFTW3_PlanKey key( _DimX, _DimY, _DimZ, _IsForward, _IsDouble, _status, FFTW3_AUTO, _nthreads, _howmany, _ExtX, _ExtY, _ExtZ ) ;
+	std::map< FFTW3_PlanKey, unsigned >::iterator it = FFTW3_tuned.find( key ) ;
 
-	if( IsForward ) 
+	if( it != FFTW3_tuned.end() )
 	{
-		fftwf_plan p = fftwf_plan_guru_split_dft( 1, dims, 0, NULL, in_re, in_im, out_re, out_im, FFTW_ESTIMATE ) ;
+		_plan( it->second, real, cre, cim ) ;
+		return ;
+	}
+
+	struct timeval t0, t1 ;
+	unsigned best = FFTW_ESTIMATE ;
+
+	_plan( FFTW_ESTIMATE, real, cre, cim ) ;
+	double tbest = _time( real, cre, cim ) ;
 
-		if( p )
+	gettimeofday( &t0, NULL ) ;
+	_plan( FFTW_MEASURE, real, cre, cim ) ;
+	gettimeofday( &t1, NULL ) ;
+	double tplan = (double)( t1.tv_sec - t0.tv_sec ) + 1.0E-6 * (double)( t1.tv_usec - t0.tv_usec ) ;
+	double t = _time( real, cre, cim ) ;
+	if( t < tbest )
+	{
+		tbest = t ;
+		best = FFTW_MEASURE ;
+	}
+
+	double limit = 4.0 * tplan > 1.0 ? 4.0 * tplan : 1.0 ;
+	if( _IsDouble )
+		fftw_set_timelimit( limit ) ;
+	else
+		fftwf_set_timelimit( limit ) ;
+
+	_plan( FFTW_PATIENT, real, cre, cim ) ;
+
+	if( _IsDouble )
+		fftw_set_timelimit( FFTW_NO_TIMELIMIT ) ;
+	else
+		fftwf_set_timelimit( FFTW_NO_TIMELIMIT ) ;
+
+	t = _time( real, cre, cim ) ;
+	if( t < tbest )
+	{
+		tbest = t ;
+		best = FFTW_PATIENT ;
+	}
+
+	/* the wisdom accumulated above makes re-planning the winner cheap */
+	if( best != FFTW_PATIENT )
+		_plan( best, real, cre, cim ) ;
+
+	FFTW3_tuned[ key ] = best ;
+}
+
+void FFTW3_FFT::execute( double * buf1, double * buf2, double * buf3 )
+{
+	if( _status == 4 )
+		throw FFTW3Error( -4 ) ;
+
+	if( _IsDouble )
+	{
+		if( _pruned )
 		{
-			if( IsShift )
-				shift1d( DimX, in_re, in_im, in_re, in_im ) ;
+			if( _IsForward )
+				_runPruned( buf1, buf2, buf3 ) ;
+			else
+				_runPruned( buf3, buf1, buf2 ) ;
+		}
+		else if( _IsForward )
+			fftw_execute_split_dft_r2c( _dplan, buf1, buf2, buf3 ) ;
+		else
+			fftw_execute_split_dft_c2r( _dplan, buf1, buf2, buf3 ) ;
 
-			fftwf_execute_split_dft( p, in_re, in_im, out_re, out_im ) ;
+		if( !_IsForward )
+		{
+			size_t n = (size_t) _howmany * _DimX * _DimY * _DimZ ;
+			for( size_t i = 0 ; i < n ; i++ )
+				buf3[i] /= _weight ;
+		}
+	}
+	else
+		throw FFTW3Error( -2, _IsForward ) ;
+}
 
-			fftwf_destroy_plan (p) ;
+void FFTW3_FFT::execute( float * buf1, float * buf2, float * buf3 )
+{
+	if( _status == 4 )
+		throw FFTW3Error( -4 ) ;
 
-			if( IsShift && in_re != out_re && in_im != out_im )
-				shift1d( DimX, in_re, in_im, in_re, in_im ) ;
+	if( !_IsDouble )
+	{
+		if( _pruned )
+		{
+			if( _IsForward )
+				_runPruned( buf1, buf2, buf3 ) ;
+			else
+				_runPruned( buf3, buf1, buf2 ) ;
 		}
+		else if( _IsForward )
+			fftwf_execute_split_dft_r2c( _splan, buf1, buf2, buf3 ) ;
 		else
-			throw FFTW3Error( 0 ) ;		
+			fftwf_execute_split_dft_c2r( _splan, buf1, buf2, buf3 ) ;
+
+		if( !_IsForward )
+		{
+			size_t n = (size_t) _howmany * _DimX * _DimY * _DimZ ;
+			for( size_t i = 0 ; i < n ; i++ )
+				buf3[i] /= _weight ;
+		}
 	}
 	else
+		throw FFTW3Error( -3, _IsForward ) ;
+}
+
+void FFTW3_FFT::execute( double * real, fftw_complex * spec )
+{
+	if( _status != 4 || !_IsForward )
+		throw FFTW3Error( -4 ) ;
+	if( !_IsDouble )
+		throw FFTW3Error( -3, _IsForward ) ;
+
+	if( _pruned )
+		_runPruned( real, spec, NULL ) ;
+	else
+		fftw_execute_dft_r2c( _dplan, real, spec ) ;
+}
+
+void FFTW3_FFT::execute( float * real, fftwf_complex * spec )
+{
+	if( _status != 4 || !_IsForward )
+		throw FFTW3Error( -4 ) ;
+	if( _IsDouble )
+		throw FFTW3Error( -2, _IsForward ) ;
+
+	if( _pruned )
+		_runPruned( real, spec, NULL ) ;
+	else
+		fftwf_execute_dft_r2c( _splan, real, spec ) ;
+}
+
+void FFTW3_FFT::execute( fftw_complex * spec, double * real )
+{
+	if( _status != 4 || _IsForward )
+		throw FFTW3Error( -4 ) ;
+	if( !_IsDouble )
+		throw FFTW3Error( -3, _IsForward ) ;
+
+	if( _pruned )
+		_runPruned( real, spec, NULL ) ;
+	else
+		fftw_execute_dft_c2r( _dplan, spec, real ) ;
+
+	size_t n = (size_t) _howmany * _DimX * _DimY * _DimZ ;
+	for( size_t i = 0 ; i < n ; i++ )
+		real[i] /= _weight ;
+}
+
+void FFTW3_FFT::execute( fftwf_complex * spec, float * real )
+{
+	if( _status != 4 || _IsForward )
+		throw FFTW3Error( -4 ) ;
+	if( _IsDouble )
+		throw FFTW3Error( -2, _IsForward ) ;
+
+	if( _pruned )
+		_runPruned( real, spec, NULL ) ;
+	else
+		fftwf_execute_dft_c2r( _splan, spec, real ) ;
+
+	size_t n = (size_t) _howmany * _DimX * _DimY * _DimZ ;
+	for( size_t i = 0 ; i < n ; i++ )
+		real[i] /= _weight ;
+}
+
+void FFTW3_FFT::forward( double * real, double * re, double * im )
+{
+	if( _status == 4 )
+		execute( real, (fftw_complex *) re ) ;
+	else
+		execute( real, re, im ) ;
+}
+
+void FFTW3_FFT::forward( float * real, float * re, float * im )
+{
+	if( _status == 4 )
+		execute( real, (fftwf_complex *) re ) ;
+	else
+		execute( real, re, im ) ;
+}
+
+void FFTW3_FFT::backward( double * re, double * im, double * real )
+{
+	if( _status == 4 )
+		execute( (fftw_complex *) re, real ) ;
+	else
+		execute( re, im, real ) ;
+}
+
+void FFTW3_FFT::backward( float * re, float * im, float * real )
+{
+	if( _status == 4 )
+		execute( (fftwf_complex *) re, real ) ;
+	else
+		execute( re, im, real ) ;
+}
+
+bool FFTW3_PlanKey::operator<( const FFTW3_PlanKey & k ) const
+{
+	if( DimX != k.DimX )           return DimX < k.DimX ;
+	if( DimY != k.DimY )           return DimY < k.DimY ;
+	if( DimZ != k.DimZ )           return DimZ < k.DimZ ;
+	if( IsForward != k.IsForward ) return IsForward < k.IsForward ;
+	if( IsDouble != k.IsDouble )   return IsDouble < k.IsDouble ;
+	if( status != k.status )       return status < k.status ;
+	if( effort != k.effort )       return effort < k.effort ;
+	if( nthreads != k.nthreads )   return nthreads < k.nthreads ;
+	if( howmany != k.howmany )     return howmany < k.howmany ;
+	if( ExtX != k.ExtX )           return ExtX < k.ExtX ;
+	if( ExtY != k.ExtY )           return ExtY < k.ExtY ;
+	return ExtZ < k.ExtZ ;
+}
+
+
+FFTW3_PlanCache::PlanMap  FFTW3_PlanCache::_plans ;
+pthread_mutex_t           FFTW3_PlanCache::_lock = PTHREAD_MUTEX_INITIALIZER ;
+
+
+FFTW3_FFT * FFTW3_PlanCache::acquire( int DimX, int DimY, int DimZ, bool IsForward, bool IsDouble, int status, 
+                                      FFTW3_Effort effort, int nthreads, int howmany, int ExtX, int ExtY, int ExtZ )
+{
+	FFTW3_Lock lock( &_lock ) ;
+
+	if( nthreads < 1 )
+		nthreads = 1 ;
+	if( howmany < 1 )
+		howmany = 1 ;
+	ExtX = FFTW3_extent( ExtX, DimX ) ;
+	ExtY = FFTW3_extent( ExtY, DimY ) ;
+	ExtZ = FFTW3_extent( ExtZ, DimZ ) ;
+
+	FFTW3_PlanKey key( DimX, DimY, DimZ, IsForward, IsDouble, status, effort, nthreads, howmany, ExtX, ExtY, ExtZ ) ;
+	PlanMap::iterator it = _plans.find( key ) ;
+
+	if( it == _plans.end() )
 	{
-		fftwf_plan p = fftwf_plan_guru_split_dft( 1, dims, 0, NULL, in_im, in_re, out_im, out_re, FFTW_ESTIMATE ) ;
+		FFTW3_FFT * plan = new FFTW3_FFT( DimX, DimY, DimZ, IsForward, IsDouble, status, effort, nthreads, howmany, 
+		                                  ExtX, ExtY, ExtZ ) ;
+		it = _plans.insert( std::make_pair( key, std::make_pair( plan, 0 ) ) ).first ;
+	}
+
+	it->second.second++ ;
+	return it->second.first ;
+}
+
+void FFTW3_PlanCache::release( FFTW3_FFT * plan )
+{
+	if( plan == NULL )
+		return ;
+
+	FFTW3_Lock lock( &_lock ) ;
+
+	FFTW3_PlanKey key( plan->DimX(), plan->DimY(), plan->DimZ(), plan->IsForward(), plan->IsDouble(), 
+	                   plan->status(), plan->effort(), plan->nthreads(), plan->howmany(), 
+	                   plan->ExtX(), plan->ExtY(), plan->ExtZ() ) ;
+	PlanMap::iterator it = _plans.find( key ) ;
 
-		if( p )
+	if( it != _plans.end() && it->second.first == plan && it->second.second > 0 )
+		it->second.second-- ;
+}
+
+void FFTW3_PlanCache::clear()
+{
+	FFTW3_Lock lock( &_lock ) ;
+
+	PlanMap::iterator it = _plans.begin() ;
+	while( it != _plans.end() )
+	{
+		if( it->second.second == 0 )
 		{
-			double weight = (double) DimX ;
+			delete it->second.first ;
+			_plans.erase( it++ ) ;
+		}
+		else
+			++it ;
+	}
+}
 
-			fftwf_execute_split_dft( p, in_im, in_re, out_im, out_re ) ;
-			float * temp = out_im ;
-			out_im = out_re ;
-			out_re = temp ;
+int FFTW3_PlanCache::size()
+{
+	FFTW3_Lock lock( &_lock ) ;
+	return (int)_plans.size() ;
+}
 
-			fftwf_destroy_plan (p) ;
+/*
+	The overlap pattern of split arrays : bit 0 is set if the real parts are in-place,
+	bit 1 is set if the imaginary parts are in-place.
+*/
+static int FFTW3_overlap( void * ri, void * ii, void * ro, void * io )
+{
+	return ( ri == ro ? 1 : 0 ) | ( ii != NULL && ii == io ? 2 : 0 ) ;
+}
 
-			if( IsShift )
-				shift1d( DimX, out_re, out_im, out_re, out_im ) ;
+static bool FFTW3_aligned( double * a, double * b, double * c, double * d = NULL )
+{
+	return fftw_alignment_of( a ) == 0 && fftw_alignment_of( b ) == 0 && fftw_alignment_of( c ) == 0 &&
+	       ( d == NULL || fftw_alignment_of( d ) == 0 ) ;
+}
 
-			for( int i = 0 ; i < DimX ; i++ )
-			{
-				out_re[i] /= weight ;
-				out_im[i] /= weight ;
-			}
+static bool FFTW3_aligned( float * a, float * b, float * c, float * d = NULL )
+{
+	return fftwf_alignment_of( a ) == 0 && fftwf_alignment_of( b ) == 0 && fftwf_alignment_of( c ) == 0 &&
+	       ( d == NULL || fftwf_alignment_of( d ) == 0 ) ;
+}
+
+
+FFTW3_Transform::~FFTW3_Transform()
+{
+	FFTW3_Lock lock( &FFTW3_planner ) ;
+
+	if( _dplan )
+		fftw_destroy_plan( _dplan ) ;
+
+	if( _splan )
+		fftwf_destroy_plan( _splan ) ;
+}
+
+FFTW3_Transform::FFTW3_Transform( int rank, int DimX, int DimY, int DimZ, bool IsReal, bool IsDouble,
+                                  int overlap, bool IsAligned, int nthreads )
+{
+	_rank      = rank < 1 ? 1 : rank > 3 ? 3 : rank ;
+	_DimX      = DimX ;
+	_DimY      = _rank > 1 ? DimY : 1 ;
+	_DimZ      = _rank > 2 ? DimZ : 1 ;
+	_IsReal    = IsReal ;
+	_IsDouble  = IsDouble ;
+	_overlap   = IsReal ? ( overlap & 1 ) : ( overlap & 3 ) ;
+	_IsAligned = IsAligned ;
+	_nthreads  = nthreads < 1 ? get_my_threads() : nthreads ;
+	_dplan     = NULL ;
+	_splan     = NULL ;
+
+	fftw_iodim64 dims [3] ;
+
+	dims[2].n  = _DimZ ;
+	dims[2].is = (ptrdiff_t) _DimX * _DimY ;
+	dims[2].os = (ptrdiff_t) _DimX * _DimY ;
+	dims[1].n  = _DimY ;
+	dims[1].is = _DimX ;
+	dims[1].os = _DimX ;
+	dims[0].n  = _DimX ;
+	dims[0].is = 1 ;
+	dims[0].os = 1 ;
+
+	/* FFTW_ESTIMATE never touches the arrays, they only tell the planner the overlap and the alignment */
+	unsigned flags = FFTW_ESTIMATE | ( _IsAligned ? 0 : FFTW_UNALIGNED ) ;
+	size_t   bytes = (size_t) _DimX * _DimY * _DimZ * ( _IsDouble ? sizeof(double) : sizeof(float) ) ;
+	void   * ri    = fftw_malloc( bytes ) ;
+	void   * ii    = fftw_malloc( bytes ) ;
+	void   * ro    = _overlap & 1 ? ri : fftw_malloc( bytes ) ;
+	void   * io    = _overlap & 2 ? ii : fftw_malloc( bytes ) ;
+
+	{
+		FFTW3_Lock lock( &FFTW3_planner ) ;
+
+		FFTW3_setThreads( _IsDouble, _nthreads ) ;
+
+		if( _IsDouble )
+		{
+			if( _IsReal )
+				_dplan = fftw_plan_guru64_split_dft_r2c( _rank, dims, 0, NULL, (double *)ri, (double *)ro, (double *)io, flags ) ;
+			else
+				_dplan = fftw_plan_guru64_split_dft( _rank, dims, 0, NULL, (double *)ri, (double *)ii, (double *)ro, (double *)io, flags ) ;
 		}
 		else
-			throw FFTW3Error( 0 ) ;		
+		{
+			if( _IsReal )
+				_splan = fftwf_plan_guru64_split_dft_r2c( _rank, dims, 0, NULL, (float *)ri, (float *)ro, (float *)io, flags ) ;
+			else
+				_splan = fftwf_plan_guru64_split_dft( _rank, dims, 0, NULL, (float *)ri, (float *)ii, (float *)ro, (float *)io, flags ) ;
+		}
+	}
+
+	if( io != ii ) fftw_free( io ) ;
+	if( ro != ri ) fftw_free( ro ) ;
+	fftw_free( ii ) ;
+	fftw_free( ri ) ;
+
+	if( !_dplan && !_splan )
+		throw FFTW3Error( 0 ) ;
+}
+
+void FFTW3_Transform::execute( double * in, double * out_re, double * out_im )
+{
+	if( !_IsReal || FFTW3_overlap( in, NULL, out_re, out_im ) != _overlap || ( _IsAligned && !FFTW3_aligned( in, out_re, out_im ) ) )
+		throw FFTW3Error( -5 ) ;
+	if( !_IsDouble )
+		throw FFTW3Error( -3 ) ;
+
+	fftw_execute_split_dft_r2c( _dplan, in, out_re, out_im ) ;
+}
+
+void FFTW3_Transform::execute( float * in, float * out_re, float * out_im )
+{
+	if( !_IsReal || FFTW3_overlap( in, NULL, out_re, out_im ) != _overlap || ( _IsAligned && !FFTW3_aligned( in, out_re, out_im ) ) )
+		throw FFTW3Error( -5 ) ;
+	if( _IsDouble )
+		throw FFTW3Error( -2 ) ;
+
+	fftwf_execute_split_dft_r2c( _splan, in, out_re, out_im ) ;
+}
+
+void FFTW3_Transform::execute( double * in_re, double * in_im, double * out_re, double * out_im )
+{
+	if( _IsReal || FFTW3_overlap( in_re, in_im, out_re, out_im ) != _overlap ||
+	    ( _IsAligned && !FFTW3_aligned( in_re, in_im, out_re, out_im ) ) )
+		throw FFTW3Error( -5 ) ;
+	if( !_IsDouble )
+		throw FFTW3Error( -3 ) ;
+
+	fftw_execute_split_dft( _dplan, in_re, in_im, out_re, out_im ) ;
+}
+
+void FFTW3_Transform::execute( float * in_re, float * in_im, float * out_re, float * out_im )
+{
+	if( _IsReal || FFTW3_overlap( in_re, in_im, out_re, out_im ) != _overlap ||
+	    ( _IsAligned && !FFTW3_aligned( in_re, in_im, out_re, out_im ) ) )
+		throw FFTW3Error( -5 ) ;
+	if( _IsDouble )
+		throw FFTW3Error( -2 ) ;
+
+	fftwf_execute_split_dft( _splan, in_re, in_im, out_re, out_im ) ;
+}
+
+bool FFTW3_TransformKey::operator<( const FFTW3_TransformKey & k ) const
+{
+	if( rank != k.rank )           return rank < k.rank ;
+	if( DimX != k.DimX )           return DimX < k.DimX ;
+	if( DimY != k.DimY )           return DimY < k.DimY ;
+	if( DimZ != k.DimZ )           return DimZ < k.DimZ ;
+	if( IsReal != k.IsReal )       return IsReal < k.IsReal ;
+	if( IsDouble != k.IsDouble )   return IsDouble < k.IsDouble ;
+	if( overlap != k.overlap )     return overlap < k.overlap ;
+	if( IsAligned != k.IsAligned ) return IsAligned < k.IsAligned ;
+	return nthreads < k.nthreads ;
+}
+
+
+FFTW3_TransformCache::TransformMap  FFTW3_TransformCache::_transforms ;
+pthread_mutex_t                     FFTW3_TransformCache::_lock = PTHREAD_MUTEX_INITIALIZER ;
+
+
+FFTW3_Transform * FFTW3_TransformCache::acquire( int rank, int DimX, int DimY, int DimZ, bool IsReal, bool IsDouble,
+                                                 int overlap, bool IsAligned, int nthreads )
+{
+	FFTW3_Lock lock( &_lock ) ;
+
+	if( nthreads < 1 )
+		nthreads = get_my_threads() ;
+
+	FFTW3_TransformKey key( rank, DimX, rank > 1 ? DimY : 1, rank > 2 ? DimZ : 1, IsReal, IsDouble,
+	                        IsReal ? ( overlap & 1 ) : ( overlap & 3 ), IsAligned, nthreads ) ;
+	TransformMap::iterator it = _transforms.find( key ) ;
+
+	if( it == _transforms.end() )
+	{
+		FFTW3_Transform * plan = new FFTW3_Transform( rank, DimX, DimY, DimZ, IsReal, IsDouble, overlap, IsAligned, nthreads ) ;
+		it = _transforms.insert( std::make_pair( key, std::make_pair( plan, 0 ) ) ).first ;
+	}
+
+	it->second.second++ ;
+	return it->second.first ;
+}
+
+void FFTW3_TransformCache::release( FFTW3_Transform * plan )
+{
+	if( plan == NULL )
+		return ;
+
+	FFTW3_Lock lock( &_lock ) ;
+
+	FFTW3_TransformKey key( plan->rank(), plan->DimX(), plan->DimY(), plan->DimZ(), plan->IsReal(), plan->IsDouble(),
+	                        plan->overlap(), plan->IsAligned(), plan->nthreads() ) ;
+	TransformMap::iterator it = _transforms.find( key ) ;
+
+	if( it != _transforms.end() && it->second.first == plan && it->second.second > 0 )
+		it->second.second-- ;
+}
+
+void FFTW3_TransformCache::clear()
+{
+	FFTW3_Lock lock( &_lock ) ;
+
+	TransformMap::iterator it = _transforms.begin() ;
+	while( it != _transforms.end() )
+	{
+		if( it->second.second == 0 )
+		{
+			delete it->second.first ;
+			_transforms.erase( it++ ) ;
+		}
+		else
+			++it ;
+	}
+}
+
+int FFTW3_TransformCache::size()
+{
+	FFTW3_Lock lock( &_lock ) ;
+	return (int)_transforms.size() ;
+}
+
+/*
+	Holds a transform of FFTW3_TransformCache for the duration of a one-shot transform below.
+*/
+class FFTW3_TransformHold
+{
+	public:
+	FFTW3_TransformHold( FFTW3_Transform * plan ) : _plan( plan ) {}
+	~FFTW3_TransformHold() { FFTW3_TransformCache::release( _plan ) ; }
+
+	FFTW3_Transform & operator*() { return *_plan ; }
+
+	private:
+	FFTW3_Transform * _plan ;
+} ;
+
+
+static void FFTW3_shift( int rank, int DimX, int DimY, int DimZ, double * re, double * im )
+{
+	if( rank == 3 )      shift3d( DimX, DimY, DimZ, re, im, re, im ) ;
+	else if( rank == 2 ) shift2d( DimX, DimY, re, im, re, im ) ;
+	else                 shift1d( DimX, re, im, re, im ) ;
+}
+
+static void FFTW3_shift( int rank, int DimX, int DimY, int DimZ, float * re, float * im )
+{
+	if( rank == 3 )      shift3d( DimX, DimY, DimZ, re, im, re, im ) ;
+	else if( rank == 2 ) shift2d( DimX, DimY, re, im, re, im ) ;
+	else                 shift1d( DimX, re, im, re, im ) ;
+}
+
+/*
+	A complex transform with a plan handle, the backward transform runs the forward plan
+	with the real and imaginary parts swapped.
+*/
+template< class T >
+static void FFTW3_c2c( FFTW3_Transform & plan, int rank, bool IsForward, bool IsShift,
+                       T * in_re, T * in_im, T * out_re, T * out_im )
+{
+	if( plan.rank() != rank || plan.IsReal() )
+		throw FFTW3Error( -5 ) ;
+
+	int DimX = plan.DimX() ;
+	int DimY = plan.DimY() ;
+	int DimZ = plan.DimZ() ;
+
+	if( IsForward )
+	{
+		if( IsShift )
+			FFTW3_shift( rank, DimX, DimY, DimZ, in_re, in_im ) ;
+
+		plan.execute( in_re, in_im, out_re, out_im ) ;
+
+		if( IsShift && in_re != out_re && in_im != out_im )
+			FFTW3_shift( rank, DimX, DimY, DimZ, in_re, in_im ) ;
+	}
+	else
+	{
+		double weight = (double) DimX * DimY * DimZ ;
+		size_t n      = (size_t) DimX * DimY * DimZ ;
+
+		plan.execute( in_im, in_re, out_im, out_re ) ;
+
+		if( IsShift )
+			FFTW3_shift( rank, DimX, DimY, DimZ, out_re, out_im ) ;
+
+		for( size_t i = 0 ; i < n ; i++ )
+		{
+			out_re[i] /= weight ;
+			out_im[i] /= weight ;
+		}
 	}
+}
+
+/*
+	The one-shot complex transforms take their plan from FFTW3_TransformCache.
+*/
+template< class T >
+static void FFTW3_c2c( int rank, int DimX, int DimY, int DimZ, bool IsForward, bool IsShift,
+                       T * in_re, T * in_im, T * out_re, T * out_im, bool IsDouble )
+{
+	int overlap = IsForward ? FFTW3_overlap( in_re, in_im, out_re, out_im )
+	                        : FFTW3_overlap( in_im, in_re, out_im, out_re ) ;
+
+	FFTW3_TransformHold plan( FFTW3_TransformCache::acquire( rank, DimX, DimY, DimZ, false, IsDouble, overlap,
+	                                                         FFTW3_aligned( in_re, in_im, out_re, out_im ) ) ) ;
+
+	FFTW3_c2c( *plan, rank, IsForward, IsShift, in_re, in_im, out_re, out_im ) ;
+}
+
+void fft3d( int DimX, int DimY, int DimZ, double * in, double * out_re, double * out_im )
+{
+	FFTW3_TransformHold plan( FFTW3_TransformCache::acquire( 3, DimX, DimY, DimZ, true, true,
+	                                                         FFTW3_overlap( in, NULL, out_re, out_im ),
+	                                                         FFTW3_aligned( in, out_re, out_im ) ) ) ;
+	(*plan).execute( in, out_re, out_im ) ;
+}
+
+void fft3d( int DimX, int DimY, int DimZ, float * in, float * out_re, float * out_im )
+{
+	FFTW3_TransformHold plan( FFTW3_TransformCache::acquire( 3, DimX, DimY, DimZ, true, false,
+	                                                         FFTW3_overlap( in, NULL, out_re, out_im ),
+	                                                         FFTW3_aligned( in, out_re, out_im ) ) ) ;
+	(*plan).execute( in, out_re, out_im ) ;
+}
+
+void fft3d( FFTW3_Transform & plan, double * in, double * out_re, double * out_im )
+{
+	if( plan.rank() != 3 || !plan.IsReal() )
+		throw FFTW3Error( -5 ) ;
+
+	plan.execute( in, out_re, out_im ) ;
+}
+
+void fft3d( FFTW3_Transform & plan, float * in, float * out_re, float * out_im )
+{
+	if( plan.rank() != 3 || !plan.IsReal() )
+		throw FFTW3Error( -5 ) ;
+
+	plan.execute( in, out_re, out_im ) ;
+}
+
+void fft3d( int DimX, int DimY, int DimZ, bool IsForward, bool IsShift,
+            double * in_re, double * in_im, double * out_re, double * out_im )
+{
+	FFTW3_c2c( 3, DimX, DimY, DimZ, IsForward, IsShift, in_re, in_im, out_re, out_im, true ) ;
+}
+
+void fft3d( int DimX, int DimY, int DimZ, bool IsForward, bool IsShift,
+            float * in_re, float * in_im, float * out_re, float * out_im )
+{
+	FFTW3_c2c( 3, DimX, DimY, DimZ, IsForward, IsShift, in_re, in_im, out_re, out_im, false ) ;
+}
+
+void fft2d( int DimX, int DimY, bool IsForward, bool IsShift,
+            double * in_re, double * in_im, double * out_re, double * out_im )
+{
+	FFTW3_c2c( 2, DimX, DimY, 1, IsForward, IsShift, in_re, in_im, out_re, out_im, true ) ;
+}
+
+void fft2d( int DimX, int DimY, bool IsForward, bool IsShift,
+            float * in_re, float * in_im, float * out_re, float * out_im )
+{
+	FFTW3_c2c( 2, DimX, DimY, 1, IsForward, IsShift, in_re, in_im, out_re, out_im, false ) ;
+}
+
+void fft1d( int DimX, bool IsForward, bool IsShift,
+            double * in_re, double * in_im, double * out_re, double * out_im )
+{
+	FFTW3_c2c( 1, DimX, 1, 1, IsForward, IsShift, in_re, in_im, out_re, out_im, true ) ;
+}
+
+void fft1d( int DimX, bool IsForward, bool IsShift,
+            float * in_re, float * in_im, float * out_re, float * out_im )
+{
+	FFTW3_c2c( 1, DimX, 1, 1, IsForward, IsShift, in_re, in_im, out_re, out_im, false ) ;
+}
+
+void fft3d( FFTW3_Transform & plan, bool IsForward, bool IsShift,
+            double * in_re, double * in_im, double * out_re, double * out_im )
+{
+	FFTW3_c2c( plan, 3, IsForward, IsShift, in_re, in_im, out_re, out_im ) ;
+}
+
+void fft3d( FFTW3_Transform & plan, bool IsForward, bool IsShift,
+            float * in_re, float * in_im, float * out_re, float * out_im )
+{
+	FFTW3_c2c( plan, 3, IsForward, IsShift, in_re, in_im, out_re, out_im ) ;
+}
+
+void fft2d( FFTW3_Transform & plan, bool IsForward, bool IsShift,
+            double * in_re, double * in_im, double * out_re, double * out_im )
+{
+	FFTW3_c2c( plan, 2, IsForward, IsShift, in_re, in_im, out_re, out_im ) ;
+}
+
+void fft2d( FFTW3_Transform & plan, bool IsForward, bool IsShift,
+            float * in_re, float * in_im, float * out_re, float * out_im )
+{
+	FFTW3_c2c( plan, 2, IsForward, IsShift, in_re, in_im, out_re, out_im ) ;
+}
+
+void fft1d( FFTW3_Transform & plan, bool IsForward, bool IsShift,
+            double * in_re, double * in_im, double * out_re, double * out_im )
+{
+	FFTW3_c2c( plan, 1, IsForward, IsShift, in_re, in_im, out_re, out_im ) ;
+}
+
+void fft1d( FFTW3_Transform & plan, bool IsForward, bool IsShift,
+            float * in_re, float * in_im, float * out_re, float * out_im )
+{
+	FFTW3_c2c( plan, 1, IsForward, IsShift, in_re, in_im, out_re, out_im ) ;
 }
\ No newline at end of file
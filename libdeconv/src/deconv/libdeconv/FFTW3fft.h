@@ -23,10 +23,30 @@
 #define FFTW3FFT_H
 
 
+#include <map>
+#include <string>
+#include <pthread.h>
 #include <fftw3.h>
 
 
-#define FFTW3_FLAG FFTW_MEASURE
+/*
+	Planner effort of a FFTW3_FFT plan.
+	FFTW3_ESTIMATE, FFTW3_MEASURE and FFTW3_PATIENT select FFTW_ESTIMATE, FFTW_MEASURE and FFTW_PATIENT.
+	FFTW3_AUTO plans a size with each of them the first time it is seen, times the plans 
+	and keeps the fastest one; the winner is remembered for the rest of the process.
+	FFTW3_MEASURE is the default used by the deconvolvers.
+*/
+enum FFTW3_Effort
+{
+	FFTW3_ESTIMATE = 0,
+	FFTW3_MEASURE  = 1,
+	FFTW3_PATIENT  = 2,
+	FFTW3_AUTO     = 3
+} ;
+
+unsigned     FFTW3_flags( FFTW3_Effort effort ) ;
+
+const char * FFTW3_effortName( FFTW3_Effort effort ) ;
 
 
 /* 
@@ -35,29 +55,74 @@
 	and is dedicated for 3-D deconvolution algorithms.
 
 	Use it in 2 steps :
-	- step 1 : create  a plan -> FFTW3_FFT::Ptr plan( new FFTW3_FFT( DimX, DimY, DimZ, IsForward, IsDouble, status )
+	- step 1 : create  a plan -> FFTW3_FFT::Ptr plan( new FFTW3_FFT( DimX, DimY, DimZ, IsForward, IsDouble, status, effort, nthreads, howmany )
 	- step 2 : execute a plan -> p->execute( buf1, buf2, buf3 )
 
 	<DimX> is the fastest varying dimension of a transform.
 	<DimZ> are the slowest varying dimension of a transform.
 	<_FFTsize> = DimX*DimY*(DimZ/2+1) if <DimZ> is even.
 	<_FFTsize> = DimX*DimY*(DimZ+1)/2 if <DimZ> is odd.
+	FFTW3_FFT::FFTsize( DimX, DimY, DimZ ) returns it without creating a plan.
+	The sizes and the strides are passed to the FFTW3 guru64 interface, so a volume 
+	may have more than 2^31 values; each of its dimensions must fit an int.
 
 	<IsDouble> indicates whether the floating type of the transformed data is double or single.
 
+	<effort> is the planner effort (see FFTW3_Effort above) and its default is FFTW3_MEASURE.
+
+	<nthreads> is the number of threads executing the plan and its default is 1;
+	it has effect only if the library is built with the FFTW3 threads libraries (HAVE_FFTW3_THREADS).
+	flags() returns the FFTW3 planner flags the plan was finally created with, 
+	which is the fastest candidate if <effort> is FFTW3_AUTO.
+
+	<howmany> is the number of volumes transformed by one execute() and its default is 1.
+	A batched plan transforms <howmany> volumes of the same size stored one after another in each array :
+	a real volume takes DimX*DimY*DimZ values and a complex volume takes as many values as 
+	one array of the chosen <status> below, so each array described below is <howmany> times longer.
+	One batched transform reuses the caches and the threads better than <howmany> separate ones.
+
+	<ExtX>, <ExtY>, <ExtZ> are the nonzero extent of the real volumes, their default 0 takes the whole dimension.
+	If <ExtY> < DimY or <ExtZ> < DimZ, e.g. for a stack padded with zero planes, a status 3 or 4 plan is pruned :
+	the real data is taken as zero outside x < ExtX, y < ExtY, z < ExtZ, the forward transform only runs 
+	the X and Y passes over the populated rows and planes, and the backward transform only computes 
+	the rows y < ExtY, z < ExtZ of its output and sets the other rows to zero. The spectrum has the 
+	same layout as the one of an unpruned plan. The X passes always run over whole rows, so <ExtX> alone 
+	does not prune a plan. A pruned plan keeps a scratch spectrum of (DimX/2+1)*DimY*DimZ complex values, 
+	threads executing it at the same time allocate their own ones.
+
 	<IsForward> = true : r2c transform plan, under this case
 	<buf1> is input real, <buf2> is output real and <buf3> is output imaginary.
 	<status> = 1 : <buf1> must be different than <buf2> and <buf3>, all arrays have the same size of DimX*DimY*DimZ. 
 	<status> = 2 : real arrays overlap, buf1 and <buf2> must be same, all arrays have the same size of DimX*DimY*DimZ.
 	<status> = 3 : <buf1> has the size of DimX*DimY*DimZ, <buf2> and <buf3> have the same size of _FFTsize.
+	<status> = 4 : interleaved spectrum, use execute( real, spec ) where <real> is input real of DimX*DimY*DimZ 
+	               and <spec> is output complex of <_FFTsize>, i.e. 2*<_FFTsize> values stored as (re, im) pairs.
   
 	<IsForward> = false: c2r transform plan, under this case 
 	<buf1> is input real and <buf2> is input imaginary, <buf3> is output real.
 	<status> = 1 : <buf3> must be different than <buf1> and <buf2>, all arrays have the same size of DimX*DimY*DimZ 
 	<status> = 2 : real arrays overlap, <buf3> and <buf1> must be same, all arrays have the same size of DimX*DimY*DimZ.
 	<status> = 3 : <buf3> has the size of DimX*DimY*DimZ, <buf1> and <buf2> have the same size of <_FFTsize>.
+	<status> = 4 : interleaved spectrum, use execute( spec, real ) where <spec> is input complex of <_FFTsize>
+	               and <real> is output real of DimX*DimY*DimZ; <spec> is destroyed.
+
+	The interleaved layout (status 4) touches one complex stream instead of the two split streams,
+	FFTW runs faster on it and the pointwise kernels on the spectrum read half as many arrays
+	(see "SPECTRALkernels.h"). A status 1-3 plan can only be executed with three arrays
+	and a status 4 plan only with a real and a complex array.
+
+	forward() and backward() run a forward or backward status 3 or 4 plan on a spectrum given as 
+	two arrays <re> and <im>, so that a same code serves both layouts : they run execute( real, re, im ) 
+	or execute( re, im, real ) for a status 3 plan, and execute() on <re> as the interleaved spectrum 
+	for a status 4 plan, <im> being then ignored (see the <S> = 2 layout of "SPECTRALkernels.h").
 	
 	All date arrays must be one-dimensional and data is stored as "x + y*DimX + z*DimY*DimX".
+	They should be allocated by fftw_malloc() or new[] so that they have the same alignment as 
+	the arrays the plan was created with.
+
+	The plan is created with the arrays allocated temporarily, which are released once planning is done.
+	Creation and destruction of a plan are serialized by the global FFTW3 planner lock, 
+	while execute() is reentrant and a same plan can be shared by several threads.
 	
 	Throw: throw an error if fail.
 */
@@ -67,37 +132,299 @@ class FFTW3_FFT
 
 	~FFTW3_FFT() ;
 
-	FFTW3_FFT( int DimX, int DimY, int DimZ, bool IsForward, bool IsDouble, int status ) ;
+	FFTW3_FFT( int DimX, int DimY, int DimZ, bool IsForward, bool IsDouble, int status, 
+	           FFTW3_Effort effort = FFTW3_MEASURE, int nthreads = 1, int howmany = 1, 
+	           int ExtX = 0, int ExtY = 0, int ExtZ = 0 ) ;
 
 	void execute( double * buf1, double * buf2, double * buf3 ) ;
 	void execute( float  * buf1, float  * buf2, float  * buf3 ) ;
 
+	void execute( double * real, fftw_complex  * spec ) ;
+	void execute( float  * real, fftwf_complex * spec ) ;
+	void execute( fftw_complex  * spec, double * real ) ;
+	void execute( fftwf_complex * spec, float  * real ) ;
+
+	void forward( double * real, double * re, double * im ) ;
+	void forward( float  * real, float  * re, float  * im ) ;
+	void backward( double * re, double * im, double * real ) ;
+	void backward( float  * re, float  * im, float  * real ) ;
+
 	int   DimX()       { return _DimX ;      }
 	int   DimY()       { return _DimY ;      }
 	int   DimZ()       { return _DimZ ;      }
-	int   FFTsize()    { return _FFTsize ;   }
+	size_t FFTsize()   { return _FFTsize ;   }
 	int   status()     { return _status ;    }
 	bool  IsDouble()   { return _IsDouble ;  }
 	bool  IsForward()  { return _IsForward ; }
+	FFTW3_Effort  effort()  { return _effort ; }
+	int           nthreads()  { return _nthreads ; }
+	int           howmany()   { return _howmany ;  }
+	int           ExtX()      { return _ExtX ;     }
+	int           ExtY()      { return _ExtY ;     }
+	int           ExtZ()      { return _ExtZ ;     }
+	bool          IsPruned()  { return _pruned ;   }
+	unsigned      flags()   { return _flags ;  }
+	
+	static size_t FFTsize( int DimX, int DimY, int DimZ ) { return (size_t)( DimZ/2 + 1 ) * DimY * DimX ; }
 
         
 	protected:
 	int         _DimX ;
 	int         _DimY ;
 	int         _DimZ ;
-	int         _FFTsize ;
+	size_t      _FFTsize ;
 	int         _status ;
 	bool        _IsDouble ;
 	bool        _IsForward ;
 	double      _weight ;
+	FFTW3_Effort  _effort ;
+	unsigned      _flags ;
+	int           _nthreads ;
+	int           _howmany ;
+	int           _ExtX ;
+	int           _ExtY ;
+	int           _ExtZ ;
+	bool          _pruned ;
+	fftw_plan   _dplan ;
+	fftwf_plan  _splan ;
+	fftw_plan   _dsub [3] ;
+	fftwf_plan  _ssub [3] ;
+	void *           _scratch ;
+	pthread_mutex_t  _scratchLock ;
+
+	void    _plan( unsigned flags, void * real, void * cre, void * cim ) ;
+	void    _planPruned( unsigned flags, void * real ) ;
+	void    _runPruned( void * real, void * cre, void * cim ) ;
+	void    _destroy() ;
+	double  _time( void * real, void * cre, void * cim ) ;
+	void    _tune( void * real, void * cre, void * cim ) ;
+} ;
+
+
+
+/*
+	The key identifying a FFTW3_FFT plan in FFTW3_PlanCache and a tuned size in FFTW3_AUTO mode.
+	Two plans with the same key are interchangeable.
+*/
+struct FFTW3_PlanKey
+{
+	int   DimX ;
+	int   DimY ;
+	int   DimZ ;
+	bool  IsForward ;
+	bool  IsDouble ;
+	int   status ;
+	int   effort ;
+	int   nthreads ;
+	int   howmany ;
+	int   ExtX ;
+	int   ExtY ;
+	int   ExtZ ;
+
+	FFTW3_PlanKey( int dimx, int dimy, int dimz, bool forward, bool isdouble, int st, int eff, int nt, int hm = 1, 
+	               int ex = 0, int ey = 0, int ez = 0 ) :
+		DimX( dimx ), DimY( dimy ), DimZ( dimz ), IsForward( forward ), IsDouble( isdouble ), 
+		status( st ), effort( eff ), nthreads( nt ), howmany( hm ), ExtX( ex ), ExtY( ey ), ExtZ( ez ) {}
+
+	bool operator<( const FFTW3_PlanKey & k ) const ;
+} ;
+
+
+
+/*
+	This class is a process-wide registry of FFTW3_FFT plans shared by all deconvolvers.
+	Planning with FFTW_MEASURE is expensive, so a plan is created only once per process 
+	for each (DimX, DimY, DimZ, IsForward, IsDouble, status, effort, nthreads, howmany, extent) and is reused by later runs.
+
+	Use it in 3 steps :
+	- step 1 : get a plan     -> FFTW3_FFT * p = FFTW3_PlanCache::acquire( DimX, DimY, DimZ, IsForward, IsDouble, status, effort, nthreads, howmany )
+	- step 2 : execute a plan -> p->execute( buf1, buf2, buf3 )
+	- step 3 : return a plan  -> FFTW3_PlanCache::release( p )
+	
+	A released plan is kept in the registry until clear() is called, 
+	clear() only destroys the plans which are not in use.
+	All functions are thread-safe.
+
+	Throw: acquire() throws an error if the plan can not be created.
+*/
+class FFTW3_PlanCache
+{
+	public:
+
+	static FFTW3_FFT * acquire( int DimX, int DimY, int DimZ, bool IsForward, bool IsDouble, int status, 
+	                            FFTW3_Effort effort = FFTW3_MEASURE, int nthreads = 1, int howmany = 1, 
+	                            int ExtX = 0, int ExtY = 0, int ExtZ = 0 ) ;
+
+	static void  release( FFTW3_FFT * plan ) ;
+
+	static void  clear() ;
+
+	static int   size() ;
+
+
+	private:
+	typedef std::map< FFTW3_PlanKey, std::pair< FFTW3_FFT *, int > > PlanMap ;
+
+	static PlanMap          _plans ;
+	static pthread_mutex_t  _lock ;
+} ;
+
+
+
+/*
+	This class keeps FFTW3 wisdom in files, so that the plans measured by one process 
+	are not measured again by the following processes.
+
+	Wisdom is stored separately for the double and single precisions in "<path>.double" and "<path>.float".
+	<path> is taken from the environment variable DECONV_FFTW_WISDOM if it is set, 
+	otherwise it is "$HOME/.deconv_fftw_wisdom". setPath() overrides both and an empty path 
+	disables the wisdom files.
+
+	Each file starts with a header line recording the CPU model the wisdom was measured on.
+	Wisdom measured on another CPU model is ignored since its plans are not the fastest ones here.
+
+	load() is called automatically before the first FFTW3_FFT plan is created, and the wisdom of 
+	the plans created by a process is saved once when it exits; save() saves it at once. A save merges 
+	the wisdom saved meanwhile by other processes and replaces the file by renaming a temporary file.
+	The notice of a file made on another CPU model goes to std::cerr.
+	All functions are thread-safe and never throw, a missing or unreadable file is simply ignored.
+*/
+class FFTW3_Wisdom
+{
+	public:
+
+	static void         setPath( const char * path ) ;
+
+	static std::string  path() ;
+
+	static std::string  cpu() ;
+
+	static void  load() ;
+
+	static void  save( bool IsDouble ) ;
+} ;
+
+
+
+/*
+	This class is a plan handle of the one-shot transforms fft3d/fft2d/fft1d below.
+	A FFTW_ESTIMATE plan is cheap but not free, and the one-shot transforms called many times 
+	on a same size spend most of their time planning. A handle created once and passed to 
+	the fft3d/fft2d/fft1d overloads taking a FFTW3_Transform skips planning entirely.
+
+	<rank> is 3, 2 or 1; <DimY> is ignored if <rank> is 1 and <DimZ> is ignored if <rank> is smaller than 3.
+
+	<IsReal> = true  : r2c plan for fft3d( plan, in, out_re, out_im ).
+	<IsReal> = false : complex plan for fft{3,2,1}d( plan, IsForward, IsShift, in_re, in_im, out_re, out_im ), 
+	                   a same plan runs both the forward and the backward transforms.
+
+	<overlap> tells which arrays the transform will run in-place : bit 0 is set if the input and output 
+	real parts are the same arrays, bit 1 is set if the imaginary parts are; its default is 0 (out-of-place).
+	A backward complex transform swaps the real and imaginary parts, so its bits are swapped too.
+
+	<IsAligned> = true : all arrays are allocated by fftw_malloc() or are SIMD aligned otherwise. 
+	<IsAligned> = false : the plan runs with any arrays, a bit more slowly.
+
+	<nthreads> is the number of threads, its default 0 takes get_my_threads() (see "MYthreads.h").
+	
+	The split arrays of a transform must be distinct arrays, not the two halves of an interleaved array.
+	
+	Throw: throw an error if the plan can not be created, or if execute() is given arrays 
+	       whose overlap or alignment do not match the plan.
+*/
+class FFTW3_Transform
+{
+	public:
+
+	~FFTW3_Transform() ;
+
+	FFTW3_Transform( int rank, int DimX, int DimY, int DimZ, bool IsReal, bool IsDouble, 
+	                 int overlap = 0, bool IsAligned = true, int nthreads = 0 ) ;
+
+	void execute( double * in, double * out_re, double * out_im ) ;
+	void execute( float  * in, float  * out_re, float  * out_im ) ;
+
+	void execute( double * in_re, double * in_im, double * out_re, double * out_im ) ;
+	void execute( float  * in_re, float  * in_im, float  * out_re, float  * out_im ) ;
+
+	int   rank()       { return _rank ;      }
+	int   DimX()       { return _DimX ;      }
+	int   DimY()       { return _DimY ;      }
+	int   DimZ()       { return _DimZ ;      }
+	bool  IsReal()     { return _IsReal ;    }
+	bool  IsDouble()   { return _IsDouble ;  }
+	int   overlap()    { return _overlap ;   }
+	bool  IsAligned()  { return _IsAligned ; }
+	int   nthreads()   { return _nthreads ;  }
+
+
+	protected:
+	int         _rank ;
+	int         _DimX ;
+	int         _DimY ;
+	int         _DimZ ;
+	bool        _IsReal ;
+	bool        _IsDouble ;
+	int         _overlap ;
+	bool        _IsAligned ;
+	int         _nthreads ;
 	fftw_plan   _dplan ;
 	fftwf_plan  _splan ;
-	float* 		_fbuf1 ;
-	float* 		_fbuf2 ;
-	float* 		_fbuf3 ;
-	double*		_dbuf1 ;
-	double*		_dbuf2 ;
-	double*		_dbuf3 ;
+} ;
+
+
+
+/*
+	The key identifying a FFTW3_Transform in FFTW3_TransformCache.
+*/
+struct FFTW3_TransformKey
+{
+	int   rank ;
+	int   DimX ;
+	int   DimY ;
+	int   DimZ ;
+	bool  IsReal ;
+	bool  IsDouble ;
+	int   overlap ;
+	bool  IsAligned ;
+	int   nthreads ;
+
+	FFTW3_TransformKey( int r, int dimx, int dimy, int dimz, bool real, bool isdouble, int ov, bool aligned, int nt ) :
+		rank( r ), DimX( dimx ), DimY( dimy ), DimZ( dimz ), IsReal( real ), IsDouble( isdouble ), 
+		overlap( ov ), IsAligned( aligned ), nthreads( nt ) {}
+
+	bool operator<( const FFTW3_TransformKey & k ) const ;
+} ;
+
+
+
+/*
+	This class is a process-wide registry of FFTW3_Transform plans used by the one-shot transforms below,
+	so that repeated transforms of a same size, precision, overlap and alignment are planned only once.
+	It is used as FFTW3_PlanCache, a released plan is kept until clear() is called.
+	All functions are thread-safe.
+
+	Throw: acquire() throws an error if the plan can not be created.
+*/
+class FFTW3_TransformCache
+{
+	public:
+
+	static FFTW3_Transform * acquire( int rank, int DimX, int DimY, int DimZ, bool IsReal, bool IsDouble, 
+	                                  int overlap = 0, bool IsAligned = true, int nthreads = 0 ) ;
+
+	static void  release( FFTW3_Transform * plan ) ;
+
+	static void  clear() ;
+
+	static int   size() ;
+
+
+	private:
+	typedef std::map< FFTW3_TransformKey, std::pair< FFTW3_Transform *, int > > TransformMap ;
+
+	static TransformMap     _transforms ;
+	static pthread_mutex_t  _lock ;
 } ;
 
 
@@ -114,12 +441,17 @@ class FFTW3_FFT
 	<out_re> and <out_im> are output real and imaginary, they must be different and not NULL.
 	<in> and <out> can not be overlapped.  	
 	All date arrays must be one-dimensional and data is stored as "x + y*DimX + z*DimY*DimX".
+
+	The plan is taken from FFTW3_TransformCache, or from <plan> which must be a 3-D r2c FFTW3_Transform.
   	
 	Throw: throw an error if fail.
 */
 void fft3d( int DimX, int DimY, int DimZ, double * in, double * out_re, double * out_im ) ;
 void fft3d( int DimX, int DimY, int DimZ, float  * in, float  * out_re, float  * out_im ) ;
 
+void fft3d( FFTW3_Transform & plan, double * in, double * out_re, double * out_im ) ;
+void fft3d( FFTW3_Transform & plan, float  * in, float  * out_re, float  * out_im ) ;
+
 /* 
 	The following functions provide 1D/2D/3D FFT routines developped based on FFTW3.
 	Both single and double floating data types are supported. 
@@ -140,6 +472,10 @@ void fft3d( int DimX, int DimY, int DimZ, float  * in, float  * out_re, float  *
 	<out_re> and <out_im> are output real and imaginary, they must be different and not NULL.
 	<in> and <out> can be overlapped. 
 	All data arrays must be one-dimensional and data is stored as "x + y*DimX + z*DimY*DimX".
+
+	These transforms use get_my_threads() threads (see "MYthreads.h") and take their plans from FFTW3_TransformCache.
+	The overloads taking a complex FFTW3_Transform <plan> of the matching rank use it instead 
+	and get the dimensions from it.
 			    
 	Throw: throw an error if fail.
 */
@@ -161,5 +497,23 @@ void fft1d( int DimX, bool IsForward, bool IsShift,
 void fft1d( int DimX, bool IsForward, bool IsShift,
             float  * in_re, float  * in_im, float  * out_re, float  * out_im ) ;
 
+void fft3d( FFTW3_Transform & plan, bool IsForward, bool IsShift, 
+            double * in_re, double * in_im, double * out_re, double * out_im ) ;
+
+void fft3d( FFTW3_Transform & plan, bool IsForward, bool IsShift, 
+            float  * in_re, float  * in_im, float  * out_re, float  * out_im ) ;
+
+void fft2d( FFTW3_Transform & plan, bool IsForward, bool IsShift, 
+            double * in_re, double * in_im, double * out_re, double * out_im ) ;
+
+void fft2d( FFTW3_Transform & plan, bool IsForward, bool IsShift, 
+            float  * in_re, float  * in_im, float  * out_re, float  * out_im ) ;
+
+void fft1d( FFTW3_Transform & plan, bool IsForward, bool IsShift,
+            double * in_re, double * in_im, double * out_re, double * out_im ) ;
+
+void fft1d( FFTW3_Transform & plan, bool IsForward, bool IsShift,
+            float  * in_re, float  * in_im, float  * out_re, float  * out_im ) ;
+
 
 #endif  /*   #include "FFTW3fft.h"   */
@@ -142,7 +142,7 @@ void Fluo3DPSF::create( int DimX, int DimY, int DimZ, float * psf, bool Check )
 				}
 			if( k == 0 || k == HalfZ )
 			{
-				for( int i = 0 ; i < slice.size() ; i++ ) psf[ i + k * slice.size() ] = (slice.data())[i] ;
+				for( int i = 0 ; i < slice.size() ; i++ ) psf[ i + (size_t) k * slice.size() ] = (slice.data())[i] ;
 				if( Check ) 
 				{
 					time( &t1 ) ;
@@ -154,8 +154,8 @@ void Fluo3DPSF::create( int DimX, int DimY, int DimZ, float * psf, bool Check )
 			{
 				for( int i = 0 ; i < slice.size() ; i++ ) 
 				{
-					psf[ i + k * slice.size() ] = (slice.data())[i] ; 
-					psf[ i + (_DimZ-k) * slice.size() ] = (slice.data())[i] ;
+					psf[ i + (size_t) k * slice.size() ] = (slice.data())[i] ; 
+					psf[ i + (size_t) (_DimZ-k) * slice.size() ] = (slice.data())[i] ;
 				}
 				if( Check ) 
 				{
@@ -184,7 +184,7 @@ void Fluo3DPSF::create( int DimX, int DimY, int DimZ, float * psf, bool Check )
 				}
 			if( k == 0 || k == HalfZ )
 			{
-				for( int i = 0 ; i < slice.size() ; i++ ) psf[ i + k * slice.size() ] = (slice.data())[i] ;
+				for( int i = 0 ; i < slice.size() ; i++ ) psf[ i + (size_t) k * slice.size() ] = (slice.data())[i] ;
 				if( Check ) 
 				{
 					time( &t1 ) ;
@@ -196,8 +196,8 @@ void Fluo3DPSF::create( int DimX, int DimY, int DimZ, float * psf, bool Check )
 			{
 				for( int i = 0 ; i < slice.size() ; i++ ) 
 				{
-					psf[ i + k * slice.size() ] = (slice.data())[i] ; 
-					psf[ i + (_DimZ-k) * slice.size() ] = (slice.data())[i] ;
+					psf[ i + (size_t) k * slice.size() ] = (slice.data())[i] ; 
+					psf[ i + (size_t) (_DimZ-k) * slice.size() ] = (slice.data())[i] ;
 				}
 				if( Check ) 
 				{
@@ -210,8 +210,8 @@ void Fluo3DPSF::create( int DimX, int DimY, int DimZ, float * psf, bool Check )
 	}
 	
 	weight = 0.0 ;
-	for( int i = 0 ; i < _DimX * _DimY * _DimZ ; i++ ) weight += psf[i] ;
-	for( int i = 0 ; i < _DimX * _DimY * _DimZ ; i++ ) psf[i] /= weight ;
+	for( size_t i = 0 ; i < (size_t) _DimX * _DimY * _DimZ ; i++ ) weight += psf[i] ;
+	for( size_t i = 0 ; i < (size_t) _DimX * _DimY * _DimZ ; i++ ) psf[i] /= weight ;
 	
 	if( Check ) std::cout << " Fluo3DPSF::create() completes generating the 3D PSF.\n" ;
 }
@@ -269,7 +269,7 @@ void Fluo3DPSF::create( int DimX, int DimY, int DimZ, double * psf, bool Check )
 				}
 			if( k == 0 || k == HalfZ )
 			{
-				for( int i = 0 ; i < slice.size() ; i++ ) psf[ i + k * slice.size() ] = (slice.data())[i] ;
+				for( int i = 0 ; i < slice.size() ; i++ ) psf[ i + (size_t) k * slice.size() ] = (slice.data())[i] ;
 				if( Check ) 
 				{
 					time( &t1 ) ;
@@ -281,8 +281,8 @@ void Fluo3DPSF::create( int DimX, int DimY, int DimZ, double * psf, bool Check )
 			{
 				for( int i = 0 ; i < slice.size() ; i++ ) 
 				{
-					psf[ i + k * slice.size() ] = (slice.data())[i] ; 
-					psf[ i + (_DimZ-k) * slice.size() ] = (slice.data())[i] ;
+					psf[ i + (size_t) k * slice.size() ] = (slice.data())[i] ; 
+					psf[ i + (size_t) (_DimZ-k) * slice.size() ] = (slice.data())[i] ;
 				}
 				if( Check ) 
 				{
@@ -311,7 +311,7 @@ void Fluo3DPSF::create( int DimX, int DimY, int DimZ, double * psf, bool Check )
 				}
 			if( k == 0 || k == HalfZ )
 			{
-				for( int i = 0 ; i < slice.size() ; i++ ) psf[ i + k * slice.size() ] = (slice.data())[i] ;
+				for( int i = 0 ; i < slice.size() ; i++ ) psf[ i + (size_t) k * slice.size() ] = (slice.data())[i] ;
 				if( Check )
 				{
 					time( &t1 ) ;
@@ -323,8 +323,8 @@ void Fluo3DPSF::create( int DimX, int DimY, int DimZ, double * psf, bool Check )
 			{
 				for( int i = 0 ; i < slice.size() ; i++ ) 
 				{
-					psf[ i + k * slice.size() ] = (slice.data())[i] ; 
-					psf[ i + (_DimZ-k) * slice.size() ] = (slice.data())[i] ;
+					psf[ i + (size_t) k * slice.size() ] = (slice.data())[i] ; 
+					psf[ i + (size_t) (_DimZ-k) * slice.size() ] = (slice.data())[i] ;
 				}
 				if( Check )
 				{
@@ -337,8 +337,8 @@ void Fluo3DPSF::create( int DimX, int DimY, int DimZ, double * psf, bool Check )
 	}
 	
 	weight = 0.0 ;
-	for( int i = 0 ; i < _DimX * _DimY * _DimZ ; i++ ) weight += psf[i] ;
-	for( int i = 0 ; i < _DimX * _DimY * _DimZ ; i++ ) psf[i] /= weight ;
+	for( size_t i = 0 ; i < (size_t) _DimX * _DimY * _DimZ ; i++ ) weight += psf[i] ;
+	for( size_t i = 0 ; i < (size_t) _DimX * _DimY * _DimZ ; i++ ) psf[i] /= weight ;
 	
 	if( Check ) std::cout << " Fluo3DPSF::create() completes generating the 3D PSF.\n" ;
 }
@@ -295,14 +295,14 @@ int FluoRZPSF::get3Dpsf( int nx, int ny, int nz, double dx, double dy, double dz
 				}
 			if( k == 0 || k == half_nz ) 
 			{
-				for( int i = 0 ; i < slice.size() ; i++ ) psf[ i + k * slice.size() ] = (slice.data())[i] ;
+				for( int i = 0 ; i < slice.size() ; i++ ) psf[ i + (size_t) k * slice.size() ] = (slice.data())[i] ;
 			}
 			else
 			{
 				for( int i = 0 ; i < slice.size() ; i++ ) 
 				{
-					psf[ i + k * slice.size() ] = (slice.data())[i] ; 
-					psf[ i + (nz-k) * slice.size() ] = (slice.data())[i] ;
+					psf[ i + (size_t) k * slice.size() ] = (slice.data())[i] ; 
+					psf[ i + (size_t) (nz-k) * slice.size() ] = (slice.data())[i] ;
 				}
 			}
 		}
@@ -310,8 +310,8 @@ int FluoRZPSF::get3Dpsf( int nx, int ny, int nz, double dx, double dy, double dz
 		delete [] y ;
 		
 		weight = 0.0 ;
-		for( int i = 0 ; i < nx * ny * nz ; i++ ) weight += psf[i] ;
-		for( int i = 0 ; i < nx * ny * nz ; i++ ) psf[i] /= weight ;
+		for( size_t i = 0 ; i < (size_t) nx * ny * nz ; i++ ) weight += psf[i] ;
+		for( size_t i = 0 ; i < (size_t) nx * ny * nz ; i++ ) psf[i] /= weight ;
 		
 		if( file )
 		{
@@ -420,14 +420,14 @@ int FluoRZPSF::get3Dpsf( int nx, int ny, int nz, double dx, double dy, double dz
 				}
 			if( k == 0 || k == half_nz ) 
 			{
-				for( int i = 0 ; i < slice.size() ; i++ ) psf[ i + k * slice.size() ] = (slice.data())[i] ;
+				for( int i = 0 ; i < slice.size() ; i++ ) psf[ i + (size_t) k * slice.size() ] = (slice.data())[i] ;
 			}
 			else
 			{
 				for( int i = 0 ; i < slice.size() ; i++ ) 
 				{
-					psf[ i + k * slice.size() ] = (slice.data())[i] ; 
-					psf[ i + (nz-k) * slice.size() ] = (slice.data())[i] ;
+					psf[ i + (size_t) k * slice.size() ] = (slice.data())[i] ; 
+					psf[ i + (size_t) (nz-k) * slice.size() ] = (slice.data())[i] ;
 				}
 			}
 		}
@@ -435,8 +435,8 @@ int FluoRZPSF::get3Dpsf( int nx, int ny, int nz, double dx, double dy, double dz
 		delete [] y ;
 		
 		weight = 0.0 ;
-		for( int i = 0 ; i < nx * ny * nz ; i++ ) weight += psf[i] ;
-		for( int i = 0 ; i < nx * ny * nz ; i++ ) psf[i] /= weight ;
+		for( size_t i = 0 ; i < (size_t) nx * ny * nz ; i++ ) weight += psf[i] ;
+		for( size_t i = 0 ; i < (size_t) nx * ny * nz ; i++ ) psf[i] /= weight ;
 		
 		if( file )
 		{
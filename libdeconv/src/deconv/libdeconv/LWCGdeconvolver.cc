@@ -21,6 +21,8 @@
 
 #include "math.h"
 #include "LWCGdeconvolver.h"
+#include "SPECTRALkernels.h"
+#include "MYthreads.h"
 
 
 /* public functions */ 
@@ -49,6 +51,194 @@ void LWCGdeconvolver::setConditioningValue( double cv )
 
 
 
+void LWCGdeconvolver::setConditioningCandidates( unsigned int n )
+{
+	if( n >= 1 && n <= ConditioningCandidatesLimit ) _ConditioningCandidates = n ;
+	else                                             throw ConditioningCandidatesError( n ) ;
+}
+
+
+
+/* conditioning value cache, see ConditioningValueCache in "LWCGdeconvolver.h" */
+
+bool ConditioningValueKey::operator<( const ConditioningValueKey & k ) const
+{
+	if( DimX != k.DimX )             return DimX < k.DimX ;
+	if( DimY != k.DimY )             return DimY < k.DimY ;
+	if( DimZ != k.DimZ )             return DimZ < k.DimZ ;
+	if( iterations != k.iterations ) return iterations < k.iterations ;
+	if( psf != k.psf )               return psf < k.psf ;
+	if( support != k.support )       return support < k.support ;
+	return mask < k.mask ;
+}
+
+
+ConditioningValueCache::ValueList  ConditioningValueCache::_values ;
+bool                               ConditioningValueCache::_loaded = false ;
+bool                               ConditioningValueCache::_init   = false ;
+std::string                        ConditioningValueCache::_path ;
+pthread_mutex_t                    ConditioningValueCache::_lock   = PTHREAD_MUTEX_INITIALIZER ;
+
+static const char * ConditioningCache_header = "# deconv conditioning values : DimX DimY DimZ iterations psf support mask mean deviation value\n" ;
+
+
+/* same size, iterations, PSF and support, and same statistics within the relative <tolerance> */
+static bool ConditioningCache_match( const ConditioningValueKey & a, const ConditioningValueKey & b, double tolerance )
+{
+	if( a < b || b < a ) return false ;
+	return fabs( a.mean - b.mean ) <= tolerance * fabs( a.mean ) && 
+	       fabs( a.deviation - b.deviation ) <= tolerance * fabs( a.deviation ) ;
+}
+
+
+/* it must be called with <_lock> held */
+void ConditioningValueCache::_load()
+{
+	if( !_init )
+	{
+		const char * env = getenv( "DECONV_CONDITIONING_CACHE" ) ;
+		_path = env ? env : "" ;
+		_init = true ;
+	}
+	if( _loaded )
+		return ;
+	_loaded = true ;
+
+	if( _path.empty() )
+		return ;
+	FILE * fp = fopen( _path.c_str(), "rt" ) ;
+	if( !fp )
+		return ;
+
+	char line[ 512 ] ;
+	ConditioningValueKey key ;
+	double cv ;
+	while( fgets( line, sizeof(line), fp ) )
+	{
+		if( line[0] == '#' )
+			continue ;
+		if( sscanf( line, "%d %d %d %u %llx %d %llx %lg %lg %lg", &key.DimX, &key.DimY, &key.DimZ, &key.iterations, 
+		            &key.psf, &key.support, &key.mask, &key.mean, &key.deviation, &cv ) == 10 )
+			_values.push_back( std::make_pair( key, cv ) ) ;
+	}
+	fclose( fp ) ;
+}
+
+bool ConditioningValueCache::lookup( const ConditioningValueKey & key, double tolerance, double & cv )
+{
+	pthread_mutex_lock( &_lock ) ;
+	_load() ;
+
+	bool found = false ;
+	for( size_t i = _values.size() ; i > 0 && !found ; i-- )
+	{
+		if( ConditioningCache_match( key, _values[i-1].first, tolerance ) )
+		{
+			cv = _values[i-1].second ;
+			found = true ;
+		}
+	}
+
+	pthread_mutex_unlock( &_lock ) ;
+	return found ;
+}
+
+void ConditioningValueCache::store( const ConditioningValueKey & key, double cv )
+{
+	pthread_mutex_lock( &_lock ) ;
+	_load() ;
+	_values.push_back( std::make_pair( key, cv ) ) ;
+
+	/* one line appended per value, so that several processes may share the file */
+	FILE * fp = _path.empty() ? NULL : fopen( _path.c_str(), "at" ) ;
+	if( fp )
+	{
+		if( ftell( fp ) == 0 )
+			fputs( ConditioningCache_header, fp ) ;
+		fprintf( fp, "%d %d %d %u %llx %d %llx %.17g %.17g %.17g\n", key.DimX, key.DimY, key.DimZ, key.iterations, 
+		         key.psf, key.support, key.mask, key.mean, key.deviation, cv ) ;
+		fclose( fp ) ;
+	}
+
+	pthread_mutex_unlock( &_lock ) ;
+}
+
+void ConditioningValueCache::setPath( const char * path )
+{
+	pthread_mutex_lock( &_lock ) ;
+	_values.clear() ;
+	_path   = path ? path : "" ;
+	_init   = true ;
+	_loaded = false ;
+	pthread_mutex_unlock( &_lock ) ;
+}
+
+std::string ConditioningValueCache::path()
+{
+	pthread_mutex_lock( &_lock ) ;
+	_load() ;
+	std::string path = _path ;
+	pthread_mutex_unlock( &_lock ) ;
+	return path ;
+}
+
+void ConditioningValueCache::clear()
+{
+	pthread_mutex_lock( &_lock ) ;
+	_values.clear() ;
+	pthread_mutex_unlock( &_lock ) ;
+}
+
+int ConditioningValueCache::size()
+{
+	pthread_mutex_lock( &_lock ) ;
+	int n = (int) _values.size() ;
+	pthread_mutex_unlock( &_lock ) ;
+	return n ;
+}
+
+
+
+/* 
+	the fingerprints of the PSF spectrum and of the spacial support and the statistics of the image spectrum of <key>;
+	the complex values are <S> apart (see "SPECTRALkernels.h") and hashed one by one, so that a key does not 
+	depend on the spectrum layout.
+*/
+template< class T >
+static void LWCG_cacheKey( ConditioningValueKey & key, size_t size, size_t space, size_t S, const T * image_re, 
+                           const T * image_im, const T * psf_re, const T * psf_im, const unsigned char * SpacialSupport )
+{
+	unsigned long long hash = 14695981039346656037ULL ;
+	const unsigned char * byte ;
+	for( size_t k = 0 ; k < size ; k++ ) 
+	{
+		byte = (const unsigned char *)( psf_re + ( psf_im == NULL ? k : k * S ) ) ;
+		for( size_t i = 0 ; i < sizeof( T ) ; i++ ) hash = ( hash ^ byte[i] ) * 1099511628211ULL ;
+	}
+	if( psf_im != NULL )
+	{
+		for( size_t k = 0 ; k < size ; k++ ) 
+		{
+			byte = (const unsigned char *)( psf_im + k * S ) ;
+			for( size_t i = 0 ; i < sizeof( T ) ; i++ ) hash = ( hash ^ byte[i] ) * 1099511628211ULL ;
+		}
+	}
+	key.psf = hash ;
+
+	hash = 14695981039346656037ULL ;
+	if( SpacialSupport != NULL )
+		for( size_t i = 0 ; i < space ; i++ ) hash = ( hash ^ SpacialSupport[i] ) * 1099511628211ULL ;
+	key.support = ( SpacialSupport != NULL ) ? 1 : 0 ;
+	key.mask    = hash ;
+
+	double sum = 0.0 ;
+	for( size_t k = 1 ; k < size ; k++ ) sum += (double) image_re[k*S] * image_re[k*S] + (double) image_im[k*S] * image_im[k*S] ;
+	key.mean      = image_re[0] / (double) space ;
+	key.deviation = ( size > 1 ) ? sqrt( sum / ( size - 1 ) ) / space : 0.0 ;
+}
+
+
+
 /* protected functions */
 
 void LWCGdeconvolver::_printConditioning( double cv, double likelihood ) 
@@ -63,114 +253,112 @@ void LWCGdeconvolver::_exportLWCG( FILE * fp )
 	_exportCommon( fp ) ;
 	fprintf( fp, "%d -> Conditioning_Iteration of each conditioning process before the deconvolution loop.\n", _ConditioningIteration ) ;
 	fprintf( fp, "%e -> Conditioning_Tolerance in each conditioning process before the deconvolution loop.\n", _ConditioningTolerance ) ;
+	fprintf( fp, "%d -> Conditioning_Candidates evaluated at once in each conditioning process.\n", _ConditioningCandidates ) ;
+	fprintf( fp, "%d -> Conditioning_Cache reuses the conditioning values found by the previous runs.\n", _ConditioningCache ) ;
 	fprintf( fp, "%e -> Conditioning_Value found after conditioning and used in the deconvolution loop\n", _ConditioningValue ) ;
 	fprintf( fp, "\n" ) ;
 }
 
 
 
-double LWCGdeconvolver::_getLikelihood( int size, double * image_re, double * image_im, double * psf_re, 
+bool LWCGdeconvolver::_cachedConditioning( ConditioningValueKey & key, size_t size, double * image_re, double * image_im, 
+                        double * psf_re, double * psf_im, unsigned char * SpacialSupport, double & cv )
+{
+	if( !_ConditioningCache ) return false ;
+
+	key.DimX = _DimX ;
+	key.DimY = _DimY ;
+	key.DimZ = _DimZ ;
+	key.iterations = _ConditioningIteration ;
+	LWCG_cacheKey( key, size, _Space, _Interleaved ? 2 : 1, image_re, image_im, psf_re, psf_im, SpacialSupport ) ;
+	if( !ConditioningValueCache::lookup( key, _ConditioningTolerance, cv ) ) return false ;
+
+	if( _CheckStatus ) printf( " --> Conditioning value = %9.6f -> from the conditioning cache\n", cv ) ;
+	return true ;
+}
+
+
+
+bool LWCGdeconvolver::_cachedConditioning( ConditioningValueKey & key, size_t size, float * image_re, float * image_im, 
+                        float * psf_re, float * psf_im, unsigned char * SpacialSupport, double & cv )
+{
+	if( !_ConditioningCache ) return false ;
+
+	key.DimX = _DimX ;
+	key.DimY = _DimY ;
+	key.DimZ = _DimZ ;
+	key.iterations = _ConditioningIteration ;
+	LWCG_cacheKey( key, size, _Space, _Interleaved ? 2 : 1, image_re, image_im, psf_re, psf_im, SpacialSupport ) ;
+	if( !ConditioningValueCache::lookup( key, _ConditioningTolerance, cv ) ) return false ;
+
+	if( _CheckStatus ) printf( " --> Conditioning value = %9.6f -> from the conditioning cache\n", cv ) ;
+	return true ;
+}
+
+
+
+double LWCGdeconvolver::_storeConditioning( const ConditioningValueKey & key, double cv )
+{
+	if( _ConditioningCache ) ConditioningValueCache::store( key, cv ) ;
+	return cv ;
+}
+
+
+
+double LWCGdeconvolver::_getLikelihood( size_t size, double * image_re, double * image_im, double * psf_re, 
                         double * psf_im, double * object_re, double * object_im )
 { 
-	double likelihood = 0.0 ;
-     	
-	for( int i = 0 ; i < size ; i++ )
-	{
-		likelihood += ( ( image_re[i]-psf_re[i]*object_re[i]+psf_im[i]*object_im[i] ) *
-		                ( image_re[i]-psf_re[i]*object_re[i]+psf_im[i]*object_im[i] ) +
-		                ( image_im[i]-psf_re[i]*object_im[i]-psf_im[i]*object_re[i] ) *
-		                ( image_im[i]-psf_re[i]*object_im[i]-psf_im[i]*object_re[i] ) ) ;
-       		
-	}
-     	
-	return likelihood ;
+	if( _Interleaved ) return SPECTRAL_distance<2>( size, object_re, object_im, image_re, image_im, psf_re, psf_im, _Threads ) ;
+	return SPECTRAL_distance<1>( size, object_re, object_im, image_re, image_im, psf_re, psf_im, _Threads ) ;
 }
 
 
 
-double LWCGdeconvolver::_getLikelihood( int size, float * image_re, float * image_im, float * psf_re, 
+double LWCGdeconvolver::_getLikelihood( size_t size, float * image_re, float * image_im, float * psf_re, 
                         float * psf_im, float * object_re, float * object_im )
 { 
-	double likelihood = 0.0 ;
-	
-	for( int i = 0 ; i < size ; i++ )
-	{
-		likelihood += ( ( image_re[i]-psf_re[i]*object_re[i]+psf_im[i]*object_im[i] ) *
-		                ( image_re[i]-psf_re[i]*object_re[i]+psf_im[i]*object_im[i] ) +
-		                ( image_im[i]-psf_re[i]*object_im[i]-psf_im[i]*object_re[i] ) *
-		                ( image_im[i]-psf_re[i]*object_im[i]-psf_im[i]*object_re[i] ) ) ;
-	}
-     	
-	return likelihood ;
+	if( _Interleaved ) return SPECTRAL_distance<2>( size, object_re, object_im, image_re, image_im, psf_re, psf_im, _Threads ) ;
+	return SPECTRAL_distance<1>( size, object_re, object_im, image_re, image_im, psf_re, psf_im, _Threads ) ;
 }
 
 
 
-void LWCGdeconvolver::_update( int size, double cv, double * object_re, double * object_im, 
+void LWCGdeconvolver::_update( size_t size, double cv, double * step, double * object_re, double * object_im, 
                       double * image_re, double * image_im, double * psf_re, double * psf_im, double * otf )
 {
-	double temp1, temp2, temp3, temp4 ;
-	
-	for( int i = 0 ; i < size ; i++ )
-	{
-		       temp1 = otf[i] + cv ;
-		       temp2 = ( image_re[i]*psf_re[i] + image_im[i]*psf_im[i] ) / temp1 ;
-		       temp3 = ( image_im[i]*psf_re[i] - image_re[i]*psf_im[i] ) / temp1 ;
-		       temp4 = otf[i] / temp1 ;
-		object_re[i] = temp2 - temp4 * object_re[i] ;
-		object_im[i] = temp3 - temp4 * object_im[i] ;
-	}
-	       	
-	_FFTplanb->execute( object_re, object_im, object_re ) ;
+	if( _Interleaved ) SPECTRAL_landweber<2>( size, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, cv, _Threads ) ;
+	else               SPECTRAL_landweber<1>( size, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, cv, _Threads ) ;
+	_FFTplanb->backward( object_re, object_im, step ) ;
 }
 
 
 
-void LWCGdeconvolver::_update( int size, double cv, float * object_re, float * object_im, 
+void LWCGdeconvolver::_update( size_t size, double cv, float * step, float * object_re, float * object_im, 
                       float * image_re, float * image_im, float * psf_re, float * psf_im, float * otf )
 {
-	float temp1, temp2, temp3, temp4 ;
-	
-	for( int i = 0 ; i < size ; i++ )
-	{
-		       temp1 = otf[i] + cv ;
-		       temp2 = ( image_re[i]*psf_re[i] + image_im[i]*psf_im[i] ) / temp1 ;
-		       temp3 = ( image_im[i]*psf_re[i] - image_re[i]*psf_im[i] ) / temp1 ;
-		       temp4 = otf[i] / temp1 ;
-		object_re[i] = temp2 - temp4 * object_re[i] ;
-		object_im[i] = temp3 - temp4 * object_im[i] ;
-	}
-       	
-	_FFTplanb->execute( object_re, object_im, object_re ) ;	
+	if( _Interleaved ) SPECTRAL_landweber<2>( size, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, cv, _Threads ) ;
+	else               SPECTRAL_landweber<1>( size, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, cv, _Threads ) ;
+	_FFTplanb->backward( object_re, object_im, step ) ;
 }
 
 
 
-double LWCGdeconvolver::_getSumLikelihood( int size, double cv, double * object0, double * object, double * object_re, double * object_im,
+double LWCGdeconvolver::_getSumLikelihood( size_t size, double cv, double * object0, double * object, double * step, double * object_re, double * object_im,
                         double * image_re, double * image_im, double * psf_re, double * psf_im, double * otf, unsigned char * SpacialSupport )
 {
 	double sum_likelihood = 0.0 ;
 	unsigned int iter = 0 ;
 
-	for( int i = 0 ; i < _Space ; i++ ) object[i] = object0[i] ;
-	_FFTplanf->execute( object, object_re, object_im ) ;
+	for( size_t i = 0 ; i < _Space ; i++ ) object[i] = object0[i] ;
+	_FFTplanf->forward( object, object_re, object_im ) ;
 
 	while( iter < _ConditioningIteration )
 	{
-		_update( size, cv, object_re, object_im, image_re, image_im, psf_re, psf_im, otf ) ;
+		_update( size, cv, step, object_re, object_im, image_re, image_im, psf_re, psf_im, otf ) ;
 
-		for( int i = 0 ; i < _Space ; i++ )
-		{
-			object[i] += object_re[i] ;
-			if( object[i] < 0.0 ) object[i] = 0.0 ;
-		}
-       		
-		if( SpacialSupport != NULL )
-		{
-			for( int i = 0 ; i < _Space ; i++ ) object[i] *= ((double) SpacialSupport[i]) ;
-		}
+		UPDATE_apply( _Space, object, UPDATE_add< double >( object, step ), SpacialSupport, _Threads ) ;
 	
-		_FFTplanf->execute( object, object_re, object_im ) ;
+		_FFTplanf->forward( object, object_re, object_im ) ;
 
 		sum_likelihood += _getLikelihood( size, image_re, image_im, psf_re, psf_im, object_re, object_im ) ;
 
@@ -182,31 +370,22 @@ double LWCGdeconvolver::_getSumLikelihood( int size, double cv, double * object0
 
 
 
-double LWCGdeconvolver::_getSumLikelihood( int size, double cv, float * object0, float * object, float * object_re, float * object_im,
+double LWCGdeconvolver::_getSumLikelihood( size_t size, double cv, float * object0, float * object, float * step, float * object_re, float * object_im,
                         float * image_re, float * image_im, float * psf_re, float * psf_im, float * otf, unsigned char * SpacialSupport )
 {	
 	unsigned int iter = 0 ;	
 	double sum_likelihood = 0.0 ;
 
-	for( int i = 0 ; i < _Space ; i++ ) object[i] = object0[i] ;
-	_FFTplanf->execute( object, object_re, object_im ) ;
+	for( size_t i = 0 ; i < _Space ; i++ ) object[i] = object0[i] ;
+	_FFTplanf->forward( object, object_re, object_im ) ;
 
 	while( iter < _ConditioningIteration )
 	{
-		_update( size, cv, object_re, object_im, image_re, image_im, psf_re, psf_im, otf ) ;
+		_update( size, cv, step, object_re, object_im, image_re, image_im, psf_re, psf_im, otf ) ;
 		
-		for( int i = 0 ; i < _Space ; i++ )
-		{
-			object[i] += object_re[i] ;
-			if( object[i] < 0.0 ) object[i] = 0.0 ;
-		}
-       		
-		if( SpacialSupport != NULL )
-		{
-			for( int i = 0 ; i < _Space ; i++ ) object[i] *= ((double) SpacialSupport[i]) ;
-		}
+		UPDATE_apply( _Space, object, UPDATE_add< float >( object, step ), SpacialSupport, _Threads ) ;
 
-		_FFTplanf->execute( object, object_re, object_im ) ;
+		_FFTplanf->forward( object, object_re, object_im ) ;
 
 		sum_likelihood += _getLikelihood( size, image_re, image_im, psf_re, psf_im, object_re, object_im ) ;
 
@@ -218,9 +397,17 @@ double LWCGdeconvolver::_getSumLikelihood( int size, double cv, float * object0,
 
 
 
-double LWCGdeconvolver::_runConditioning( int size, double * object0, double * object, double * object_re, double * object_im, double * image_re,
+double LWCGdeconvolver::_runConditioning( size_t size, double * object0, double * object, double * step, double * object_re, double * object_im, double * image_re,
                         double * image_im, double * psf_re, double * psf_im, double * otf, unsigned char * SpacialSupport )
 {
+	ConditioningValueKey key ;
+	double cv ;
+	if( _cachedConditioning( key, size, image_re, image_im, psf_re, psf_im, SpacialSupport, cv ) ) return cv ;
+
+	if( _ConditioningCandidates > 1 )
+		return _storeConditioning( key, _searchConditioning( size, object0, object, step, object_re, object_im, 
+		                           image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ) ;
+
 	double R   = 0.61803399 ;
 	double C   = 1.0 - R ;
 	double likelihood = 1.0E+37 ;
@@ -232,7 +419,7 @@ double LWCGdeconvolver::_runConditioning( int size, double * object0, double * o
 	{
 		last_likelihood = likelihood ;
 		x0 = x0 * 0.1 ;
-		likelihood = _getSumLikelihood( size, x0, object0, object, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
+		likelihood = _getSumLikelihood( size, x0, object0, object, step, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
 		if( _CheckStatus ) _printConditioning( x0, likelihood ) ;
 	}        	       	       
 
@@ -242,7 +429,7 @@ double LWCGdeconvolver::_runConditioning( int size, double * object0, double * o
 	{
 		f1 = last_likelihood ;
 		x2 = x1 + C * ( x3 - x1 ) ;       		
-		f2 = _getSumLikelihood( size, x2, object0, object, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
+		f2 = _getSumLikelihood( size, x2, object0, object, step, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
 		if( _CheckStatus ) _printConditioning( x2, f2 ) ;
 	}
 	else
@@ -250,7 +437,7 @@ double LWCGdeconvolver::_runConditioning( int size, double * object0, double * o
 		x2 = x1 ;
 		f2 = last_likelihood ;
 		x1 = x2 - C * ( x2 - x0 ) ;
-		f1 = _getSumLikelihood( size, x1, object0, object, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
+		f1 = _getSumLikelihood( size, x1, object0, object, step, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
 		if( _CheckStatus ) _printConditioning( x1, f1 ) ;
 	}
        	
@@ -262,7 +449,7 @@ double LWCGdeconvolver::_runConditioning( int size, double * object0, double * o
 			x1 = x2 ;
 			x2 = R * x1 + C * x3 ;
 			f1 = f2 ;
-			f2 = _getSumLikelihood( size, x2, object0, object, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
+			f2 = _getSumLikelihood( size, x2, object0, object, step, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
 			if( _CheckStatus ) _printConditioning( x2, f2 ) ;
 		}
 		else
@@ -271,26 +458,34 @@ double LWCGdeconvolver::_runConditioning( int size, double * object0, double * o
 			x2 = x1 ;
 			x1 = R * x2 + C * x0 ;
 			f2 = f1 ;
-			f1 = _getSumLikelihood( size, x1, object0, object, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
+			f1 = _getSumLikelihood( size, x1, object0, object, step, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
 			if( _CheckStatus ) _printConditioning( x1, f1 ) ;
 		}
 	}
 
 	if( f1 < f2 )
 	{
-		return x1 ;
+		return _storeConditioning( key, x1 ) ;
 	}
 	else 
 	{
-		return x2 ;
+		return _storeConditioning( key, x2 ) ;
 	}
 }
 
 
 
-double LWCGdeconvolver::_runConditioning( int size, float * object0, float * object, float * object_re, float * object_im, float * image_re, 
+double LWCGdeconvolver::_runConditioning( size_t size, float * object0, float * object, float * step, float * object_re, float * object_im, float * image_re, 
                         float * image_im, float * psf_re, float * psf_im, float * otf, unsigned char * SpacialSupport )
 {
+	ConditioningValueKey key ;
+	double cv ;
+	if( _cachedConditioning( key, size, image_re, image_im, psf_re, psf_im, SpacialSupport, cv ) ) return cv ;
+
+	if( _ConditioningCandidates > 1 )
+		return _storeConditioning( key, _searchConditioning( size, object0, object, step, object_re, object_im, 
+		                           image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ) ;
+
 	double R   = 0.61803399 ;
 	double C   = 1.0 - R ;
 	double likelihood = 1.0E+37 ;
@@ -302,7 +497,7 @@ double LWCGdeconvolver::_runConditioning( int size, float * object0, float * obj
 	{
 		last_likelihood = likelihood ;
 		x0 = x0 * 0.1 ;
-		likelihood = _getSumLikelihood( size, x0, object0, object, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
+		likelihood = _getSumLikelihood( size, x0, object0, object, step, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
 		if( _CheckStatus ) _printConditioning( x0, likelihood ) ;
 	}        	       	       
 
@@ -312,7 +507,7 @@ double LWCGdeconvolver::_runConditioning( int size, float * object0, float * obj
 	{
 		f1 = last_likelihood ;
 		x2 = x1 + C * ( x3 - x1 ) ;       		
-		f2 = _getSumLikelihood( size, x2, object0, object, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
+		f2 = _getSumLikelihood( size, x2, object0, object, step, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
 		if( _CheckStatus ) _printConditioning( x2, f2 ) ;
 	}
 	else
@@ -320,7 +515,7 @@ double LWCGdeconvolver::_runConditioning( int size, float * object0, float * obj
 		x2 = x1 ;
 		f2 = last_likelihood ;
 		x1 = x2 - C * ( x2 - x0 ) ;
-		f1 = _getSumLikelihood( size, x1, object0, object, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
+		f1 = _getSumLikelihood( size, x1, object0, object, step, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
 		if( _CheckStatus ) _printConditioning( x1, f1 ) ;
 	}
 	   	
@@ -332,7 +527,7 @@ double LWCGdeconvolver::_runConditioning( int size, float * object0, float * obj
 			x1 = x2 ;
 			x2 = R * x1 + C * x3 ;
 			f1 = f2 ;
-			f2 = _getSumLikelihood( size, x2, object0, object, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
+			f2 = _getSumLikelihood( size, x2, object0, object, step, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
 			if( _CheckStatus ) _printConditioning( x2, f2 ) ;
 		}
 		else
@@ -341,18 +536,175 @@ double LWCGdeconvolver::_runConditioning( int size, float * object0, float * obj
 			x2 = x1 ;
 			x1 = R * x2 + C * x0 ;
 			f2 = f1 ;
-			f1 = _getSumLikelihood( size, x1, object0, object, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
+			f1 = _getSumLikelihood( size, x1, object0, object, step, object_re, object_im, image_re, image_im, psf_re, psf_im, otf, SpacialSupport ) ;
 			if( _CheckStatus ) _printConditioning( x1, f1 ) ;
 		}
 	}
 
 	if( f1 < f2 )
 	{
-		return x1 ;
+		return _storeConditioning( key, x1 ) ;
 	}
 	else 
 	{
-		return x2 ;
+		return _storeConditioning( key, x2 ) ;
+	}
+}
+
+
+
+/*
+	LWCGsearch holds the arrays of the candidates evaluated at once by _searchConditioning(); LWCG_evaluate() 
+	runs _getSumLikelihood() for the candidates [begin, end) in the threads of my_parallel_for(), candidate j on 
+	<object>[j], <step>[j], <re>[j] and <im>[j] with the conditioning value <cv>[j]. All the candidates share 
+	the plans <planf>, <planb> of <threads> threads, as execute() is reentrant (see "FFTW3fft.h").
+	The spectra are interleaved if <interleaved> is true, <im>[j] being then <re>[j] + 1.
+*/
+template< class T >
+struct LWCGsearch
+{
+	size_t                space ;
+	size_t                size ;
+	unsigned int          iterations ;
+	int                   threads ;
+	bool                  interleaved ;
+	FFTW3_FFT *           planf ;
+	FFTW3_FFT *           planb ;
+	const T *             object0 ;
+	const T *             image_re ;
+	const T *             image_im ;
+	const T *             psf_re ;
+	const T *             psf_im ;
+	const T *             otf ;
+	const unsigned char * support ;
+	T *                   object[ConditioningCandidatesLimit] ;
+	T *                   step[ConditioningCandidatesLimit] ;
+	T *                   re[ConditioningCandidatesLimit] ;
+	T *                   im[ConditioningCandidatesLimit] ;
+	double                cv[ConditioningCandidatesLimit] ;
+	double                likelihood[ConditioningCandidatesLimit] ;
+} ;
+
+template< class T >
+void LWCG_evaluate( size_t begin, size_t end, void * arg )
+{
+	LWCGsearch< T > & s = *(LWCGsearch< T > *) arg ;
+
+	for( size_t j = begin ; j < end ; j++ )
+	{
+		T * object = s.object[j], * step = s.step[j], * re = s.re[j], * im = s.im[j] ;
+		double sum_likelihood = 0.0 ;
+
+		for( size_t i = 0 ; i < s.space ; i++ ) object[i] = s.object0[i] ;
+		s.planf->forward( object, re, im ) ;
+
+		for( unsigned int iter = 0 ; iter < s.iterations ; iter++ )
+		{
+			if( s.interleaved )
+				SPECTRAL_landweber<2>( s.size, re, im, s.image_re, s.image_im, s.psf_re, s.psf_im, s.otf, (T) s.cv[j], s.threads ) ;
+			else
+				SPECTRAL_landweber<1>( s.size, re, im, s.image_re, s.image_im, s.psf_re, s.psf_im, s.otf, (T) s.cv[j], s.threads ) ;
+			s.planb->backward( re, im, step ) ;
+			UPDATE_apply( s.space, object, UPDATE_add< T >( object, step ), s.support, s.threads ) ;
+			s.planf->forward( object, re, im ) ;
+			if( s.interleaved )
+				sum_likelihood += SPECTRAL_distance<2>( s.size, re, im, s.image_re, s.image_im, s.psf_re, s.psf_im, s.threads ) ;
+			else
+				sum_likelihood += SPECTRAL_distance<1>( s.size, re, im, s.image_re, s.image_im, s.psf_re, s.psf_im, s.threads ) ;
+		}
+		s.likelihood[j] = sum_likelihood ;
 	}
 }
 
+
+
+template< class T >
+double LWCGdeconvolver::_searchConditioning( size_t size, T * object0, T * object, T * step, T * object_re, T * object_im, 
+                        T * image_re, T * image_im, T * psf_re, T * psf_im, T * otf, unsigned char * SpacialSupport )
+{
+	int n = (int) _ConditioningCandidates ;
+	LWCGsearch< T > s ;
+
+	s.space      = _Space ;
+	s.size       = size ;
+	s.iterations = _ConditioningIteration ;
+	s.threads    = ( _Threads / n > 1 ) ? _Threads / n : 1 ;
+	s.interleaved = _Interleaved ;
+	s.object0    = object0 ;
+	s.image_re   = image_re ;
+	s.image_im   = image_im ;
+	s.psf_re     = psf_re ;
+	s.psf_im     = psf_im ;
+	s.otf        = otf ;
+	s.support    = SpacialSupport ;
+
+	/* the first candidate runs on the arrays of the caller */
+	s.object[0] = object ;
+	s.step[0]   = step ;
+	s.re[0]     = object_re ;
+	s.im[0]     = object_im ;
+	for( int j = 1 ; j < n ; j++ )
+	{
+		WS_malloc( s.object[j], _Space ) ;
+		WS_malloc( s.step[j], _Space ) ;
+		WS_malloc( s.re[j], _Interleaved ? 2 * size : size ) ;
+		if( _Interleaved ) s.im[j] = s.re[j] + 1 ;
+		else               WS_malloc( s.im[j], size ) ;
+	}
+
+	bool IsDouble = ( sizeof( T ) == sizeof( double ) ) ;
+	s.planf = FFTW3_PlanCache::acquire( _DimX, _DimY, _DimZ, true,  IsDouble, _Interleaved ? 4 : 3, _PlannerEffort, s.threads ) ;
+	s.planb = FFTW3_PlanCache::acquire( _DimX, _DimY, _DimZ, false, IsDouble, _Interleaved ? 4 : 3, _PlannerEffort, s.threads ) ;
+
+	/* bracketing: n decades at once, until the sum of likelihoods increases at <x0> */
+	double x0 = 1.0, x1 = 1.0, f1 = 1.0E+37 ;
+	bool   increase = false ;
+	while( !increase )
+	{
+		for( int j = 0 ; j < n ; j++ ) s.cv[j] = ( j == 0 ? x0 : s.cv[j-1] ) * 0.1 ;
+		my_parallel_for( n, 1, LWCG_evaluate< T >, &s, n ) ;
+
+		for( int j = 0 ; j < n && !increase ; j++ )
+		{
+			x0 = s.cv[j] ;
+			if( _CheckStatus ) _printConditioning( x0, s.likelihood[j] ) ;
+			if( s.likelihood[j] <= f1 ) { x1 = x0 ; f1 = s.likelihood[j] ; }
+			else                        increase = true ;
+		}
+	}
+
+	/* multi-point search: n values evenly spaced in the bracket ( x0, x3 ) around the best value <x1> */
+	double x3 = x0 * 100.0 ;
+	while( fabs(x3-x0) > _ConditioningTolerance * 2.0 * fabs(x1) )
+	{
+		for( int j = 0 ; j < n ; j++ ) s.cv[j] = x0 + ( x3 - x0 ) * ( j + 1 ) / ( n + 1 ) ;
+		my_parallel_for( n, 1, LWCG_evaluate< T >, &s, n ) ;
+
+		for( int j = 0 ; j < n ; j++ )
+		{
+			if( _CheckStatus ) _printConditioning( s.cv[j], s.likelihood[j] ) ;
+			if( s.likelihood[j] < f1 ) { x1 = s.cv[j] ; f1 = s.likelihood[j] ; }
+		}
+
+		double lower = x0, upper = x3 ;
+		for( int j = 0 ; j < n ; j++ )
+		{
+			if( s.cv[j] < x1 && s.cv[j] > lower ) lower = s.cv[j] ;
+			if( s.cv[j] > x1 && s.cv[j] < upper ) upper = s.cv[j] ;
+		}
+		x0 = lower ;
+		x3 = upper ;
+	}
+
+	FFTW3_PlanCache::release( s.planf ) ;
+	FFTW3_PlanCache::release( s.planb ) ;
+	for( int j = 1 ; j < n ; j++ )
+	{
+		WS_free( s.object[j] ) ;
+		WS_free( s.step[j] ) ;
+		WS_free( s.re[j] ) ;
+		if( !_Interleaved ) WS_free( s.im[j] ) ;
+	}
+
+	return x1 ;
+}
@@ -23,6 +23,9 @@
 #define LWCGDECONVOLVER_H
 
 
+#include <string>
+#include <vector>
+#include <pthread.h>
 #include "deconvolver.h"
 #include "FFTW3fft.h"
 
@@ -54,12 +57,43 @@
  *	<_ConditioningValue> will not be calculated be calculated in {LW/CG}deconvolver::run(), 
  *	instead {LW/CG}deconvolver::run() will use <_ConditioningValue> set by user to do pre-conditioning; 
  *	Make sure that you can set <_ConditioningValue> correctly.
+ *
+ *	-------------------------------------------------
+ *	Concurrent Conditioning: <_ConditioningCandidates>
+ *	-------------------------------------------------
+ *
+ *	<_ConditioningCandidates> : it is the number of conditioning values evaluated at once; its default value is 1.
+ *
+ *	If <_ConditioningCandidates> is 1, the search brackets <_ConditioningValue> by decades, 0.1, 0.01, ..., and 
+ *	narrows the bracket by golden search, one conditioning value after the other.
+ *
+ *	If <_ConditioningCandidates> is n > 1, n conditioning values are evaluated at once in n threads, each one with 
+ *	its own object, step and spectrum and <_Threads>/n threads for its kernels and FFTs: the bracketing evaluates 
+ *	n decades at once, and the golden search is replaced by a multi-point search which evaluates n values evenly 
+ *	spaced in the bracket and keeps the neighbours of the best value found, so each round shrinks the bracket by 
+ *	(n+1)/2 at least. With n = 8 the search takes about 5 rounds instead of about 12 sequential evaluations; it 
+ *	pays most when the FFTs of a volume do not scale over all the threads. The value found may differ from the 
+ *	golden search within <_ConditioningTolerance>.
+ *	It needs 2 volumes and 2 half spectra (see "FFTW3fft.h") more per extra candidate during the search, 
+ *	which are freed before the deconvolution loop; init() does not reset it.
+ *
+ *	-----------------------------------------
+ *	Conditioning Cache: <_ConditioningCache>
+ *	-----------------------------------------
+ *
+ *	<_ConditioningCache> : if it is true, the conditioning values found are kept in ConditioningValueCache below 
+ *	                       and a run which matches a kept value uses it without any search; its default value is false.
+ *
+ *	A run matches a kept value if it has the same size, <_ConditioningIteration> and PSF spectrum, and if the mean 
+ *	and the deviation of its image spectrum, which follows the noise level, are equal within <_ConditioningTolerance>,
+ *	e.g. the repeated acquisitions of a same sample with a same PSF. init() does not reset it.
  */
 
 
 #define ConditioningIterationLimit 50
 #define ConditioningValueLimit     1.0E-10
 #define ConditioningToleranceLimit 1.0E-6
+#define ConditioningCandidatesLimit 16
 
 
 class ConditioningIterationError : public Error
@@ -97,22 +131,107 @@ class ConditioningToleranceError : public Error
         }
 } ;
 
+
+class ConditioningCandidatesError : public Error
+{
+        public:
+        ConditioningCandidatesError( unsigned int n )
+        {
+                _error << " Conditioning_Candidates Setup Error ( it must be between 1 and " 
+                       << ConditioningCandidatesLimit << " ) :\n"
+                       << " Conditioning_Candidates was set -> " << n << "\n" ;
+        }
+} ;
+
+
+/*
+	ConditioningValueKey identifies the conditioning search of a run: its size, <_ConditioningIteration>, 
+	the fingerprint <psf> of its PSF spectrum (a 64 bits FNV-1a hash of its values), the spacial support 
+	<support> (0 without one, 1 otherwise) with the fingerprint <mask> of its values, and two statistics 
+	of its image spectrum, <mean> = image[0] / (DimX*DimY*DimZ) and <deviation>, the root mean square of the 
+	other frequencies divided by DimX*DimY*DimZ. operator< orders the keys without the statistics.
+*/
+struct ConditioningValueKey
+{
+	int                 DimX ;
+	int                 DimY ;
+	int                 DimZ ;
+	unsigned int        iterations ;
+	unsigned long long  psf ;
+	int                 support ;
+	unsigned long long  mask ;
+	double              mean ;
+	double              deviation ;
+
+	bool operator<( const ConditioningValueKey & k ) const ;
+} ;
+
+
+
+/*
+	This class is a process-wide registry of the conditioning values found by LWCGdeconvolver::_runConditioning()
+	when LWCGdeconvolver::setConditioningCache() is set.
+
+	lookup() returns true and sets <cv> to the last value stored for the size, iterations, PSF and support of <key>
+	whose statistics are equal to the ones of <key> within the relative <tolerance>.
+	store()  keeps <cv> for <key> and appends it to the file of path() if it is not empty.
+
+	The file keeps the values of the previous processes, it is read before the first lookup().
+	Its path is taken from the environment variable DECONV_CONDITIONING_CACHE if it is set, otherwise 
+	it is empty and the values are kept in memory only. setPath() overrides it and an empty path 
+	disables the file; it forgets the values kept in memory, which are read again from the new file 
+	before the next lookup(). clear() forgets the values kept in memory, the file is kept.
+	All functions are thread-safe and never throw, a missing or unreadable file is simply ignored.
+*/
+class ConditioningValueCache
+{
+	public:
+
+	static bool         lookup( const ConditioningValueKey & key, double tolerance, double & cv ) ;
+
+	static void         store( const ConditioningValueKey & key, double cv ) ;
+
+	static void         setPath( const char * path ) ;
+
+	static std::string  path() ;
+
+	static void         clear() ;
+
+	static int          size() ;
+
+
+	private:
+	typedef std::vector< std::pair< ConditioningValueKey, double > > ValueList ;
+
+	static void             _load() ;
+
+	static ValueList        _values ;
+	static bool             _loaded ;
+	static bool             _init ;
+	static std::string      _path ;
+	static pthread_mutex_t  _lock ;
+} ;
+
                
 class LWCGdeconvolver : public deconvolver
 {
 	public:	
 		virtual ~LWCGdeconvolver() {}
-		LWCGdeconvolver() {}
+		LWCGdeconvolver() : _ConditioningCandidates( 1 ), _ConditioningCache( false ), _FFTplanf( NULL ), _FFTplanb( NULL ) {}
 	
 	/*
 	 *	Get protected members
 	 *	ConditioningIteration() returns <_ConditioningIteration> described above.
 	 *	ConditioningTolerance() returns <_ConditioningTolerance> described above.
 	 *	ConditioningValue()     returns <_ConditioningValue>     described above.
+	 *	ConditioningCandidates() returns <_ConditioningCandidates> described above.
+	 *	ConditioningCache()      returns <_ConditioningCache>      described above.
 	 */
 	unsigned int  ConditioningIteration()  { return _ConditioningIteration ; }
 	double        ConditioningTolerance()  { return _ConditioningTolerance ; }
 	double        ConditioningValue()      { return _ConditioningValue ;     }
+	unsigned int  ConditioningCandidates() { return _ConditioningCandidates ; }
+	bool          ConditioningCache()      { return _ConditioningCache ;      }
 	
 	
 	/*
@@ -143,12 +262,32 @@ class LWCGdeconvolver : public deconvolver
 	 *		throw an error if the input is out of the pre-defined range.
 	 */
 	void    setConditioningValue( double cv = 1.0e-8 ) ;
+	
+	
+	/*
+	 *	Set <_ConditioningCandidates> described above
+	 *	Input:
+	 *		n, it is the number of conditioning values evaluated at once and its default value is 1.
+	 *	Throw:
+	 *		throw an error if the input is out of the pre-defined range.
+	 */
+	void    setConditioningCandidates( unsigned int n = 1 ) ;
+	
+	
+	/*
+	 *	Set <_ConditioningCache> described above
+	 *	Input:
+	 *		IsCache, true to keep and reuse the conditioning values, its default value is false.
+	 */
+	void    setConditioningCache( bool IsCache = false ) { _ConditioningCache = IsCache ; }
         
 
 	protected:        
 	unsigned int    _ConditioningIteration ;
 	double          _ConditioningValue ;
 	double          _ConditioningTolerance ;	
+	unsigned int    _ConditioningCandidates ;
+	bool            _ConditioningCache ;
 	FFTW3_FFT*  	_FFTplanf ;
 	FFTW3_FFT*  	_FFTplanb ;
 	
@@ -156,33 +295,58 @@ class LWCGdeconvolver : public deconvolver
 	
 	void    _exportLWCG( FILE * fp ) ;
 	
-	double  _getLikelihood( int size, double * image_re, double * image_im,  double * psf_re,
+	double  _getLikelihood( size_t size, double * image_re, double * image_im,  double * psf_re,
 	                        double * psf_im,   double * object_re, double * object_im ) ;
                                
-	double  _getLikelihood( int size, float  * image_re, float  * image_im,  float  * psf_re,
+	double  _getLikelihood( size_t size, float  * image_re, float  * image_im,  float  * psf_re,
 	                        float  * psf_im,   float  * object_re, float  * object_im ) ;
                                                   
-	void    _update( int size, double cv, double * object_re, double * object_im, 
+	/*
+	 *	The conditioning search runs on the half spectrum <object_re>, <object_im> of FFTsize() values 
+	 *	with the plans <_FFTplanf>, <_FFTplanb> (see "FFTW3fft.h"); <step> receives the real LW step 
+	 *	and <object0> holds the first estimated object, both of DimX*DimY*DimZ values.
+	 *	If <_Interleaved> is set, the plans are status 4 ones and all the spectra are interleaved, 
+	 *	each <*_im> pointing to the value after <*_re>, except a real <psf_re> whose <psf_im> is NULL.
+	 */
+	void    _update( size_t size, double cv, double * step, double * object_re, double * object_im, 
 	                 double * image_re, double * image_im, double * psf_re, double * psf_im, double * otf ) ;
                                    
-	void    _update( int size, double cv, float * object_re, float * object_im, 
+	void    _update( size_t size, double cv, float * step, float * object_re, float * object_im, 
 	                 float * image_re, float * image_im, float * psf_re, float * psf_im, float * otf ) ;
 			
-	double  _getSumLikelihood( int size, double cv, double * object0, double * object, 
+	double  _getSumLikelihood( size_t size, double cv, double * object0, double * object, double * step, 
 	                           double * object_re, double * object_im, double * image_re, double * image_im, 
 	                           double * psf_re, double * psf_im, double * otf, unsigned char * SpacialSupport ) ;
 
-	double  _getSumLikelihood( int size, double cv, float * object0, float * object, 
+	double  _getSumLikelihood( size_t size, double cv, float * object0, float * object, float * step, 
 	                           float * object_re, float * object_im, float * image_re, float * image_im, 
 	                           float * psf_re, float * psf_im, float * otf, unsigned char * SpacialSupport ) ;
 
-	double  _runConditioning( int size, double * object0, double * object, 
+	double  _runConditioning( size_t size, double * object0, double * object, double * step, 
 	                          double * object_re, double * object_im, double * image_re, double * image_im, 
 	                          double * psf_re, double * psf_im, double * otf, unsigned char * SpacialSupport ) ;
 				 
-	double  _runConditioning( int size, float * object0, float * object, 
+	double  _runConditioning( size_t size, float * object0, float * object, float * step, 
 	                          float * object_re, float * object_im, float * image_re, float * image_im, 
 	                          float * psf_re, float * psf_im, float * otf, unsigned char * SpacialSupport ) ;
+
+	/* 
+	 *	_cachedConditioning() returns true and <cv> if <_ConditioningCache> is set and ConditioningValueCache 
+	 *	has a value for <key>, which it fills from the image and PSF spectra and the spacial support of _runConditioning().
+	 *	_storeConditioning() keeps <cv> for <key> if <_ConditioningCache> is set and returns <cv>.
+	 */
+	bool    _cachedConditioning( ConditioningValueKey & key, size_t size, double * image_re, double * image_im, 
+	                             double * psf_re, double * psf_im, unsigned char * SpacialSupport, double & cv ) ;
+
+	bool    _cachedConditioning( ConditioningValueKey & key, size_t size, float * image_re, float * image_im, 
+	                             float * psf_re, float * psf_im, unsigned char * SpacialSupport, double & cv ) ;
+
+	double  _storeConditioning( const ConditioningValueKey & key, double cv ) ;
+
+	/* the search of <_ConditioningCandidates> values at once called by _runConditioning(), same arguments */
+	template< class T >
+	double  _searchConditioning( size_t size, T * object0, T * object, T * step, T * object_re, T * object_im, 
+	                             T * image_re, T * image_im, T * psf_re, T * psf_im, T * otf, unsigned char * SpacialSupport ) ;
 } ;
 
 
@@ -21,27 +21,151 @@
 
 #include <math.h>
 #include "LWdeconvolver.h"
+#include "SPECTRALkernels.h"
+
+template< class WS >
+static void LWdeallocate( WS & ws )
+{
+	WS_free( ws.psf_re ) ;
+	WS_free( ws.psf_im ) ;
+	WS_free( ws.image_re ) ;
+	WS_free( ws.image_im ) ;
+	WS_free( ws.otf ) ;
+	WS_free( ws.buf_re ) ;
+	WS_free( ws.buf_im ) ;
+	WS_free( ws.search ) ;
+}
+
+/*
+	The LW working space: seven spectra of <size>, six if the PSF spectrum is real, split or interleaved, 
+	and the search point of <space> values for the accelerated iterations, 
+	allocated with fftw_malloc(); returns its size in bytes.
+	If an array can not be allocated, the ones already allocated are freed and std::bad_alloc is thrown.
+*/
+template< class WS >
+static size_t LWallocate( WS & ws, size_t size, bool interleaved, bool real, size_t space )
+{
+	size_t bytes = 0 ;
+	size_t n     = interleaved ? 2 * size : size ;
+	
+	ws.size = size ;
+	ws.real = real ;
+	try
+	{
+		bytes += WS_malloc( ws.psf_re,   real ? size : n ) ;
+		bytes += WS_malloc( ws.psf_im,   ( real || interleaved ) ? 0 : size ) ;
+		bytes += WS_malloc( ws.image_re, n ) ;
+		bytes += WS_malloc( ws.image_im, interleaved ? 0 : size ) ;
+		bytes += WS_malloc( ws.otf,      size ) ;
+		bytes += WS_malloc( ws.buf_re,   n ) ;
+		bytes += WS_malloc( ws.buf_im,   interleaved ? 0 : size ) ;
+		bytes += WS_malloc( ws.search,   space ) ;
+	}
+	catch( std::bad_alloc & )
+	{
+		LWdeallocate( ws ) ;
+		throw ;
+	}
+	
+	return bytes ;
+}
+
+
+/*
+	The momentum of the accelerated iterations, see "LWdeconvolver.h".
+	LWmomentum   : search = object + beta * ( object - last ); returns the sum of 
+	               ( search - object ) * ( object - last ) with the search point of the last step, 
+	               which is positive when the last step went against the momentum.
+	LWaccelerate : moves the search point with the momentum of <t>, or restarts it at the object;
+	               returns the next <t>.
+*/
+template< class T >
+struct LWmomentum
+{
+	typedef double result ;
+	T * search ; const T * object ; const T * last ; double beta ;
+	
+	double operator()( size_t begin, size_t end ) const
+	{
+		double restart = 0.0 ;
+		T d ;
+		for( size_t i = begin ; i < end ; i++ )
+		{
+			d = object[i] - last[i] ;
+			restart  += ( search[i] - object[i] ) * d ;
+			search[i] = (T)( object[i] + beta * d ) ;
+		}
+		return restart ;
+	}
+	
+	void join( double & total, const double & partial ) const { total += partial ; }
+} ;
+
+/*
+	Scale the conditioned spectra so that SPECTRAL_residual() gives the sum of <steps> Landweber steps,
+	see "LWdeconvolver.h"; <ws.otf> holds a = otf / ( otf + cv ) and the scale tends to <steps> when a tends to 0.
+	<image_im> holds the imaginary parts of the image spectrum, which is interleaved in <ws.image_re>
+	(<image_im> = <ws.image_re> + 1) if <interleaved> is true; the volume is split over <nthreads> threads.
+*/
+template< class T >
+struct LWmultiStepBody
+{
+	T * re ; T * im ; T * otf ; size_t S ; double steps ;
+	
+	void operator()( size_t begin, size_t end ) const
+	{
+		double a, scale ;
+		for( size_t k = begin, i = begin * S ; k < end ; k++, i += S )
+		{
+			a = otf[k] ;
+			scale = ( a > 1.0E-8 ) ? ( 1.0 - pow( 1.0 - a, steps ) ) / a : steps ;
+			re[i]  *= scale ;
+			im[i]  *= scale ;
+			otf[k] *= scale ;
+		}
+	}
+} ;
+
+template< class WS, class T >
+static void LWmultiStep( WS & ws, T * image_im, unsigned int steps, bool interleaved, int nthreads )
+{
+	LWmultiStepBody< T > body = { ws.image_re, image_im, ws.otf, interleaved ? 2u : 1u, (double) steps } ;
+	my_parallel_range( ws.size, body, nthreads ) ;
+}
+
+template< class T >
+static double LWaccelerate( size_t space, T * search, const T * object, const T * last, double t, int nthreads )
+{
+	double t_next = 0.5 * ( 1.0 + sqrt( 1.0 + 4.0 * t * t ) ) ;
+	LWmomentum< T > momentum = { search, object, last, ( t - 1.0 ) / t_next } ;
+	
+	if( my_parallel_reduce( space, momentum, nthreads ) <= 0.0 ) return t_next ;
+	for( size_t i = 0 ; i < space ; i++ ) search[i] = object[i] ;
+	return 1.0 ;
+}
+
+
 
 /* public functions */
 
 LWdeconvolver::LWdeconvolver()
 {
+	_LinearSteps = 1 ;
 	init() ; 
 }
 	
 LWdeconvolver::~LWdeconvolver()
 {
-	if (_FFTplanf)
-		delete _FFTplanf ;
-		
-	if (_FFTplanb)
-		delete _FFTplanb ;
+	FFTW3_PlanCache::release( _FFTplanf ) ;
+	FFTW3_PlanCache::release( _FFTplanb ) ;
 }
 
-void LWdeconvolver::init( bool IsApplyNorm, bool IsTrackLike, bool IsTrackMax, bool IsCheckStatus )
+void LWdeconvolver::init( bool IsApplyNorm, bool IsTrackLike, bool IsTrackMax, bool IsCheckStatus, bool IsAccelerate )
 {
 	_setControlFlags( IsCheckStatus, IsApplyNorm, IsTrackMax, IsTrackLike ) ;
 	
+	_Accelerate = IsAccelerate ;
+	
 	setConditioningIteration() ;
 	setConditioningValue() ;
 	setConditioningTolerance() ;
@@ -64,6 +188,16 @@ void LWdeconvolver::exportLW( const char * filename )
 	if( fp )
 	{
 		_exportLWCG( fp ) ;
+		
+		fprintf( fp, "%d -> Apply accelerated iterations with momentum restart in the deconvolution loop.\n", ((int) _Accelerate) ) ; 
+		fprintf( fp, "\n" ) ;
+		
+		if( _LinearSteps > 1 )
+		{
+			fprintf( fp, "%d -> Landweber steps applied in closed form between two projections.\n", _LinearSteps ) ;
+			fprintf( fp, "\n" ) ;
+		}
+		
 		fclose( fp ) ;
 	}
 	else
@@ -72,70 +206,194 @@ void LWdeconvolver::exportLW( const char * filename )
 	}
 }
 
+void LWdeconvolver::allocWorkspace( int DimX, int DimY, int DimZ, LWdws & ws )
+{
+	freeWorkspace( ws ) ;
+	_setDimensions( DimX, DimY, DimZ ) ;
+	ws.bytes = LWallocate( ws, FFTW3_FFT::FFTsize( _DimX, _DimY, _DimZ ), _Interleaved, _RealOTF, _Accelerate ? _Space : 0 ) ;
+}
+
+void LWdeconvolver::allocWorkspace( int DimX, int DimY, int DimZ, LWsws & ws )
+{
+	freeWorkspace( ws ) ;
+	_setDimensions( DimX, DimY, DimZ ) ;
+	ws.bytes = LWallocate( ws, FFTW3_FFT::FFTsize( _DimX, _DimY, _DimZ ), _Interleaved, _RealOTF, _Accelerate ? _Space : 0 ) ;
+}
+
+void LWdeconvolver::freeWorkspace( LWdws & ws )
+{
+	LWdeallocate( ws ) ;
+	ws.size  = 0 ;
+	ws.bytes = 0 ;
+}
+
+void LWdeconvolver::freeWorkspace( LWsws & ws )
+{
+	LWdeallocate( ws ) ;
+	ws.size  = 0 ;
+	ws.bytes = 0 ;
+}
+
 void LWdeconvolver::run( int DimX, int DimY, int DimZ, double * object_re, double * object_im, double * object, 
                          LWdws & ws, unsigned char * SpacialSupport, unsigned char * FrequencySupport )
 {
-	double max_intensity = 0.0, cri = 1.0E+37, temp1, temp2 ;
+	/* initialize running */
+	_LWstartRun( DimX, DimY, DimZ, ws ) ;
+
+	/* start initialization */
+	if( _CheckStatus ) _LWprintStatus( 1 ) ;
+	if( _Interleaved ) _initPSF( _FFTplanf, object_im, ws.psf_re, FrequencySupport, ws.otf ) ;
+	else               _initPSF( ws.size, object_im, ws.psf_re, ws.psf_im, FrequencySupport, ws.otf ) ;
+	_LWrunFrame( object_re, object_im, object, ws, SpacialSupport, _ConditioningIteration > 0 ) ;
 	
+	/* end deconvolution */
+	_LWfinishRun( ws ) ;	
+}
+
+void LWdeconvolver::run( int DimX, int DimY, int DimZ, float * object_re, float * object_im, float * object, 
+                         LWsws & ws, unsigned char * SpacialSupport, unsigned char * FrequencySupport )
+{
 	/* initialize running */
 	_LWstartRun( DimX, DimY, DimZ, ws ) ;
 
 	/* start initialization */
 	if( _CheckStatus ) _LWprintStatus( 1 ) ;
-	_initPSF( ws.size, object_im, ws.psf_re, ws.psf_im, FrequencySupport, ws.otf ) ;
+	if( _Interleaved ) _initPSF( _FFTplanf, object_im, ws.psf_re, FrequencySupport, ws.otf ) ;
+	else               _initPSF( ws.size, object_im, ws.psf_re, ws.psf_im, FrequencySupport, ws.otf ) ;
+	_LWrunFrame( object_re, object_im, object, ws, SpacialSupport, _ConditioningIteration > 0 ) ;
+	
+	/* end deconvolution */
+	_LWfinishRun( ws ) ;	
+}
+
+void LWdeconvolver::run( int DimX, int DimY, int DimZ, const double * image, const double * psf, double * object, 
+                         LWdws & ws, unsigned char * SpacialSupport, unsigned char * FrequencySupport )
+{
+	double * scratch = NULL ;
+	
+	/* initialize running */
+	_LWstartRun( DimX, DimY, DimZ, ws ) ;
+	WS_malloc( scratch, 2 * (size_t)_Space ) ;
+
+	/* start initialization, the forward transform of the psf does not rewrite it */
+	if( _CheckStatus ) _LWprintStatus( 1 ) ;
+	if( _Interleaved ) _initPSF( _FFTplanf, const_cast< double * >( psf ), ws.psf_re, FrequencySupport, ws.otf ) ;
+	else               _initPSF( ws.size, const_cast< double * >( psf ), ws.psf_re, ws.psf_im, FrequencySupport, ws.otf ) ;
+	for( size_t i = 0 ; i < _Space ; i++ ) scratch[i] = image[i] ;
+	_LWrunFrame( scratch, scratch + _Space, object, ws, SpacialSupport, _ConditioningIteration > 0 ) ;
+	WS_free( scratch ) ;
+	
+	/* end deconvolution */
+	_LWfinishRun( ws ) ;	
+}
+
+void LWdeconvolver::run( int DimX, int DimY, int DimZ, const float * image, const float * psf, float * object, 
+                         LWsws & ws, unsigned char * SpacialSupport, unsigned char * FrequencySupport )
+{
+	float * scratch = NULL ;
+	
+	/* initialize running */
+	_LWstartRun( DimX, DimY, DimZ, ws ) ;
+	WS_malloc( scratch, 2 * (size_t)_Space ) ;
+
+	/* start initialization, the forward transform of the psf does not rewrite it */
+	if( _CheckStatus ) _LWprintStatus( 1 ) ;
+	if( _Interleaved ) _initPSF( _FFTplanf, const_cast< float * >( psf ), ws.psf_re, FrequencySupport, ws.otf ) ;
+	else               _initPSF( ws.size, const_cast< float * >( psf ), ws.psf_re, ws.psf_im, FrequencySupport, ws.otf ) ;
+	for( size_t i = 0 ; i < _Space ; i++ ) scratch[i] = image[i] ;
+	_LWrunFrame( scratch, scratch + _Space, object, ws, SpacialSupport, _ConditioningIteration > 0 ) ;
+	WS_free( scratch ) ;
+	
+	/* end deconvolution */
+	_LWfinishRun( ws ) ;	
+}
+
+/* private functions */
+
+/*
+	Deconvolve one image after the PSF has been transformed into <ws>: the part of run() 
+	which LWsession::run() repeats for each image; the conditioning value is searched if <condition> is true.
+	The spectra are kept in <ws>, so <object_re> receives the step of each iteration and <object_im> 
+	keeps the first estimated object while conditioning and the last one in the deconvolution loop.
+*/
+void LWdeconvolver::_LWrunFrame( double * object_re, double * object_im, double * object, LWdws & ws,
+                                 unsigned char * SpacialSupport, bool condition )
+{
+	double max_intensity = 0.0, cri = 1.0E+37, temp1, temp2 ;
+	
+	/* the imaginary parts of the spectra follow their real parts in the interleaved layout */
+	size_t S = _Interleaved ? 2 : 1 ;
+	double * image_im = _Interleaved ? ws.image_re + 1 : ws.image_im ;
+	double * buf_im   = _Interleaved ? ws.buf_re + 1   : ws.buf_im ;
+	double * psf_im   = ( _Interleaved && !ws.real ) ? ws.psf_re + 1 : ws.psf_im ;
+
 	_initIMG( max_intensity, object_re, object, SpacialSupport ) ;
-	fft3d( _DimX, _DimY, _DimZ, object_re, ws.image_re, ws.image_im ) ;	
+	_FFTplanf->forward( object_re, ws.image_re, ws.image_im ) ;	
 	if( _CheckStatus ) _LWprintStatus( 2 ) ;
 			
 	/* start conditioning */
-	if( _ConditioningIteration > 0 )
+	if( condition )
 	{
 		if( _CheckStatus ) _LWprintStatus( 3 ) ;
-		for( int i = 0 ; i < _Space ; i++ ) ws.object0[i] = object[i] ;
-		_ConditioningValue = _runConditioning( ws.size, ws.object0, object, object_re, object_im,
-		                     ws.image_re, ws.image_im, ws.psf_re, ws.psf_im, ws.otf, SpacialSupport ) ;
-		for( int i = 0 ; i < _Space ; i++ ) object[i] = ws.object0[i] ;
-		delete [] ws.object0 ;
-		ws.object0 = NULL ;
+		for( size_t i = 0 ; i < _Space ; i++ ) object_im[i] = object[i] ;
+		_ConditioningValue = _runConditioning( ws.size, object_im, object, object_re, ws.buf_re, buf_im,
+		                     ws.image_re, image_im, ws.psf_re, psf_im, ws.otf, SpacialSupport ) ;
+		for( size_t i = 0 ; i < _Space ; i++ ) object[i] = object_im[i] ;
 		if( _CheckStatus ) _LWprintStatus( 4 ) ;
 	}
 	
 	/* initialize arrays in deconvolution loop */
-	if( !_TrackLikelihood )
+	if( !_TrackLikelihood && ws.real )
 	{
-		for( int i = 0 ; i < ws.size ; i++ )
+		for( size_t k = 0, i = 0 ; k < ws.size ; k++, i += S )
 		{
-			         temp1 = ws.otf[i] + _ConditioningValue ;
-			         temp2 = ( ws.image_re[i]*ws.psf_re[i] + ws.image_im[i]*ws.psf_im[i] ) / temp1 ;
-			ws.image_im[i] = ( ws.image_im[i]*ws.psf_re[i] - ws.image_re[i]*ws.psf_im[i] ) / temp1 ;
+			         temp1 = ws.otf[k] + _ConditioningValue ;
+			ws.image_re[i] = ws.image_re[i]*ws.psf_re[k] / temp1 ;
+			   image_im[i] = image_im[i]*ws.psf_re[k] / temp1 ;
+			     ws.otf[k] = ws.otf[k] / temp1 ;
+		}
+	}
+	else if( !_TrackLikelihood )
+	{
+		for( size_t k = 0, i = 0 ; k < ws.size ; k++, i += S )
+		{
+			         temp1 = ws.otf[k] + _ConditioningValue ;
+			         temp2 = ( ws.image_re[i]*ws.psf_re[i] + image_im[i]*psf_im[i] ) / temp1 ;
+			   image_im[i] = ( image_im[i]*ws.psf_re[i] - ws.image_re[i]*psf_im[i] ) / temp1 ;
 			ws.image_re[i] = temp2 ;
-			     ws.otf[i] = ws.otf[i] / temp1 ;
+			     ws.otf[k] = ws.otf[k] / temp1 ;
 		}
 	}
+	if( !_TrackLikelihood && _LinearSteps > 1 ) LWmultiStep( ws, image_im, _LinearSteps, _Interleaved, _Threads ) ;
+	
+	/* the accelerated iterations start from the first estimated object, the plain ones step from the object */
+	double * search = object ;
+	double t = 1.0 ;
+	if( _Accelerate )
+	{
+		search = ws.search ;
+		for( size_t i = 0 ; i < _Space ; i++ ) search[i] = object[i] ;
+	}
 	
 	/* deconvolution loop */
 	if( _CheckStatus ) _LWprintStatus( 5 ) ;
 	while( _Update.size() < _MaxRunIteration && cri > _Criterion )
 	{
 		if( _CheckStatus ) _LWprintStatus( 6 ) ;		
-		_FFTplanf->execute( object, object_re, object_im  ) ;		
+		_FFTplanf->forward( search, ws.buf_re, ws.buf_im ) ;		
 		if( _TrackLikelihood )
 		{
-			_Likelihood.push_back( _getLikelihood( ws.size, ws.image_re, ws.image_im, 
-			                       ws.psf_re, ws.psf_im, object_re, object_im ) ) ;
-     			_LWupdate1( object_re, object_im, ws ) ;   
+			_Likelihood.push_back( _getLikelihood( ws.size, ws.image_re, image_im, 
+			                       ws.psf_re, psf_im, ws.buf_re, buf_im ) ) ;
+     			_LWupdate1( object_re, ws ) ;   
 		}
 		else
 		{
-			_LWupdate2( object_re, object_im, ws ) ; 
+			_LWupdate2( object_re, ws ) ; 
 		}		
-		for( int i = 0 ; i < _Space ; i++ )
-		{
-			object_im[i]  = object[i] ;
-			   object[i] += object_re[i] ;
-			if( object[i] < 0.0 ) object[i] = 0.0 ;
-		}     		
-		_getUpdate( object, object_im, SpacialSupport ) ;   
+		_pushUpdate( object, object_im, UPDATE_object( _Space, object, object_im, true, 
+		             UPDATE_add< double >( search, object_re ), SpacialSupport, _Threads ) ) ;
+		if( _Accelerate ) t = LWaccelerate( _Space, search, object, object_im, t, _Threads ) ;
 		if( _Update.size() >= 10 )
 		{
 			cri = 0.0 ;
@@ -143,77 +401,90 @@ void LWdeconvolver::run( int DimX, int DimY, int DimZ, double * object_re, doubl
 			cri /= 10.0 ;
 		}
 		if( _CheckStatus ) _LWprintStatus( 7 ) ;
-	}	
-	
-	/* end deconvolution */
-	_LWfinishRun( ws ) ;	
+	}
 }
 
-void LWdeconvolver::run( int DimX, int DimY, int DimZ, float * object_re, float * object_im, float * object, 
-                         LWsws & ws, unsigned char * SpacialSupport, unsigned char * FrequencySupport )
+
+
+void LWdeconvolver::_LWrunFrame( float * object_re, float * object_im, float * object, LWsws & ws,
+                                 unsigned char * SpacialSupport, bool condition )
 {
 	float  max_intensity = 0.0, temp1, temp2 ;
 	double cri = 1.0E+37 ;
+	
+	/* the imaginary parts of the spectra follow their real parts in the interleaved layout */
+	size_t S = _Interleaved ? 2 : 1 ;
+	float * image_im = _Interleaved ? ws.image_re + 1 : ws.image_im ;
+	float * buf_im   = _Interleaved ? ws.buf_re + 1   : ws.buf_im ;
+	float * psf_im   = ( _Interleaved && !ws.real ) ? ws.psf_re + 1 : ws.psf_im ;
 
-	/* initialize running */
-	_LWstartRun( DimX, DimY, DimZ, ws ) ;
-
-	/* start initialization */
-	if( _CheckStatus ) _LWprintStatus( 1 ) ;
-	_initPSF( ws.size, object_im, ws.psf_re, ws.psf_im, FrequencySupport, ws.otf ) ;
 	_initIMG( max_intensity, object_re, object, SpacialSupport ) ;
-	fft3d( _DimX, _DimY, _DimZ, object_re, ws.image_re, ws.image_im ) ;	
+	_FFTplanf->forward( object_re, ws.image_re, ws.image_im ) ;	
 	if( _CheckStatus ) _LWprintStatus( 2 ) ;
 	
 	/* start conditioning */
-	if( _ConditioningIteration > 0 )
+	if( condition )
 	{
 		if( _CheckStatus ) _LWprintStatus( 3 ) ;
-		for( int i = 0 ; i < _Space ; i++ ) ws.object0[i] = object[i] ;
-		_ConditioningValue = _runConditioning( ws.size, ws.object0, object, object_re, object_im, 
-		                     ws.image_re, ws.image_im, ws.psf_re, ws.psf_im, ws.otf, SpacialSupport ) ;
-		for( int i = 0 ; i < _Space ; i++ ) object[i] = ws.object0[i] ;
-		delete [] ws.object0 ;
-		ws.object0 = NULL ;
+		for( size_t i = 0 ; i < _Space ; i++ ) object_im[i] = object[i] ;
+		_ConditioningValue = _runConditioning( ws.size, object_im, object, object_re, ws.buf_re, buf_im, 
+		                     ws.image_re, image_im, ws.psf_re, psf_im, ws.otf, SpacialSupport ) ;
+		for( size_t i = 0 ; i < _Space ; i++ ) object[i] = object_im[i] ;
 		if( _CheckStatus ) _LWprintStatus( 4 ) ;
 	}
 	
 	/* initialize arrays in deconvolution loop */
-	if( !_TrackLikelihood )
+	if( !_TrackLikelihood && ws.real )
+	{
+		for( size_t k = 0, i = 0 ; k < ws.size ; k++, i += S )
+		{
+			         temp1 = ws.otf[k] + _ConditioningValue ;
+			ws.image_re[i] = ws.image_re[i]*ws.psf_re[k] / temp1 ;
+			   image_im[i] = image_im[i]*ws.psf_re[k] / temp1 ;
+			     ws.otf[k] = ws.otf[k] / temp1 ;
+		}
+	}
+	else if( !_TrackLikelihood )
 	{
-		for( int i = 0 ; i < ws.size ; i++ )
+		for( size_t k = 0, i = 0 ; k < ws.size ; k++, i += S )
 		{
-			         temp1 = ws.otf[i] + _ConditioningValue ;
-			         temp2 = ( ws.image_re[i]*ws.psf_re[i] + ws.image_im[i]*ws.psf_im[i] ) / temp1 ;
-			ws.image_im[i] = ( ws.image_im[i]*ws.psf_re[i] - ws.image_re[i]*ws.psf_im[i] ) / temp1 ;
+			         temp1 = ws.otf[k] + _ConditioningValue ;
+			         temp2 = ( ws.image_re[i]*ws.psf_re[i] + image_im[i]*psf_im[i] ) / temp1 ;
+			   image_im[i] = ( image_im[i]*ws.psf_re[i] - ws.image_re[i]*psf_im[i] ) / temp1 ;
 			ws.image_re[i] = temp2 ;
-			     ws.otf[i] = ws.otf[i] / temp1 ;
+			     ws.otf[k] = ws.otf[k] / temp1 ;
 		}
 	}
+	if( !_TrackLikelihood && _LinearSteps > 1 ) LWmultiStep( ws, image_im, _LinearSteps, _Interleaved, _Threads ) ;
+	
+	/* the accelerated iterations start from the first estimated object, the plain ones step from the object */
+	float * search = object ;
+	double t = 1.0 ;
+	if( _Accelerate )
+	{
+		search = ws.search ;
+		for( size_t i = 0 ; i < _Space ; i++ ) search[i] = object[i] ;
+	}
 	
 	/* deconvolution loop */
 	if( _CheckStatus ) _LWprintStatus( 5 ) ;
 	while( _Update.size() < _MaxRunIteration && cri > _Criterion )
 	{
 		if( _CheckStatus ) _LWprintStatus( 6 ) ;		
-		_FFTplanf->execute( object, object_re, object_im  ) ;		
+		_FFTplanf->forward( search, ws.buf_re, ws.buf_im ) ;		
 		if( _TrackLikelihood )
 		{
-			_Likelihood.push_back( _getLikelihood( ws.size, ws.image_re, ws.image_im, 
-			                       ws.psf_re, ws.psf_im, object_re, object_im ) ) ;
-			_LWupdate1( object_re, object_im, ws ) ;  
+			_Likelihood.push_back( _getLikelihood( ws.size, ws.image_re, image_im, 
+			                       ws.psf_re, psf_im, ws.buf_re, buf_im ) ) ;
+			_LWupdate1( object_re, ws ) ;  
 		}
 		else
 		{
-			_LWupdate2( object_re, object_im, ws ) ; 
+			_LWupdate2( object_re, ws ) ; 
 		}		
-		for( int i = 0 ; i < _Space ; i++ )
-		{
-			object_im[i]  = object[i] ;
-			   object[i] += object_re[i] ;
-			if( object[i] < 0.0 ) object[i] = 0.0 ;
-		}
-		_getUpdate( object, object_im, SpacialSupport ) ; 
+		_pushUpdate( object, object_im, UPDATE_object( _Space, object, object_im, true, 
+		             UPDATE_add< float >( search, object_re ), SpacialSupport, _Threads ) ) ;
+		if( _Accelerate ) t = LWaccelerate( _Space, search, object, object_im, t, _Threads ) ;
 		if( _Update.size() >= 10 )
 		{
 			cri = 0.0 ;
@@ -222,12 +493,9 @@ void LWdeconvolver::run( int DimX, int DimY, int DimZ, float * object_re, float
 		}
 		if( _CheckStatus ) _LWprintStatus( 7 ) ;
 	}
-	
-	/* end deconvolution */
-	_LWfinishRun( ws ) ;	
 }
 
-/* private functions */
+
 
 void LWdeconvolver::_LWprintStatus( int stage )
 {
@@ -276,6 +544,10 @@ void LWdeconvolver::_LWprintStatus( int stage )
 		case 5:
 			std::cout << " LWdeconvolver::run starts the loop with conditioning value = " 
 			          << _ConditioningValue << ".\n" ;
+			if( !_TrackLikelihood && _LinearSteps > 1 )
+			{
+				std::cout << " LWdeconvolver::run applys " << _LinearSteps << " Landweber steps per iteration.\n" ;
+			}
 			break ;
 
 		case 6:
@@ -306,6 +578,11 @@ void LWdeconvolver::_LWprintStatus( int stage )
 void LWdeconvolver::_LWstartRun( int DimX, int DimY, int DimZ, LWdws & ws )
 {
 	_setDimensions( DimX, DimY, DimZ ) ;
+	if( ws.bytes > 0 && ( ws.size != FFTW3_FFT::FFTsize( _DimX, _DimY, _DimZ ) || _Interleaved != ( ws.buf_im == NULL ) || 
+	                      _RealOTF != ws.real || ( _Accelerate && ws.search == NULL ) ) )
+	{
+		throw WorkspaceError( ws.size, FFTW3_FFT::FFTsize( _DimX, _DimY, _DimZ ) ) ;
+	}
 	double memory = (double)_Space * 3.0 ;
 
 	time( &_StartRunTime ) ;
@@ -317,28 +594,16 @@ void LWdeconvolver::_LWstartRun( int DimX, int DimY, int DimZ, LWdws & ws )
 	time( &_t0 ) ;
 	std::cout << " LWdeconvolver::run starts creating FFT plans ... \n" ;
 
-	_FFTplanf = new FFTW3_FFT (_DimX, _DimY, _DimZ, true,  true, 1) ; 	
-	_FFTplanb = new FFTW3_FFT (_DimX, _DimY, _DimZ, false, true, 2); 
+	_FFTplanf = FFTW3_PlanCache::acquire( _DimX, _DimY, _DimZ, true,  true, _Interleaved ? 4 : 3, _PlannerEffort, _Threads ) ;
+	_FFTplanb = FFTW3_PlanCache::acquire( _DimX, _DimY, _DimZ, false, true, _Interleaved ? 4 : 3, _PlannerEffort, _Threads ) ;
 
 	time( &_t1 ) ;
 	std::cout << " LWdeconvolver::run completes creating FFT plans, elapsed "
 	          << difftime( _t1, _t0 ) << " seconds.\n" ;
 
-	ws.size = _FFTplanf->FFTsize() ;
-	memory += ( (double)ws.size * 5.0 ) ;
-	
-	ws.psf_re   = new double[ ws.size ] ;
-	ws.psf_im   = new double[ ws.size ] ;
-	ws.image_re = new double[ ws.size ] ;
-	ws.image_im = new double[ ws.size ] ;
-	ws.otf      = new double[ ws.size ] ;
-	
-	if( _ConditioningIteration > 0 )
-	{
-		ws.object0 = new double[ _Space ] ;
-		memory += (double)_Space ;
-	}
-	else    ws.object0 = NULL ;
+	if( ws.bytes == 0 ) LWallocate( ws, _FFTplanf->FFTsize(), _Interleaved, _RealOTF, _Accelerate ? _Space : 0 ) ;
+	memory += ( (double)ws.size * ( ws.real ? 6.0 : 7.0 ) ) ;
+	if( ws.search != NULL ) memory += (double)_Space ;
 	
 	if( _Update.size()  > 0 ) _Update.clear() ;
 	if( _Likelihood.size() > 0 ) _Likelihood.clear() ;
@@ -350,6 +615,11 @@ void LWdeconvolver::_LWstartRun( int DimX, int DimY, int DimZ, LWdws & ws )
 void LWdeconvolver::_LWstartRun( int DimX, int DimY, int DimZ, LWsws & ws )
 {
 	_setDimensions( DimX, DimY, DimZ ) ;
+	if( ws.bytes > 0 && ( ws.size != FFTW3_FFT::FFTsize( _DimX, _DimY, _DimZ ) || _Interleaved != ( ws.buf_im == NULL ) || 
+	                      _RealOTF != ws.real || ( _Accelerate && ws.search == NULL ) ) )
+	{
+		throw WorkspaceError( ws.size, FFTW3_FFT::FFTsize( _DimX, _DimY, _DimZ ) ) ;
+	}
 	double memory = (double)_Space * 3.0 ;
 
 	time( &_StartRunTime ) ;
@@ -361,28 +631,17 @@ void LWdeconvolver::_LWstartRun( int DimX, int DimY, int DimZ, LWsws & ws )
 	time( &_t0 ) ;
 	std::cout << " LWdeconvolver::run starts creating FFT plans ... \n" ;
 
-	_FFTplanf = new FFTW3_FFT (_DimX, _DimY, _DimZ, true,  false, 1 ); 
+	_FFTplanf = FFTW3_PlanCache::acquire( _DimX, _DimY, _DimZ, true,  false, _Interleaved ? 4 : 3, _PlannerEffort, _Threads ) ;
 	
-	_FFTplanb = new FFTW3_FFT (_DimX, _DimY, _DimZ, false, false, 2) ; 
+	_FFTplanb = FFTW3_PlanCache::acquire( _DimX, _DimY, _DimZ, false, false, _Interleaved ? 4 : 3, _PlannerEffort, _Threads ) ;
 		
 	time( &_t1 ) ;
 	std::cout << " LWdeconvolver::run completes creating FFT plans, elapsed "
 	          << difftime( _t1, _t0 ) << " seconds.\n" ;
 
-	ws.size = _FFTplanf->FFTsize() ;
-	memory += ( (double)ws.size * 5.0 ) ;
-
-	ws.psf_re   = new float[ ws.size ] ;
-	ws.psf_im   = new float[ ws.size ] ;
-	ws.image_re = new float[ ws.size ] ;
-	ws.image_im = new float[ ws.size ] ;
-	ws.otf      = new float[ ws.size ] ;
-	if( _ConditioningIteration > 0 )
-	{
-		ws.object0 = new float[ _Space ] ;
-		memory += (double)_Space ;
-	}
-	else    ws.object0 = NULL ;
+	if( ws.bytes == 0 ) LWallocate( ws, _FFTplanf->FFTsize(), _Interleaved, _RealOTF, _Accelerate ? _Space : 0 ) ;
+	memory += ( (double)ws.size * ( ws.real ? 6.0 : 7.0 ) ) ;
+	if( ws.search != NULL ) memory += (double)_Space ;
 	
 	if( _Update.size()  > 0 ) _Update.clear() ;
 	if( _Likelihood.size() > 0 ) _Likelihood.clear() ;
@@ -393,11 +652,12 @@ void LWdeconvolver::_LWstartRun( int DimX, int DimY, int DimZ, LWsws & ws )
 
 void LWdeconvolver::_LWfinishRun( LWdws & ws )
 {
-	if( ws.psf_re   != NULL ) delete [] ws.psf_re ;
-	if( ws.psf_im   != NULL ) delete [] ws.psf_im ;
-	if( ws.image_re != NULL ) delete [] ws.image_re ;
-	if( ws.image_im != NULL ) delete [] ws.image_im ;
-	if( ws.otf      != NULL ) delete [] ws.otf ;
+	if( ws.bytes == 0 ) LWdeallocate( ws ) ;
+
+	FFTW3_PlanCache::release( _FFTplanf ) ;
+	FFTW3_PlanCache::release( _FFTplanb ) ;
+	_FFTplanf = NULL ;
+	_FFTplanb = NULL ;
 		
 	time( &_StopRunTime ) ;
 	std::cout << " LWdeconvolution finish running at " << ctime( &_StopRunTime ) ;
@@ -405,74 +665,174 @@ void LWdeconvolver::_LWfinishRun( LWdws & ws )
 
 void LWdeconvolver::_LWfinishRun( LWsws & ws )
 {
-	if( ws.psf_re   != NULL ) delete [] ws.psf_re ;
-	if( ws.psf_im   != NULL ) delete [] ws.psf_im ;
-	if( ws.image_re != NULL ) delete [] ws.image_re ;
-	if( ws.image_im != NULL ) delete [] ws.image_im ;
-	if( ws.otf      != NULL ) delete [] ws.otf ;
+	if( ws.bytes == 0 ) LWdeallocate( ws ) ;
+
+	FFTW3_PlanCache::release( _FFTplanf ) ;
+	FFTW3_PlanCache::release( _FFTplanb ) ;
+	_FFTplanf = NULL ;
+	_FFTplanb = NULL ;
 	
 	time( &_StopRunTime ) ;
 	std::cout << " LWdeconvolution finish running at " << ctime( &_StopRunTime ) ;
 }
 
-void LWdeconvolver::_LWupdate1( double * object_re, double * object_im, LWdws & ws  )
+void LWdeconvolver::_LWupdate1( double * step, LWdws & ws )
 {
-	double temp1, temp2, temp3, temp4 ;
+	if( _Interleaved )
+		SPECTRAL_landweber<2>( ws.size, ws.buf_re, ws.buf_re + 1, ws.image_re, ws.image_re + 1, ws.psf_re, 
+		                       ws.real ? NULL : ws.psf_re + 1, ws.otf, _ConditioningValue, _Threads ) ;
+	else
+		SPECTRAL_landweber<1>( ws.size, ws.buf_re, ws.buf_im, ws.image_re, ws.image_im, ws.psf_re, ws.psf_im, ws.otf, 
+		                       _ConditioningValue, _Threads ) ;
+	_FFTplanb->backward( ws.buf_re, ws.buf_im, step ) ;
+}
+
+
+
+void LWdeconvolver::_LWupdate1( float * step, LWsws & ws )
+{
+	if( _Interleaved )
+		SPECTRAL_landweber<2>( ws.size, ws.buf_re, ws.buf_re + 1, ws.image_re, ws.image_re + 1, ws.psf_re, 
+		                       ws.real ? NULL : ws.psf_re + 1, ws.otf, _ConditioningValue, _Threads ) ;
+	else
+		SPECTRAL_landweber<1>( ws.size, ws.buf_re, ws.buf_im, ws.image_re, ws.image_im, ws.psf_re, ws.psf_im, ws.otf, 
+		                       _ConditioningValue, _Threads ) ;
+	_FFTplanb->backward( ws.buf_re, ws.buf_im, step ) ;
+}
+
+
+
+void LWdeconvolver::_LWupdate2( double * step, LWdws & ws )
+{
+	if( _Interleaved )
+		SPECTRAL_residual<2>( ws.size, ws.buf_re, ws.buf_re + 1, ws.image_re, ws.image_re + 1, ws.otf, _Threads ) ;
+	else
+		SPECTRAL_residual<1>( ws.size, ws.buf_re, ws.buf_im, ws.image_re, ws.image_im, ws.otf, _Threads ) ;
+	_FFTplanb->backward( ws.buf_re, ws.buf_im, step ) ;
+}
+
+
+ 
+void LWdeconvolver::_LWupdate2( float * step, LWsws & ws )
+{
+	if( _Interleaved )
+		SPECTRAL_residual<2>( ws.size, ws.buf_re, ws.buf_re + 1, ws.image_re, ws.image_re + 1, ws.otf, _Threads ) ;
+	else
+		SPECTRAL_residual<1>( ws.size, ws.buf_re, ws.buf_im, ws.image_re, ws.image_im, ws.otf, _Threads ) ;
+	_FFTplanb->backward( ws.buf_re, ws.buf_im, step ) ;
+}
+
+
+/* 
+	LWsession: the FFT of the PSF and the OTF are kept from prepare(); the OTF is copied 
+	back before each run() since the deconvolution loop scales it by the conditioning value.
+*/
+
+LWsession::LWsession()
+{
+	_Prepared    = false ;
+	_IsDouble    = true ;
+	_Conditioned = false ;
+	_dscratch    = NULL ;
+	_sscratch    = NULL ;
+	_dotf        = NULL ;
+	_sotf        = NULL ;
+}
+
+
+
+LWsession::~LWsession()
+{
+	release() ;
+}
+
+
+
+void LWsession::prepare( int DimX, int DimY, int DimZ, double * psf, unsigned char * FrequencySupport )
+{
+	release() ;
 	
-	for( int i = 0 ; i < ws.size ; i++ )
-	{
-		       temp1 = ws.otf[i] + _ConditioningValue ;
-		       temp2 = ( ws.image_re[i]*ws.psf_re[i] + ws.image_im[i]*ws.psf_im[i] ) / temp1 ;
-		       temp3 = ( ws.image_im[i]*ws.psf_re[i] - ws.image_re[i]*ws.psf_im[i] ) / temp1 ;
-		       temp4 = ws.otf[i] / temp1 ;
-		object_re[i] = temp2 - temp4 * object_re[i] ;
-		object_im[i] = temp3 - temp4 * object_im[i] ;
-	}
-	       	
-	_FFTplanb->execute( object_re, object_im, object_re ) ;
+	_LWstartRun( DimX, DimY, DimZ, _dws ) ;
+	WS_malloc( _dscratch, _Space ) ;
+	WS_malloc( _dotf, _dws.size ) ;
+	if( _Interleaved ) _initPSF( _FFTplanf, psf, _dws.psf_re, FrequencySupport, _dws.otf ) ;
+	else               _initPSF( _dws.size, psf, _dws.psf_re, _dws.psf_im, FrequencySupport, _dws.otf ) ;
+	for( size_t i = 0 ; i < _dws.size ; i++ ) _dotf[i] = _dws.otf[i] ;
+	
+	_IsDouble    = true ;
+	_Conditioned = false ;
+	_Prepared    = true ;
 }
 
 
 
-void LWdeconvolver::_LWupdate1( float * object_re, float * object_im, LWsws & ws )
+void LWsession::run( double * image, double * object, unsigned char * SpacialSupport )
 {
-	float temp1, temp2, temp3, temp4 ;
+	if( !_Prepared || !_IsDouble ) throw SessionError( "LWsession" ) ;
 	
-	for( int i = 0 ; i < ws.size ; i++ )
-	{
-		       temp1 = ws.otf[i] + _ConditioningValue ;
-		       temp2 = ( ws.image_re[i]*ws.psf_re[i] + ws.image_im[i]*ws.psf_im[i] ) / temp1 ;
-		       temp3 = ( ws.image_im[i]*ws.psf_re[i] - ws.image_re[i]*ws.psf_im[i] ) / temp1 ;
-		       temp4 = ws.otf[i] / temp1 ;
-		object_re[i] = temp2 - temp4 * object_re[i] ;
-		object_im[i] = temp3 - temp4 * object_im[i] ;
-	}
-       	
-	_FFTplanb->execute( object_re, object_im, object_re ) ;	
+	if( _Update.size()  > 0 ) _Update.clear() ;
+	if( _Likelihood.size() > 0 ) _Likelihood.clear() ;
+	if( _ObjectMax.size()  > 0 ) _ObjectMax.clear() ;
+	_ApplySpacialSupport = false ;
+	
+	if( _CheckStatus ) _LWprintStatus( 1 ) ;
+	for( size_t i = 0 ; i < _dws.size ; i++ ) _dws.otf[i] = _dotf[i] ;
+	_LWrunFrame( image, _dscratch, object, _dws, SpacialSupport, !_Conditioned && _ConditioningIteration > 0 ) ;
+	_Conditioned = true ;
 }
 
 
 
-void LWdeconvolver::_LWupdate2( double * object_re, double * object_im, LWdws & ws )
+void LWsession::prepare( int DimX, int DimY, int DimZ, float * psf, unsigned char * FrequencySupport )
 {
-	for( int i = 0 ; i < ws.size ; i++ )
-	{
-		object_re[i] = ws.image_re[i] - ws.otf[i] * object_re[i] ;
-		object_im[i] = ws.image_im[i] - ws.otf[i] * object_im[i] ;
-	}
-       	
-	_FFTplanb->execute( object_re, object_im, object_re ) ;
+	release() ;
+	
+	_LWstartRun( DimX, DimY, DimZ, _sws ) ;
+	WS_malloc( _sscratch, _Space ) ;
+	WS_malloc( _sotf, _sws.size ) ;
+	if( _Interleaved ) _initPSF( _FFTplanf, psf, _sws.psf_re, FrequencySupport, _sws.otf ) ;
+	else               _initPSF( _sws.size, psf, _sws.psf_re, _sws.psf_im, FrequencySupport, _sws.otf ) ;
+	for( size_t i = 0 ; i < _sws.size ; i++ ) _sotf[i] = _sws.otf[i] ;
+	
+	_IsDouble    = false ;
+	_Conditioned = false ;
+	_Prepared    = true ;
 }
 
 
- 
-void LWdeconvolver::_LWupdate2( float * object_re, float * object_im, LWsws & ws )
+
+void LWsession::run( float * image, float * object, unsigned char * SpacialSupport )
 {
-	for( int i = 0 ; i < ws.size ; i++ )
+	if( !_Prepared || _IsDouble ) throw SessionError( "LWsession" ) ;
+	
+	if( _Update.size()  > 0 ) _Update.clear() ;
+	if( _Likelihood.size() > 0 ) _Likelihood.clear() ;
+	if( _ObjectMax.size()  > 0 ) _ObjectMax.clear() ;
+	_ApplySpacialSupport = false ;
+	
+	if( _CheckStatus ) _LWprintStatus( 1 ) ;
+	for( size_t i = 0 ; i < _sws.size ; i++ ) _sws.otf[i] = _sotf[i] ;
+	_LWrunFrame( image, _sscratch, object, _sws, SpacialSupport, !_Conditioned && _ConditioningIteration > 0 ) ;
+	_Conditioned = true ;
+}
+
+
+
+void LWsession::release()
+{
+	if( _Prepared )
 	{
-		object_re[i] = ws.image_re[i] - ws.otf[i] * object_re[i] ;
-		object_im[i] = ws.image_im[i] - ws.otf[i] * object_im[i] ;
+		if( _IsDouble ) _LWfinishRun( _dws ) ;
+		else            _LWfinishRun( _sws ) ;
 	}
-       	
-	_FFTplanb->execute( object_re, object_im, object_re ) ;
+	WS_free( _dscratch ) ;
+	WS_free( _dotf ) ;
+	WS_free( _sscratch ) ;
+	WS_free( _sotf ) ;
+	
+	_dscratch    = NULL ;
+	_sscratch    = NULL ;
+	_dotf        = NULL ;
+	_sotf        = NULL ;
+	_Prepared = false ;
 }
@@ -34,6 +34,35 @@
  *	===================================================================================================
  *
  *
+ *		------------------------------------
+ *		Accelerated Landweber: <_Accelerate>
+ *		------------------------------------
+ *		If <_Accelerate> is true, run() applies the Landweber step on a search point extrapolated from 
+ *		the last two estimated objects with the momentum of FISTA (A. Beck and M. Teboulle, SIAM Journal 
+ *		on Imaging Sciences 2, 2009), and restarts the momentum whenever the last step went against it 
+ *		(B. O'Donoghue and E. Candes, Foundations of Computational Mathematics 15, 2015). The FFT plans 
+ *		and the conditioned spectra are the same as for the plain iterations, the working space takes 
+ *		one more volume for the search point. The update and the likelihood are tracked as before; 
+ *		CriterionIteration() (see "deconvolver.h") tells how many iterations each mode takes.
+ *		The momentum keeps the update of the accelerated iterations larger while they approach the solution
+ *		faster, so a same <_Criterion> stops them later and closer to it; compare the modes on the likelihood.
+ *		The likelihood tracked in the accelerated iterations is the one of the search point.
+ *
+ *
+ *		----------------------------------
+ *		Linear Multi-Steps: <_LinearSteps>
+ *		----------------------------------
+ *		Without the positivity and the spacial support, K conditioned Landweber steps on the object are 
+ *		a polynomial of the conditioned OTF a = otf / ( otf + cv ): the spectrum of their sum is 
+ *		S * ( image - a * object ) with S = ( 1 - ( 1 - a )^K ) / a. If <_LinearSteps> is K > 1, run() scales 
+ *		the conditioned spectra by S once, and each iteration applies K steps in closed form with one pair 
+ *		of FFTs before the positivity and the spacial support are projected; <_MaxRunIteration>, <_Update> 
+ *		and <_Criterion> then count such iterations. The projection every K steps may converge to a slightly 
+ *		different object than the projection every step. The spectra can only be scaled when the likelihood 
+ *		is not tracked, run() takes one step per iteration otherwise. <_LinearSteps> is 1 by default 
+ *		and init() does not reset it.
+ *
+ *
  *		----------------------------------------------------------------------
  *		run() : <image>, <psf>, <object>, <SpacialSupport>, <FrequencySupport>
  *		----------------------------------------------------------------------
@@ -43,7 +72,8 @@
  *		*****************************
  *		The input cubic image to be deconvolved, with the dimensions of DimX, DimY and DimZ 
  *		where DimX is its fastest varying dimension and DimZ is its slowest varying dimension, 
- *		must have a black (0) background. Each dimension of the cubic image must be a power of 2. 
+ *		must have a black (0) background. Any positive dimensions are allowed, but FFTs are fastest if
+ *		each dimension is a product of 2, 3, 5 and 7; pad the image to such a size with "PADfft.h". 
  *		The image data must be stored in an one-dimensional array : <image> as "x+y*DimX+z*DimX*DimY".
  *		
  *		Warnning: the <image> array will be rewritten in run(). 
@@ -95,32 +125,49 @@
 
 /*
  *	LWdeconvolver working space in double floating precision
+ *	<bytes> is the size in bytes of a working space from allocWorkspace(); it is 0 if run() allocates its own.
+ *	<buf_re> and <buf_im> hold the spectrum of the estimated object.
+ *	The spectra <psf_*>, <image_*> and <buf_*> have <size> values each; if the deconvolver is interleaved 
+ *	(see "deconvolver.h"), <psf_re>, <image_re> and <buf_re> hold <size> (re, im) pairs and the <*_im> are NULL.
+ *	<real> is true if the PSF spectrum is real (see setRealOTF() in "deconvolver.h"); <psf_re> then holds 
+ *	<size> real values in both layouts and <psf_im> is NULL.
+ *	<search> holds the search point of the accelerated iterations; it is NULL if they are not applied.
  */
-typedef struct
+struct LWdws
 {
-	int size ;
+	LWdws() : size( 0 ), bytes( 0 ), real( false ), psf_re( NULL ), psf_im( NULL ), image_re( NULL ), image_im( NULL ), otf( NULL ), buf_re( NULL ), buf_im( NULL ), search( NULL ) {}
+	size_t size ;
+	size_t bytes ;
+	bool real ;
 	double * psf_re ;
 	double * psf_im ;
 	double * image_re ;
 	double * image_im ;
 	double * otf ;
-	double * object0 ;
-} LWdws ;
+	double * buf_re ;
+	double * buf_im ;
+	double * search ;
+} ;
 
 
 /*
  *	LWdeconvolver working space in single floating precision
  */
-typedef struct
+struct LWsws
 {
-	int size ;
+	LWsws() : size( 0 ), bytes( 0 ), real( false ), psf_re( NULL ), psf_im( NULL ), image_re( NULL ), image_im( NULL ), otf( NULL ), buf_re( NULL ), buf_im( NULL ), search( NULL ) {}
+	size_t size ;
+	size_t bytes ;
+	bool real ;
 	float * psf_re ;
 	float * psf_im ;
 	float * image_re ;
 	float * image_im ;
 	float * otf ;
-	float * object0 ;
-} LWsws ;
+	float * buf_re ;
+	float * buf_im ;
+	float * search ;
+} ;
 
                
 class LWdeconvolver : public LWCGdeconvolver
@@ -135,6 +182,8 @@ class LWdeconvolver : public LWCGdeconvolver
 	 *		IsTrackLike,   it is the track_likelihood      indicator. (described in "deconvolver.h")
 	 *		IsTrackMax,    it is the track_max_intensity   indicator. (described in "deconvolver.h")
 	 *		IsCheckStatus, it is the check_program_running indicator. (described in "deconvolver.h")
+	 *		IsAccelerate,  it is to indicate whether to apply the accelerated iterations or not;
+	 *		               see the description for the accelerated Landweber above in this file.
 	 *	Warning:
 	 *		<_MaxRunIteration>       will be set to be its default value. (described in "deconvolver.h")
 	 *		<_Criterion>             will be set to be its default value. (described in "deconvolver.h")
@@ -142,17 +191,36 @@ class LWdeconvolver : public LWCGdeconvolver
 	 *		<_ConditioningValue>     will be set to be its default value. (described in "LWCGdeconvolver.h")
 	 *		<_ConditioningTolerance> will be set to be its default value. (described in "LWCGdeconvolver.h")
 	 */ 	
-	void    init(  bool IsApplyNorm = false, bool IsTrackLike = false, bool IsTrackMax = false, bool IsCheckStatus = true ) ;
+	void    init(  bool IsApplyNorm = false, bool IsTrackLike = false, bool IsTrackMax = false, bool IsCheckStatus = true,
+	               bool IsAccelerate = false ) ;
+
+
+	/*
+	 *	Get <_Accelerate> (see the description of the accelerated Landweber above).
+	 */
+	bool    Accelerate() { return _Accelerate ; }
+
+
+	/*
+	 *	Get/set <_LinearSteps> (see the description of the linear multi-steps above).
+	 *	Input:
+	 *		steps, it is the number of Landweber steps between two projections; 
+	 *		       a number less than 1 is taken as 1 and its default is 1.
+	 */
+	unsigned int  LinearSteps() { return _LinearSteps ; }
+	void    setLinearSteps( unsigned int steps = 1 ) { _LinearSteps = ( steps < 1 ) ? 1 : steps ; }
 
 
 	/*
 	 *	Run LWdeconvolution in double floating precision
 	 *	Input:
-	 *		DimX,             it is the fastest varying dimension of the image/psf; it must be power of 2.
-	 *		DimY,             it is the middle          dimension of the image/psf; it must be power of 2.
-	 *		DimZ,             it is the slowest varying dimension of the image/psf; it must be power of 2.
-	 *		image,            it points to an one-dimensional DimX*DimY*DimZ array storing the image data.
-	 *		psf,              it points to an one-dimensional DimX*DimY*DimZ array storing the psf data.
+	 *		DimX,             it is the fastest varying dimension of the image/psf; it must be positive.
+	 *		DimY,             it is the middle          dimension of the image/psf; it must be positive.
+	 *		DimZ,             it is the slowest varying dimension of the image/psf; it must be positive.
+	 *		image,            it points to an one-dimensional DimX*DimY*DimZ array storing the image data;
+	 *		                  it will be rewritten.
+	 *		psf,              it points to an one-dimensional DimX*DimY*DimZ array storing the psf data;
+	 *		                  it will be rewritten.
 	 *		object,           it points to an one-dimensional DimX*DimY*DimZ array storing both 
 	 *		                  the first estimated object data and the finally deconvolved object data. 
 	 *		ws,               it points to the LWdeconvolver double/float working space. 
@@ -168,6 +236,37 @@ class LWdeconvolver : public LWCGdeconvolver
 	void    run( int DimX, int DimY, int DimZ, float  * image, float  * psf, float  * object, LWsws & ws,
 	             unsigned char * SpacialSupport = NULL, unsigned char * FrequencySupport = NULL ) ;
 
+
+	/*
+	 *	Run LWdeconvolution without rewriting the image and the psf, in double/single floating precision
+	 *	The input is the same as for run() above, but <image> and <psf> are only read; the run allocates 
+	 *	two DimX*DimY*DimZ scratch volumes and frees them at its end.
+	 *	Throw:
+	 *		throw an error if a given dimension is wrong.
+	 */
+	void    run( int DimX, int DimY, int DimZ, const double * image, const double * psf, double * object, LWdws & ws,
+	             unsigned char * SpacialSupport = NULL, unsigned char * FrequencySupport = NULL ) ;
+	void    run( int DimX, int DimY, int DimZ, const float  * image, const float  * psf, float  * object, LWsws & ws,
+	             unsigned char * SpacialSupport = NULL, unsigned char * FrequencySupport = NULL ) ;
+
+	
+	/*
+	 *	Allocate/free a LWdeconvolver working space once for many runs of a same size
+	 *	The working space is allocated with fftw_malloc() for the dimensions and the control flags set at 
+	 *	the time; run() then uses it instead of allocating and freeing its own. 
+	 *	Input:
+	 *		DimX, DimY, DimZ, they are the dimensions of the runs; each must be positive.
+	 *		ws,               it is the working space; ws.bytes returns its size in bytes.
+	 *	Throw:
+	 *		throw an error if a given dimension is wrong; run() throws an error if the working space 
+	 *		does not fit its dimensions or control flags; std::bad_alloc is thrown, and nothing is
+	 *		allocated, if the memory runs out.
+	 */
+	void    allocWorkspace( int DimX, int DimY, int DimZ, LWdws & ws ) ;
+	void    allocWorkspace( int DimX, int DimY, int DimZ, LWsws & ws ) ;
+	void    freeWorkspace( LWdws & ws ) ;
+	void    freeWorkspace( LWsws & ws ) ;
+	
 	
 	/*
 	 *	Export the profile of a LWdeconvolver to a text file
@@ -179,7 +278,10 @@ class LWdeconvolver : public LWCGdeconvolver
 	void    exportLW( const char * filename ) ;
 	
 	
-	private:        
+	protected:
+	bool            _Accelerate ;
+	unsigned int    _LinearSteps ;
+        
 	void    _LWprintStatus( int stage ) ;
         
 	void    _LWstartRun( int DimX, int DimY, int DimZ, LWdws & ws ) ;
@@ -188,11 +290,92 @@ class LWdeconvolver : public LWCGdeconvolver
 	void    _LWfinishRun( LWdws & ws ) ;
 	void    _LWfinishRun( LWsws & ws ) ;
         
-	void    _LWupdate1( double * object_re, double * object_im, LWdws & ws ) ; 
-	void    _LWupdate1( float  * object_re, float  * object_im, LWsws & ws ) ;
+	void    _LWrunFrame( double * object_re, double * object_im, double * object, LWdws & ws, unsigned char * SpacialSupport, bool condition ) ;
+	void    _LWrunFrame( float  * object_re, float  * object_im, float  * object, LWsws & ws, unsigned char * SpacialSupport, bool condition ) ;
         
-	void  _LWupdate2( double * object_re, double * object_im, LWdws & ws ) ; 
-	void  _LWupdate2( float  * object_re, float  * object_im, LWsws & ws ) ;
+	void    _LWupdate1( double * step, LWdws & ws ) ; 
+	void    _LWupdate1( float  * step, LWsws & ws ) ;
+        
+	void  _LWupdate2( double * step, LWdws & ws ) ; 
+	void  _LWupdate2( float  * step, LWsws & ws ) ;
+} ;
+
+
+
+/*
+ *	===========================================================================================
+ *	LWsession runs LWdeconvolution on many images taken with a same PSF, e.g. the frames of a 
+ *	time-lapse series: prepare() creates the FFT plans, the working space and the FFT of the PSF 
+ *	once, and each run() then deconvolves one image without allocating memory or creating plans.
+ *	===========================================================================================
+ *
+ *	The control flags and parameters are set as for a LWdeconvolver, before prepare().
+ *	The conditioning value is searched on the first image run and then used for the following ones;
+ *	set <_ConditioningIteration> to 0 and give <_ConditioningValue> before prepare() to skip the search.
+ */
+class LWsession : public LWdeconvolver
+{
+	public:
+	LWsession() ;
+	virtual ~LWsession() ;
+	
+	
+	/*
+	 *	Prepare a session in double/single floating precision
+	 *	Input:
+	 *		DimX, DimY, DimZ, they are the dimensions of the psf and of every image; each must be positive.
+	 *		psf,              it points to an one-dimensional DimX*DimY*DimZ array storing the psf data;
+	 *		                  it is not kept by the session.
+	 *		FrequencySupport, it points to an one-dimensional unsigned char DimX*DimY*DimZ
+	 *		                  array storing the frequency support data and its default is NULL.
+	 *	Throw:
+	 *		throw an error if a given dimension is wrong.
+	 */
+	void    prepare( int DimX, int DimY, int DimZ, double * psf, unsigned char * FrequencySupport = NULL ) ;
+	void    prepare( int DimX, int DimY, int DimZ, float  * psf, unsigned char * FrequencySupport = NULL ) ;
+	
+	
+	/*
+	 *	Run LWdeconvolution on one image with the prepared psf
+	 *	Input:
+	 *		image,            it points to an one-dimensional DimX*DimY*DimZ array storing the image data;
+	 *		                  it will be rewritten.
+	 *		object,           it points to an one-dimensional DimX*DimY*DimZ array storing both 
+	 *		                  the first estimated object data and the finally deconvolved object data. 
+	 *		SpacialSuppport,  it points to an one-dimensional unsigned char DimX*DimY*DimZ 
+	 *		                  array storing the spacial support data and its default is NULL.
+	 *	Throw:
+	 *		throw an error if the session has not been prepared in the same floating precision.
+	 */
+	void    run( double * image, double * object, unsigned char * SpacialSupport = NULL ) ;
+	void    run( float  * image, float  * object, unsigned char * SpacialSupport = NULL ) ;
+	
+	
+	/*
+	 *	Release the FFT plans and the working space of a session; it is called by prepare() and the destructor.
+	 */
+	void    release() ;
+	
+	
+	/*
+	 *	Get the state of a session
+	 *	IsPrepared() returns true after prepare() and until release().
+	 *	IsDouble()   returns true if the session was prepared in double floating precision.
+	 */
+	bool    IsPrepared()  { return _Prepared ; }
+	bool    IsDouble()    { return _IsDouble ; }
+	
+	
+	private:
+	bool      _Prepared ;
+	bool      _IsDouble ;
+	bool      _Conditioned ;
+	LWdws     _dws ;
+	LWsws     _sws ;
+	double *  _dscratch ;
+	float  *  _sscratch ;
+	double *  _dotf ;
+	float  *  _sotf ;
 } ;
 
 
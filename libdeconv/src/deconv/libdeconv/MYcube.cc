@@ -45,7 +45,7 @@ void read_my_cube_hdr( std::string filehead, int& length, int& width, int& heigh
 	}
 }
 
-void read_my_byte_cube_data( const char* filename, int cube_size, unsigned char * buf )
+void read_my_byte_cube_data( const char* filename, size_t cube_size, unsigned char * buf )
 {
 	FILE * fp = fopen( filename, "r" ) ;
 	
@@ -53,7 +53,7 @@ void read_my_byte_cube_data( const char* filename, int cube_size, unsigned char
 		throw ErrnoError( std::string(filename) ) ;
 	else
 	{
-		int index = 0 ;
+		size_t index = 0 ;
 		unsigned char* pbuf = buf ;
 
 		while (index < cube_size) {
@@ -67,7 +67,7 @@ void read_my_byte_cube_data( const char* filename, int cube_size, unsigned char
 	} 
 }
 
-void read_my_short_cube_data( const char* filename, int cube_size, unsigned short * buf )
+void read_my_short_cube_data( const char* filename, size_t cube_size, unsigned short * buf )
 {
 	FILE * fp = fopen( filename, "r" ) ;
 	
@@ -75,7 +75,7 @@ void read_my_short_cube_data( const char* filename, int cube_size, unsigned shor
 		throw ErrnoError( std::string(filename) ) ;
 	else
 	{
-		int index = 0 ;
+		size_t index = 0 ;
 		unsigned short* pbuf = buf ;
 
 		while (!feof(fp)) {
@@ -94,7 +94,7 @@ void read_my_short_cube_data( const char* filename, int cube_size, unsigned shor
 	}
 }
 
-void read_my_single_cube_data( const char* filename, int cube_size, float * buf )
+void read_my_single_cube_data( const char* filename, size_t cube_size, float * buf )
 {
 	FILE * fp = fopen( filename, "r" ) ;
 	
@@ -102,7 +102,7 @@ void read_my_single_cube_data( const char* filename, int cube_size, float * buf
 		throw ErrnoError( std::string(filename) ) ;
 	else
 	{
-		int index = 0 ;
+		size_t index = 0 ;
 		float* pbuf = buf ;
 
 		while (index < cube_size) {
@@ -117,7 +117,7 @@ void read_my_single_cube_data( const char* filename, int cube_size, float * buf
 	}
 }
 
-void read_my_double_cube_data( const char* filename, int cube_size, double * buf )
+void read_my_double_cube_data( const char* filename, size_t cube_size, double * buf )
 {
 	FILE * fp = fopen( filename, "r" ) ;
 	
@@ -125,7 +125,7 @@ void read_my_double_cube_data( const char* filename, int cube_size, double * buf
 		throw ErrnoError( std::string(filename) ) ;
 	else
 	{
-		int index = 0 ;
+		size_t index = 0 ;
 		double* pbuf = buf ;
 
 		while (index < cube_size) {
@@ -164,10 +164,10 @@ void write_my_byte_cube( const char* filehead, int length, int width, int height
 		throw ErrnoError( filename ) ;
 	else
 	{
-		int index = 0 ;
+		size_t index = 0 ;
 		unsigned char* pbuf = buf ;
 
-		while (index < length * width * height) {
+		while (index < (size_t) length * width * height) {
 
 			if (!fwrite (pbuf++, sizeof (unsigned char), 1, fp))
 				throw WriteDataError (std::string(filename)) ;
@@ -190,10 +190,10 @@ void write_my_short_cube( const char* filehead, int length, int width, int heigh
 		throw ErrnoError( filename ) ;
 	else
 	{
-		int index = 0 ;
+		size_t index = 0 ;
 		unsigned short* pbuf = buf ;
 
-		while (index < length * height * width) {
+		while (index < (size_t) length * height * width) {
 			unsigned short val ;
          	swab ((char*)pbuf++, (char*)&val, sizeof (unsigned short)) ;
 
@@ -218,10 +218,10 @@ void write_my_single_cube( const char* filehead, int length, int width, int heig
 		throw ErrnoError( filename ) ;
 	else
 	{
-		int index = 0 ;
+		size_t index = 0 ;
 		float* pbuf = buf ;
 
-		while (index < length * width * height) {
+		while (index < (size_t) length * width * height) {
 
 			if (!fwrite (pbuf++, sizeof (float), 1, fp))
 				throw WriteDataError (std::string(filename)) ;
@@ -244,10 +244,10 @@ void write_my_double_cube( const char* filehead, int length, int width, int heig
 		throw ErrnoError( filename ) ;
 	else
 	{
-		int index = 0 ;
+		size_t index = 0 ;
 		double* pbuf = buf ;
 
-		while (index < length * width * height) {
+		while (index < (size_t) length * width * height) {
 
 			if (!fwrite (pbuf++, sizeof (double), 1, fp))
 				throw WriteDataError (std::string(filename)) ;
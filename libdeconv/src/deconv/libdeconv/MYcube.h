@@ -26,10 +26,10 @@
 
 
 void read_my_cube_hdr        ( std::string filehead, int& length, int& width, int& height ) ;
-void read_my_byte_cube_data  ( const char* filename, int cube_size, unsigned char  * buf ) ;
-void read_my_short_cube_data ( const char* filename, int cube_size, unsigned short * buf ) ;
-void read_my_single_cube_data( const char* filename, int cube_size, float  * buf ) ;
-void read_my_double_cube_data( const char* filename, int cube_size, double * buf ) ;
+void read_my_byte_cube_data  ( const char* filename, size_t cube_size, unsigned char  * buf ) ;
+void read_my_short_cube_data ( const char* filename, size_t cube_size, unsigned short * buf ) ;
+void read_my_single_cube_data( const char* filename, size_t cube_size, float  * buf ) ;
+void read_my_double_cube_data( const char* filename, size_t cube_size, double * buf ) ;
 
 
 void write_my_cube_hdr   ( const char* filehead, int length, int width, int height ) ;
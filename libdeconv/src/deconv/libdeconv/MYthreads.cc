@@ -0,0 +1,103 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:    Yuansheng Sun (yuansheng-sun@uiowa.edu)
+ * Copyright: University of Iowa 2006
+ *
+ * Filename:  MYthreads.cc
+ */
+
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <vector>
+#include "MYthreads.h"
+
+
+static int my_threads = 0 ;
+
+
+int get_my_threads()
+{
+	if( my_threads < 1 )
+	{
+		const char * env = getenv( "DECONV_NUM_THREADS" ) ;
+		int n = env ? atoi( env ) : 1 ;
+		my_threads = ( n < 1 ) ? 1 : n ;
+	}
+	return my_threads ;
+}
+
+void set_my_threads( int nthreads )
+{
+	my_threads = ( nthreads < 1 ) ? 1 : nthreads ;
+}
+
+
+
+typedef struct
+{
+	my_work  work ;
+	void   * arg ;
+	size_t   begin ;
+	size_t   end ;
+} my_chunk ;
+
+
+static void * my_run_chunk( void * p )
+{
+	my_chunk * c = (my_chunk *) p ;
+	c->work( c->begin, c->end, c->arg ) ;
+	return NULL ;
+}
+
+void my_parallel_for( size_t n, size_t grain, my_work work, void * arg, int nthreads )
+{
+	if( n == 0 )
+		return ;
+
+	int nt = ( nthreads < 1 ) ? get_my_threads() : nthreads ;
+	if( grain < 1 ) grain = 1 ;
+	if( (size_t) nt > n / grain ) nt = (int)( n / grain ) ;
+	if( nt <= 1 )
+	{
+		work( 0, n, arg ) ;
+		return ;
+	}
+
+	std::vector< my_chunk >  chunks( nt ) ;
+	std::vector< pthread_t > threads( nt ) ;
+	std::vector< bool >      started( nt, false ) ;
+
+	for( int t = 0 ; t < nt ; t++ )
+	{
+		chunks[t].work  = work ;
+		chunks[t].arg   = arg ;
+		chunks[t].begin = n / nt * t + n % nt * t / nt ;
+		chunks[t].end   = n / nt * ( t + 1 ) + n % nt * ( t + 1 ) / nt ;
+	}
+
+	for( int t = 1 ; t < nt ; t++ )
+		started[t] = ( pthread_create( &threads[t], NULL, my_run_chunk, &chunks[t] ) == 0 ) ;
+
+	my_run_chunk( &chunks[0] ) ;
+
+	for( int t = 1 ; t < nt ; t++ )
+	{
+		if( started[t] )
+			pthread_join( threads[t], NULL ) ;
+		else
+			my_run_chunk( &chunks[t] ) ;
+	}
+}
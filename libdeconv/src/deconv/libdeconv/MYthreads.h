@@ -0,0 +1,122 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:    Yuansheng Sun (yuansheng-sun@uiowa.edu)
+ * Copyright: University of Iowa 2006
+ *
+ * Filename:  MYthreads.h
+ */
+
+
+#ifndef MYTHREADS_H
+#define MYTHREADS_H
+
+
+#include <stddef.h>
+#include <vector>
+
+
+/*
+	The number of threads used by the deconvolution library.
+
+	get_my_threads() returns the default number of threads; it is taken from the environment 
+	variable DECONV_NUM_THREADS when it is first called, and it is 1 if the variable is not set.
+	set_my_threads() overrides the default; a number less than 1 is taken as 1.
+
+	A deconvolver uses the default number of threads unless deconvolver::setThreads() is called.
+*/
+int   get_my_threads() ;
+void  set_my_threads( int nthreads ) ;
+
+
+/*
+	Split the loop [0, n) into <nthreads> contiguous chunks and run work( begin, end, arg ) 
+	on each chunk in its own thread; the calling thread runs the first chunk and returns when all are done.
+	Every chunk has at least <grain> iterations, so a short loop runs in fewer threads or 
+	directly in the calling thread. <nthreads> less than 1 takes get_my_threads(). <work> must not throw.
+*/
+typedef void (*my_work)( size_t begin, size_t end, void * arg ) ;
+
+void  my_parallel_for( size_t n, size_t grain, my_work work, void * arg, int nthreads = 0 ) ;
+
+
+/*
+	The per-voxel and per-frequency loops of the deconvolvers run through the two templates below,
+	<Body> is a functor holding the arrays of the loop; the loops run over size_t indices, so that 
+	a volume may have more than 2^31 voxels.
+
+	my_parallel_range()  : body( begin, end ) updates the elements [begin, end).
+	my_parallel_reduce() : body( begin, end ) returns the partial result of the elements [begin, end) 
+	                       of type Body::result, and body.join( total, partial ) adds a partial result to total.
+
+	A reduction is cut into blocks of MY_BLOCK iterations whatever the number of threads, and the 
+	partial results are joined in the order of the blocks, so the result does not depend on <nthreads>. 
+	A thread is given MY_GRAIN iterations at least.
+*/
+#define MY_GRAIN  32768
+#define MY_BLOCK  8192
+
+template< class Body >
+void my_range( size_t begin, size_t end, void * arg )
+{
+	( *(const Body *) arg )( begin, end ) ;
+}
+
+template< class Body >
+inline void my_parallel_range( size_t n, const Body & body, int nthreads )
+{
+	if( nthreads <= 1 || n < 2 * MY_GRAIN ) body( 0, n ) ;
+	else my_parallel_for( n, MY_GRAIN, my_range< Body >, (void *) &body, nthreads ) ;
+}
+
+
+template< class Body >
+struct my_reduction
+{
+	const Body *                          body ;
+	size_t                                n ;
+	std::vector< typename Body::result >  partial ;
+} ;
+
+template< class Body >
+void my_reduce_blocks( size_t begin, size_t end, void * arg )
+{
+	my_reduction< Body > * r = (my_reduction< Body > *) arg ;
+	
+	for( size_t b = begin ; b < end ; b++ )
+	{
+		size_t last = ( b + 1 ) * MY_BLOCK ;
+		r->partial[b] = ( *r->body )( b * MY_BLOCK, ( last < r->n ) ? last : r->n ) ;
+	}
+}
+
+template< class Body >
+inline typename Body::result my_parallel_reduce( size_t n, const Body & body, int nthreads )
+{
+	size_t blocks = ( n + MY_BLOCK - 1 ) / MY_BLOCK ;
+	if( blocks <= 1 ) return body( 0, n ) ;
+	
+	my_reduction< Body > r ;
+	r.body = &body ;
+	r.n    = n ;
+	r.partial.resize( blocks ) ;
+	my_parallel_for( blocks, MY_GRAIN / MY_BLOCK, my_reduce_blocks< Body >, &r, ( nthreads < 1 ) ? 1 : nthreads ) ;
+	
+	typename Body::result total = r.partial[0] ;
+	for( size_t b = 1 ; b < blocks ; b++ ) body.join( total, r.partial[b] ) ;
+	return total ;
+}
+
+
+#endif   /* include MYthreads.h */
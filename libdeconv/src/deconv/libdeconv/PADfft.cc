@@ -0,0 +1,195 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:    Yuansheng Sun (yuansheng-sun@uiowa.edu)
+ * Copyright: University of Iowa 2006
+ *
+ * Filename:  PADfft.cc
+ */
+
+
+#include <vector>
+#include "MYerror.h"
+#include "PADfft.h"
+
+
+class PadError : public Error
+{
+	public:
+	PadError( int DimX, int DimY, int DimZ, int PadX, int PadY, int PadZ )
+	{
+		_error << " PADfft error : each dimension must be positive and not larger than its padded dimension.\n"
+		       << " dimensions was set -> " << DimX << " x " << DimY << " x " << DimZ 
+		       << " , padded dimensions was set -> " << PadX << " x " << PadY << " x " << PadZ << ".\n" ;
+	}
+} ;
+
+
+int fastsize( int n )
+{
+	if( n <= 1 ) return 1 ;
+
+	for( int m = n ; ; m++ )
+	{
+		int k = m ;
+		while( k % 2 == 0 ) k /= 2 ;
+		while( k % 3 == 0 ) k /= 3 ;
+		while( k % 5 == 0 ) k /= 5 ;
+		while( k % 7 == 0 ) k /= 7 ;
+		if( k == 1 ) return m ;
+	}
+}
+
+
+static void checkPad( int DimX, int DimY, int DimZ, int PadX, int PadY, int PadZ )
+{
+	if( DimX < 1 || DimY < 1 || DimZ < 1 || PadX < DimX || PadY < DimY || PadZ < DimZ )
+		throw PadError( DimX, DimY, DimZ, PadX, PadY, PadZ ) ;
+}
+
+
+/*
+	Map each of the <pad> indices of a padded axis to an index of the <dim> long axis, -1 means 0 is filled.
+*/
+static void padIndex( int dim, int pad, int mode, std::vector< int > & index )
+{
+	index.resize( pad ) ;
+
+	for( int i = 0 ; i < dim ; i++ ) index[i] = i ;
+
+	for( int i = dim ; i < pad ; i++ )
+	{
+		int d1 = i - dim + 1 ;     /* distance beyond the last  voxel */
+		int d2 = pad - i ;         /* distance before the first voxel through the wrap-around */
+		int j ;
+
+		if( mode == PAD_EDGE )
+			j = ( d1 <= d2 ) ? dim - 1 : 0 ;
+		else if( mode == PAD_MIRROR )
+			j = ( d1 <= d2 ) ? dim - d1 : d2 - 1 ;
+		else
+			j = -1 ;
+
+		if( j >= dim ) j = dim - 1 ;
+		if( j < 0 && mode != PAD_ZERO ) j = 0 ;
+		index[i] = j ;
+	}
+}
+
+
+/*
+	Map the padded axis of a PSF in its deconvolution shape, zeros are inserted in the middle.
+*/
+static void padpsfIndex( int dim, int pad, std::vector< int > & index )
+{
+	index.resize( pad ) ;
+
+	for( int i = 0 ; i < pad ; i++ )
+	{
+		if( i < (dim+1)/2 )           index[i] = i ;
+		else if( i >= pad - dim/2 )   index[i] = i - ( pad - dim ) ;
+		else                          index[i] = -1 ;
+	}
+}
+
+
+template< class T >
+static void padCopy( int DimX, int DimY, int /* DimZ */, T * in, int PadX, int PadY, int PadZ, T * out,
+                     std::vector< int > & ix, std::vector< int > & iy, std::vector< int > & iz )
+{
+	for( int k = 0 ; k < PadZ ; k++ )
+		for( int j = 0 ; j < PadY ; j++ )
+		{
+			T * o = out + ( (size_t) k*PadY + j ) * PadX ;
+
+			if( iz[k] < 0 || iy[j] < 0 )
+			{
+				for( int i = 0 ; i < PadX ; i++ ) o[i] = (T) 0 ;
+				continue ;
+			}
+
+			T * p = in + ( (size_t) iz[k]*DimY + iy[j] ) * DimX ;
+			for( int i = 0 ; i < PadX ; i++ ) o[i] = ( ix[i] < 0 ) ? (T) 0 : p[ ix[i] ] ;
+		}
+}
+
+
+template< class T >
+static void pad( int DimX, int DimY, int DimZ, T * in, int PadX, int PadY, int PadZ, T * out, int mode )
+{
+	std::vector< int > ix, iy, iz ;
+
+	checkPad( DimX, DimY, DimZ, PadX, PadY, PadZ ) ;
+	padIndex( DimX, PadX, mode, ix ) ;
+	padIndex( DimY, PadY, mode, iy ) ;
+	padIndex( DimZ, PadZ, mode, iz ) ;
+	padCopy( DimX, DimY, DimZ, in, PadX, PadY, PadZ, out, ix, iy, iz ) ;
+}
+
+
+template< class T >
+static void padpsf( int DimX, int DimY, int DimZ, T * psf, int PadX, int PadY, int PadZ, T * out )
+{
+	std::vector< int > ix, iy, iz ;
+
+	checkPad( DimX, DimY, DimZ, PadX, PadY, PadZ ) ;
+	padpsfIndex( DimX, PadX, ix ) ;
+	padpsfIndex( DimY, PadY, iy ) ;
+	padpsfIndex( DimZ, PadZ, iz ) ;
+	padCopy( DimX, DimY, DimZ, psf, PadX, PadY, PadZ, out, ix, iy, iz ) ;
+}
+
+
+template< class T >
+static void crop( int PadX, int PadY, int PadZ, T * in, int DimX, int DimY, int DimZ, T * out )
+{
+	checkPad( DimX, DimY, DimZ, PadX, PadY, PadZ ) ;
+
+	for( int k = 0 ; k < DimZ ; k++ )
+		for( int j = 0 ; j < DimY ; j++ )
+			for( int i = 0 ; i < DimX ; i++ )
+				out[ ( (size_t) k*DimY + j ) * DimX + i ] = in[ ( (size_t) k*PadY + j ) * PadX + i ] ;
+}
+
+
+
+void pad3d( int DimX, int DimY, int DimZ, double * in, int PadX, int PadY, int PadZ, double * out, int mode )
+{
+	pad( DimX, DimY, DimZ, in, PadX, PadY, PadZ, out, mode ) ;
+}
+
+void pad3d( int DimX, int DimY, int DimZ, float * in, int PadX, int PadY, int PadZ, float * out, int mode )
+{
+	pad( DimX, DimY, DimZ, in, PadX, PadY, PadZ, out, mode ) ;
+}
+
+void padpsf3d( int DimX, int DimY, int DimZ, double * psf, int PadX, int PadY, int PadZ, double * out )
+{
+	padpsf( DimX, DimY, DimZ, psf, PadX, PadY, PadZ, out ) ;
+}
+
+void padpsf3d( int DimX, int DimY, int DimZ, float * psf, int PadX, int PadY, int PadZ, float * out )
+{
+	padpsf( DimX, DimY, DimZ, psf, PadX, PadY, PadZ, out ) ;
+}
+
+void crop3d( int PadX, int PadY, int PadZ, double * in, int DimX, int DimY, int DimZ, double * out )
+{
+	crop( PadX, PadY, PadZ, in, DimX, DimY, DimZ, out ) ;
+}
+
+void crop3d( int PadX, int PadY, int PadZ, float * in, int DimX, int DimY, int DimZ, float * out )
+{
+	crop( PadX, PadY, PadZ, in, DimX, DimY, DimZ, out ) ;
+}
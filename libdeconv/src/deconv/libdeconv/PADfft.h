@@ -0,0 +1,83 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:    Yuansheng Sun (yuansheng-sun@uiowa.edu)
+ * Copyright: University of Iowa 2006
+ *
+ * Filename:  PADfft.h
+ */
+ 
+
+#ifndef PADFFT_H
+#define PADFFT_H
+
+
+/*
+	The following functions pad a volume to a size which FFTW transforms fast and crop it back,
+	so that a deconvolution does not have to run on the next power of 2 in each dimension.
+
+	fastsize() returns the smallest integer not less than <n> of the form 2^a * 3^b * 5^c * 7^d.
+
+	pad3d() copies the <DimX> x <DimY> x <DimZ> volume <in> into the corner of the 
+	<PadX> x <PadY> x <PadZ> volume <out> and fills the rest according to <mode> :
+		PAD_ZERO   : the padded voxels are 0.
+		PAD_EDGE   : the padded voxels repeat the nearest edge voxel of the volume.
+		PAD_MIRROR : the padded voxels mirror the volume about its nearest edge.
+	The FFT treats the padded volume as periodic, so along each axis the first half of the padding 
+	is taken from the end of the volume and the second half from its start, which avoids a step 
+	at the wrap-around where the padding meets the first voxel again.
+	Use PAD_EDGE or PAD_MIRROR for the image and the first estimated object.
+
+	padpsf3d() pads a PSF stored in its deconvolution shape (see "EMdeconvolver.h"), whose center is 
+	the voxel 0 and whose negative offsets are wrapped to the end of each axis. The zeros are inserted
+	in the middle of each axis, so the padded PSF keeps the same shape and sum.
+
+	crop3d() copies the corner <DimX> x <DimY> x <DimZ> of the <PadX> x <PadY> x <PadZ> volume <in>
+	into <out>; use it on the deconvolved object after run().
+
+	Typical use :
+		PadX = fastsize( DimX ) ; PadY = fastsize( DimY ) ; PadZ = fastsize( DimZ ) ;
+		pad3d( DimX, DimY, DimZ, image, PadX, PadY, PadZ, pimage, PAD_MIRROR ) ;
+		pad3d( DimX, DimY, DimZ, object, PadX, PadY, PadZ, pobject, PAD_MIRROR ) ;
+		padpsf3d( DimX, DimY, DimZ, psf, PadX, PadY, PadZ, ppsf ) ;
+		deconvolver.run( PadX, PadY, PadZ, pimage, ppsf, pobject, ws ) ;
+		crop3d( PadX, PadY, PadZ, pobject, DimX, DimY, DimZ, object ) ;
+
+	All data arrays must be one-dimensional and data is stored as "x + y*DimX + z*DimY*DimX",
+	<in> and <out> can not be overlapped and each Pad must not be less than the corresponding Dim.
+
+	Throw: throw an error if a given dimension is wrong.
+*/
+
+#define PAD_ZERO    0
+#define PAD_EDGE    1
+#define PAD_MIRROR  2
+
+
+int  fastsize( int n ) ;
+
+
+void pad3d( int DimX, int DimY, int DimZ, double * in, int PadX, int PadY, int PadZ, double * out, int mode = PAD_MIRROR ) ;
+void pad3d( int DimX, int DimY, int DimZ, float  * in, int PadX, int PadY, int PadZ, float  * out, int mode = PAD_MIRROR ) ;
+
+
+void padpsf3d( int DimX, int DimY, int DimZ, double * psf, int PadX, int PadY, int PadZ, double * out ) ;
+void padpsf3d( int DimX, int DimY, int DimZ, float  * psf, int PadX, int PadY, int PadZ, float  * out ) ;
+
+
+void crop3d( int PadX, int PadY, int PadZ, double * in, int DimX, int DimY, int DimZ, double * out ) ;
+void crop3d( int PadX, int PadY, int PadZ, float  * in, int DimX, int DimY, int DimZ, float  * out ) ;
+
+
+#endif /*   include  "PADfft.h"  */
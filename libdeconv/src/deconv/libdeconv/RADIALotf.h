@@ -0,0 +1,210 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:    Yuansheng Sun (yuansheng-sun@uiowa.edu)
+ * Copyright: University of Iowa 2006
+ *
+ * Filename:  RADIALotf.h
+ */
+
+
+#ifndef RADIALOTF_H
+#define RADIALOTF_H
+
+
+#include <math.h>
+#include <vector>
+#include "MYthreads.h"
+#include "deconvolver.h"
+
+
+/*
+	The OTF of a PSF which is radially symmetric in XY, such as the one of Fluo3DPSF with CalibrationX
+	equal to CalibrationY, depends only on the radial frequency kr and the axial frequency kz.
+	RADIALotf keeps it as a table of <nr> x <Zh> real values per volume instead of the FFTW3_FFT::FFTsize()
+	values of the whole spectrum, e.g. about 47000 values instead of 68 millions for a 1024 x 1024 x 128 volume.
+
+	The frequency k of a spectrum is kx + ky*DimX + kz*DimX*DimY with kz < <Zh> (see "FFTW3fft.h");
+	its radial frequency, in cycles per pixel, is r = sqrt( fx*fx + fy*fy ) where fx = kx/DimX or
+	( kx - DimX )/DimX for kx >= (DimX+1)/2, and likewise fy. <table>[ ( b*Zh + kz )*nr + j ] is the OTF
+	of volume b at kz and r = j*<step>, <step> = 1 / max( DimX, DimY ), and the OTF between two
+	entries is linearly interpolated.
+
+	RADIAL_allocate() allocates the table of <howmany> volumes with fftw_malloc(), returns its size in bytes.
+	RADIAL_free()     frees it.
+	RADIAL_fit()      fills the table of volume <b> from the real spectrum <spec> of FFTsize() values,
+	                  each entry is the mean of the spectrum around it weighted as by the interpolation.
+	RADIAL_expand()   writes the interpolated OTF of the frequencies [begin, end) into <psf>,
+	                  begin and end run over all the <howmany> volumes; it is masked by <support> if not NULL.
+	RADIAL_error()    returns the largest difference between <spec> and the interpolated OTF of volume <b>,
+	                  relative to the largest value of <spec>.
+	RADIAL_multiply() : spec = spec * otf, a convolution or a correlation in the spacial domain as the
+	                  OTF is real; <S> is the layout of the spectrum (see "SPECTRALkernels.h").
+*/
+#define RADIAL_BLOCK 1024
+
+template< class T >
+struct RADIALotf
+{
+	RADIALotf() : X( 0 ), Y( 0 ), Zh( 0 ), howmany( 0 ), nr( 0 ), step( 0.0 ), table( NULL ), support( NULL ) {}
+	int                   X ;
+	int                   Y ;
+	int                   Zh ;
+	int                   howmany ;
+	int                   nr ;
+	double                step ;
+	T *                   table ;
+	const unsigned char * support ;
+} ;
+
+
+/* the radial frequency of ( kx, ky ) in units of <step> */
+template< class T >
+inline double RADIAL_radius( const RADIALotf< T > & otf, int kx, int ky )
+{
+	double fx = (double)( kx < ( otf.X + 1 ) / 2 ? kx : kx - otf.X ) / otf.X ;
+	double fy = (double)( ky < ( otf.Y + 1 ) / 2 ? ky : ky - otf.Y ) / otf.Y ;
+	return sqrt( fx * fx + fy * fy ) / otf.step ;
+}
+
+template< class T >
+inline size_t RADIAL_allocate( RADIALotf< T > & otf, int DimX, int DimY, int DimZ, int howmany )
+{
+	otf.X       = DimX ;
+	otf.Y       = DimY ;
+	otf.Zh      = DimZ / 2 + 1 ;
+	otf.howmany = howmany ;
+	otf.step    = 1.0 / ( DimX > DimY ? DimX : DimY ) ;
+	otf.nr      = (int) RADIAL_radius( otf, DimX / 2, DimY / 2 ) + 2 ;
+	otf.support = NULL ;
+	return WS_malloc( otf.table, (size_t) otf.nr * otf.Zh * howmany ) ;
+}
+
+template< class T >
+inline void RADIAL_free( RADIALotf< T > & otf )
+{
+	WS_free( otf.table ) ;
+	otf.support = NULL ;
+}
+
+template< class T >
+void RADIAL_fit( RADIALotf< T > & otf, int b, const T * spec )
+{
+	std::vector< double > sum( otf.nr ), weight( otf.nr ) ;
+
+	for( int kz = 0 ; kz < otf.Zh ; kz++ )
+	{
+		sum.assign( otf.nr, 0.0 ) ;
+		weight.assign( otf.nr, 0.0 ) ;
+		for( int ky = 0 ; ky < otf.Y ; ky++ )
+		{
+			const T * line = spec + ( (size_t) kz * otf.Y + ky ) * otf.X ;
+			for( int kx = 0 ; kx < otf.X ; kx++ )
+			{
+				double r = RADIAL_radius( otf, kx, ky ) ;
+				int    j = (int) r ;
+				double w = r - j ;
+				sum[j]        += ( 1.0 - w ) * line[kx] ;
+				weight[j]     += ( 1.0 - w ) ;
+				sum[j + 1]    += w * line[kx] ;
+				weight[j + 1] += w ;
+			}
+		}
+		T * t = otf.table + ( (size_t) b * otf.Zh + kz ) * otf.nr ;
+		for( int j = 0 ; j < otf.nr ; j++ ) t[j] = (T)( weight[j] > 0.0 ? sum[j] / weight[j] : 0.0 ) ;
+	}
+}
+
+template< class T >
+void RADIAL_expand( const RADIALotf< T > & otf, size_t begin, size_t end, T * psf )
+{
+	size_t size = (size_t) otf.X * otf.Y * otf.Zh ;
+	size_t b    = begin / size ;
+	size_t q    = begin - b * size ;
+	int    kz   = (int)( q / ( (size_t) otf.X * otf.Y ) ) ;
+	int    ky   = (int)( ( q / otf.X ) % otf.Y ) ;
+	int    kx   = (int)( q % otf.X ) ;
+
+	const T * t = otf.table + ( b * otf.Zh + kz ) * otf.nr ;
+	for( size_t k = begin ; k < end ; k++ )
+	{
+		double r = RADIAL_radius( otf, kx, ky ) ;
+		int    j = (int) r ;
+		T      w = (T)( r - j ) ;
+		*psf = t[j] + w * ( t[j + 1] - t[j] ) ;
+		if( otf.support != NULL ) *psf *= (T) otf.support[q] ;
+		psf++ ;
+		q++ ;
+
+		/* next frequency */
+		if( ++kx < otf.X ) continue ;
+		kx = 0 ;
+		if( ++ky < otf.Y ) continue ;
+		ky = 0 ;
+		t += otf.nr ;
+		if( q == size ) q = 0 ;
+	}
+}
+
+template< class T >
+double RADIAL_error( const RADIALotf< T > & otf, int b, const T * spec )
+{
+	size_t size = (size_t) otf.X * otf.Y * otf.Zh ;
+	double max = 0.0, error = 0.0 ;
+	std::vector< T > psf( RADIAL_BLOCK ) ;
+
+	for( size_t begin = 0 ; begin < size ; begin += RADIAL_BLOCK )
+	{
+		size_t end = ( begin + RADIAL_BLOCK < size ) ? begin + RADIAL_BLOCK : size ;
+		RADIAL_expand( otf, b * size + begin, b * size + end, &psf[0] ) ;
+		for( size_t k = begin ; k < end ; k++ )
+		{
+			if( fabs( (double) spec[k] ) > max ) max = fabs( (double) spec[k] ) ;
+			if( fabs( (double)( spec[k] - psf[k - begin] ) ) > error ) error = fabs( (double)( spec[k] - psf[k - begin] ) ) ;
+		}
+	}
+	return ( max > 0.0 ) ? error / max : 0.0 ;
+}
+
+
+template< int S, class T >
+struct RADIAL_multiplyBody
+{
+	T * re ; T * im ; const RADIALotf< T > * otf ;
+
+	void operator()( size_t begin, size_t end ) const
+	{
+		T psf[RADIAL_BLOCK] ;
+		for( size_t first = begin ; first < end ; first += RADIAL_BLOCK )
+		{
+			size_t last = ( first + RADIAL_BLOCK < end ) ? first + RADIAL_BLOCK : end ;
+			RADIAL_expand( *otf, first, last, psf ) ;
+			for( size_t k = first, i = first * S ; k < last ; k++, i += S )
+			{
+				re[i] *= psf[k - first] ;
+				im[i] *= psf[k - first] ;
+			}
+		}
+	}
+} ;
+
+template< int S, class T >
+inline void RADIAL_multiply( size_t size, T * re, T * im, const RADIALotf< T > & otf, int nthreads = 1 )
+{
+	RADIAL_multiplyBody< S, T > body = { re, im, &otf } ;
+	my_parallel_range( size, body, nthreads ) ;
+}
+
+
+#endif
@@ -20,130 +20,120 @@
 
 
 #include <stdlib.h>
-#include <math.h>
 #include "SHIFTfft.h"
+#include "MYthreads.h"
 
 
-void shift1d( int dimX, float * in_re, float * in_im, float * out_re, float * out_im )
+/*
+	Shifting DC to the center multiplies sample (i, j, k) by (-1)^(i+j+k).
+	A row of fixed (j, k) is multiplied by +1, -1, +1, ... or by -1, +1, -1, ... , 
+	so each row is a branch-free loop over sample pairs which the compiler vectorizes, 
+	and the rows are shared among get_my_threads() threads.
+*/
+#define SHIFT_GRAIN 4096
+
+
+template< class T >
+static void SHIFT_row( int n, T sign, T * in, T * out )
 {
-	if( in_im == NULL )
+	int i = 0 ;
+	for( ; i + 1 < n ; i += 2 )
 	{
-		for( int i = 0 ; i < dimX ; i++ ) out_re[i] = in_re[i] * pow( -1.0, i ) ;
+		out[i]   =  sign * in[i] ;
+		out[i+1] = -sign * in[i+1] ;
 	}
-	else
+	if( i < n ) out[i] = sign * in[i] ;
+}
+
+
+template< class T >
+struct SHIFT_args
+{
+	int  dimX ;
+	int  dimY ;
+	T  * in_re ;
+	T  * in_im ;
+	T  * out_re ;
+	T  * out_im ;
+} ;
+
+
+/* rows [begin, end) of a volume, row r has j = r % dimY and k = r / dimY */
+template< class T >
+static void SHIFT_rows( size_t begin, size_t end, void * arg )
+{
+	SHIFT_args<T> * a = (SHIFT_args<T> *) arg ;
+
+	for( size_t r = begin ; r < end ; r++ )
 	{
-		for( int i = 0 ; i < dimX ; i++ )
-		{
-			out_re[i] = in_re[i] * pow( -1.0, i ) ;
-			out_im[i] = in_im[i] * pow( -1.0, i ) ;
-		}
+		size_t j    = r % a->dimY ;
+		size_t k    = r / a->dimY ;
+		T      sign = ( (j + k) & 1 ) ? (T) -1.0 : (T) 1.0 ;
+		size_t off  = r * a->dimX ;
+
+		SHIFT_row( a->dimX, sign, a->in_re + off, a->out_re + off ) ;
+		if( a->in_im != NULL )
+			SHIFT_row( a->dimX, sign, a->in_im + off, a->out_im + off ) ;
 	}
 }
 
 
+template< class T >
+static void SHIFT_volume( int dimX, int dimY, int dimZ, T * in_re, T * in_im, T * out_re, T * out_im )
+{
+	SHIFT_args<T> a ;
+
+	a.dimX   = dimX ;
+	a.dimY   = dimY ;
+	a.in_re  = in_re ;
+	a.in_im  = in_im ;
+	a.out_re = out_re ;
+	a.out_im = out_im ;
+
+	size_t grain = SHIFT_GRAIN / dimX + 1 ;
+	my_parallel_for( (size_t) dimY * dimZ, grain, SHIFT_rows<T>, &a ) ;
+}
+
+
+
+void shift1d( int dimX, float * in_re, float * in_im, float * out_re, float * out_im )
+{
+	SHIFT_volume( dimX, 1, 1, in_re, in_im, out_re, out_im ) ;
+}
+
+
 
 void shift1d( int dimX, double * in_re, double * in_im, double * out_re, double * out_im )
 {
-	if( in_im == NULL )
-	{
-		for( int i = 0 ; i < dimX ; i++ ) out_re[i] = in_re[i] * pow( -1.0, i ) ;
-	}
-	else
-	{
-		for( int i = 0 ; i < dimX ; i++ )
-		{
-			out_re[i] = in_re[i] * pow( -1.0, i ) ;
-			out_im[i] = in_im[i] * pow( -1.0, i ) ;
-		}
-	}
+	SHIFT_volume( dimX, 1, 1, in_re, in_im, out_re, out_im ) ;
 }
 
 
 
 void shift2d( int dimX, int dimY, float  * in_re, float  * in_im, float  * out_re, float  * out_im )
 {
-	if( in_im == NULL )
-	{
-		for( int j = 0 ; j < dimY ; j++ )
-			for( int i = 0 ; i < dimX ; i++ )
-				out_re[ j*dimX+i ] = in_re[ j*dimX+i ] * pow( -1.0, i+j ) ;
-	}
-	else
-	{
-		for( int j = 0 ; j < dimY ; j++ )
-			for( int i = 0 ; i < dimX ; i++ )
-			{
-				out_re[ j*dimX+i ] = in_re[ j*dimX+i ] * pow( -1.0, i+j ) ;
-				out_im[ j*dimX+i ] = in_im[ j*dimX+i ] * pow( -1.0, i+j ) ;
-			}
-	}
+	SHIFT_volume( dimX, dimY, 1, in_re, in_im, out_re, out_im ) ;
 }
 
 
 
 void shift2d( int dimX, int dimY, double * in_re, double * in_im, double * out_re, double * out_im )
 {
-	if( in_im == NULL )
-	{
-		for( int j = 0 ; j < dimY ; j++ )
-			for( int i = 0 ; i < dimX ; i++ )
-				out_re[ j*dimX+i ] = in_re[ j*dimX+i ] * pow( -1.0, i+j ) ;
-	}
-	else
-	{
-		for( int j = 0 ; j < dimY ; j++ )
-			for( int i = 0 ; i < dimX ; i++ )
-			{
-				out_re[ j*dimX+i ] = in_re[ j*dimX+i ] * pow( -1.0, i+j ) ;
-				out_im[ j*dimX+i ] = in_im[ j*dimX+i ] * pow( -1.0, i+j ) ;
-			}
-	}
+	SHIFT_volume( dimX, dimY, 1, in_re, in_im, out_re, out_im ) ;
 }
 
 
 
 void shift3d( int dimX, int dimY, int dimZ, float  * in_re, float  * in_im, float  * out_re, float  * out_im )
 {
-	if( in_im == NULL )
-	{
-		for( int k = 0 ; k < dimZ ; k++ )
-			for( int j = 0 ; j < dimY ; j++ )
-				for( int i = 0 ; i < dimX ; i++ )
-					out_re[ k*dimY*dimX+j*dimX+i ] = in_re[ k*dimY*dimX+j*dimX+i ] * pow( -1.0, i+j+k ) ;
-	}
-	else
-	{
-		for( int k = 0 ; k < dimZ ; k++ )
-			for( int j = 0 ; j < dimY ; j++ )
-				for( int i = 0 ; i < dimX ; i++ )
-				{
-					out_re[ k*dimY*dimX+j*dimX+i ] = in_re[ k*dimY*dimX+j*dimX+i ] * pow( -1.0, i+j+k ) ;
-					out_im[ k*dimY*dimX+j*dimX+i ] = in_im[ k*dimY*dimX+j*dimX+i ] * pow( -1.0, i+j+k ) ;
-				}
-	}
+	SHIFT_volume( dimX, dimY, dimZ, in_re, in_im, out_re, out_im ) ;
 }
 
 
 
 void shift3d( int dimX, int dimY, int dimZ, double * in_re, double * in_im, double * out_re, double * out_im )
 {
-	if( in_im == NULL )
-	{
-		for( int k = 0 ; k < dimZ ; k++ )
-			for( int j = 0 ; j < dimY ; j++ )
-				for( int i = 0 ; i < dimX ; i++ )
-					out_re[ k*dimY*dimX+j*dimX+i ] = in_re[ k*dimY*dimX+j*dimX+i ] * pow( -1.0, i+j+k ) ;
-	}
-	else
-	{
-		for( int k = 0 ; k < dimZ ; k++ )
-			for( int j = 0 ; j < dimY ; j++ )
-				for( int i = 0 ; i < dimX ; i++ )
-				{
-					out_re[ k*dimY*dimX+j*dimX+i ] = in_re[ k*dimY*dimX+j*dimX+i ] * pow( -1.0, i+j+k ) ;
-					out_im[ k*dimY*dimX+j*dimX+i ] = in_im[ k*dimY*dimX+j*dimX+i ] * pow( -1.0, i+j+k ) ;
-				}
-	}
+	SHIFT_volume( dimX, dimY, dimZ, in_re, in_im, out_re, out_im ) ;
 }
 
 
@@ -23,6 +23,12 @@
 #define SHIFTFFT_H
 
 
+/*
+	Shift DC to the center of a 1D/2D/3D transform by multiplying each sample (i, j, k) by (-1)^(i+j+k).
+	The output can be the input itself, <in_im> can be NULL for real data.
+	The rows of a 2D/3D array are shared among get_my_threads() threads (see "MYthreads.h").
+*/
+
 void shift1d( int dimX, float  * in_re, float  * in_im, float  * out_re, float  * out_im ) ;
 void shift1d( int dimX, double * in_re, double * in_im, double * out_re, double * out_im ) ;
 
@@ -0,0 +1,394 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:    Yuansheng Sun (yuansheng-sun@uiowa.edu)
+ * Copyright: University of Iowa 2006
+ *
+ * Filename:  SPECTRALkernels.h
+ */
+
+
+#ifndef SPECTRALKERNELS_H
+#define SPECTRALKERNELS_H
+
+
+#include <math.h>
+#include "MYthreads.h"
+
+
+/*
+	The following templates provide the pointwise kernels applied on the spectra in the deconvolution loops.
+	They serve both spectrum layouts of FFTW3_FFT (see "FFTW3fft.h") with one code path:
+
+	<S> = 1 : split layout, <re> and <im> are two different arrays of <size> values.
+	<S> = 2 : interleaved layout, the spectrum is one array of <size> (re, im) pairs,
+	          pass the array as <re> and the array plus 1 as <im>.
+
+	The i-th complex value is ( re[i*S], im[i*S] ) in both layouts, a real array such as <otf> 
+	has <size> values. <T> is double or float. The kernels run in <nthreads> threads (see "MYthreads.h").
+	If <psf_im> is NULL, the PSF spectrum is real and <psf_re> is a real array (see deconvolver::setRealOTF()),
+	each product with the PSF is then two real scalings.
+
+	SPECTRAL_multiply()     : spec = spec * psf,          a convolution in the spacial domain.
+	SPECTRAL_correlate()    : spec = spec * conj( psf ),  a correlation in the spacial domain.
+	SPECTRAL_support()      : spec = spec * support,      <support> has <size> values of 0 or 1.
+	SPECTRAL_landweber()    : spec = ( image * conj( psf ) - otf * spec ) / ( otf + cv ),  the conditioned LW step.
+	SPECTRAL_residual()     : spec = image - otf * spec,  the LW step.
+	SPECTRAL_landweberIR()  : spec = ( image * conj( psf ) - otf * spec ) / ( otf + cv ) - penalty * spec,  the conditioned CG residual.
+	SPECTRAL_residualIR()   : spec = image - ( otf + penalty ) * spec,  the CG residual.
+	SPECTRAL_whiten()       : spec = spec * psf / sqrt( otf + cv ),  the conditioned CG projection.
+	SPECTRAL_distance()     : returns the sum of | image - psf * spec |^2, the LW/CG likelihood.
+*/
+
+
+/*
+	The split layout of SPECTRAL_multiply(), SPECTRAL_correlate() and SPECTRAL_residual() runs the vector 
+	kernels of "SPECTRALsimd.cc", chosen when the library is loaded after the instruction sets of the CPU:
+	"avx512", "avx2", "sse2" or "scalar" in this order of preference. They give the same results as the 
+	"scalar" kernels bit for bit.
+
+	get_spectral_isa() returns the name of the kernels in use.
+	set_spectral_isa() selects the kernels named <isa>, it returns false and keeps the kernels in use 
+	if the CPU does not support them. The environment variable DECONV_SIMD selects the kernels at startup.
+*/
+const char * get_spectral_isa() ;
+bool         set_spectral_isa( const char * isa ) ;
+
+void  SPECTRAL_multiplySplit(  size_t n, double * re, double * im, const double * psf_re, const double * psf_im ) ;
+void  SPECTRAL_multiplySplit(  size_t n, float  * re, float  * im, const float  * psf_re, const float  * psf_im ) ;
+void  SPECTRAL_correlateSplit( size_t n, double * re, double * im, const double * psf_re, const double * psf_im ) ;
+void  SPECTRAL_correlateSplit( size_t n, float  * re, float  * im, const float  * psf_re, const float  * psf_im ) ;
+void  SPECTRAL_residualSplit(  size_t n, double * re, double * im, const double * image_re, const double * image_im, const double * otf ) ;
+void  SPECTRAL_residualSplit(  size_t n, float  * re, float  * im, const float  * image_re, const float  * image_im, const float  * otf ) ;
+
+
+template< int S, class T >
+struct SPECTRAL_multiplyBody
+{
+	T * re ; T * im ; const T * psf_re ; const T * psf_im ;
+	
+	void operator()( size_t begin, size_t end ) const
+	{
+		if( psf_im == NULL )
+		{
+			for( size_t k = begin, i = begin * S ; k < end ; k++, i += S )
+			{
+				re[i] *= psf_re[k] ;
+				im[i] *= psf_re[k] ;
+			}
+			return ;
+		}
+		if( S == 1 )
+		{
+			SPECTRAL_multiplySplit( end - begin, re + begin, im + begin, psf_re + begin, psf_im + begin ) ;
+			return ;
+		}
+		T temp ;
+		for( size_t i = begin * S ; i < end * S ; i += S )
+		{
+			 temp = re[i] * psf_re[i] - im[i] * psf_im[i] ;
+			im[i] = re[i] * psf_im[i] + im[i] * psf_re[i] ;
+			re[i] = temp ;
+		}
+	}
+} ;
+
+template< int S, class T >
+inline void SPECTRAL_multiply( size_t size, T * re, T * im, const T * psf_re, const T * psf_im, int nthreads = 1 )
+{
+	SPECTRAL_multiplyBody< S, T > body = { re, im, psf_re, psf_im } ;
+	my_parallel_range( size, body, nthreads ) ;
+}
+
+
+template< int S, class T >
+struct SPECTRAL_correlateBody
+{
+	T * re ; T * im ; const T * psf_re ; const T * psf_im ;
+	
+	void operator()( size_t begin, size_t end ) const
+	{
+		if( psf_im == NULL )
+		{
+			/* conj( psf ) = psf */
+			for( size_t k = begin, i = begin * S ; k < end ; k++, i += S )
+			{
+				re[i] *= psf_re[k] ;
+				im[i] *= psf_re[k] ;
+			}
+			return ;
+		}
+		if( S == 1 )
+		{
+			SPECTRAL_correlateSplit( end - begin, re + begin, im + begin, psf_re + begin, psf_im + begin ) ;
+			return ;
+		}
+		T temp ;
+		for( size_t i = begin * S ; i < end * S ; i += S )
+		{
+			 temp = re[i] * psf_re[i] + im[i] * psf_im[i] ;
+			im[i] = im[i] * psf_re[i] - re[i] * psf_im[i] ;
+			re[i] = temp ;
+		}
+	}
+} ;
+
+template< int S, class T >
+inline void SPECTRAL_correlate( size_t size, T * re, T * im, const T * psf_re, const T * psf_im, int nthreads = 1 )
+{
+	SPECTRAL_correlateBody< S, T > body = { re, im, psf_re, psf_im } ;
+	my_parallel_range( size, body, nthreads ) ;
+}
+
+
+template< int S, class T >
+struct SPECTRAL_supportBody
+{
+	T * re ; T * im ; const unsigned char * support ;
+	
+	void operator()( size_t begin, size_t end ) const
+	{
+		for( size_t i = begin ; i < end ; i++ )
+		{
+			re[i*S] *= ((T) support[i]) ;
+			im[i*S] *= ((T) support[i]) ;
+		}
+	}
+} ;
+
+template< int S, class T >
+inline void SPECTRAL_support( size_t size, T * re, T * im, const unsigned char * support, int nthreads = 1 )
+{
+	SPECTRAL_supportBody< S, T > body = { re, im, support } ;
+	my_parallel_range( size, body, nthreads ) ;
+}
+
+
+template< int S, class T >
+struct SPECTRAL_landweberBody
+{
+	T * re ; T * im ; const T * image_re ; const T * image_im ; const T * psf_re ; const T * psf_im ; const T * otf ; double cv ;
+	
+	void operator()( size_t begin, size_t end ) const
+	{
+		T temp1, temp2, temp3, temp4 ;
+		if( psf_im == NULL )
+		{
+			for( size_t k = begin, i = begin * S ; k < end ; k++, i += S )
+			{
+				temp1 = otf[k] + cv ;
+				temp2 = ( image_re[i]*psf_re[k] ) / temp1 ;
+				temp3 = ( image_im[i]*psf_re[k] ) / temp1 ;
+				temp4 = otf[k] / temp1 ;
+				re[i] = temp2 - temp4 * re[i] ;
+				im[i] = temp3 - temp4 * im[i] ;
+			}
+			return ;
+		}
+		for( size_t k = begin, i = begin * S ; k < end ; k++, i += S )
+		{
+			temp1 = otf[k] + cv ;
+			temp2 = ( image_re[i]*psf_re[i] + image_im[i]*psf_im[i] ) / temp1 ;
+			temp3 = ( image_im[i]*psf_re[i] - image_re[i]*psf_im[i] ) / temp1 ;
+			temp4 = otf[k] / temp1 ;
+			re[i] = temp2 - temp4 * re[i] ;
+			im[i] = temp3 - temp4 * im[i] ;
+		}
+	}
+} ;
+
+template< int S, class T >
+inline void SPECTRAL_landweber( size_t size, T * re, T * im, const T * image_re, const T * image_im, 
+                                const T * psf_re, const T * psf_im, const T * otf, double cv, int nthreads = 1 )
+{
+	SPECTRAL_landweberBody< S, T > body = { re, im, image_re, image_im, psf_re, psf_im, otf, cv } ;
+	my_parallel_range( size, body, nthreads ) ;
+}
+
+
+template< int S, class T >
+struct SPECTRAL_residualBody
+{
+	T * re ; T * im ; const T * image_re ; const T * image_im ; const T * otf ;
+	
+	void operator()( size_t begin, size_t end ) const
+	{
+		if( S == 1 )
+		{
+			SPECTRAL_residualSplit( end - begin, re + begin, im + begin, image_re + begin, image_im + begin, otf + begin ) ;
+			return ;
+		}
+		for( size_t k = begin, i = begin * S ; k < end ; k++, i += S )
+		{
+			re[i] = image_re[i] - otf[k] * re[i] ;
+			im[i] = image_im[i] - otf[k] * im[i] ;
+		}
+	}
+} ;
+
+template< int S, class T >
+inline void SPECTRAL_residual( size_t size, T * re, T * im, const T * image_re, const T * image_im, const T * otf, int nthreads = 1 )
+{
+	SPECTRAL_residualBody< S, T > body = { re, im, image_re, image_im, otf } ;
+	my_parallel_range( size, body, nthreads ) ;
+}
+
+
+template< int S, class T >
+struct SPECTRAL_landweberIRBody
+{
+	T * re ; T * im ; const T * image_re ; const T * image_im ; const T * psf_re ; const T * psf_im ; const T * otf ; 
+	double cv ; double penalty ;
+	
+	void operator()( size_t begin, size_t end ) const
+	{
+		T temp1, temp2, temp3, temp4 ;
+		if( psf_im == NULL )
+		{
+			for( size_t k = begin, i = begin * S ; k < end ; k++, i += S )
+			{
+				temp1 = otf[k] + cv ;
+				temp2 = ( image_re[i] * psf_re[k] ) / temp1 ;
+				temp3 = ( image_im[i] * psf_re[k] ) / temp1 ;
+				temp4 = otf[k] / temp1 ;
+				re[i] = temp2 - ( temp4 + penalty ) * re[i] ;
+				im[i] = temp3 - ( temp4 + penalty ) * im[i] ; 
+			}
+			return ;
+		}
+		for( size_t k = begin, i = begin * S ; k < end ; k++, i += S )
+		{
+			temp1 = otf[k] + cv ;
+			temp2 = ( image_re[i] * psf_re[i] + image_im[i] * psf_im[i] ) / temp1 ;
+			temp3 = ( image_im[i] * psf_re[i] - image_re[i] * psf_im[i] ) / temp1 ;
+			temp4 = otf[k] / temp1 ;
+			re[i] = temp2 - ( temp4 + penalty ) * re[i] ;
+			im[i] = temp3 - ( temp4 + penalty ) * im[i] ; 
+		}
+	}
+} ;
+
+template< int S, class T >
+inline void SPECTRAL_landweberIR( size_t size, T * re, T * im, const T * image_re, const T * image_im, 
+                                  const T * psf_re, const T * psf_im, const T * otf, double cv, double penalty, int nthreads = 1 )
+{
+	SPECTRAL_landweberIRBody< S, T > body = { re, im, image_re, image_im, psf_re, psf_im, otf, cv, penalty } ;
+	my_parallel_range( size, body, nthreads ) ;
+}
+
+
+template< int S, class T >
+struct SPECTRAL_residualIRBody
+{
+	T * re ; T * im ; const T * image_re ; const T * image_im ; const T * otf ; double penalty ;
+	
+	void operator()( size_t begin, size_t end ) const
+	{
+		for( size_t k = begin, i = begin * S ; k < end ; k++, i += S )
+		{
+			re[i] = image_re[i] - ( otf[k] + penalty ) * re[i] ;
+			im[i] = image_im[i] - ( otf[k] + penalty ) * im[i] ; 
+		}
+	}
+} ;
+
+template< int S, class T >
+inline void SPECTRAL_residualIR( size_t size, T * re, T * im, const T * image_re, const T * image_im, const T * otf, 
+                                 double penalty, int nthreads = 1 )
+{
+	SPECTRAL_residualIRBody< S, T > body = { re, im, image_re, image_im, otf, penalty } ;
+	my_parallel_range( size, body, nthreads ) ;
+}
+
+
+template< int S, class T >
+struct SPECTRAL_whitenBody
+{
+	T * re ; T * im ; const T * psf_re ; const T * psf_im ; const T * otf ; double cv ;
+	
+	void operator()( size_t begin, size_t end ) const
+	{
+		T temp1, temp2, temp3, temp4 ;
+		if( psf_im == NULL )
+		{
+			for( size_t k = begin, i = begin * S ; k < end ; k++, i += S )
+			{
+				temp1 = sqrt( otf[k] + cv ) ; 
+				temp2 = psf_re[k] / temp1 ;
+				re[i] = re[i] * temp2 ;
+				im[i] = im[i] * temp2 ;
+			}
+			return ;
+		}
+		for( size_t k = begin, i = begin * S ; k < end ; k++, i += S )
+		{
+			temp1 = sqrt( otf[k] + cv ) ; 
+			temp2 = psf_re[i] / temp1 ;
+			temp3 = psf_im[i] / temp1 ;
+			temp4 = re[i] * temp3 + im[i] * temp2 ;
+			re[i] = re[i] * temp2 - im[i] * temp3 ;
+			im[i] = temp4 ;
+		}
+	}
+} ;
+
+template< int S, class T >
+inline void SPECTRAL_whiten( size_t size, T * re, T * im, const T * psf_re, const T * psf_im, const T * otf, double cv, int nthreads = 1 )
+{
+	SPECTRAL_whitenBody< S, T > body = { re, im, psf_re, psf_im, otf, cv } ;
+	my_parallel_range( size, body, nthreads ) ;
+}
+
+
+template< int S, class T >
+struct SPECTRAL_distanceBody
+{
+	typedef double result ;
+	const T * re ; const T * im ; const T * image_re ; const T * image_im ; const T * psf_re ; const T * psf_im ;
+	
+	double operator()( size_t begin, size_t end ) const
+	{
+		double likelihood = 0.0 ;
+		if( psf_im == NULL )
+		{
+			for( size_t k = begin, i = begin * S ; k < end ; k++, i += S )
+			{
+				likelihood += ( ( image_re[i]-psf_re[k]*re[i] ) * ( image_re[i]-psf_re[k]*re[i] ) +
+				                ( image_im[i]-psf_re[k]*im[i] ) * ( image_im[i]-psf_re[k]*im[i] ) ) ;
+			}
+			return likelihood ;
+		}
+		for( size_t i = begin * S ; i < end * S ; i += S )
+		{
+			likelihood += ( ( image_re[i]-psf_re[i]*re[i]+psf_im[i]*im[i] ) *
+			                ( image_re[i]-psf_re[i]*re[i]+psf_im[i]*im[i] ) +
+			                ( image_im[i]-psf_re[i]*im[i]-psf_im[i]*re[i] ) *
+			                ( image_im[i]-psf_re[i]*im[i]-psf_im[i]*re[i] ) ) ;
+		}
+		return likelihood ;
+	}
+	
+	void join( double & total, const double & partial ) const { total += partial ; }
+} ;
+
+template< int S, class T >
+inline double SPECTRAL_distance( size_t size, const T * re, const T * im, const T * image_re, const T * image_im, 
+                                 const T * psf_re, const T * psf_im, int nthreads = 1 )
+{
+	SPECTRAL_distanceBody< S, T > body = { re, im, image_re, image_im, psf_re, psf_im } ;
+	return my_parallel_reduce( size, body, nthreads ) ;
+}
+
+
+#endif  /*   #include "SPECTRALkernels.h"   */
@@ -0,0 +1,245 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:    Yuansheng Sun (yuansheng-sun@uiowa.edu)
+ * Copyright: University of Iowa 2006
+ *
+ * Filename:  SPECTRALsimd.cc
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "SPECTRALkernels.h"
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define SPECTRAL_X86
+#include <immintrin.h>
+#endif
+
+/* a multiply and an add are never fused, the vector kernels must round as the scalar ones */
+#if defined( __clang__ )
+#pragma STDC FP_CONTRACT OFF
+#elif defined( __GNUC__ )
+#pragma GCC optimize ( "fp-contract=off" )
+#endif
+
+
+/*
+	The split layout kernels, one scalar version and one version for each x86 instruction set.
+	The vector versions do the same multiplies and adds in the same order as the scalar one, 
+	without fused multiply-adds, so they give the same results bit for bit.
+*/
+
+template< class T >
+static void SPECTRAL_multiplyScalar( size_t n, T * re, T * im, const T * psf_re, const T * psf_im )
+{
+	T temp ;
+	for( size_t i = 0 ; i < n ; i++ )
+	{
+		 temp = re[i] * psf_re[i] - im[i] * psf_im[i] ;
+		im[i] = re[i] * psf_im[i] + im[i] * psf_re[i] ;
+		re[i] = temp ;
+	}
+}
+
+template< class T >
+static void SPECTRAL_correlateScalar( size_t n, T * re, T * im, const T * psf_re, const T * psf_im )
+{
+	T temp ;
+	for( size_t i = 0 ; i < n ; i++ )
+	{
+		 temp = re[i] * psf_re[i] + im[i] * psf_im[i] ;
+		im[i] = im[i] * psf_re[i] - re[i] * psf_im[i] ;
+		re[i] = temp ;
+	}
+}
+
+template< class T >
+static void SPECTRAL_residualScalar( size_t n, T * re, T * im, const T * image_re, const T * image_im, const T * otf )
+{
+	for( size_t i = 0 ; i < n ; i++ )
+	{
+		re[i] = image_re[i] - otf[i] * re[i] ;
+		im[i] = image_im[i] - otf[i] * im[i] ;
+	}
+}
+
+
+#ifdef SPECTRAL_X86
+
+/*
+	SPECTRAL_VECTOR( name, isa, T, V, P, S, W ) defines the three kernels <name>Multiply, <name>Correlate 
+	and <name>Residual for the type <T> held <W> at a time in the vector type <V>; the intrinsics are P_opS, 
+	e.g. _mm256_mul_pd. The tail shorter than a vector is left to the scalar kernels.
+*/
+#define SPECTRAL_VECTOR( name, isa, T, V, P, S, W )                                                         \
+__attribute__(( target( isa ) ))                                                                           \
+static void name##Multiply( size_t n, T * re, T * im, const T * psf_re, const T * psf_im )                 \
+{                                                                                                          \
+	size_t i = 0 ;                                                                                     \
+	for( ; i + W <= n ; i += W )                                                                       \
+	{                                                                                                  \
+		V r = P##_loadu_##S( re + i ),     m = P##_loadu_##S( im + i ) ;                         \
+		V a = P##_loadu_##S( psf_re + i ), b = P##_loadu_##S( psf_im + i ) ;                     \
+		P##_storeu_##S( re + i, P##_sub_##S( P##_mul_##S( r, a ), P##_mul_##S( m, b ) ) ) ;      \
+		P##_storeu_##S( im + i, P##_add_##S( P##_mul_##S( r, b ), P##_mul_##S( m, a ) ) ) ;      \
+	}                                                                                                  \
+	SPECTRAL_multiplyScalar( n - i, re + i, im + i, psf_re + i, psf_im + i ) ;                         \
+}                                                                                                          \
+                                                                                                           \
+__attribute__(( target( isa ) ))                                                                           \
+static void name##Correlate( size_t n, T * re, T * im, const T * psf_re, const T * psf_im )                \
+{                                                                                                          \
+	size_t i = 0 ;                                                                                     \
+	for( ; i + W <= n ; i += W )                                                                       \
+	{                                                                                                  \
+		V r = P##_loadu_##S( re + i ),     m = P##_loadu_##S( im + i ) ;                         \
+		V a = P##_loadu_##S( psf_re + i ), b = P##_loadu_##S( psf_im + i ) ;                     \
+		P##_storeu_##S( re + i, P##_add_##S( P##_mul_##S( r, a ), P##_mul_##S( m, b ) ) ) ;      \
+		P##_storeu_##S( im + i, P##_sub_##S( P##_mul_##S( m, a ), P##_mul_##S( r, b ) ) ) ;      \
+	}                                                                                                  \
+	SPECTRAL_correlateScalar( n - i, re + i, im + i, psf_re + i, psf_im + i ) ;                        \
+}                                                                                                          \
+                                                                                                           \
+__attribute__(( target( isa ) ))                                                                           \
+static void name##Residual( size_t n, T * re, T * im, const T * image_re, const T * image_im, const T * otf ) \
+{                                                                                                          \
+	size_t i = 0 ;                                                                                     \
+	for( ; i + W <= n ; i += W )                                                                       \
+	{                                                                                                  \
+		V o = P##_loadu_##S( otf + i ) ;                                                           \
+		P##_storeu_##S( re + i, P##_sub_##S( P##_loadu_##S( image_re + i ),                        \
+		                                      P##_mul_##S( o, P##_loadu_##S( re + i ) ) ) ) ;     \
+		P##_storeu_##S( im + i, P##_sub_##S( P##_loadu_##S( image_im + i ),                       \
+		                                      P##_mul_##S( o, P##_loadu_##S( im + i ) ) ) ) ;     \
+	}                                                                                                  \
+	SPECTRAL_residualScalar( n - i, re + i, im + i, image_re + i, image_im + i, otf + i ) ;            \
+}
+
+SPECTRAL_VECTOR( SPECTRAL_sse2d,   "sse2",    double, __m128d, _mm,    pd, 2 )
+SPECTRAL_VECTOR( SPECTRAL_sse2s,   "sse2",    float,  __m128,  _mm,    ps, 4 )
+SPECTRAL_VECTOR( SPECTRAL_avx2d,   "avx2",    double, __m256d, _mm256, pd, 4 )
+SPECTRAL_VECTOR( SPECTRAL_avx2s,   "avx2",    float,  __m256,  _mm256, ps, 8 )
+SPECTRAL_VECTOR( SPECTRAL_avx512d, "avx512f", double, __m512d, _mm512, pd, 8 )
+SPECTRAL_VECTOR( SPECTRAL_avx512s, "avx512f", float,  __m512,  _mm512, ps, 16 )
+
+#endif  /* SPECTRAL_X86 */
+
+
+
+/* the kernels in use, chosen once when the library is loaded */
+
+typedef struct
+{
+	const char * isa ;
+	void (*dmultiply)(  size_t, double *, double *, const double *, const double * ) ;
+	void (*dcorrelate)( size_t, double *, double *, const double *, const double * ) ;
+	void (*dresidual)(  size_t, double *, double *, const double *, const double *, const double * ) ;
+	void (*smultiply)(  size_t, float *,  float *,  const float *,  const float * ) ;
+	void (*scorrelate)( size_t, float *,  float *,  const float *,  const float * ) ;
+	void (*sresidual)(  size_t, float *,  float *,  const float *,  const float *,  const float * ) ;
+} SPECTRAL_table ;
+
+static const SPECTRAL_table SPECTRAL_tables[] = 
+{
+#ifdef SPECTRAL_X86
+	{ "avx512", SPECTRAL_avx512dMultiply, SPECTRAL_avx512dCorrelate, SPECTRAL_avx512dResidual,
+	            SPECTRAL_avx512sMultiply, SPECTRAL_avx512sCorrelate, SPECTRAL_avx512sResidual },
+	{ "avx2",   SPECTRAL_avx2dMultiply,   SPECTRAL_avx2dCorrelate,   SPECTRAL_avx2dResidual,
+	            SPECTRAL_avx2sMultiply,   SPECTRAL_avx2sCorrelate,   SPECTRAL_avx2sResidual },
+	{ "sse2",   SPECTRAL_sse2dMultiply,   SPECTRAL_sse2dCorrelate,   SPECTRAL_sse2dResidual,
+	            SPECTRAL_sse2sMultiply,   SPECTRAL_sse2sCorrelate,   SPECTRAL_sse2sResidual },
+#endif
+	{ "scalar", SPECTRAL_multiplyScalar< double >, SPECTRAL_correlateScalar< double >, SPECTRAL_residualScalar< double >,
+	            SPECTRAL_multiplyScalar< float >,  SPECTRAL_correlateScalar< float >,  SPECTRAL_residualScalar< float > }
+} ;
+
+static const int SPECTRAL_ntables = sizeof( SPECTRAL_tables ) / sizeof( SPECTRAL_table ) ;
+
+
+static bool SPECTRAL_supports( const char * isa )
+{
+#ifdef SPECTRAL_X86
+	__builtin_cpu_init() ;
+	if( strcmp( isa, "avx512" ) == 0 ) return __builtin_cpu_supports( "avx512f" ) ;
+	if( strcmp( isa, "avx2" )   == 0 ) return __builtin_cpu_supports( "avx2" ) ;
+	if( strcmp( isa, "sse2" )   == 0 ) return __builtin_cpu_supports( "sse2" ) ;
+#endif
+	return strcmp( isa, "scalar" ) == 0 ;
+}
+
+static const SPECTRAL_table * SPECTRAL_select( const char * isa )
+{
+	for( int t = 0 ; t < SPECTRAL_ntables ; t++ )
+	{
+		if( ( isa == NULL || strcmp( isa, SPECTRAL_tables[t].isa ) == 0 ) && SPECTRAL_supports( SPECTRAL_tables[t].isa ) )
+			return SPECTRAL_tables + t ;
+	}
+	return NULL ;
+}
+
+static const SPECTRAL_table * SPECTRAL_startup()
+{
+	const SPECTRAL_table * table = SPECTRAL_select( getenv( "DECONV_SIMD" ) ) ;
+	return table ? table : SPECTRAL_select( NULL ) ;
+}
+
+static const SPECTRAL_table * SPECTRAL_kernels = SPECTRAL_startup() ;
+
+
+
+const char * get_spectral_isa()
+{
+	return SPECTRAL_kernels->isa ;
+}
+
+bool set_spectral_isa( const char * isa )
+{
+	const SPECTRAL_table * table = SPECTRAL_select( isa ) ;
+	if( table == NULL ) return false ;
+	SPECTRAL_kernels = table ;
+	return true ;
+}
+
+
+void SPECTRAL_multiplySplit( size_t n, double * re, double * im, const double * psf_re, const double * psf_im )
+{
+	SPECTRAL_kernels->dmultiply( n, re, im, psf_re, psf_im ) ;
+}
+
+void SPECTRAL_multiplySplit( size_t n, float * re, float * im, const float * psf_re, const float * psf_im )
+{
+	SPECTRAL_kernels->smultiply( n, re, im, psf_re, psf_im ) ;
+}
+
+void SPECTRAL_correlateSplit( size_t n, double * re, double * im, const double * psf_re, const double * psf_im )
+{
+	SPECTRAL_kernels->dcorrelate( n, re, im, psf_re, psf_im ) ;
+}
+
+void SPECTRAL_correlateSplit( size_t n, float * re, float * im, const float * psf_re, const float * psf_im )
+{
+	SPECTRAL_kernels->scorrelate( n, re, im, psf_re, psf_im ) ;
+}
+
+void SPECTRAL_residualSplit( size_t n, double * re, double * im, const double * image_re, const double * image_im, const double * otf )
+{
+	SPECTRAL_kernels->dresidual( n, re, im, image_re, image_im, otf ) ;
+}
+
+void SPECTRAL_residualSplit( size_t n, float * re, float * im, const float * image_re, const float * image_im, const float * otf )
+{
+	SPECTRAL_kernels->sresidual( n, re, im, image_re, image_im, otf ) ;
+}
@@ -0,0 +1,205 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:    Yuansheng Sun (yuansheng-sun@uiowa.edu)
+ * Copyright: University of Iowa 2006
+ *
+ * Filename:  UPDATEkernels.h
+ */
+
+
+#ifndef UPDATEKERNELS_H
+#define UPDATEKERNELS_H
+
+
+#include <math.h>
+#include <stdlib.h>
+#include "MYthreads.h"
+
+
+/*
+	UPDATE_object() applies the update of an iteration on the estimated object in one pass over the volume:
+	the new value of each voxel is given by the functor <step>, it is masked by <support> if it is not NULL, 
+	and the sums needed by deconvolver::_pushUpdate() are accumulated in UPDATE_sums on the way.
+	If <save> is true, the voxel is copied into <last> before the step; otherwise <last> holds the last object.
+	UPDATE_normalize() divides the object by its max and takes the sums again, the only second pass 
+	left, when the object is normalized.
+	UPDATE_apply() applies the step and the mask only, without the sums.
+	The kernels run in <nthreads> threads and the sums are deterministic (see "MYthreads.h").
+
+	The steps of the deconvolvers, <T> is double or float :
+	UPDATE_keep       : object,                                    the object has been updated already (EM).
+	UPDATE_add        : max( object + corr, 0 ),                   the LW update.
+	UPDATE_addSigned  : max( object + alpha * dir, 0 ),            the CG update; <sign> is 0 where it clips.
+	UPDATE_regularize : ( sqrt( 1 + 2 * penalty * object ) - 1 ) / penalty, the EM intensity regularization.
+*/
+
+typedef struct
+{
+	double max ;        /* max of the new object */
+	double oo ;         /* sum of object * object */
+	double dd ;         /* sum of ( object - last ) * ( object - last ) */
+} UPDATE_sums ;
+
+
+template< class T >
+struct UPDATE_keep
+{
+	const T * object ;
+	UPDATE_keep( const T * o ) : object( o ) {}
+	T operator()( size_t i ) const { return object[i] ; }
+} ;
+
+template< class T >
+struct UPDATE_add
+{
+	const T * object ;
+	const T * corr ;
+	UPDATE_add( const T * o, const T * c ) : object( o ), corr( c ) {}
+	T operator()( size_t i ) const 
+	{
+		T o = object[i] + corr[i] ;
+		return ( o < 0.0 ) ? 0.0 : o ;
+	}
+} ;
+
+template< class T >
+struct UPDATE_addSigned
+{
+	const T * object ;
+	const T * dir ;
+	T alpha ;
+	unsigned char * sign ;
+	UPDATE_addSigned( const T * o, const T * d, T a, unsigned char * s ) : object( o ), dir( d ), alpha( a ), sign( s ) {}
+	T operator()( size_t i ) const 
+	{
+		T o = object[i] + alpha * dir[i] ;
+		sign[i] = (unsigned char)( o >= 0.0 ) ;
+		return ( o < 0.0 ) ? 0.0 : o ;
+	}
+} ;
+
+template< class T >
+struct UPDATE_regularize
+{
+	const T * object ;
+	double penalty ;
+	UPDATE_regularize( const T * o, double p ) : object( o ), penalty( p ) {}
+	T operator()( size_t i ) const { return ( -1.0 + sqrt( 1.0 + 2.0 * penalty * object[i] ) ) / penalty ; }
+} ;
+
+
+template< class T, class Step >
+struct UPDATE_objectBody
+{
+	typedef UPDATE_sums result ;
+	T * object ; T * last ; bool save ; const Step * step ; const unsigned char * support ;
+	
+	UPDATE_sums operator()( size_t begin, size_t end ) const
+	{
+		UPDATE_sums sums = { -1.0E+37, 0.0, 0.0 } ;
+		T o ;
+		
+		for( size_t i = begin ; i < end ; i++ )
+		{
+			if( save ) last[i] = object[i] ;
+			o = (*step)( i ) ;
+			if( support != NULL ) o *= ((T) support[i]) ;
+			object[i] = o ;
+			
+			if( o > sums.max ) sums.max = o ;
+			sums.oo += ( o * o ) ;
+			sums.dd += ( o - last[i] ) * ( o - last[i] ) ;
+		}
+		return sums ;
+	}
+	
+	void join( UPDATE_sums & total, const UPDATE_sums & partial ) const 
+	{
+		if( partial.max > total.max ) total.max = partial.max ;
+		total.oo += partial.oo ;
+		total.dd += partial.dd ;
+	}
+} ;
+
+template< class T, class Step >
+inline UPDATE_sums UPDATE_object( size_t space, T * object, T * last, bool save, const Step & step, 
+                                  const unsigned char * support, int nthreads = 1 )
+{
+	UPDATE_objectBody< T, Step > body = { object, last, save, &step, support } ;
+	return my_parallel_reduce( space, body, nthreads ) ;
+}
+
+
+template< class T >
+struct UPDATE_normalizeBody
+{
+	typedef UPDATE_sums result ;
+	T * object ; const T * last ; T max ;
+	
+	UPDATE_sums operator()( size_t begin, size_t end ) const
+	{
+		UPDATE_sums sums = { 1.0, 0.0, 0.0 } ;
+		
+		for( size_t i = begin ; i < end ; i++ )
+		{
+			object[i] /= max ;
+			sums.oo += ( object[i] * object[i] ) ;
+			sums.dd += ( object[i] - last[i] ) * ( object[i] - last[i] ) ;
+		}
+		return sums ;
+	}
+	
+	void join( UPDATE_sums & total, const UPDATE_sums & partial ) const 
+	{
+		total.oo += partial.oo ;
+		total.dd += partial.dd ;
+	}
+} ;
+
+template< class T >
+inline UPDATE_sums UPDATE_normalize( size_t space, T * object, const T * last, T max, int nthreads = 1 )
+{
+	UPDATE_normalizeBody< T > body = { object, last, max } ;
+	return my_parallel_reduce( space, body, nthreads ) ;
+}
+
+
+template< class T, class Step >
+struct UPDATE_applyBody
+{
+	T * object ; const Step * step ; const unsigned char * support ;
+	
+	void operator()( size_t begin, size_t end ) const
+	{
+		T o ;
+		
+		for( size_t i = begin ; i < end ; i++ )
+		{
+			o = (*step)( i ) ;
+			if( support != NULL ) o *= ((T) support[i]) ;
+			object[i] = o ;
+		}
+	}
+} ;
+
+template< class T, class Step >
+inline void UPDATE_apply( size_t space, T * object, const Step & step, const unsigned char * support, int nthreads = 1 )
+{
+	UPDATE_applyBody< T, Step > body = { object, &step, support } ;
+	my_parallel_range( space, body, nthreads ) ;
+}
+
+
+#endif  /*   #include "UPDATEkernels.h"   */
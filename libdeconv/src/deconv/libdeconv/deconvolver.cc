@@ -21,6 +21,7 @@
 
 #include "deconvolver.h"
 #include "FFTW3fft.h"
+#include "SPECTRALkernels.h"
  
  
 /* public functions */
@@ -61,33 +62,60 @@ unsigned int deconvolver::exportLikelihoodTrack( double * vtrack )
 
 
 
-/* protected functions */
-
-bool deconvolver::_IsPowerOf2( int num )
+unsigned int deconvolver::CriterionIteration()
 {
-	int newnum, pcnt ;
-        
-	pcnt = 0 ;
-	newnum = num ;
-        
-	while( newnum > 0 ) 
+	double cri ;
+	for( unsigned int n = 10 ; n <= _Update.size() ; n++ )
 	{
-		newnum = newnum >> 1 ; 
-		pcnt++ ; 
+		cri = 0.0 ;
+		for( unsigned int i = 1 ; i <= 10 ; i++ ) cri += _Update[ n-i ] ;
+		cri /= 10.0 ;
+		if( cri <= _Criterion ) return n ;
 	}
 	
-	pcnt-- ;
-	newnum = 1 << pcnt;
+	return 0 ;
+}
+
 
-	if( newnum == num ) 
+
+template< class T >
+static bool EvenPSF( int DimX, int DimY, int DimZ, const T * psf, double tolerance )
+{
+	double max = 0.0 ;
+	for( size_t i = 0 ; i < (size_t) DimX * DimY * DimZ ; i++ ) 
 	{
-		return true ;
+		if( fabs( psf[i] ) > max ) max = fabs( psf[i] ) ;
 	}
-	else    return false ;
+	
+	for( int z = 0 ; z < DimZ ; z++ )
+	{
+		for( int y = 0 ; y < DimY ; y++ )
+		{
+			const T * row    = psf + ( (size_t) z * DimY + y ) * DimX ;
+			const T * mirror = psf + ( (size_t)( ( DimZ - z ) % DimZ ) * DimY + ( DimY - y ) % DimY ) * DimX ;
+			for( int x = 0 ; x < DimX ; x++ )
+			{
+				if( fabs( row[x] - mirror[( DimX - x ) % DimX] ) > tolerance * max ) return false ;
+			}
+		}
+	}
+	return true ;
+}
+
+bool deconvolver::IsEvenPSF( int DimX, int DimY, int DimZ, double * psf, double tolerance )
+{
+	return EvenPSF( DimX, DimY, DimZ, psf, tolerance ) ;
+}
+
+bool deconvolver::IsEvenPSF( int DimX, int DimY, int DimZ, float * psf, double tolerance )
+{
+	return EvenPSF( DimX, DimY, DimZ, psf, tolerance ) ;
 }
 
 
 
+/* protected functions */
+
 void deconvolver::_exportCommon( FILE * fp ) 
 {
 	if( _StartRunTime > 0 && _StopRunTime > 0 ) 
@@ -108,6 +136,10 @@ void deconvolver::_exportCommon( FILE * fp )
 	fprintf( fp, "%d -> Max_Allowed_Iterations in the deconvolution loop\n", _MaxRunIteration ) ;
 	fprintf( fp, "%d -> Actually_Run_Iterations in the deconvolution loop\n", (int)_Update.size() ) ;
 	fprintf( fp, "%e -> Stop_Criterion_to_Terminate the deconvolution loop\n",  _Criterion ) ;
+	fprintf( fp, "%s -> FFT_Planner_Effort of the deconvolution plans\n", FFTW3_effortName( _PlannerEffort ) ) ;
+	fprintf( fp, "%d -> Number_of_Threads used in the deconvolution\n", _Threads ) ;
+	fprintf( fp, "%d -> Interleaved_Spectra kept in the working space\n", ((int) _Interleaved) ) ;
+	fprintf( fp, "%d -> Real_OTF kept in the working space\n", ((int) _RealOTF) ) ;
 	fprintf( fp, "\n" ) ;
 	
 	fprintf( fp, "%d -> Apply Normalization on the input image and deconvolved object.\n", ((int) _ApplyNormalization) ) ;
@@ -120,12 +152,12 @@ void deconvolver::_exportCommon( FILE * fp )
 
 void deconvolver::_setDimensions( int DimX, int DimY, int DimZ )
 {
-	if( DimX > 0 && _IsPowerOf2(DimX) && DimY > 0 && _IsPowerOf2(DimY) && DimZ > 0 && _IsPowerOf2(DimZ)  )
+	if( DimX > 0 && DimY > 0 && DimZ > 0 )
 	{
 		_DimX  = DimX ;
 		_DimY  = DimY ;
 		_DimZ  = DimZ ;
-		_Space = DimX * DimY * DimZ ;
+		_Space = (size_t) DimX * DimY * DimZ ;
 	} 
 	else	throw DimensionError( DimX, DimY, DimZ ) ;
 }
@@ -141,50 +173,163 @@ void deconvolver::_setControlFlags(  bool IsCheck, bool IsApply, bool IsTrackMax
 	_ApplyFrequencySupport = false ;
 }
 
-void deconvolver::_initPSF( int size, double * psf, double * psf_re, double * psf_im, unsigned char * FrequencySupport, double * otf )
+void deconvolver::_initPSF( size_t size, double * psf, double * psf_re, double * psf_im, unsigned char * FrequencySupport, double * otf )
 {
-	fft3d( _DimX, _DimY, _DimZ, psf, psf_re, psf_im ) ;
+	if( _RealOTF )
+	{
+		/* <psf_im> is not in the working space, the imaginary part is dropped */
+		WS_malloc( psf_im, size ) ;
+		fft3d( _DimX, _DimY, _DimZ, psf, psf_re, psf_im ) ;
+		WS_free( psf_im ) ;
+	}
+	else	fft3d( _DimX, _DimY, _DimZ, psf, psf_re, psf_im ) ;
 	
 	if( FrequencySupport != NULL )
 	{
 		_ApplyFrequencySupport = true ;
-		for( int i = 0 ; i < size ; i++ )
+		for( size_t i = 0 ; i < size ; i++ )
 		{
 			psf_re[i] *= ((double) FrequencySupport[i]) ;
-			psf_im[i] *= ((double) FrequencySupport[i]) ;
+			if( psf_im != NULL ) psf_im[i] *= ((double) FrequencySupport[i]) ;
 		}
 	}
 	
 	if( otf != NULL )
 	{
-		for( int i = 0 ; i < size ; i++ ) 
+		for( size_t i = 0 ; i < size ; i++ ) 
 		{
-			otf[i] = psf_re[i] * psf_re[i] + psf_im[i] * psf_im[i] ;
+			otf[i] = psf_re[i] * psf_re[i] ;
+			if( psf_im != NULL ) otf[i] += psf_im[i] * psf_im[i] ;
 		}
 	}
 }
 
-void deconvolver::_initPSF( int size, float * psf, float * psf_re, float * psf_im, unsigned char * FrequencySupport, float * otf )
+void deconvolver::_initPSF( size_t size, float * psf, float * psf_re, float * psf_im, unsigned char * FrequencySupport, float * otf )
 {
-	fft3d( _DimX, _DimY, _DimZ, psf, psf_re, psf_im ) ;
+	if( _RealOTF )
+	{
+		/* <psf_im> is not in the working space, the imaginary part is dropped */
+		WS_malloc( psf_im, size ) ;
+		fft3d( _DimX, _DimY, _DimZ, psf, psf_re, psf_im ) ;
+		WS_free( psf_im ) ;
+	}
+	else	fft3d( _DimX, _DimY, _DimZ, psf, psf_re, psf_im ) ;
 	
 	if( FrequencySupport != NULL )
 	{
 		_ApplyFrequencySupport = true ;
-		for( int i = 0 ; i < size ; i++ )
+		for( size_t i = 0 ; i < size ; i++ )
 		{
 			psf_re[i] *= ((float) FrequencySupport[i]) ;
-			psf_im[i] *= ((float) FrequencySupport[i]) ;
+			if( psf_im != NULL ) psf_im[i] *= ((float) FrequencySupport[i]) ;
+		}
+	}
+	
+	if( otf != NULL )
+	{
+		for( size_t i = 0 ; i < size ; i++ ) 
+		{
+			otf[i] = psf_re[i] * psf_re[i] ;
+			if( psf_im != NULL ) otf[i] += psf_im[i] * psf_im[i] ;
+		}
+	}
+}
+
+/*
+	The interleaved layout: the PSF spectrum is computed by the forward status 4 <plan> of the run 
+	into <spec> holding plan->FFTsize() (re, im) pairs, or plan->FFTsize() real values if <_RealOTF>;
+	<otf>, if not NULL, receives its squared modulus as the split layout one above.
+*/
+void deconvolver::_initPSF( FFTW3_FFT * plan, double * psf, double * spec, unsigned char * FrequencySupport, double * otf )
+{
+	size_t size = plan->FFTsize() ;
+	
+	if( _RealOTF )
+	{
+		/* <spec> holds the real parts only */
+		double * temp = NULL ;
+		WS_malloc( temp, 2 * (size_t)size * plan->howmany() ) ;
+		plan->execute( psf, (fftw_complex *) temp ) ;
+		for( size_t i = 0 ; i < size * plan->howmany() ; i++ ) spec[i] = temp[2*i] ;
+		WS_free( temp ) ;
+		
+		if( FrequencySupport != NULL )
+		{
+			_ApplyFrequencySupport = true ;
+			for( size_t i = 0 ; i < size * plan->howmany() ; i++ ) spec[i] *= ((double) FrequencySupport[i % size]) ;
+		}
+		if( otf != NULL )
+		{
+			for( size_t i = 0 ; i < size * plan->howmany() ; i++ ) otf[i] = spec[i] * spec[i] ;
+		}
+		return ;
+	}
+	
+	plan->execute( psf, (fftw_complex *) spec ) ;
+	
+	if( FrequencySupport != NULL )
+	{
+		_ApplyFrequencySupport = true ;
+		for( int b = 0 ; b < plan->howmany() ; b++ )
+		{
+			double * sb = spec + 2 * b * size ;
+			SPECTRAL_support<2>( size, sb, sb + 1, FrequencySupport ) ;
 		}
 	}
 	
 	if( otf != NULL )
 	{
-		for( int i = 0 ; i < size ; i++ ) 
+		for( size_t i = 0 ; i < size * plan->howmany() ; i++ ) 
 		{
-			otf[i] = psf_re[i] * psf_re[i] + psf_im[i] * psf_im[i] ;
+			otf[i] = spec[2*i] * spec[2*i] + spec[2*i+1] * spec[2*i+1] ;
 		}
-	}	
+	}
+}
+
+void deconvolver::_initPSF( FFTW3_FFT * plan, float * psf, float * spec, unsigned char * FrequencySupport, float * otf )
+{
+	size_t size = plan->FFTsize() ;
+	
+	if( _RealOTF )
+	{
+		/* <spec> holds the real parts only */
+		float * temp = NULL ;
+		WS_malloc( temp, 2 * (size_t)size * plan->howmany() ) ;
+		plan->execute( psf, (fftwf_complex *) temp ) ;
+		for( size_t i = 0 ; i < size * plan->howmany() ; i++ ) spec[i] = temp[2*i] ;
+		WS_free( temp ) ;
+		
+		if( FrequencySupport != NULL )
+		{
+			_ApplyFrequencySupport = true ;
+			for( size_t i = 0 ; i < size * plan->howmany() ; i++ ) spec[i] *= ((float) FrequencySupport[i % size]) ;
+		}
+		if( otf != NULL )
+		{
+			for( size_t i = 0 ; i < size * plan->howmany() ; i++ ) otf[i] = spec[i] * spec[i] ;
+		}
+		return ;
+	}
+	
+	plan->execute( psf, (fftwf_complex *) spec ) ;
+	
+	if( FrequencySupport != NULL )
+	{
+		_ApplyFrequencySupport = true ;
+		for( int b = 0 ; b < plan->howmany() ; b++ )
+		{
+			float * sb = spec + 2 * b * size ;
+			SPECTRAL_support<2>( size, sb, sb + 1, FrequencySupport ) ;
+		}
+	}
+	
+	if( otf != NULL )
+	{
+		for( size_t i = 0 ; i < size * plan->howmany() ; i++ ) 
+		{
+			otf[i] = spec[2*i] * spec[2*i] + spec[2*i+1] * spec[2*i+1] ;
+		}
+	}
 }
 
 void deconvolver::_initIMG( double & max_intensity, double * image, double * object, unsigned char * SpacialSupport )
@@ -194,18 +339,18 @@ void deconvolver::_initIMG( double & max_intensity, double * image, double * obj
 	if( _ApplyNormalization )
 	{
 		max_intensity = object[0] ;
-		for( int i = 0 ; i < _Space ; i++ )
+		for( size_t i = 0 ; i < _Space ; i++ )
 		{
 			if( object[i] > max_intensity ) max_intensity = object[i] ;
 		}
-		for( int i = 0 ; i < _Space ; i++ ) object[i] /= max_intensity ;
+		for( size_t i = 0 ; i < _Space ; i++ ) object[i] /= max_intensity ;
 		
 		max_intensity = image[0] ;
-		for( int i = 0 ; i < _Space ; i++ )
+		for( size_t i = 0 ; i < _Space ; i++ )
 		{
 			if( image[i] > max_intensity ) max_intensity = image[i] ;
 		}
-		for( int i = 0 ; i < _Space ; i++ ) image[i] /= max_intensity ;
+		for( size_t i = 0 ; i < _Space ; i++ ) image[i] /= max_intensity ;
 	}
 }
 
@@ -216,87 +361,54 @@ void deconvolver::_initIMG( float & max_intensity, float * image, float * object
 	if( _ApplyNormalization )
 	{
 		max_intensity = object[0] ;
-		for( int i = 0 ; i < _Space ; i++ )
+		for( size_t i = 0 ; i < _Space ; i++ )
 		{
 			if( object[i] > max_intensity ) max_intensity = object[i] ;
 		}
-		for( int i = 0 ; i < _Space ; i++ ) object[i] /= max_intensity ;
+		for( size_t i = 0 ; i < _Space ; i++ ) object[i] /= max_intensity ;
 		
 		max_intensity = image[0] ;
-		for( int i = 0 ; i < _Space ; i++ )
+		for( size_t i = 0 ; i < _Space ; i++ )
 		{
 			if( image[i] > max_intensity ) max_intensity = image[i] ;
 		}
-		for( int i = 0 ; i < _Space ; i++ ) image[i] /= max_intensity ;
+		for( size_t i = 0 ; i < _Space ; i++ ) image[i] /= max_intensity ;
 	}
 }
 
 void deconvolver::_getUpdate( double * object, double * last_object, unsigned char * SpacialSupport )
 {
-	if( SpacialSupport != NULL )
-	{
-		for( int i = 0 ; i < _Space ; i++ ) object[i] *= ((double) SpacialSupport[i]) ;
-	}
-     	    		
-	if( _TrackMaxInObject )
-	{
-		double max_intensity = object[0] ;
-     		
-		for( int i = 0 ; i < _Space ; i++ )
-		{
-			if( object[i] > max_intensity  ) max_intensity = object[i] ;
-		}
-     		
-		_ObjectMax.push_back( max_intensity ) ;
+	_pushUpdate( object, last_object, 
+	             UPDATE_object( _Space, object, last_object, false, UPDATE_keep< double >( object ), SpacialSupport, _Threads ) ) ;
+}
 
-		if( _ApplyNormalization )
-		{
-			for( int i = 0 ; i < _Space ; i++ ) object[i] /= max_intensity ;
-		}
-	}
-	     			
-	double temp1 = 0.0 ;
-	double temp2 = 0.0 ;
-     	
-	for( int i = 0 ; i < _Space ; i++ )
+void deconvolver::_getUpdate( float * object, float * last_object, unsigned char * SpacialSupport )
+{
+	_pushUpdate( object, last_object, 
+	             UPDATE_object( _Space, object, last_object, false, UPDATE_keep< float >( object ), SpacialSupport, _Threads ) ) ;
+}
+
+/*
+	Track the max and the update of an object whose sums were taken by UPDATE_object() (see "UPDATEkernels.h").
+*/
+void deconvolver::_pushUpdate( double * object, double * last_object, UPDATE_sums sums )
+{
+	if( _TrackMaxInObject )
 	{
-		temp1 += ( object[i] - last_object[i] )* ( object[i] - last_object[i] ) ;
-		temp2 += ( object[i] * object[i] ) ;
+		_ObjectMax.push_back( sums.max ) ;
+		if( _ApplyNormalization ) sums = UPDATE_normalize( _Space, object, last_object, (double) sums.max, _Threads ) ;
 	}
-
-	_Update.push_back( (temp1/temp2) ) ;
+	
+	_Update.push_back( ( sums.dd / sums.oo ) ) ;
 }
 
-void deconvolver::_getUpdate( float * object, float * last_object, unsigned char * SpacialSupport )
+void deconvolver::_pushUpdate( float * object, float * last_object, UPDATE_sums sums )
 {
-	if( SpacialSupport != NULL )
-	{
-		for( int i = 0 ; i < _Space ; i++ ) object[i] *= ((float) SpacialSupport[i]) ;
-	}    		
-     	
 	if( _TrackMaxInObject )
 	{
-		float max_intensity = object[0] ;
-		for( int i = 0 ; i < _Space ; i++ )
-		{
-			if( object[i] > max_intensity  ) max_intensity = object[i] ;
-		}
-		
-		_ObjectMax.push_back( max_intensity ) ;
-     		
-		if( _ApplyNormalization )
-		{
-			for( int i = 0 ; i < _Space ; i++ ) object[i] /= max_intensity ;
-		}
-	}     			
-     		
-	double temp1 = 0.0 ;
-	double temp2 = 0.0 ;
-     	
-	for( int i = 0 ; i < _Space ; i++ )
-	{
-		temp1 += ( object[i] - last_object[i] )* ( object[i] - last_object[i] ) ;
-		temp2 += ( object[i] * object[i] ) ;
+		_ObjectMax.push_back( sums.max ) ;
+		if( _ApplyNormalization ) sums = UPDATE_normalize( _Space, object, last_object, (float) sums.max, _Threads ) ;
 	}
-	_Update.push_back( (temp1/temp2) ) ;
+	
+	_Update.push_back( ( sums.dd / sums.oo ) ) ;
 }
@@ -27,7 +27,11 @@
 #include <stdio.h>
 #include <time.h>
 #include <vector>
+#include <new>
 #include "MYerror.h"
+#include "FFTW3fft.h"
+#include "MYthreads.h"
+#include "UPDATEkernels.h"
 
 
 /*
@@ -91,6 +95,55 @@
  *	<_MaxRunIteration>, it is the number of max allowed deconvolved iterations; its default value is 1000;
  *	                    Deconvolution process will be stopped when <_MaxRunIteration> iteraions have been 
  *	                    executed in the deconvolution main loop even if the criterion is not achieved.
+ *
+ *
+ *	-------------------------------------------
+ *	FFT Planner Effort : <_PlannerEffort>
+ *	-------------------------------------------
+ *
+ *	<_PlannerEffort>, it is the planner effort of the FFT plans used in a deconvolution (see "FFTW3fft.h");
+ *	                  its default value is FFTW3_MEASURE and it is not changed by init();
+ *	                  FFTW3_ESTIMATE plans at once and suits quick previews, 
+ *	                  FFTW3_PATIENT plans slowly but pays off in long runs,
+ *	                  FFTW3_AUTO times the candidate plans the first time a size is seen.
+ *
+ *
+ *	-------------------------------------------
+ *	Number of Threads : <_Threads>
+ *	-------------------------------------------
+ *
+ *	<_Threads>, it is the number of threads used in a deconvolution; its default value is get_my_threads(),
+ *	            which is taken from the environment variable DECONV_NUM_THREADS (see "MYthreads.h");
+ *	            it is not changed by init(). The FFT plans are executed with <_Threads> threads
+ *	            if the library is built with the FFTW3 threads libraries.
+ *
+ *
+ *	-------------------------------------------
+ *	Spectrum Layout : <_Interleaved>
+ *	-------------------------------------------
+ *
+ *	<_Interleaved>, it selects the layout of the spectra kept in the working space; its default value is false
+ *	                and it is not changed by init(). If it is false, a spectrum is kept in two split arrays
+ *	                <*_re> and <*_im>. If it is true, a spectrum is kept interleaved as (re, im) pairs in
+ *	                the <*_re> array of twice the size and the <*_im> array is not allocated (NULL);
+ *	                the spectral kernels then read half as many memory streams and FFTW runs faster.
+ *	                Both layouts give the same deconvolved object. It is used by EMdeconvolver,
+ *	                LWdeconvolver and CGdeconvolver; the input image and psf arrays of LWdeconvolver
+ *	                and CGdeconvolver only hold real volumes and do not depend on it.
+ *
+ *
+ *	-------------------------------------------
+ *	PSF Spectrum : <_RealOTF>
+ *	-------------------------------------------
+ *
+ *	<_RealOTF>, it selects a real PSF spectrum; its default value is false and it is not changed by init().
+ *	            The PSF of a microscope, as given by Fluo3DPSF and FluoRZPSF, is even in the layout 
+ *	            of the deconvolution, psf( x, y, z ) = psf( -x, -y, -z ) with periodic coordinates, 
+ *	            so its spectrum is real. If it is true, only the real part of the PSF spectrum is kept 
+ *	            in <psf_re> and <psf_im> is not allocated (NULL); each complex product with the PSF spectrum 
+ *	            becomes two real scalings, which halves the memory and the traffic of the PSF spectrum.
+ *	            This deconvolves with the even part of the PSF, ( psf( x, y, z ) + psf( -x, -y, -z ) ) / 2,
+ *	            which is the PSF itself when IsEvenPSF() is true.
  */
 
 class DimensionError : public Error
@@ -98,17 +151,57 @@ class DimensionError : public Error
 	public:
 	DimensionError( int DimX, int DimY, int DimZ )
 	{
-		_error << " Deconvolver::run() : each dimension must be positive and power of 2.\n"
+		_error << " Deconvolver::run() : each dimension must be positive.\n"
 		       << " dimensions was set -> DimX = " << DimX 
 		       << " , DimY = " << DimY << " , DimZ = " << DimZ << ".\n" ; 
 	}
 } ;
+
+class WorkspaceError : public Error
+{
+	public:
+	WorkspaceError( size_t size, size_t needed )
+	{
+		_error << " Deconvolver::run() : the working space does not fit the run ;"
+		       << " allocate it after setting the dimensions and the control flags.\n"
+		       << " working space size -> " << size << " , size of the run -> " << needed << ".\n" ; 
+	}
+} ;
+
+class SessionError : public Error
+{
+	public:
+	SessionError( const char * session )
+	{
+		_error << " " << session << "::run() : the session must be prepared in the same floating precision first.\n" ;
+	}
+} ;
+
+/*
+ *	Allocate/free a working space array with fftw_malloc()/fftw_free(), so that it is aligned 
+ *	for the SIMD code of FFTW; WS_malloc() returns the size of the array in bytes.
+ *	Throw: WS_malloc() throws std::bad_alloc, as new does, if the array can not be allocated; <p> is then NULL.
+ */
+template< class T >
+inline size_t WS_malloc( T * & p, size_t n )
+{
+	p = ( n > 0 ) ? (T *) fftw_malloc( n * sizeof(T) ) : NULL ;
+	if( n > 0 && p == NULL ) throw std::bad_alloc() ;
+	return ( n * sizeof(T) ) ;
+}
+
+template< class T >
+inline void WS_free( T * & p )
+{
+	if( p != NULL ) fftw_free( p ) ;
+	p = NULL ;
+}
   	                 
 class deconvolver
 {
  public:
 	virtual ~deconvolver() {}
-	deconvolver() {}
+	deconvolver() : _PlannerEffort( FFTW3_MEASURE ), _Threads( get_my_threads() ), _Interleaved( false ), _RealOTF( false ) {}
 	
 	
 	/*
@@ -121,7 +214,7 @@ class deconvolver
 	int     DimX()                { return _DimX ;               }
 	int     DimY()                { return _DimY ;               }
 	int     DimZ()                { return _DimZ ;               }
-	int     Space()               { return _Space ;              }
+	size_t  Space()               { return _Space ;              }
 
 	
 	/*	Get protected members - control flags in the deconvolution
@@ -159,6 +252,54 @@ class deconvolver
 	 *		cri, it is the criterion and its default value is 1.0e-7.
 	 */     
 	void    setCriterion( double cri = 1.0e-7 ) { _Criterion = cri ;        }
+
+
+	/*
+	 *	Get/Set the planner effort of the FFT plans described above
+	 *	Input:
+	 *		effort, it is the planner effort and its default value is FFTW3_MEASURE.
+	 */
+	FFTW3_Effort  PlannerEffort()  { return _PlannerEffort ; }
+	void    setPlannerEffort( FFTW3_Effort effort = FFTW3_MEASURE ) { _PlannerEffort = effort ; }
+
+
+	/*
+	 *	Get/Set the number of threads described above
+	 *	Input:
+	 *		nthreads, it is the number of threads; a number less than 1 is taken as 1.
+	 */
+	int     Threads()  { return _Threads ; }
+	void    setThreads( int nthreads ) { _Threads = ( nthreads < 1 ) ? 1 : nthreads ; }
+
+
+	/*
+	 *	Get/Set the spectrum layout described above
+	 *	Input:
+	 *		IsInterleaved, it is true to keep the spectra interleaved and its default value is false.
+	 */
+	bool    Interleaved()  { return _Interleaved ; }
+	void    setInterleaved( bool IsInterleaved = false ) { _Interleaved = IsInterleaved ; }
+
+
+	/*
+	 *	Get/Set the real PSF spectrum described above
+	 *	Input:
+	 *		IsReal, it is true to keep the PSF spectrum real and its default value is false.
+	 */
+	bool    RealOTF()  { return _RealOTF ; }
+	void    setRealOTF( bool IsReal = false ) { _RealOTF = IsReal ; }
+
+
+	/*
+	 *	Check whether a PSF is even in the layout of the deconvolution, so that setRealOTF( true ) is exact
+	 *	Input:
+	 *		DimX, DimY, DimZ, they are the dimensions of the PSF;
+	 *		psf, it points to the PSF of DimX*DimY*DimZ values;
+	 *		tolerance, it is the largest difference allowed between psf( x, y, z ) and psf( -x, -y, -z ) 
+	 *		           relative to the max of the PSF, and its default value is 1.0e-6.
+	 */
+	static bool  IsEvenPSF( int DimX, int DimY, int DimZ, double * psf, double tolerance = 1.0e-6 ) ;
+	static bool  IsEvenPSF( int DimX, int DimY, int DimZ, float  * psf, double tolerance = 1.0e-6 ) ;
         
         
 	/* 
@@ -187,14 +328,26 @@ class deconvolver
 	 */
 	unsigned int  exportLikelihoodTrack( double * vtrack ) ;
 	
+	
+	/* 
+	 *	Get the number of iterations the last run took to meet <_Criterion>, taken from the update track
+	 *	as in the deconvolution loop; it is 0 if the run stopped before, e.g. at <_MaxRunIteration>.
+	 *	It compares the convergence of the modes of a deconvolver on a same image.
+	 */
+	unsigned int  CriterionIteration() ;
+	
 
 	protected:
 	int                     _DimX ;
 	int                     _DimY ;
 	int                     _DimZ ;
-	int                     _Space ;        
+	size_t                  _Space ;        
 	unsigned int            _MaxRunIteration ;
 	double                  _Criterion ;        
+	FFTW3_Effort            _PlannerEffort ;
+	int                     _Threads ;
+	bool                    _Interleaved ;
+	bool                    _RealOTF ;
 	bool                    _CheckStatus ;
 	bool                    _ApplyNormalization ;
 	bool                    _TrackMaxInObject ;
@@ -208,22 +361,26 @@ class deconvolver
 	bool                    _ApplySpacialSupport ;
 	bool                    _ApplyFrequencySupport ;
         
-	bool  _IsPowerOf2( int num ) ;
-        
 	void  _exportCommon( FILE * fp ) ;
         
 	void  _setDimensions( int DimX, int DimY, int DimZ ) ;
         
 	void  _setControlFlags( bool IsCheck, bool IsApply, bool IsTrackMax, bool IsTrackLike ) ;
 	
-	void  _initPSF( int size, double * psf, double * psf_re, double * psf_im, unsigned char * FrequencySupport, double * otf = NULL ) ;	 
-	void  _initPSF( int size, float  * psf, float  * psf_re, float  * psf_im, unsigned char * FrequencySupport, float  * otf = NULL ) ;
+	void  _initPSF( size_t size, double * psf, double * psf_re, double * psf_im, unsigned char * FrequencySupport, double * otf = NULL ) ;	 
+	void  _initPSF( size_t size, float  * psf, float  * psf_re, float  * psf_im, unsigned char * FrequencySupport, float  * otf = NULL ) ;
+
+	void  _initPSF( FFTW3_FFT * plan, double * psf, double * spec, unsigned char * FrequencySupport, double * otf = NULL ) ;
+	void  _initPSF( FFTW3_FFT * plan, float  * psf, float  * spec, unsigned char * FrequencySupport, float  * otf = NULL ) ;
         
 	void  _initIMG( double & max_intensity, double * image, double * object, unsigned char * SpacialSupport ) ;
 	void  _initIMG( float  & max_intensity, float  * image, float  * object, unsigned char * SpacialSupport ) ;  
         
 	void  _getUpdate( double * object, double * last_object, unsigned char * SpacialSupport ) ;
 	void  _getUpdate( float  * object, float  * last_object, unsigned char * SpacialSupport ) ;     
+        
+	void  _pushUpdate( double * object, double * last_object, UPDATE_sums sums ) ;
+	void  _pushUpdate( float  * object, float  * last_object, UPDATE_sums sums ) ;     
 } ;
 
 
@@ -0,0 +1,213 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:    Yuansheng Sun (yuansheng-sun@uiowa.edu)
+ * Copyright: University of Iowa 2006
+ *
+ * Filename:  deconvInterleaved.cc
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <iostream>
+#include <vector>
+#include "libdeconv/EMdeconvolver.h"
+#include "libdeconv/LWdeconvolver.h"
+#include "libdeconv/CGdeconvolver.h"
+
+
+/*
+ *	deconvInterleaved is designed for checking the interleaved spectrum layout of the deconvolvers
+ *	(see setInterleaved() in "deconvolver.h") against the split layout. It deconvolves a small zero padded
+ *	image with a Gaussian PSF in both layouts, in double and single precision, with EMdeconvolver without 
+ *	and with a nonzero extent (see "EMdeconvolver.h"), so that the pruned FFTs are run, and with 
+ *	LWdeconvolver and CGdeconvolver in the variants which run the different spectral kernels;
+ *	the objects must agree within the rounding errors of the FFTs.
+ *
+ *	One dummy input argument:
+ *		[<iterations>]
+ *	It returns 0 if all the runs agree, 1 otherwise.
+ */
+
+
+std::string usage = std::string("$deconvInterleaved [<iterations>]\n") ;
+
+static const int DimX = 12, DimY = 10, DimZ = 8 ;
+static const int ExtX = 8,  ExtY = 7,  ExtZ = 5 ;
+
+
+/* a wrapped Gaussian PSF of unit sum and a random image which is zero outside the extent */
+template< class T >
+static void makeData( std::vector< T > & image, std::vector< T > & psf )
+{
+	size_t Space = (size_t) DimX * DimY * DimZ ;
+	double sum   = 0.0 ;
+
+	image.assign( Space, (T) 0.0 ) ;
+	psf.assign( Space, (T) 0.0 ) ;
+	srand( 1 ) ;
+	for( int z = 0 ; z < DimZ ; z++ )
+		for( int y = 0 ; y < DimY ; y++ )
+			for( int x = 0 ; x < DimX ; x++ )
+			{
+				size_t i  = x + y * DimX + (size_t) z * DimX * DimY ;
+				int    dx = ( x < DimX / 2 ) ? x : x - DimX ;
+				int    dy = ( y < DimY / 2 ) ? y : y - DimY ;
+				int    dz = ( z < DimZ / 2 ) ? z : z - DimZ ;
+				psf[i] = (T) exp( -( dx * dx + dy * dy ) / 2.0 - dz * dz / 3.0 ) ;
+				sum   += psf[i] ;
+				if( x < ExtX && y < ExtY && z < ExtZ ) image[i] = (T)( 1 + rand() % 100 ) ;
+			}
+	for( size_t i = 0 ; i < Space ; i++ ) psf[i] = (T)( psf[i] / sum ) ;
+}
+
+
+/* 
+ *	The runs of one deconvolver in the layout <interleaved>, <variant> selects its options :
+ *	EM : 0 the whole volume, 1 the nonzero extent.
+ *	LW : 0 the conditioning search, 1 the tracked likelihood, 2 several conditioning candidates, 
+ *	     3 a real OTF with several linear steps.
+ *	CG : 0 the intensity regularization, 1 the tracked likelihood, 2 no regularization, 3 a real OTF.
+ */
+template< class T, class WS >
+static void runEM( bool interleaved, int variant, int iterations, const std::vector< T > & image,
+                   const std::vector< T > & psf, std::vector< T > & object )
+{
+	EMdeconvolver d ;
+	WS            ws ;
+
+	d.init( false, false, false, false, false ) ;
+	d.setMaxRunIteration( iterations ) ;
+	d.setCriterion( 0.0 ) ;
+	d.setInterleaved( interleaved ) ;
+	if( variant == 1 ) d.setNonzeroExtent( ExtX, ExtY, ExtZ ) ;
+
+	object = image ;
+	d.run( DimX, DimY, DimZ, &image[0], &psf[0], &object[0], ws ) ;
+}
+
+template< class T, class WS >
+static void runLW( bool interleaved, int variant, int iterations, const std::vector< T > & image,
+                   const std::vector< T > & psf, std::vector< T > & object )
+{
+	LWdeconvolver d ;
+	WS            ws ;
+
+	d.init( false, variant == 1, false, false, false ) ;
+	d.setMaxRunIteration( iterations ) ;
+	d.setCriterion( 0.0 ) ;
+	d.setInterleaved( interleaved ) ;
+	if( variant == 2 ) d.setConditioningCandidates( 3 ) ;
+	if( variant == 3 ) 
+	{
+		d.setRealOTF( true ) ;
+		d.setLinearSteps( 3 ) ;
+	}
+
+	object = image ;
+	d.run( DimX, DimY, DimZ, &image[0], &psf[0], &object[0], ws ) ;
+}
+
+template< class T, class WS >
+static void runCG( bool interleaved, int variant, int iterations, const std::vector< T > & image,
+                   const std::vector< T > & psf, std::vector< T > & object )
+{
+	CGdeconvolver d ;
+	WS            ws ;
+
+	d.init( variant != 2, false, variant == 1, false, false ) ;
+	d.setMaxRunIteration( iterations ) ;
+	d.setCriterion( 0.0 ) ;
+	d.setInterleaved( interleaved ) ;
+	if( variant == 3 ) d.setRealOTF( true ) ;
+
+	object = image ;
+	d.run( DimX, DimY, DimZ, &image[0], &psf[0], &object[0], ws ) ;
+}
+
+
+/* the largest difference between <a> and <b> relative to the largest value of <a> */
+template< class T >
+static double difference( const std::vector< T > & a, const std::vector< T > & b )
+{
+	double diff = 0.0, max = 0.0 ;
+	for( size_t i = 0 ; i < a.size() ; i++ )
+	{
+		if( fabs( (double) a[i] - (double) b[i] ) > diff ) diff = fabs( (double) a[i] - (double) b[i] ) ;
+		if( fabs( (double) a[i] ) > max )                  max  = fabs( (double) a[i] ) ;
+	}
+	return ( max > 0.0 ) ? diff / max : diff ;
+}
+
+
+/* 1 if the interleaved run of <run> differs from the split one by more than <tolerance>, 0 otherwise */
+template< class T >
+static int check( const char * name, void (*run)( bool, int, int, const std::vector< T > &, const std::vector< T > &, 
+                  std::vector< T > & ), int variant, const char * option, int iterations, double tolerance )
+{
+	std::vector< T > image, psf, split, inter ;
+
+	makeData( image, psf ) ;
+	run( false, variant, iterations, image, psf, split ) ;
+	run( true,  variant, iterations, image, psf, inter ) ;
+
+	double diff = difference( split, inter ) ;
+	bool   same = ( diff <= tolerance ) ;
+	printf( " %s %s %-12s : interleaved %s split, relative difference %12.6e\n", name,
+	         sizeof(T) == sizeof(double) ? "double" : "float ", option, same ? "same as" : "DIFFERS from", diff ) ;
+	return same ? 0 : 1 ;
+}
+
+
+int main( int argc, char ** argv )
+{
+	int iterations = 20 ;
+	int mismatches = 0 ;
+
+	if( argc > 2 )
+	{
+		std::cout << usage ;
+		return 1 ;
+	}
+	if( argc > 1 ) iterations = atoi( argv[1] ) ;
+	if( iterations < 1 )
+	{
+		std::cout << usage ;
+		return 1 ;
+	}
+
+	const char * EMoptions[] = { "no extent", "extent" } ;
+	const char * LWoptions[] = { "conditioned", "likelihood", "candidates", "real OTF" } ;
+	const char * CGoptions[] = { "regularized", "likelihood", "plain", "real OTF" } ;
+	for( int v = 0 ; v < 2 ; v++ )
+	{
+		mismatches += check< double >( "EM", runEM< double, EMdws >, v, EMoptions[v], iterations, 1.0E-9 ) ;
+		mismatches += check< float >(  "EM", runEM< float,  EMsws >, v, EMoptions[v], iterations, 1.0E-4 ) ;
+	}
+	for( int v = 0 ; v < 4 ; v++ )
+	{
+		mismatches += check< double >( "LW", runLW< double, LWdws >, v, LWoptions[v], iterations, 1.0E-9 ) ;
+		mismatches += check< float >(  "LW", runLW< float,  LWsws >, v, LWoptions[v], iterations, 1.0E-4 ) ;
+	}
+	for( int v = 0 ; v < 4 ; v++ )
+	{
+		mismatches += check< double >( "CG", runCG< double, CGdws >, v, CGoptions[v], iterations, 1.0E-9 ) ;
+		mismatches += check< float >(  "CG", runCG< float,  CGsws >, v, CGoptions[v], iterations, 1.0E-4 ) ;
+	}
+
+	FFTW3_PlanCache::clear() ;
+	return ( mismatches == 0 ) ? 0 : 1 ;
+}
@@ -0,0 +1,185 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:    Yuansheng Sun (yuansheng-sun@uiowa.edu)
+ * Copyright: University of Iowa 2006
+ *
+ * Filename:  deconvLayout.cc
+ */
+ 
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <math.h>
+#include <iostream>
+#include "libdeconv/FFTW3fft.h"
+#include "libdeconv/SPECTRALkernels.h"
+
+
+/*
+ *	deconvLayout is designed for comparing the split and interleaved spectrum layouts (see "FFTW3fft.h")
+ *	on a given deconvolution size. It times the cycle run in every deconvolution iteration 
+ *	- a forward r2c transform, a pointwise multiplication with the PSF spectrum and a backward c2r transform -
+ *	and the spectral kernel alone, whose memory bandwidth is reported in GB/s.
+ *
+ *	Three required input arguments:
+ *		<DimensionX> <DimensionY> <DimensionZ>
+ *	Two dummy input arguments:
+ *		[<iterations>] [<threads>]
+ */
+
+
+#define DataType                    float   //benchmark precision
+#define IsDoubleType                false   //put true if <DataType> is double.
+#define ComplexType                 fftwf_complex   //put fftw_complex if <DataType> is double.
+
+
+std::string usage = std::string("$deconvLayout <DimensionX> <DimensionY> <DimensionZ> [<iterations>] [<threads>]\n") ;
+
+
+static double seconds()
+{
+	struct timeval t ;
+	gettimeofday( &t, NULL ) ;
+	return (double) t.tv_sec + 1.0E-6 * (double) t.tv_usec ;
+}
+
+
+int main( int argc, char ** argv )
+{
+	int          DimX, DimY, DimZ ;
+	size_t       Space, size ;
+	int          iterations = 50 ;
+	int          threads    = 1 ;
+	double       t0, t_split, t_inter, k_split, k_inter, bytes, diff ;
+	FFTW3_FFT  * splitf, * splitb, * interf, * interb ;
+	
+
+	if( argc < 4 || argc > 6 )
+	{
+		std::cout << usage ;
+		return 1 ;
+	}
+
+	DimX = atoi( argv[1] ) ;
+	DimY = atoi( argv[2] ) ;
+	DimZ = atoi( argv[3] ) ;
+	if( argc > 4 ) iterations = atoi( argv[4] ) ;
+	if( argc > 5 ) threads    = atoi( argv[5] ) ;
+	if( DimX < 1 || DimY < 1 || DimZ < 1 || iterations < 1 )
+	{
+		std::cout << usage ;
+		return 1 ;
+	}
+	Space = (size_t) DimX * DimY * DimZ ;
+
+	splitf = FFTW3_PlanCache::acquire( DimX, DimY, DimZ, true,  IsDoubleType, 3, FFTW3_MEASURE, threads ) ;
+	splitb = FFTW3_PlanCache::acquire( DimX, DimY, DimZ, false, IsDoubleType, 3, FFTW3_MEASURE, threads ) ;
+	interf = FFTW3_PlanCache::acquire( DimX, DimY, DimZ, true,  IsDoubleType, 4, FFTW3_MEASURE, threads ) ;
+	interb = FFTW3_PlanCache::acquire( DimX, DimY, DimZ, false, IsDoubleType, 4, FFTW3_MEASURE, threads ) ;
+	size   = splitf->FFTsize() ;
+
+	DataType * psf    = (DataType *) fftw_malloc( sizeof(DataType) * Space ) ;
+	DataType * in     = (DataType *) fftw_malloc( sizeof(DataType) * Space ) ;
+	DataType * out1   = (DataType *) fftw_malloc( sizeof(DataType) * Space ) ;
+	DataType * out2   = (DataType *) fftw_malloc( sizeof(DataType) * Space ) ;
+	DataType * psf_re = (DataType *) fftw_malloc( sizeof(DataType) * size ) ;
+	DataType * psf_im = (DataType *) fftw_malloc( sizeof(DataType) * size ) ;
+	DataType * buf_re = (DataType *) fftw_malloc( sizeof(DataType) * size ) ;
+	DataType * buf_im = (DataType *) fftw_malloc( sizeof(DataType) * size ) ;
+	DataType * psf_c  = (DataType *) fftw_malloc( sizeof(DataType) * size * 2 ) ;
+	DataType * buf_c  = (DataType *) fftw_malloc( sizeof(DataType) * size * 2 ) ;
+
+	/* a smooth PSF of unit sum and a noisy object */
+	srand( 1 ) ;
+	for( size_t i = 0 ; i < Space ; i++ )
+	{
+		psf[i] = (DataType) 0.0 ;
+		in[i]  = (DataType) ( rand() % 256 ) ;
+	}
+	psf[0] = (DataType) 0.5 ;
+	psf[1 % Space] += (DataType) 0.25 ;
+	psf[(Space - 1) % Space] += (DataType) 0.25 ;
+
+	splitf->execute( psf, psf_re, psf_im ) ;
+	interf->execute( psf, (ComplexType *) psf_c ) ;
+
+	std::cout << " deconvLayout size : " << DimX << " x " << DimY << " x " << DimZ 
+	          << " , spectrum size : " << size << " , iterations : " << iterations 
+	          << " , threads : " << threads << "\n" ;
+
+	/* full cycle, split layout */
+	t0 = seconds() ;
+	for( int k = 0 ; k < iterations ; k++ )
+	{
+		splitf->execute( in, buf_re, buf_im ) ;
+		SPECTRAL_multiply<1>( size, buf_re, buf_im, psf_re, psf_im ) ;
+		splitb->execute( buf_re, buf_im, out1 ) ;
+	}
+	t_split = ( seconds() - t0 ) / iterations ;
+
+	/* full cycle, interleaved layout */
+	t0 = seconds() ;
+	for( int k = 0 ; k < iterations ; k++ )
+	{
+		interf->execute( in, (ComplexType *) buf_c ) ;
+		SPECTRAL_multiply<2>( size, buf_c, buf_c + 1, psf_c, psf_c + 1 ) ;
+		interb->execute( (ComplexType *) buf_c, out2 ) ;
+	}
+	t_inter = ( seconds() - t0 ) / iterations ;
+
+	diff = 0.0 ;
+	for( size_t i = 0 ; i < Space ; i++ )
+	{
+		if( fabs( (double) out1[i] - (double) out2[i] ) > diff ) diff = fabs( (double) out1[i] - (double) out2[i] ) ;
+	}
+
+	/* spectral kernel alone, it reads 4 and writes 2 values per frequency in both layouts */
+	t0 = seconds() ;
+	for( int k = 0 ; k < iterations ; k++ ) SPECTRAL_multiply<1>( size, buf_re, buf_im, psf_re, psf_im ) ;
+	k_split = ( seconds() - t0 ) / iterations ;
+
+	t0 = seconds() ;
+	for( int k = 0 ; k < iterations ; k++ ) SPECTRAL_multiply<2>( size, buf_c, buf_c + 1, psf_c, psf_c + 1 ) ;
+	k_inter = ( seconds() - t0 ) / iterations ;
+
+	bytes = 6.0 * (double) size * sizeof(DataType) ;
+
+	printf( " split       : cycle %10.3f ms , kernel %8.3f ms , %7.2f GB/s\n", 
+	         1000.0 * t_split, 1000.0 * k_split, bytes / k_split / 1.0E9 ) ;
+	printf( " interleaved : cycle %10.3f ms , kernel %8.3f ms , %7.2f GB/s\n", 
+	         1000.0 * t_inter, 1000.0 * k_inter, bytes / k_inter / 1.0E9 ) ;
+	printf( " speedup     : cycle %10.3f x  , kernel %8.3f x\n", t_split / t_inter, k_split / k_inter ) ;
+	printf( " max difference between the layouts : %12.6e\n", diff ) ;
+
+	FFTW3_PlanCache::release( splitf ) ;
+	FFTW3_PlanCache::release( splitb ) ;
+	FFTW3_PlanCache::release( interf ) ;
+	FFTW3_PlanCache::release( interb ) ;
+	FFTW3_PlanCache::clear() ;
+
+	fftw_free( psf ) ;
+	fftw_free( in ) ;
+	fftw_free( out1 ) ;
+	fftw_free( out2 ) ;
+	fftw_free( psf_re ) ;
+	fftw_free( psf_im ) ;
+	fftw_free( buf_re ) ;
+	fftw_free( buf_im ) ;
+	fftw_free( psf_c ) ;
+	fftw_free( buf_c ) ;
+
+	return 0 ;
+}
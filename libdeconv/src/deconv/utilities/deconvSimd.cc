@@ -0,0 +1,139 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:    Yuansheng Sun (yuansheng-sun@uiowa.edu)
+ * Copyright: University of Iowa 2006
+ *
+ * Filename:  deconvSimd.cc
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+#include "libdeconv/SPECTRALkernels.h"
+
+
+/*
+ *	deconvSimd is designed for checking the vector kernels of the split spectrum layout (see "SPECTRALkernels.h")
+ *	against the "scalar" kernels. Every kernel set supported by the CPU runs SPECTRAL_multiplySplit(),
+ *	SPECTRAL_correlateSplit() and SPECTRAL_residualSplit() in double and single precision on every length
+ *	from 0 to <MaxLength> and on arrays shifted by one value, so that the vector tails and the unaligned
+ *	loads are run; the results must be equal to the "scalar" ones bit for bit.
+ *
+ *	One dummy input argument:
+ *		[<MaxLength>]
+ *	It returns 0 if all the kernels agree, 1 otherwise.
+ */
+
+
+std::string usage = std::string("$deconvSimd [<MaxLength>]\n") ;
+
+static const char * isas[] = { "sse2", "avx2", "avx512" } ;
+
+
+/* the three kernels of the kernel set in use on the length <n> from the same random input */
+template< class T >
+static void runKernels( size_t n, size_t shift, unsigned seed, std::vector< T > & out )
+{
+	std::vector< T > a( n + shift ), b( n + shift ), c( n + shift ), d( n + shift ), e( n + shift ) ;
+
+	srand( seed ) ;
+	for( size_t i = 0 ; i < n + shift ; i++ )
+	{
+		a[i] = (T)( rand() / (double) RAND_MAX - 0.5 ) ;
+		b[i] = (T)( rand() / (double) RAND_MAX - 0.5 ) ;
+		c[i] = (T)( rand() / (double) RAND_MAX - 0.5 ) ;
+		d[i] = (T)( rand() / (double) RAND_MAX - 0.5 ) ;
+		e[i] = (T)( rand() / (double) RAND_MAX ) ;
+	}
+
+	out.clear() ;
+	T * re = &a[0] + shift, * im = &b[0] + shift ;
+
+	SPECTRAL_multiplySplit( n, re, im, &c[0] + shift, &d[0] + shift ) ;
+	out.insert( out.end(), re, re + n ) ;
+	out.insert( out.end(), im, im + n ) ;
+
+	SPECTRAL_correlateSplit( n, re, im, &c[0] + shift, &d[0] + shift ) ;
+	out.insert( out.end(), re, re + n ) ;
+	out.insert( out.end(), im, im + n ) ;
+
+	SPECTRAL_residualSplit( n, re, im, &c[0] + shift, &d[0] + shift, &e[0] + shift ) ;
+	out.insert( out.end(), re, re + n ) ;
+	out.insert( out.end(), im, im + n ) ;
+}
+
+
+/* the number of lengths on which the kernel set <isa> differs from "scalar" */
+template< class T >
+static int check( const char * isa, size_t MaxLength )
+{
+	std::vector< T > scalar, vector ;
+	int mismatches = 0 ;
+
+	for( size_t n = 0 ; n <= MaxLength ; n++ )
+	{
+		for( size_t shift = 0 ; shift < 2 ; shift++ )
+		{
+			set_spectral_isa( "scalar" ) ;
+			runKernels( n, shift, (unsigned)( n + 1 ), scalar ) ;
+			set_spectral_isa( isa ) ;
+			runKernels( n, shift, (unsigned)( n + 1 ), vector ) ;
+
+			if( n > 0 && memcmp( &scalar[0], &vector[0], scalar.size() * sizeof(T) ) != 0 )
+			{
+				printf( " %-7s %s : mismatch on length %lu shifted by %lu\n", isa,
+				         sizeof(T) == sizeof(double) ? "double" : "float ", (unsigned long) n, (unsigned long) shift ) ;
+				mismatches++ ;
+			}
+		}
+	}
+	return mismatches ;
+}
+
+
+int main( int argc, char ** argv )
+{
+	size_t MaxLength = 69 ;
+	int    mismatches = 0 ;
+
+	if( argc > 2 )
+	{
+		std::cout << usage ;
+		return 1 ;
+	}
+	if( argc > 1 ) MaxLength = (size_t) atol( argv[1] ) ;
+
+	std::string startup = get_spectral_isa() ;
+
+	for( unsigned k = 0 ; k < sizeof( isas ) / sizeof( isas[0] ) ; k++ )
+	{
+		if( !set_spectral_isa( isas[k] ) )
+		{
+			printf( " %-7s : not supported by this CPU, skipped\n", isas[k] ) ;
+			continue ;
+		}
+
+		int m = check< double >( isas[k], MaxLength ) + check< float >( isas[k], MaxLength ) ;
+		printf( " %-7s : %s on lengths 0 to %lu\n", isas[k], m == 0 ? "same as scalar" : "DIFFERS from scalar",
+		         (unsigned long) MaxLength ) ;
+		mismatches += m ;
+	}
+
+	set_spectral_isa( startup.c_str() ) ;
+	return ( mismatches == 0 ) ? 0 : 1 ;
+}
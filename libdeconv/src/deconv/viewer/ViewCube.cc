@@ -303,7 +303,7 @@ void write_cube( void )
 	if( saved_type == 1 )
 	{
 		ByteCube bcube( cube.length(), cube.width(), cube.height() ) ;
-		for( int i = 0 ; i < cube.size() ; i++ ) 
+		for( size_t i = 0 ; i < cube.size() ; i++ ) 
 		{
 			(bcube.data())[i] = byte_contrast( (cube.data())[i], IntensityWindow, IntensityCenter ) ;
 		}  			
@@ -312,7 +312,7 @@ void write_cube( void )
 	else if( saved_type == 2 )
 	{
 		ShortCube scube( cube.length(), cube.width(), cube.height() ) ; 
-		for( int i = 0 ; i < cube.size() ; i++ ) 
+		for( size_t i = 0 ; i < cube.size() ; i++ ) 
 		{
 			(scube.data())[i] = short_contrast( (cube.data())[i], IntensityWindow, IntensityCenter ) ;
 		}
@@ -321,7 +321,7 @@ void write_cube( void )
 	else if( saved_type == 3 )
 	{
 		SingleCube fcube( cube.length(), cube.width(), cube.height() ) ;
-		for( int i = 0 ; i < cube.size() ; i++ ) 
+		for( size_t i = 0 ; i < cube.size() ; i++ ) 
 		{
 			(fcube.data())[i] = (float) contrast( (cube.data())[i], IntensityWindow, IntensityCenter ) ;
  		}
@@ -330,7 +330,7 @@ void write_cube( void )
 	else if( saved_type == 4 )
 	{
 		DoubleCube dcube( cube.length(), cube.width(), cube.height() ) ;
-		for( int i = 0 ; i < cube.size() ; i++ ) 
+		for( size_t i = 0 ; i < cube.size() ; i++ ) 
 		{
 			(dcube.data())[i] = contrast( (cube.data())[i], IntensityWindow, IntensityCenter ) ;
 		}
@@ -888,7 +888,7 @@ void plotMenuFunc( int choice )
 			for( int i = 0 ; i < ndata ; i++ ) data[i] = 0.0 ;
 			if( XYviewON && XZviewON && YZviewON )
 			{
-				for( int i = 0 ; i < cube.size() ; i++ ) 
+				for( size_t i = 0 ; i < cube.size() ; i++ ) 
 				{
 					data[ (int) byte_contrast( (cube.data())[i], IntensityWindow, IntensityCenter ) ]++ ;
 				}
@@ -940,7 +940,7 @@ void plotMenuFunc( int choice )
 			for( int i = 0 ; i < ndata ; i++ ) data[i] = 0.0 ;
 			if( XYviewON && XZviewON && YZviewON )
 			{
-				for( int i = 0 ; i < cube.size() ; i++ ) 
+				for( size_t i = 0 ; i < cube.size() ; i++ ) 
 				{
 					data[ (int) short_contrast( (cube.data())[i], IntensityWindow, IntensityCenter ) ]++ ;
 				}
@@ -1227,7 +1227,7 @@ void operateMenuFunc( int choice )
 			std::cout << " Apply substration : data_intensity = (data_intensity-value, 0)?(data_intensity-value>0).\n"
 			          << " Now, please input the substracted value <<<< " ;
 			std::cin  >> value ;	
-			for( int i = 0 ; i < cube.size() ; i++ ) 
+			for( size_t i = 0 ; i < cube.size() ; i++ ) 
 			{
 				if( (cube.data())[i] - value < 0.0 ) (cube.data())[i] = 0.0 ;
 				else                                 (cube.data())[i] = (cube.data())[i] - value ;
@@ -1252,7 +1252,7 @@ void operateMenuFunc( int choice )
 			std::cin  >> low ;
 			if( low >= 0 )
 			{
-				for( int i = 0 ; i < cube.size() ; i++ )
+				for( size_t i = 0 ; i < cube.size() ; i++ )
 				{
 					(cube.data())[i] = log( (cube.data())[i] * pow( 10.0, (double) low ) + 1.0 ) ;
 				}
@@ -1275,10 +1275,10 @@ void operateMenuFunc( int choice )
 				PowerSpectraON = true ;
 				cubecopy = cube ;
 				double* buf = new double[cube.size()] ;
-				for( int i = 0 ; i < cube.size() ; i++ ) buf[i] = 0.0 ;
+				for( size_t i = 0 ; i < cube.size() ; i++ ) buf[i] = 0.0 ;
 				fft3d( cube.length(), cube.width(), cube.height(), true, true, 
 				       cube.data(), buf, cube.data(), buf ) ;
-				for( int i = 0 ; i < cube.size() ; i++ ) 
+				for( size_t i = 0 ; i < cube.size() ; i++ ) 
 				{
 					(cube.data())[i] = sqrt( (cube.data())[i] * (cube.data())[i] + buf[i] * buf[i] ) ;
 				}
@@ -1305,17 +1305,17 @@ void operateMenuFunc( int choice )
                                                         rx, ry, hz, (unsigned char) 1 ) )
                         {
 								double* buf = new double[cube.size()] ;
-                                for( int i = 0 ; i < cube.size() ; i++ ) buf[i] = 0.0 ;
+                                for( size_t i = 0 ; i < cube.size() ; i++ ) buf[i] = 0.0 ;
                                 fft3d( cube.length(), cube.width(), cube.height(), true, true,
                                        cube.data(), buf, cube.data(), buf ) ;
-                                for( int i = 0 ; i < cube.size() ; i++ )
+                                for( size_t i = 0 ; i < cube.size() ; i++ )
                                 {
                                         (cube.data())[i] *= (double) (filter_cube.data())[i] ;
                                         buf[i] *= (double) (filter_cube.data())[i] ;
                                 }
                                 fft3d( cube.length(), cube.width(), cube.height(), false, true,
                                        cube.data(), buf, cube.data(), buf ) ;
-                                for( int i = 0 ; i < cube.size(); i++ )
+                                for( size_t i = 0 ; i < cube.size() ; i++ )
                                 	if( (cube.data())[i] < 0 ) 
 										(cube.data())[i] = 0.0 ;
 